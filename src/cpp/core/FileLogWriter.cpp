@@ -1,7 +1,7 @@
 /*
  * FileLogWriter.cpp
  *
- * Copyright (C) 2009-17 by RStudio, Inc.
+ * Copyright (C) 2009-18 by RStudio, Inc.
  *
  * Unless you have received this program directly from RStudio pursuant
  * to the terms of a commercial license agreement with RStudio, then
@@ -15,19 +15,108 @@
 
 #include <core/FileLogWriter.hpp>
 
+#include <cstddef>
+#include <cstdlib>
+#include <ostream>
+#include <set>
+
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+#include <boost/foreach.hpp>
+
 #include <core/FileInfo.hpp>
 #include <core/FileSerializer.hpp>
 #include <core/system/System.hpp>
 #include <core/Thread.hpp>
 
+#define LOGMAX (2048*1024)  // rotate/remove every 2 megabytes
+
 namespace rstudio {
 namespace core {
 
+namespace {
+
+// number of entries which can be waiting to be written (must be a power of 2)
+const std::size_t kQueueCapacity = 8192;
+
+// how long the writer sleeps when it isn't woken by new entries, and how
+// often it checks whether the log file was moved or truncated underneath it
+const int kWriterIdleMs = 100;
+const int kFileCheckMs = 1000;
+
+// how long flush() waits for the writer
+const int kFlushTimeoutMs = 2000;
+
+// live writers, flushed at exit (the global log writer is never destroyed
+// so without this entries logged just before exiting would be lost)
+boost::mutex s_writersMutex;
+std::set<FileLogWriter*>* s_pWriters = NULL;
+
+void flushWritersAtExit()
+{
+   try
+   {
+      std::set<FileLogWriter*> writers;
+      LOCK_MUTEX(s_writersMutex)
+      {
+         if (s_pWriters)
+            writers = *s_pWriters;
+      }
+      END_LOCK_MUTEX
+
+      BOOST_FOREACH(FileLogWriter* pWriter, writers)
+      {
+         pWriter->flush();
+      }
+   }
+   catch(...)
+   {
+   }
+}
+
+void registerWriter(FileLogWriter* pWriter)
+{
+   LOCK_MUTEX(s_writersMutex)
+   {
+      if (s_pWriters == NULL)
+      {
+         s_pWriters = new std::set<FileLogWriter*>();
+         std::atexit(flushWritersAtExit);
+      }
+      s_pWriters->insert(pWriter);
+   }
+   END_LOCK_MUTEX
+}
+
+void unregisterWriter(FileLogWriter* pWriter)
+{
+   LOCK_MUTEX(s_writersMutex)
+   {
+      if (s_pWriters)
+         s_pWriters->erase(pWriter);
+   }
+   END_LOCK_MUTEX
+}
+
+} // anonymous namespace
+
 FileLogWriter::FileLogWriter(const std::string& programIdentity,
                              int logLevel,
                              const FilePath& logDir)
                                 : programIdentity_(programIdentity),
-                                  logLevel_(logLevel)
+                                  logLevel_(logLevel),
+                                  slots_(new Slot[kQueueCapacity]),
+                                  slotMask_(kQueueCapacity - 1),
+                                  enqueuePos_(0),
+                                  dequeuePos_(0),
+                                  dropped_(0),
+                                  droppedTotal_(0),
+                                  ownerPid_(core::system::currentProcessId()),
+                                  async_(false),
+                                  writerWaiting_(false),
+                                  writtenPos_(0),
+                                  stopping_(false),
+                                  logFileSize_(0)
 {
    logDir.ensureDirectory();
 
@@ -39,13 +128,42 @@ FileLogWriter::FileLogWriter(const std::string& programIdentity,
       // swallow errors -- we can't log so it doesn't matter
       core::appendToFile(logFile_, "");
    }
+
+   for (std::size_t i = 0; i < kQueueCapacity; i++)
+      slots_[i].sequence = i;
+
+   // start the writer (if we can't then we just write synchronously)
+   core::thread::safeLaunchThread(boost::bind(&FileLogWriter::writerMain, this),
+                                  &writerThread_);
+   if (writerThread_.joinable())
+   {
+      async_ = true;
+      registerWriter(this);
+   }
 }
 
 FileLogWriter::~FileLogWriter()
 {
    try
    {
-      // we don't keep a file handle open so do nothing here
+      if (async_)
+      {
+         unregisterWriter(this);
+
+         // the writer drains the queue before exiting
+         LOCK_MUTEX(wakeMutex_)
+         {
+            stopping_ = true;
+         }
+         END_LOCK_MUTEX
+         wakeWriter_.notify_all();
+
+         // a forked child inherits the thread object but not the thread
+         if (core::system::currentProcessId() == ownerPid_)
+            writerThread_.join();
+         else
+            writerThread_.detach();
+      }
    }
    catch(...)
    {
@@ -65,19 +183,249 @@ void FileLogWriter::log(const std::string& programIdentity,
    if (logLevel > logLevel_)
       return;
 
+   std::string entry = formatLogEntry(programIdentity, message);
+
+   // a forked child has no writer thread
+   if (!async_ || core::system::currentProcessId() != ownerPid_)
+   {
+      logSynchronously(entry);
+      return;
+   }
+
+   if (!enqueue(&entry))
+   {
+      ++dropped_;
+      ++droppedTotal_;
+   }
+
+   // only wake the writer if it's waiting (if it's busy it'll find the
+   // entry when it finishes its current batch)
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   if (writerWaiting_)
+   {
+      LOCK_MUTEX(wakeMutex_)
+      {
+         wakeWriter_.notify_one();
+      }
+      END_LOCK_MUTEX
+   }
+}
+
+void FileLogWriter::flush()
+{
+   if (!async_ || core::system::currentProcessId() != ownerPid_)
+      return;
+
+   std::size_t target = enqueuePos_;
+
+   using namespace boost::posix_time;
+   ptime timeout = microsec_clock::universal_time() +
+                   milliseconds(kFlushTimeoutMs);
+
+   boost::unique_lock<boost::mutex> lock(wakeMutex_);
+   wakeWriter_.notify_one();
+   while (writtenPos_ < target && !stopping_)
+   {
+      if (!batchWritten_.timed_wait(lock, timeout))
+         break;
+   }
+}
+
+// bounded multi-producer queue: each slot's sequence number records whether
+// it is free for the producer claiming position 'pos' (sequence == pos) or
+// holds an entry for the consumer at 'pos' (sequence == pos + 1)
+bool FileLogWriter::enqueue(std::string* pEntry)
+{
+   std::size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+   for (;;)
+   {
+      Slot& slot = slots_[pos & slotMask_];
+      std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence) -
+                            static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0)
+      {
+         if (enqueuePos_.compare_exchange_weak(pos,
+                                               pos + 1,
+                                               std::memory_order_relaxed))
+         {
+            slot.entry.swap(*pEntry);
+            slot.sequence.store(pos + 1, std::memory_order_release);
+            return true;
+         }
+      }
+      else if (diff < 0)
+      {
+         // full
+         return false;
+      }
+      else
+      {
+         pos = enqueuePos_.load(std::memory_order_relaxed);
+      }
+   }
+}
+
+bool FileLogWriter::dequeue(std::string* pEntry)
+{
+   Slot& slot = slots_[dequeuePos_ & slotMask_];
+   std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+   if (sequence != dequeuePos_ + 1)
+      return false;
+
+   pEntry->swap(slot.entry);
+   slot.entry.clear();
+   slot.sequence.store(dequeuePos_ + kQueueCapacity, std::memory_order_release);
+   ++dequeuePos_;
+   return true;
+}
+
+bool FileLogWriter::queueEmpty() const
+{
+   const Slot& slot = slots_[dequeuePos_ & slotMask_];
+   return slot.sequence.load(std::memory_order_acquire) != dequeuePos_ + 1;
+}
+
+void FileLogWriter::writerMain()
+{
+   try
+   {
+      using namespace boost::posix_time;
+      lastFileCheck_ = microsec_clock::universal_time();
+
+      std::string batch;
+      std::string entry;
+      for (;;)
+      {
+         batch.clear();
+         while (dequeue(&entry))
+            batch.append(entry);
+
+         std::size_t dropped = dropped_.exchange(0);
+         if (dropped > 0)
+         {
+            batch.append(formatLogEntry(
+               programIdentity_,
+               (boost::format("%1% log messages dropped") % dropped).str()));
+         }
+
+         if (!batch.empty())
+            writeBatch(batch);
+
+         LOCK_MUTEX(wakeMutex_)
+         {
+            writtenPos_ = dequeuePos_;
+         }
+         END_LOCK_MUTEX
+         batchWritten_.notify_all();
+
+         if (!batch.empty())
+            continue;
+
+         // nothing to write -- wait for more
+         boost::unique_lock<boost::mutex> lock(wakeMutex_);
+         if (stopping_)
+            break;
+
+         writerWaiting_ = true;
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+         if (queueEmpty())
+         {
+            // (the timeout also covers an entry racing with writerWaiting_)
+            wakeWriter_.timed_wait(lock, milliseconds(kWriterIdleMs));
+         }
+         writerWaiting_ = false;
+         lock.unlock();
+
+         checkLogFile();
+      }
+
+      pLogStream_.reset();
+   }
+   catch(...)
+   {
+   }
+}
+
+void FileLogWriter::writeBatch(const std::string& batch)
+{
+   // rotate if the last batch took us over the limit
+   if (logFileSize_ > LOGMAX)
+   {
+      pLogStream_.reset();
+      rotateLogFile();
+      logFileSize_ = 0;
+   }
+
+   if (!pLogStream_)
+      openLogFile();
+
+   if (pLogStream_)
+   {
+      // swallow errors--we can't do anything anyway
+      pLogStream_->write(batch.data(), batch.size());
+      pLogStream_->flush();
+      if (!pLogStream_->good())
+         pLogStream_.reset();
+      else
+         logFileSize_ += batch.size();
+   }
+
+#ifdef _WIN32
+   // files are opened for exclusive access on windows so we can't hold on
+   // to the file without locking out other processes logging to it
+   pLogStream_.reset();
+#endif
+}
+
+void FileLogWriter::openLogFile()
+{
+   Error error = logFile_.open_w(&pLogStream_, false);
+   if (error)
+   {
+      pLogStream_.reset();
+      return;
+   }
+
+   logFileSize_ = logFile_.size();
+}
+
+// other processes may share the log file, so periodically pick up its real
+// size (they'll have grown it too) and reopen it if one of them has rotated
+// it out from under us
+void FileLogWriter::checkLogFile()
+{
+   using namespace boost::posix_time;
+   ptime now = microsec_clock::universal_time();
+   if (now - lastFileCheck_ < milliseconds(kFileCheckMs))
+      return;
+   lastFileCheck_ = now;
+
+   if (!logFile_.exists())
+   {
+      pLogStream_.reset();
+      logFileSize_ = 0;
+      return;
+   }
+
+   uintmax_t size = logFile_.size();
+   if (size < logFileSize_)
+      pLogStream_.reset();
+   logFileSize_ = size;
+}
+
+void FileLogWriter::logSynchronously(const std::string& entry)
+{
    LOCK_MUTEX(mutex_)
    {
       rotateLogFile();
 
       // Swallow errors--we can't do anything anyway
-      core::appendToFile(logFile_, formatLogEntry(programIdentity, message));
+      core::appendToFile(logFile_, entry);
    }
    END_LOCK_MUTEX
 }
 
-
-
-#define LOGMAX (2048*1024)  // rotate/remove every 2 megabytes
 bool FileLogWriter::rotateLogFile()
 {
    if (logFile_.exists() && logFile_.size() > LOGMAX)
@@ -0,0 +1,149 @@
+/*
+ * FileLogWriterTests.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <core/FileLogWriter.hpp>
+#include <core/FileSerializer.hpp>
+
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace unit_tests {
+
+namespace {
+
+void logMessages(FileLogWriter* pWriter, int thread, int count)
+{
+   for (int i = 0; i < count; i++)
+   {
+      pWriter->log(core::system::kLogLevelError,
+                   (boost::format("message %1%-%2%") % thread % i).str());
+   }
+}
+
+std::vector<std::string> readLines(const FilePath& file)
+{
+   std::string contents;
+   readStringFromFile(file, &contents);
+
+   std::vector<std::string> lines;
+   boost::algorithm::split(lines, contents, boost::algorithm::is_any_of("\n"));
+   if (!lines.empty() && lines.back().empty())
+      lines.pop_back();
+   return lines;
+}
+
+} // anonymous namespace
+
+context("FileLogWriter")
+{
+   FilePath logDir;
+   FilePath::tempFilePath(&logDir);
+
+   test_that("Entries logged from many threads are all written or counted as dropped")
+   {
+      const int kThreads = 4;
+      const int kCount = 5000;
+
+      boost::scoped_ptr<FileLogWriter> pWriter(
+               new FileLogWriter("test-threads", core::system::kLogLevelWarning, logDir));
+
+      boost::thread_group threads;
+      for (int i = 0; i < kThreads; i++)
+         threads.create_thread(boost::bind(logMessages, pWriter.get(), i, kCount));
+      threads.join_all();
+      pWriter->flush();
+
+      std::size_t written = 0;
+      std::size_t dropped = 0;
+      std::vector<std::string> lines = readLines(logDir.childPath("test-threads.log"));
+      for (std::size_t i = 0; i < lines.size(); i++)
+      {
+         const std::string& line = lines[i];
+         expect_true(line.find(" [test-threads] ") != std::string::npos);
+         if (boost::algorithm::ends_with(line, " log messages dropped"))
+         {
+            std::size_t start = line.find("] ") + 2;
+            std::size_t end = line.find(' ', start);
+            dropped += boost::lexical_cast<std::size_t>(line.substr(start, end - start));
+         }
+         else
+         {
+            ++written;
+         }
+      }
+
+      expect_true(dropped == pWriter->droppedCount());
+      expect_true(written + dropped == static_cast<std::size_t>(kThreads * kCount));
+      pWriter.reset();
+   }
+
+   test_that("Entries below the log level are ignored")
+   {
+      boost::scoped_ptr<FileLogWriter> pWriter(
+               new FileLogWriter("test-level", core::system::kLogLevelWarning, logDir));
+      pWriter->log(core::system::kLogLevelDebug, "debug");
+      pWriter->log(core::system::kLogLevelWarning, "warning");
+      pWriter->flush();
+
+      std::vector<std::string> lines = readLines(logDir.childPath("test-level.log"));
+      expect_true(lines.size() == 1);
+      expect_true(boost::algorithm::ends_with(lines[0], "warning"));
+      pWriter.reset();
+   }
+
+   test_that("The log file is rotated once it exceeds the size limit")
+   {
+      boost::scoped_ptr<FileLogWriter> pWriter(
+               new FileLogWriter("test-rotate", core::system::kLogLevelWarning, logDir));
+
+      std::string message(1024, 'x');
+      for (int i = 0; i < 2500; i++)
+      {
+         pWriter->log(core::system::kLogLevelError, message);
+         if (i % 100 == 0)
+            pWriter->flush();
+      }
+      pWriter->flush();
+      pWriter->log(core::system::kLogLevelError, "after rotation");
+      pWriter.reset();
+
+      FilePath logFile = logDir.childPath("test-rotate.log");
+      FilePath rotatedLogFile = logDir.childPath("test-rotate.rotated.log");
+      expect_true(rotatedLogFile.exists());
+      expect_true(rotatedLogFile.size() > 2048 * 1024);
+      expect_true(logFile.size() < rotatedLogFile.size());
+
+      std::vector<std::string> lines = readLines(logFile);
+      expect_true(!lines.empty());
+      expect_true(boost::algorithm::ends_with(lines.back(), "after rotation"));
+   }
+
+   logDir.removeIfExists();
+}
+
+} // namespace unit_tests
+} // namespace core
+} // namespace rstudio
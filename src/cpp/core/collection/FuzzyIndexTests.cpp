@@ -0,0 +1,161 @@
+/*
+ * FuzzyIndexTests.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <set>
+
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+
+#include <tests/TestThat.hpp>
+
+#include <core/StringUtils.hpp>
+#include <core/collection/FuzzyIndex.hpp>
+
+namespace rstudio {
+namespace core {
+namespace unit_tests {
+
+using namespace core::collection;
+
+namespace {
+
+typedef FuzzyIndex<std::string> Index;
+
+void collect(const Index& index, std::set<std::string>* pNames, Index::Id id)
+{
+   pNames->insert(index.name(id));
+}
+
+std::set<std::string> subsequenceMatches(const Index& index, const std::string& query)
+{
+   std::set<std::string> names;
+   index.forEachSubsequenceMatch(query, boost::bind(collect, boost::cref(index), &names, _1));
+   return names;
+}
+
+std::set<std::string> prefixMatches(const Index& index, const std::string& query)
+{
+   std::set<std::string> names;
+   index.forEachPrefixMatch(query, boost::bind(collect, boost::cref(index), &names, _1));
+   return names;
+}
+
+} // anonymous namespace
+
+context("FuzzyIndex")
+{
+   test_that("Subsequence lookups agree with string_utils::isSubsequence")
+   {
+      const char* names[] = {
+         "SessionCodeSearch.cpp", "session.R", "README", "foo_bar.R",
+         "FooBar.R", "utils.R", "RcppExports.cpp", "a", ""
+      };
+      const char* queries[] = {
+         "", "s", "scs", "SCS", "sess.r", "fb", "fbr", "readme", "xyz", "a"
+      };
+
+      Index index;
+      for (std::size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+         index.insert(names[i], names[i]);
+
+      for (std::size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); q++)
+      {
+         std::set<std::string> expected;
+         for (std::size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+         {
+            if (string_utils::isSubsequence(names[i], queries[q], true))
+               expected.insert(names[i]);
+         }
+         expect_true(subsequenceMatches(index, queries[q]) == expected);
+      }
+   }
+
+   test_that("Prefix lookups ignore case")
+   {
+      Index index;
+      index.insert("Session.R", "1");
+      index.insert("sessionInfo.R", "2");
+      index.insert("other.R", "3");
+
+      std::set<std::string> matches = prefixMatches(index, "SESS");
+      expect_true(matches.size() == 2);
+      expect_true(matches.count("Session.R") == 1);
+      expect_true(matches.count("sessionInfo.R") == 1);
+      expect_true(prefixMatches(index, "x").empty());
+   }
+
+   test_that("Removed names are no longer returned and ids are recycled")
+   {
+      Index index;
+      std::vector<Index::Id> ids;
+      for (int i = 0; i < 200; i++)
+         ids.push_back(index.insert((boost::format("file%1%.R") % i).str(), "v"));
+
+      for (int i = 0; i < 150; i++)
+         index.remove(ids[i]);
+
+      expect_true(index.size() == 50);
+      expect_true(subsequenceMatches(index, "file1").count("file10.R") == 0);
+      expect_true(subsequenceMatches(index, "file1").count("file150.R") == 1);
+      expect_true(prefixMatches(index, "file").size() == 50);
+
+      // new names should reuse the freed slots without resurrecting
+      // any of the removed names
+      index.insert("replacement.R", "r");
+      expect_true(subsequenceMatches(index, "file").size() == 50);
+      expect_true(subsequenceMatches(index, "rplc").size() == 1);
+      expect_true(index.size() == 51);
+   }
+
+   test_that("TopScores keeps the k lowest scores in order")
+   {
+      TopScores<std::string> top(3);
+      top.add(5, "e");
+      top.add(1, "a");
+      top.add(4, "d");
+      top.add(1, "a2");
+      top.add(3, "c");
+
+      std::vector< std::pair<int, std::string> > results = top.sorted();
+      expect_true(results.size() == 3);
+      expect_true(results[0].second == "a");
+      expect_true(results[1].second == "a2");
+      expect_true(results[2].second == "c");
+      expect_true(top.truncated());
+
+      TopScores<std::string> all(10);
+      all.add(2, "x");
+      expect_false(all.truncated());
+   }
+
+   test_that("Ids are recycled once a fraction of the names are removed")
+   {
+      Index index;
+      std::vector<Index::Id> ids;
+      for (int i = 0; i < 1000; i++)
+         ids.push_back(index.insert((boost::format("file%1%.R") % i).str(), "v"));
+
+      for (int i = 0; i < 300; i++)
+         index.remove(ids[i]);
+
+      Index::Id id = index.insert("replacement.R", "r");
+      expect_true(id < 1000);
+      expect_true(subsequenceMatches(index, "file").size() == 700);
+   }
+}
+
+} // namespace unit_tests
+} // namespace core
+} // namespace rstudio
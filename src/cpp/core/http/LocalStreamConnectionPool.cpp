@@ -0,0 +1,281 @@
+/*
+ * LocalStreamConnectionPool.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/http/LocalStreamConnectionPool.hpp>
+
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <boost/format.hpp>
+
+#include <core/Error.hpp>
+#include <core/Log.hpp>
+#include <core/Thread.hpp>
+
+#include <core/http/SocketUtils.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+namespace {
+
+// how often we sweep all of the pools for expired connections
+const boost::posix_time::time_duration kEvictionInterval =
+                                          boost::posix_time::seconds(10);
+
+boost::posix_time::ptime now()
+{
+   return boost::posix_time::microsec_clock::universal_time();
+}
+
+// an idle keep-alive connection should have nothing to read: if the peer
+// has closed the connection we'll see eof and if it has written something
+// unsolicited then the connection is no longer in a known state
+bool isHealthy(const boost::shared_ptr<LocalStreamSocket>& pSocket)
+{
+   if (!pSocket->is_open())
+      return false;
+
+   char ch;
+   ssize_t result = ::recv(pSocket->native_handle(),
+                           &ch,
+                           1,
+                           MSG_PEEK | MSG_DONTWAIT);
+   if (result == -1)
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+   else
+      return false;
+}
+
+void closeIdleSocket(const boost::shared_ptr<LocalStreamSocket>& pSocket)
+{
+   Error error = closeSocket(*pSocket);
+   if (error && !isConnectionTerminatedError(error))
+      LOG_ERROR(error);
+}
+
+} // anonymous namespace
+
+LocalStreamConnectionPool::LocalStreamConnectionPool(
+                     std::size_t maxIdlePerStream,
+                     const boost::posix_time::time_duration& idleTimeout)
+   : maxIdlePerStream_(maxIdlePerStream),
+     idleTimeout_(idleTimeout),
+     lastEviction_(now())
+{
+}
+
+LocalStreamConnectionPool::~LocalStreamConnectionPool()
+{
+   try
+   {
+      for (std::map<std::string, IdleConnections>::iterator it = idle_.begin();
+           it != idle_.end();
+           ++it)
+      {
+         for (IdleConnections::iterator connIt = it->second.begin();
+              connIt != it->second.end();
+              ++connIt)
+         {
+            closeIdleSocket(connIt->pSocket);
+         }
+      }
+   }
+   catch(...)
+   {
+   }
+}
+
+boost::shared_ptr<LocalStreamSocket> LocalStreamConnectionPool::checkout(
+                                       boost::asio::io_service& ioService,
+                                       const std::string& streamPath)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      boost::posix_time::ptime currentTime = now();
+      evictExpired(currentTime);
+
+      std::map<std::string, IdleConnections>::iterator it =
+                                                   idle_.find(streamPath);
+      if (it != idle_.end())
+      {
+         IdleConnections& connections = it->second;
+
+         // prefer the most recently used connection (it is the least
+         // likely to have been closed by the other end)
+         while (!connections.empty())
+         {
+            IdleConnection connection = connections.back();
+            connections.pop_back();
+
+            if (connection.pIoService != &ioService)
+            {
+               // sockets are bound to the io_service that created them
+               // so we can't hand this one out
+               closeIdleSocket(connection.pSocket);
+               stats_.evictions++;
+            }
+            else if (!isHealthy(connection.pSocket))
+            {
+               closeIdleSocket(connection.pSocket);
+               stats_.stale++;
+            }
+            else
+            {
+               if (connections.empty())
+                  idle_.erase(it);
+
+               stats_.hits++;
+               return connection.pSocket;
+            }
+         }
+
+         idle_.erase(it);
+      }
+
+      stats_.misses++;
+   }
+   END_LOCK_MUTEX
+
+   return boost::shared_ptr<LocalStreamSocket>();
+}
+
+void LocalStreamConnectionPool::checkin(
+                     boost::asio::io_service& ioService,
+                     const std::string& streamPath,
+                     const boost::shared_ptr<LocalStreamSocket>& pSocket)
+{
+   if (!pSocket || !pSocket->is_open())
+      return;
+
+   LOCK_MUTEX(mutex_)
+   {
+      boost::posix_time::ptime currentTime = now();
+      evictExpired(currentTime);
+
+      IdleConnections& connections = idle_[streamPath];
+
+      // enforce the per-stream limit by dropping the oldest connection
+      if (connections.size() >= maxIdlePerStream_)
+      {
+         closeIdleSocket(connections.front().pSocket);
+         connections.pop_front();
+         stats_.evictions++;
+      }
+
+      IdleConnection connection;
+      connection.pIoService = &ioService;
+      connection.pSocket = pSocket;
+      connection.idleSince = currentTime;
+      connections.push_back(connection);
+   }
+   END_LOCK_MUTEX
+}
+
+void LocalStreamConnectionPool::recordStale()
+{
+   LOCK_MUTEX(mutex_)
+   {
+      stats_.stale++;
+   }
+   END_LOCK_MUTEX
+}
+
+void LocalStreamConnectionPool::clear(const std::string& streamPath)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      std::map<std::string, IdleConnections>::iterator it =
+                                                   idle_.find(streamPath);
+      if (it == idle_.end())
+         return;
+
+      for (IdleConnections::iterator connIt = it->second.begin();
+           connIt != it->second.end();
+           ++connIt)
+      {
+         closeIdleSocket(connIt->pSocket);
+         stats_.evictions++;
+      }
+
+      idle_.erase(it);
+   }
+   END_LOCK_MUTEX
+}
+
+LocalStreamConnectionPool::Stats LocalStreamConnectionPool::stats()
+{
+   LOCK_MUTEX(mutex_)
+   {
+      return stats_;
+   }
+   END_LOCK_MUTEX
+
+   return Stats();
+}
+
+// NOTE: must be called with mutex_ held
+void LocalStreamConnectionPool::evictExpired(
+                                    const boost::posix_time::ptime& now)
+{
+   if ((now - lastEviction_) < kEvictionInterval)
+      return;
+
+   lastEviction_ = now;
+   logStats();
+
+   std::map<std::string, IdleConnections>::iterator it = idle_.begin();
+   while (it != idle_.end())
+   {
+      // connections are ordered oldest first
+      IdleConnections& connections = it->second;
+      while (!connections.empty() &&
+             (now - connections.front().idleSince) > idleTimeout_)
+      {
+         closeIdleSocket(connections.front().pSocket);
+         connections.pop_front();
+         stats_.evictions++;
+      }
+
+      if (connections.empty())
+         idle_.erase(it++);
+      else
+         ++it;
+   }
+}
+
+// NOTE: must be called with mutex_ held
+void LocalStreamConnectionPool::logStats()
+{
+   if (stats_.hits == loggedStats_.hits &&
+       stats_.misses == loggedStats_.misses &&
+       stats_.stale == loggedStats_.stale &&
+       stats_.evictions == loggedStats_.evictions)
+   {
+      return;
+   }
+
+   loggedStats_ = stats_;
+   LOG_DEBUG_MESSAGE(boost::str(
+      boost::format("Connection pool: %1% hits, %2% misses, %3% stale, "
+                    "%4% evictions")
+         % stats_.hits % stats_.misses % stats_.stale % stats_.evictions));
+}
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
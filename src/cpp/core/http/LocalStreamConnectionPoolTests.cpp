@@ -0,0 +1,231 @@
+/*
+ * LocalStreamConnectionPoolTests.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef _WIN32
+
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/asio/local/connect_pair.hpp>
+
+#include <core/FilePath.hpp>
+#include <core/Thread.hpp>
+#include <core/http/LocalStreamAsyncClient.hpp>
+#include <core/http/LocalStreamConnectionPool.hpp>
+
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+namespace tests {
+
+namespace {
+
+const char * const kStreamPath = "/tmp/rstudio-pool-test-stream";
+
+void connectPair(boost::asio::io_service& ioService,
+                 boost::shared_ptr<LocalStreamSocket>* pClient,
+                 boost::shared_ptr<LocalStreamSocket>* pServer)
+{
+   pClient->reset(new LocalStreamSocket(ioService));
+   pServer->reset(new LocalStreamSocket(ioService));
+   boost::asio::local::connect_pair(**pClient, **pServer);
+}
+
+// serve keep-alive responses to requests on a single connection, noting
+// how many were served (and whether any other connections were made)
+void serveKeepAlive(boost::asio::io_service* pIoService,
+                    boost::asio::local::stream_protocol::acceptor* pAcceptor,
+                    int requestCount,
+                    int* pServed)
+{
+   try
+   {
+      LocalStreamSocket socket(*pIoService);
+      pAcceptor->accept(socket);
+
+      boost::asio::streambuf buffer;
+      for (int i = 0; i < requestCount; i++)
+      {
+         std::size_t length = boost::asio::read_until(socket, buffer, "\r\n\r\n");
+         buffer.consume(length);
+         boost::asio::write(socket, boost::asio::buffer(std::string(
+               "HTTP/1.1 200 OK\r\n"
+               "Connection: keep-alive\r\n"
+               "Content-Length: 2\r\n"
+               "\r\n"
+               "ok")));
+         ++*pServed;
+      }
+   }
+   catch(const boost::system::system_error&)
+   {
+   }
+}
+
+void executeRequest(boost::asio::io_service& ioService,
+                    const boost::shared_ptr<LocalStreamConnectionPool>& pPool,
+                    const FilePath& streamPath,
+                    int remaining,
+                    int* pResponses);
+
+void handleResponse(boost::asio::io_service& ioService,
+                    const boost::shared_ptr<LocalStreamConnectionPool>& pPool,
+                    const FilePath& streamPath,
+                    int remaining,
+                    int* pResponses,
+                    const Response& response)
+{
+   if (response.body() == "ok")
+      ++*pResponses;
+
+   if (remaining > 0)
+      executeRequest(ioService, pPool, streamPath, remaining, pResponses);
+}
+
+void handleError(boost::asio::io_service& ioService, const Error&)
+{
+   ioService.stop();
+}
+
+void executeRequest(boost::asio::io_service& ioService,
+                    const boost::shared_ptr<LocalStreamConnectionPool>& pPool,
+                    const FilePath& streamPath,
+                    int remaining,
+                    int* pResponses)
+{
+   boost::shared_ptr<LocalStreamAsyncClient> pClient(
+         new LocalStreamAsyncClient(ioService, streamPath));
+   pClient->setConnectionPool(pPool);
+   pClient->request().setMethod("GET");
+   pClient->request().setUri("/");
+   pClient->execute(boost::bind(handleResponse,
+                                boost::ref(ioService),
+                                pPool,
+                                streamPath,
+                                remaining - 1,
+                                pResponses,
+                                _1),
+                    boost::bind(handleError, boost::ref(ioService), _1));
+}
+
+} // anonymous namespace
+
+context("LocalStreamConnectionPoolTests")
+{
+   test_that("Empty pool records a miss")
+   {
+      boost::asio::io_service ioService;
+      LocalStreamConnectionPool pool;
+
+      expect_false(pool.checkout(ioService, kStreamPath));
+      expect_true(pool.stats().misses == 1);
+      expect_true(pool.stats().hits == 0);
+   }
+
+   test_that("Idle connections are reused")
+   {
+      boost::asio::io_service ioService;
+      LocalStreamConnectionPool pool;
+
+      boost::shared_ptr<LocalStreamSocket> pClient, pServer;
+      connectPair(ioService, &pClient, &pServer);
+
+      pool.checkin(ioService, kStreamPath, pClient);
+      expect_true(pool.checkout(ioService, kStreamPath) == pClient);
+      expect_true(pool.stats().hits == 1);
+
+      // the connection is no longer idle once checked out
+      expect_false(pool.checkout(ioService, kStreamPath));
+   }
+
+   test_that("Connections closed by the peer are discarded")
+   {
+      boost::asio::io_service ioService;
+      LocalStreamConnectionPool pool;
+
+      boost::shared_ptr<LocalStreamSocket> pClient, pServer;
+      connectPair(ioService, &pClient, &pServer);
+
+      pool.checkin(ioService, kStreamPath, pClient);
+      pServer->close();
+
+      expect_false(pool.checkout(ioService, kStreamPath));
+      expect_true(pool.stats().stale == 1);
+      expect_false(pClient->is_open());
+   }
+
+   test_that("Idle connections per stream are bounded")
+   {
+      boost::asio::io_service ioService;
+      LocalStreamConnectionPool pool(1);
+
+      boost::shared_ptr<LocalStreamSocket> pClient1, pServer1;
+      connectPair(ioService, &pClient1, &pServer1);
+      boost::shared_ptr<LocalStreamSocket> pClient2, pServer2;
+      connectPair(ioService, &pClient2, &pServer2);
+
+      pool.checkin(ioService, kStreamPath, pClient1);
+      pool.checkin(ioService, kStreamPath, pClient2);
+
+      expect_true(pool.stats().evictions == 1);
+      expect_false(pClient1->is_open());
+      expect_true(pool.checkout(ioService, kStreamPath) == pClient2);
+   }
+
+   test_that("Async clients reuse keep-alive connections")
+   {
+      FilePath streamPath;
+      expect_false(FilePath::tempFilePath(&streamPath));
+
+      boost::asio::io_service serverIoService;
+      boost::asio::local::stream_protocol::acceptor acceptor(
+            serverIoService,
+            boost::asio::local::stream_protocol::endpoint(
+                                          streamPath.absolutePath()));
+
+      // both requests are served on the first connection
+      const int kRequests = 2;
+      int served = 0;
+      boost::thread serverThread;
+      core::thread::safeLaunchThread(
+               boost::bind(serveKeepAlive, &serverIoService, &acceptor,
+                           kRequests, &served),
+               &serverThread);
+
+      boost::asio::io_service ioService;
+      boost::shared_ptr<LocalStreamConnectionPool> pPool(
+            new LocalStreamConnectionPool());
+      int responses = 0;
+      executeRequest(ioService, pPool, streamPath, kRequests, &responses);
+      ioService.run();
+      serverThread.join();
+
+      expect_true(responses == kRequests);
+      expect_true(served == kRequests);
+      expect_true(pPool->stats().misses == 1);
+      expect_true(pPool->stats().hits == 1);
+
+      streamPath.removeIfExists();
+   }
+}
+
+} // namespace tests
+} // namespace http
+} // namespace core
+} // namespace rstudio
+
+#endif // !_WIN32
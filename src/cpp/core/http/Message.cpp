@@ -30,6 +30,7 @@ namespace http {
   
 // encodings
 const char * const kGzipEncoding = "gzip";
+const char * const kDeflateEncoding = "deflate";
 
 // transfer encodings
 const char * const kTransferEncoding = "Transfer-Encoding";
@@ -155,6 +156,7 @@ void Message::reset()
    httpVersion_.clear() ;
    headers_.clear() ;
    body_.clear() ;
+   pSharedBody_.reset() ;
    
    // allow additional reseting by subclasses
    resetMembers() ;
@@ -188,7 +190,7 @@ std::vector<boost::asio::const_buffer> Message::toBuffers(
    buffers.insert(buffers.end(), headerBuffs.begin(), headerBuffs.end());
 
    // body
-   buffers.push_back(boost::asio::buffer(body_)) ;
+   buffers.push_back(boost::asio::buffer(body())) ;
 
    // return the buffers
    return buffers ;
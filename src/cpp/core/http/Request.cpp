@@ -186,6 +186,7 @@ std::string Request::queryParamValue(const std::string& name) const
 void Request::setBody(const std::string& body)
 {
    body_ = body;
+   pSharedBody_.reset();
    setContentLength(static_cast<int>(body_.length()));
 }
    
@@ -27,6 +27,7 @@
 #include <core/http/URL.hpp>
 #include <core/http/Util.hpp>
 #include <core/http/Cookie.hpp>
+#include <core/http/StaticFileCache.hpp>
 #include <core/Hash.hpp>
 #include <core/RegexUtils.hpp>
 
@@ -36,6 +37,31 @@ namespace rstudio {
 namespace core {
 namespace http {
 
+namespace {
+
+// does an If-None-Match header value (a list of entity tags, or "*") match
+// the given entity tag? (using the weak comparison required for GET)
+bool eTagMatches(const std::string& ifNoneMatch, const std::string& eTag)
+{
+   std::vector<std::string> eTags;
+   boost::algorithm::split(eTags, ifNoneMatch, boost::algorithm::is_any_of(","));
+   for (std::vector<std::string>::iterator it = eTags.begin();
+        it != eTags.end();
+        ++it)
+   {
+      std::string candidate = boost::algorithm::trim_copy(*it);
+      if (boost::algorithm::starts_with(candidate, "W/"))
+         candidate = candidate.substr(2);
+
+      if (candidate == "*" || candidate == eTag)
+         return true;
+   }
+
+   return false;
+}
+
+} // anonymous namespace
+
 Response::Response() 
    : Message(), statusCode_(status::Ok) 
 {
@@ -174,6 +200,64 @@ Error Response::setCacheableBody(const FilePath& filePath,
    return setCacheableBody(content, request);
 }
 
+void Response::setSharedBody(
+                           const boost::shared_ptr<const std::string>& pBody)
+{
+   body_.clear();
+   pSharedBody_ = pBody;
+   setContentLength(static_cast<int>(pBody->length()));
+}
+
+void Response::setStaticFile(const FilePath& filePath, const Request& request)
+{
+   // ensure that the file exists
+   if (!filePath.exists())
+   {
+      setNotFoundError(request.uri());
+      return;
+   }
+
+   // html sent to qt is padded when it's read (see setBody), so serve it
+   // from disk; likewise for files which aren't in the cache
+   boost::shared_ptr<const StaticFile> pFile;
+   bool padding =
+       browser_utils::isQt(request.headerValue("User-Agent")) &&
+       filePath.mimeContentType() == "text/html";
+   if (!padding)
+      pFile = staticFileCache().file(filePath);
+   if (!pFile)
+   {
+      setCacheableFile(filePath, request);
+      return;
+   }
+
+   // each encoding has its own entity tag
+   bool gzip = pFile->pGzipContent && request.acceptsEncoding(kGzipEncoding);
+   std::string eTag = gzip ? pFile->gzipETag : pFile->eTag;
+   setHeader("ETag", eTag);
+
+   using namespace boost::posix_time;
+   ptime lastModifiedDate = from_time_t(pFile->lastWriteTime);
+   setHeader("Last-Modified", util::httpDate(lastModifiedDate));
+
+   // If-None-Match takes precedence over If-Modified-Since
+   std::string ifNoneMatch = request.headerValue("If-None-Match");
+   bool notModified = !ifNoneMatch.empty() ?
+                         eTagMatches(ifNoneMatch, eTag) :
+                         lastModifiedDate == request.ifModifiedSince();
+   if (notModified)
+   {
+      removeHeader("Content-Type"); // upstream code may have set this
+      setStatusCode(status::NotModified);
+      return;
+   }
+
+   setContentType(pFile->contentType);
+   if (gzip)
+      setContentEncoding(kGzipEncoding);
+   setSharedBody(gzip ? pFile->pGzipContent : pFile->pContent);
+}
+
 void Response::setDynamicHtml(const std::string& html,
                               const Request& request)
 {
@@ -265,6 +349,7 @@ void Response::setBodyUnencoded(const std::string& body)
 {
    removeHeader("Content-Encoding");
    body_ = body;
+   pSharedBody_.reset();
    setContentLength(static_cast<int>(body_.length()));
 }
    
@@ -0,0 +1,266 @@
+/*
+ * StaticFileCache.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/http/StaticFileCache.hpp>
+
+#include <sstream>
+
+#include <boost/bind.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Hash.hpp>
+#include <core/Log.hpp>
+#include <core/SafeConvert.hpp>
+#include <core/Thread.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+namespace {
+
+// files beyond this size are served from disk
+const std::size_t kMaxStaticFileSize = 16 * 1024 * 1024;
+
+// enough for the web application's files
+const std::size_t kMaxStaticFileBytes = 96 * 1024 * 1024;
+
+std::string strongETag(const std::string& content, const std::string& suffix)
+{
+   return "\"" + hash::crc32Hash(content) + "-" +
+          safe_convert::numberToString(content.size()) + suffix + "\"";
+}
+
+// text formats compress well (images, fonts and archives are mostly
+// compressed already, so compressing them just costs time)
+bool isCompressible(const std::string& contentType)
+{
+   return boost::algorithm::starts_with(contentType, "text/") ||
+          boost::algorithm::contains(contentType, "javascript") ||
+          boost::algorithm::contains(contentType, "json") ||
+          boost::algorithm::contains(contentType, "xml");
+}
+
+Error gzipContent(const std::string& content, std::string* pCompressed)
+{
+   try
+   {
+      std::istringstream is(content);
+      std::ostringstream os;
+      boost::iostreams::filtering_ostream filteringStream;
+      filteringStream.push(boost::iostreams::gzip_compressor());
+      filteringStream.push(os);
+      boost::iostreams::copy(is, filteringStream);
+      *pCompressed = os.str();
+      return Success();
+   }
+   catch(const std::exception& e)
+   {
+      Error error = systemError(boost::system::errc::io_error,
+                                ERROR_LOCATION);
+      error.addProperty("what", e.what());
+      return error;
+   }
+}
+
+Error loadStaticFile(const FilePath& filePath,
+                     boost::shared_ptr<StaticFile>* pFile)
+{
+   boost::shared_ptr<StaticFile> pStaticFile = boost::make_shared<StaticFile>();
+   pStaticFile->contentType = filePath.mimeContentType();
+   pStaticFile->lastWriteTime = filePath.lastWriteTime();
+   pStaticFile->fileSize = static_cast<std::size_t>(filePath.size());
+
+   boost::shared_ptr<std::string> pContent = boost::make_shared<std::string>();
+   Error error = readStringFromFile(filePath, pContent.get());
+   if (error)
+      return error;
+   pStaticFile->eTag = strongETag(*pContent, "");
+   pStaticFile->pContent = pContent;
+
+#ifndef _WIN32
+   // keep the gzip encoding if it's any smaller (never compress on win32)
+   if (isCompressible(pStaticFile->contentType))
+   {
+      boost::shared_ptr<std::string> pGzipContent =
+            boost::make_shared<std::string>();
+      error = gzipContent(*pContent, pGzipContent.get());
+      if (error)
+         return error;
+      if (pGzipContent->size() < pContent->size())
+      {
+         pStaticFile->gzipETag = strongETag(*pContent, "-gzip");
+         pStaticFile->pGzipContent = pGzipContent;
+      }
+   }
+#endif
+
+   *pFile = pStaticFile;
+   return Success();
+}
+
+std::size_t staticFileBytes(const StaticFile& file)
+{
+   std::size_t bytes = file.pContent->size();
+   if (file.pGzipContent)
+      bytes += file.pGzipContent->size();
+   return bytes;
+}
+
+bool addDirectoryFile(StaticFileCache* pCache,
+                      std::size_t maxBytes,
+                      int,
+                      const FilePath& filePath)
+{
+   if (!filePath.isDirectory())
+      pCache->file(filePath);
+
+   // keep going until the cache is full
+   return pCache->bytes() < maxBytes;
+}
+
+} // anonymous namespace
+
+StaticFileCache& staticFileCache()
+{
+   static StaticFileCache instance(kMaxStaticFileSize, kMaxStaticFileBytes);
+   return instance;
+}
+
+StaticFileCache::StaticFileCache(std::size_t maxFileSize, std::size_t maxBytes)
+   : maxFileSize_(maxFileSize), maxBytes_(maxBytes), bytes_(0)
+{
+}
+
+Error StaticFileCache::addDirectory(const FilePath& directory)
+{
+   if (!directory.exists())
+      return Success();
+
+   return directory.childrenRecursive(
+                     boost::bind(addDirectoryFile, this, maxBytes_, _1, _2));
+}
+
+boost::shared_ptr<const StaticFile> StaticFileCache::file(
+                                                const FilePath& filePath)
+{
+   if (!filePath.exists() || filePath.isDirectory())
+      return boost::shared_ptr<const StaticFile>();
+
+   // return the cached file if it's up to date (the size is compared as
+   // well since the write time has a resolution of a second)
+   std::time_t lastWriteTime = filePath.lastWriteTime();
+   std::size_t fileSize = static_cast<std::size_t>(filePath.size());
+   LOCK_MUTEX(mutex_)
+   {
+      std::map<std::string, boost::shared_ptr<const StaticFile> >::const_iterator
+            it = files_.find(filePath.absolutePath());
+      if (it != files_.end())
+      {
+         if (it->second->lastWriteTime == lastWriteTime &&
+             it->second->fileSize == fileSize)
+         {
+            return it->second;
+         }
+      }
+
+      // don't bother loading new files once the cache is full
+      else if (bytes_ + fileSize > maxBytes_)
+      {
+         return boost::shared_ptr<const StaticFile>();
+      }
+   }
+   END_LOCK_MUTEX
+
+   if (fileSize > maxFileSize_)
+      return boost::shared_ptr<const StaticFile>();
+
+   // load the file (outside of the lock, as this reads and compresses it)
+   boost::shared_ptr<const StaticFile> pFile;
+   if (!addFile(filePath, &pFile))
+      return boost::shared_ptr<const StaticFile>();
+
+   return pFile;
+}
+
+std::size_t StaticFileCache::size()
+{
+   LOCK_MUTEX(mutex_)
+   {
+      return files_.size();
+   }
+   END_LOCK_MUTEX
+
+   return 0;
+}
+
+std::size_t StaticFileCache::bytes()
+{
+   LOCK_MUTEX(mutex_)
+   {
+      return bytes_;
+   }
+   END_LOCK_MUTEX
+
+   return 0;
+}
+
+bool StaticFileCache::addFile(const FilePath& filePath,
+                              boost::shared_ptr<const StaticFile>* pFile)
+{
+   boost::shared_ptr<StaticFile> pStaticFile;
+   Error error = loadStaticFile(filePath, &pStaticFile);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return false;
+   }
+   *pFile = pStaticFile;
+
+   LOCK_MUTEX(mutex_)
+   {
+      // replace any previous version of the file
+      std::string key = filePath.absolutePath();
+      std::map<std::string, boost::shared_ptr<const StaticFile> >::iterator
+            it = files_.find(key);
+      if (it != files_.end())
+      {
+         bytes_ -= staticFileBytes(*(it->second));
+         files_.erase(it);
+      }
+
+      // add the file if there's room (it can still be served either way)
+      std::size_t bytes = staticFileBytes(*pStaticFile);
+      if (bytes_ + bytes <= maxBytes_)
+      {
+         files_[key] = pStaticFile;
+         bytes_ += bytes;
+      }
+   }
+   END_LOCK_MUTEX
+
+   return true;
+}
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
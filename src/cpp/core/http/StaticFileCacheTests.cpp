@@ -0,0 +1,182 @@
+/*
+ * StaticFileCacheTests.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/http/StaticFileCache.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/SafeConvert.hpp>
+
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+namespace tests {
+
+namespace {
+
+// compresses well, so that the gzip encoding is kept
+std::string repeated(const std::string& str, int times)
+{
+   std::string result;
+   for (int i = 0; i < times; i++)
+      result += str;
+   return result;
+}
+
+} // anonymous namespace
+
+context("StaticFileCacheTests")
+{
+   test_that("Files are loaded once and shared")
+   {
+      FilePath dir;
+      REQUIRE_FALSE(FilePath::tempFilePath(&dir));
+      REQUIRE_FALSE(dir.ensureDirectory());
+      FilePath file = dir.complete("app.js");
+      std::string contents = repeated("function foo() { return 42; }\n", 100);
+      REQUIRE_FALSE(writeStringToFile(file, contents));
+
+      StaticFileCache cache(1024 * 1024, 1024 * 1024);
+      boost::shared_ptr<const StaticFile> pFile = cache.file(file);
+      REQUIRE(pFile);
+      CHECK(*pFile->pContent == contents);
+      CHECK(pFile->contentType == file.mimeContentType());
+      CHECK(pFile->lastWriteTime == file.lastWriteTime());
+      CHECK(cache.size() == 1);
+
+#ifndef _WIN32
+      REQUIRE(pFile->pGzipContent);
+      CHECK(pFile->pGzipContent->size() < contents.size());
+      CHECK(pFile->gzipETag != pFile->eTag);
+      CHECK(cache.bytes() == contents.size() + pFile->pGzipContent->size());
+#endif
+
+      // a second lookup returns the same buffers
+      CHECK(cache.file(file) == pFile);
+
+      dir.removeIfExists();
+   }
+
+   test_that("Changed files are reloaded")
+   {
+      FilePath dir;
+      REQUIRE_FALSE(FilePath::tempFilePath(&dir));
+      REQUIRE_FALSE(dir.ensureDirectory());
+      FilePath file = dir.complete("index.htm");
+      REQUIRE_FALSE(writeStringToFile(file, "<html>one</html>"));
+      file.setLastWriteTime(file.lastWriteTime() - 10);
+
+      StaticFileCache cache(1024 * 1024, 1024 * 1024);
+      boost::shared_ptr<const StaticFile> pFile = cache.file(file);
+      REQUIRE(pFile);
+      std::string eTag = pFile->eTag;
+
+      REQUIRE_FALSE(writeStringToFile(file, "<html>two</html>"));
+      boost::shared_ptr<const StaticFile> pChanged = cache.file(file);
+      REQUIRE(pChanged);
+      CHECK(pChanged != pFile);
+      CHECK(*pChanged->pContent == "<html>two</html>");
+      CHECK(pChanged->eTag != eTag);
+      CHECK(cache.size() == 1);
+
+      // the previous version is unaffected
+      CHECK(*pFile->pContent == "<html>one</html>");
+
+      // a change within the same second is noticed by the change in size
+      std::time_t lastWriteTime = file.lastWriteTime();
+      REQUIRE_FALSE(writeStringToFile(file, "<html>three</html>"));
+      file.setLastWriteTime(lastWriteTime);
+      boost::shared_ptr<const StaticFile> pResized = cache.file(file);
+      REQUIRE(pResized);
+      CHECK(*pResized->pContent == "<html>three</html>");
+
+      dir.removeIfExists();
+   }
+
+   test_that("Only compressible content is gzipped")
+   {
+      FilePath dir;
+      REQUIRE_FALSE(FilePath::tempFilePath(&dir));
+      REQUIRE_FALSE(dir.ensureDirectory());
+      std::string contents = repeated("0123456789", 100);
+      FilePath image = dir.complete("image.png");
+      REQUIRE_FALSE(writeStringToFile(image, contents));
+      FilePath style = dir.complete("style.css");
+      REQUIRE_FALSE(writeStringToFile(style, contents));
+
+      StaticFileCache cache(1024 * 1024, 1024 * 1024);
+      boost::shared_ptr<const StaticFile> pImage = cache.file(image);
+      REQUIRE(pImage);
+      CHECK_FALSE(pImage->pGzipContent);
+
+#ifndef _WIN32
+      boost::shared_ptr<const StaticFile> pStyle = cache.file(style);
+      REQUIRE(pStyle);
+      CHECK(pStyle->pGzipContent);
+#endif
+
+      dir.removeIfExists();
+   }
+
+   test_that("Missing and large files aren't cached")
+   {
+      FilePath dir;
+      REQUIRE_FALSE(FilePath::tempFilePath(&dir));
+      REQUIRE_FALSE(dir.ensureDirectory());
+      FilePath file = dir.complete("large.css");
+      REQUIRE_FALSE(writeStringToFile(file, std::string(2048, 'a')));
+
+      StaticFileCache cache(1024, 1024 * 1024);
+      CHECK_FALSE(cache.file(file));
+      CHECK_FALSE(cache.file(dir.complete("missing.css")));
+      CHECK_FALSE(cache.file(dir));
+      CHECK(cache.size() == 0);
+
+      dir.removeIfExists();
+   }
+
+   test_that("Directories are added until the cache is full")
+   {
+      FilePath dir;
+      REQUIRE_FALSE(FilePath::tempFilePath(&dir));
+      REQUIRE_FALSE(dir.complete("js").ensureDirectory());
+      for (int i = 0; i < 10; i++)
+      {
+         std::string name = "js/file" + safe_convert::numberToString(i) + ".txt";
+         REQUIRE_FALSE(writeStringToFile(dir.complete(name),
+                                         std::string(100, 'a' + i)));
+      }
+
+      StaticFileCache cache(1024 * 1024, 1024 * 1024);
+      CHECK_FALSE(cache.addDirectory(dir));
+      CHECK(cache.size() == 10);
+
+      StaticFileCache smallCache(1024 * 1024, 450);
+      CHECK_FALSE(smallCache.addDirectory(dir));
+      CHECK(smallCache.size() > 0);
+      CHECK(smallCache.size() < 10);
+      CHECK(smallCache.bytes() <= 450);
+
+      dir.removeIfExists();
+   }
+}
+
+} // namespace tests
+} // namespace http
+} // namespace core
+} // namespace rstudio
@@ -487,7 +487,7 @@ void fileRequestHandler(const std::string& wwwLocalPath,
 
    // return requested file
    pResponse->setCacheWithRevalidationHeaders();
-   pResponse->setCacheableFile(filePath, request);
+   pResponse->setStaticFile(filePath, request);
 }
 
 std::string formatMessageAsHttpChunk(const std::string& message)
@@ -1,7 +1,7 @@
 /*
  * FileLogWriter.hpp
  *
- * Copyright (C) 2009-12 by RStudio, Inc.
+ * Copyright (C) 2009-18 by RStudio, Inc.
  *
  * Unless you have received this program directly from RStudio pursuant
  * to the terms of a commercial license agreement with RStudio, then
@@ -16,6 +16,11 @@
 #ifndef FILE_LOG_WRITER_HPP
 #define FILE_LOG_WRITER_HPP
 
+#include <atomic>
+#include <iosfwd>
+
+#include <boost/scoped_array.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
 
 #include <core/FilePath.hpp>
@@ -24,6 +29,15 @@
 namespace rstudio {
 namespace core {
 
+// Writes log entries to <logDir>/<programIdentity>.log, rotating the file
+// once it grows beyond 2MB.
+//
+// Entries are formatted on the logging thread and handed to a dedicated
+// writer thread through a bounded lock-free queue, so logging never blocks
+// on file I/O. The writer keeps the log file open, writes whatever has
+// accumulated in a single batch, and tracks the file's size itself rather
+// than stat'ing it for every entry. If the queue fills up entries are
+// dropped and a count of the dropped entries is written in their place.
 class FileLogWriter : public LogWriter
 {
 public:
@@ -38,8 +52,28 @@ public:
                      core::system::LogLevel level,
                      const std::string& message);
 
+    // wait (briefly) for all entries logged so far to be written
+    void flush();
+
+    // number of entries dropped because the queue was full
+    std::size_t droppedCount() const { return droppedTotal_; }
 
 private:
+    struct Slot
+    {
+       std::atomic<std::size_t> sequence;
+       std::string entry;
+    };
+
+    bool enqueue(std::string* pEntry);
+    bool dequeue(std::string* pEntry);
+    bool queueEmpty() const;
+
+    void writerMain();
+    void writeBatch(const std::string& batch);
+    void openLogFile();
+    void checkLogFile();
+    void logSynchronously(const std::string& entry);
     bool rotateLogFile();
 
     std::string programIdentity_;
@@ -47,6 +81,30 @@ private:
     FilePath logFile_;
     FilePath rotatedLogFile_;
     boost::mutex mutex_;
+
+    // queue (multiple producers, consumed only by the writer thread)
+    boost::scoped_array<Slot> slots_;
+    std::size_t slotMask_;
+    std::atomic<std::size_t> enqueuePos_;
+    std::size_t dequeuePos_;
+    std::atomic<std::size_t> dropped_;
+    std::atomic<std::size_t> droppedTotal_;
+
+    // writer thread
+    PidType ownerPid_;
+    boost::thread writerThread_;
+    bool async_;
+    std::atomic<bool> writerWaiting_;
+    std::atomic<std::size_t> writtenPos_;
+    boost::mutex wakeMutex_;
+    boost::condition_variable wakeWriter_;
+    boost::condition_variable batchWritten_;
+    bool stopping_;
+
+    // state owned by the writer thread
+    boost::shared_ptr<std::ostream> pLogStream_;
+    uintmax_t logFileSize_;
+    boost::posix_time::ptime lastFileCheck_;
 };
 
 } // namespace core
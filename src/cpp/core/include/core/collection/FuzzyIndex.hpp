@@ -0,0 +1,349 @@
+/*
+ * FuzzyIndex.hpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_COLLECTION_FUZZY_INDEX_HPP
+#define CORE_COLLECTION_FUZZY_INDEX_HPP
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+
+namespace rstudio {
+namespace core {
+namespace collection {
+
+// An incrementally maintained index over a set of names supporting
+// case-insensitive prefix and subsequence ("fuzzy") lookups. Each name
+// carries an associated value and is identified by the id returned from
+// insert().
+//
+// Subsequence lookups walk only the names containing the query's rarest
+// character (via per-character posting lists), reject most of those with
+// a 64-bit character-set mask, and only then verify the subsequence.
+// Prefix lookups use an ordered map of the lower-cased names.
+template <typename T>
+class FuzzyIndex : boost::noncopyable
+{
+public:
+   typedef std::size_t Id;
+
+   FuzzyIndex() : size_(0) {}
+
+   Id insert(const std::string& name, const T& value)
+   {
+      Id id;
+      if (!free_.empty())
+      {
+         id = free_.back();
+         free_.pop_back();
+      }
+      else
+      {
+         id = slots_.size();
+         slots_.push_back(Slot());
+      }
+
+      Slot& slot = slots_[id];
+      slot.name = name;
+      slot.lower = toLower(name);
+      slot.mask = maskFor(slot.lower);
+      slot.value = value;
+      slot.live = true;
+
+      addPostings(id);
+      slot.prefixIt = prefixes_.insert(std::make_pair(slot.lower, id));
+
+      ++size_;
+      return id;
+   }
+
+   void remove(Id id)
+   {
+      if (id >= slots_.size() || !slots_[id].live)
+         return;
+
+      Slot& slot = slots_[id];
+      prefixes_.erase(slot.prefixIt);
+      slot.live = false;
+      slot.value = T();
+      --size_;
+
+      // posting lists are cleaned up lazily: the id is only made available
+      // for reuse once the postings have been rebuilt without it (which we
+      // do once a quarter as many names have been removed as remain, so
+      // lookups never scan many dead postings)
+      removed_.push_back(id);
+      if (removed_.size() > 64 && removed_.size() > size_ / 4)
+         compact();
+   }
+
+   void clear()
+   {
+      slots_.clear();
+      free_.clear();
+      removed_.clear();
+      prefixes_.clear();
+      for (std::size_t i = 0; i < kPostingCount; i++)
+         postings_[i].clear();
+      size_ = 0;
+   }
+
+   std::size_t size() const { return size_; }
+   bool empty() const { return size_ == 0; }
+
+   const std::string& name(Id id) const { return slots_[id].name; }
+   const T& value(Id id) const { return slots_[id].value; }
+
+   // invoke f(id) for every name containing the query as a
+   // (case-insensitive) subsequence
+   template <typename F>
+   void forEachSubsequenceMatch(const std::string& query, F f) const
+   {
+      std::string lowerQuery = toLower(query);
+      if (lowerQuery.empty())
+      {
+         for (Id id = 0; id < slots_.size(); id++)
+         {
+            if (slots_[id].live)
+               f(id);
+         }
+         return;
+      }
+
+      // walk the shortest posting list among the query's characters
+      const std::vector<Id>* pCandidates = NULL;
+      for (std::string::const_iterator it = lowerQuery.begin();
+           it != lowerQuery.end();
+           ++it)
+      {
+         const std::vector<Id>& postings =
+               postings_[static_cast<unsigned char>(*it)];
+         if (pCandidates == NULL || postings.size() < pCandidates->size())
+            pCandidates = &postings;
+      }
+
+      boost::uint64_t queryMask = maskFor(lowerQuery);
+      for (typename std::vector<Id>::const_iterator it = pCandidates->begin();
+           it != pCandidates->end();
+           ++it)
+      {
+         const Slot& slot = slots_[*it];
+         if (!slot.live || (slot.mask & queryMask) != queryMask)
+            continue;
+
+         if (isSubsequence(slot.lower, lowerQuery))
+            f(*it);
+      }
+   }
+
+   // invoke f(id) for every name starting with the query (ignoring case)
+   template <typename F>
+   void forEachPrefixMatch(const std::string& query, F f) const
+   {
+      std::string lowerQuery = toLower(query);
+      typename PrefixMap::const_iterator it = prefixes_.lower_bound(lowerQuery);
+      for (; it != prefixes_.end(); ++it)
+      {
+         if (it->first.compare(0, lowerQuery.size(), lowerQuery) != 0)
+            break;
+         f(it->second);
+      }
+   }
+
+private:
+   typedef std::multimap<std::string, Id> PrefixMap;
+
+   struct Slot
+   {
+      Slot() : mask(0), live(false) {}
+
+      std::string name;
+      std::string lower;
+      boost::uint64_t mask;
+      T value;
+      bool live;
+      typename PrefixMap::iterator prefixIt;
+   };
+
+   static const std::size_t kPostingCount = 256;
+
+   static std::string toLower(const std::string& str)
+   {
+      std::string lower(str);
+      for (std::string::iterator it = lower.begin(); it != lower.end(); ++it)
+      {
+         if (*it >= 'A' && *it <= 'Z')
+            *it = static_cast<char>(*it - 'A' + 'a');
+      }
+      return lower;
+   }
+
+   static boost::uint64_t maskFor(const std::string& lower)
+   {
+      boost::uint64_t mask = 0;
+      for (std::string::const_iterator it = lower.begin(); it != lower.end(); ++it)
+      {
+         unsigned char ch = static_cast<unsigned char>(*it);
+         int bit;
+         if (ch >= 'a' && ch <= 'z')
+            bit = ch - 'a';
+         else if (ch >= '0' && ch <= '9')
+            bit = 26 + (ch - '0');
+         else
+            bit = 36 + (ch % 28);
+         mask |= (static_cast<boost::uint64_t>(1) << bit);
+      }
+      return mask;
+   }
+
+   static bool isSubsequence(const std::string& lower, const std::string& lowerQuery)
+   {
+      std::string::size_type queryIdx = 0;
+      std::string::size_type queryLen = lowerQuery.length();
+      for (std::string::size_type i = 0;
+           i < lower.length() && queryIdx < queryLen;
+           i++)
+      {
+         if (lower[i] == lowerQuery[queryIdx])
+            ++queryIdx;
+      }
+      return queryIdx == queryLen;
+   }
+
+   void addPostings(Id id)
+   {
+      // add the id once to the posting list of each distinct character
+      bool seen[kPostingCount] = { false };
+      const std::string& lower = slots_[id].lower;
+      for (std::string::const_iterator it = lower.begin(); it != lower.end(); ++it)
+      {
+         unsigned char ch = static_cast<unsigned char>(*it);
+         if (!seen[ch])
+         {
+            seen[ch] = true;
+            postings_[ch].push_back(id);
+         }
+      }
+   }
+
+   void compact()
+   {
+      for (std::size_t i = 0; i < kPostingCount; i++)
+      {
+         std::vector<Id>& postings = postings_[i];
+         std::vector<Id> live;
+         live.reserve(postings.size());
+         for (typename std::vector<Id>::const_iterator it = postings.begin();
+              it != postings.end();
+              ++it)
+         {
+            if (slots_[*it].live)
+               live.push_back(*it);
+         }
+         postings.swap(live);
+      }
+
+      free_.insert(free_.end(), removed_.begin(), removed_.end());
+      removed_.clear();
+   }
+
+   std::vector<Slot> slots_;
+   std::vector<Id> free_;
+   std::vector<Id> removed_;
+   std::vector<Id> postings_[kPostingCount];
+   PrefixMap prefixes_;
+   std::size_t size_;
+};
+
+// Collects the k best (lowest) scoring values offered to it, using a
+// bounded max-heap so that only O(k) values are retained regardless of
+// how many candidates are scored. Ties are broken in favour of values
+// offered earlier.
+template <typename T>
+class TopScores
+{
+public:
+   explicit TopScores(std::size_t k) : k_(k), offered_(0) {}
+
+   void add(int score, const T& value)
+   {
+      ++offered_;
+      if (k_ == 0)
+         return;
+
+      Key key(score, offered_);
+      if (heap_.size() == k_)
+      {
+         // reject anything no better than the current worst result
+         if (!(key < heap_.front().first))
+            return;
+
+         std::pop_heap(heap_.begin(), heap_.end(), Compare());
+         heap_.pop_back();
+      }
+
+      heap_.push_back(std::make_pair(key, value));
+      std::push_heap(heap_.begin(), heap_.end(), Compare());
+   }
+
+   // true if some offered values were discarded
+   bool truncated() const { return offered_ > heap_.size(); }
+
+   std::size_t offered() const { return offered_; }
+
+   // results in ascending order of score
+   std::vector< std::pair<int, T> > sorted() const
+   {
+      std::vector<Element> elements(heap_);
+      std::sort_heap(elements.begin(), elements.end(), Compare());
+
+      std::vector< std::pair<int, T> > results;
+      results.reserve(elements.size());
+      for (typename std::vector<Element>::const_iterator it = elements.begin();
+           it != elements.end();
+           ++it)
+      {
+         results.push_back(std::make_pair(it->first.first, it->second));
+      }
+      return results;
+   }
+
+private:
+   typedef std::pair<int, std::size_t> Key;
+   typedef std::pair<Key, T> Element;
+
+   struct Compare
+   {
+      bool operator()(const Element& lhs, const Element& rhs) const
+      {
+         return lhs.first < rhs.first;
+      }
+   };
+
+   std::size_t k_;
+   std::size_t offered_;
+   std::vector<Element> heap_;
+};
+
+} // namespace collection
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_COLLECTION_FUZZY_INDEX_HPP
@@ -204,12 +204,16 @@ protected:
    void writeRequest()
    {
       // specify closing of the connection after the request unless this is
-      // an attempt to upgrade to websockets
+      // an attempt to upgrade to websockets or the subclass is able to
+      // reuse the connection for subsequent requests
       Header overrideHeader;
       if (!boost::algorithm::iequals(request_.headerValue("Connection"),
                                      "Upgrade"))
       {
-         overrideHeader = Header::connectionClose();
+         if (requestKeepAlive())
+            overrideHeader = Header::connectionKeepAlive();
+         else
+            overrideHeader = Header::connectionClose();
       }
 
       // write
@@ -223,6 +227,32 @@ protected:
       );
    }
 
+   // called when an error occurs before any of the response has been read.
+   // if the connection was reused from a pool then the peer may have closed
+   // it while it was idle, in which case we transparently reconnect. once
+   // the request has been fully written the peer may already have acted on
+   // it, so it's only sent again if it's safe to repeat (GET or HEAD)
+   void handleRequestError(const boost::system::error_code& ec,
+                           const ErrorLocation& location,
+                           bool requestWritten)
+   {
+      Error error(ec, location);
+      bool canResend = !requestWritten ||
+                       request_.method() == "GET" ||
+                       request_.method() == "HEAD";
+      if (http::isConnectionTerminatedError(error) &&
+          canResend &&
+          discardStaleConnection())
+      {
+         responseBuffer_.consume(responseBuffer_.size());
+         connectAndWriteRequest();
+      }
+      else
+      {
+         handleError(error);
+      }
+   }
+
    void handleError(const Error& error)
    {
       // close the socket
@@ -362,7 +392,7 @@ private:
          }
          else
          {
-            handleErrorCode(ec, ERROR_LOCATION);
+            handleRequestError(ec, ERROR_LOCATION, false);
          }
       }
       CATCH_UNEXPECTED_ASYNC_CLIENT_EXCEPTION
@@ -395,7 +425,7 @@ private:
          }
          else
          {
-            handleErrorCode(ec, ERROR_LOCATION);
+            handleRequestError(ec, ERROR_LOCATION, true);
          }
       }
       CATCH_UNEXPECTED_ASYNC_CLIENT_EXCEPTION
@@ -435,6 +465,27 @@ private:
       return false;
    }
 
+   // hooks for subclasses which pool connections: requestKeepAlive asks
+   // the server not to close the connection after responding,
+   // releaseConnection is called (in lieu of close) once a response has
+   // been fully read and keepConnectionAlive returned true, and
+   // discardStaleConnection is called when a reused connection fails
+   // before any response was read (return true to retry the request on
+   // a new connection)
+   virtual bool requestKeepAlive()
+   {
+      return false;
+   }
+
+   virtual void releaseConnection()
+   {
+   }
+
+   virtual bool discardStaleConnection()
+   {
+      return false;
+   }
+
    void handleReadHeaders(const boost::system::error_code& ec)
    {
       try
@@ -565,9 +616,19 @@ private:
 
    void closeAndRespond()
    {
-      if (!keepConnectionAlive())
+      if (keepConnectionAlive())
+         releaseConnection();
+      else
          close();
 
+      // if we collected all of the chunks into the body then the response
+      // is no longer chunked (callers may pass it on to another client)
+      if (chunkedEncoding_ && !chunkHandler_)
+      {
+         response_.removeHeader(kTransferEncoding);
+         response_.setContentLength(static_cast<int>(response_.body().length()));
+      }
+
       if (responseHandler_ && (!chunkedEncoding_ || !chunkHandler_))
          responseHandler_(response_);
       else if (chunkHandler_)
@@ -29,6 +29,7 @@
 #include <core/system/PosixUser.hpp>
 
 #include <core/http/AsyncClient.hpp>
+#include <core/http/LocalStreamConnectionPool.hpp>
 #include <core/http/LocalStreamSocketUtils.hpp>
 
 namespace rstudio {
@@ -47,24 +48,54 @@ public:
                                                 http::ConnectionRetryProfile())
      : AsyncClient<boost::asio::local::stream_protocol::socket>(ioService,
                                                                 logToStderr),
-       socket_(ioService),
+       pSocket_(new boost::asio::local::stream_protocol::socket(ioService)),
        localStreamPath_(localStreamPath),
-       validateUid_(validateUid)
+       validateUid_(validateUid),
+       checkedConnectionPool_(false),
+       reusedConnection_(false)
    {
       setConnectionRetryProfile(retryProfile);
    }
 
+   // set (optional) connection pool. when provided, idle keep-alive
+   // connections are reused for the request and the connection is
+   // returned to the pool once the response has been read. must do
+   // this prior to calling execute
+   void setConnectionPool(
+         const boost::shared_ptr<LocalStreamConnectionPool>& pConnectionPool)
+   {
+      pConnectionPool_ = pConnectionPool;
+   }
+
 protected:
 
    virtual boost::asio::local::stream_protocol::socket& socket()
    {
-      return socket_;
+      return *pSocket_;
    }
 
 private:
 
    virtual void connectAndWriteRequest()
    {
+      // use a pooled connection if we have one (uid validation was
+      // performed when the pooled connection was first established)
+      if (pConnectionPool_ && !checkedConnectionPool_)
+      {
+         checkedConnectionPool_ = true;
+
+         boost::shared_ptr<boost::asio::local::stream_protocol::socket>
+            pSocket = pConnectionPool_->checkout(ioService(),
+                                                 localStreamPath_.absolutePath());
+         if (pSocket)
+         {
+            pSocket_ = pSocket;
+            reusedConnection_ = true;
+            writeRequest();
+            return;
+         }
+      }
+
       // validate if requested
       if (validateUid_.is_initialized() && localStreamPath_.exists())
       {
@@ -123,6 +154,63 @@ private:
    }
 
 
+   // only pooled connections ask the server to keep the connection open,
+   // and they can only be reused if the server agreed to do so and the
+   // response was delimited by its Content-Length
+   virtual bool requestKeepAlive()
+   {
+      return pConnectionPool_.get() != NULL;
+   }
+
+   bool canReuseConnection()
+   {
+      return pConnectionPool_ &&
+             boost::algorithm::iequals(response_.headerValue("Connection"),
+                                       "keep-alive") &&
+             response_.containsHeader("Content-Length") &&
+             response_.headerValue(kTransferEncoding).empty();
+   }
+
+   virtual bool stopReadingAndRespond()
+   {
+      return canReuseConnection() &&
+             response_.body().length() >= response_.contentLength();
+   }
+
+   virtual bool keepConnectionAlive()
+   {
+      return canReuseConnection();
+   }
+
+   virtual void releaseConnection()
+   {
+      pConnectionPool_->checkin(ioService(),
+                                localStreamPath_.absolutePath(),
+                                pSocket_);
+
+      // detach from the pooled socket so that subsequent calls to close
+      // don't affect it
+      pSocket_.reset(
+            new boost::asio::local::stream_protocol::socket(ioService()));
+   }
+
+   virtual bool discardStaleConnection()
+   {
+      if (!reusedConnection_)
+         return false;
+
+      // close the stale socket and connect a fresh one
+      boost::system::error_code ec;
+      pSocket_->close(ec);
+      pSocket_.reset(
+            new boost::asio::local::stream_protocol::socket(ioService()));
+      pConnectionPool_->recordStale();
+
+      // the next attempt uses a new connection
+      reusedConnection_ = false;
+      return true;
+   }
+
    const boost::shared_ptr<LocalStreamAsyncClient> sharedFromThis()
    {
       boost::shared_ptr<AsyncClient<boost::asio::local::stream_protocol::socket> >
@@ -132,9 +220,12 @@ private:
    }
 
 private:
-   boost::asio::local::stream_protocol::socket socket_;
+   boost::shared_ptr<boost::asio::local::stream_protocol::socket> pSocket_;
    core::FilePath localStreamPath_;
    boost::optional<UidType> validateUid_;
+   boost::shared_ptr<LocalStreamConnectionPool> pConnectionPool_;
+   bool checkedConnectionPool_;
+   bool reusedConnection_;
 };
    
    
@@ -0,0 +1,120 @@
+/*
+ * LocalStreamConnectionPool.hpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_HTTP_LOCAL_STREAM_CONNECTION_POOL_HPP
+#define CORE_HTTP_LOCAL_STREAM_CONNECTION_POOL_HPP
+
+#include <map>
+#include <deque>
+#include <string>
+
+#include <boost/utility.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <core/BoostThread.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+typedef boost::asio::local::stream_protocol::socket LocalStreamSocket;
+
+// pool of idle keep-alive connections to local stream servers (keyed by
+// the path of the stream). connections are checked out for the duration
+// of a single request/response exchange and checked back in once the
+// response has been fully read. idle connections are health checked
+// before being handed out and evicted once they exceed the idle timeout.
+// the pool's statistics are logged (at debug level) as they change
+class LocalStreamConnectionPool : boost::noncopyable
+{
+public:
+   struct Stats
+   {
+      Stats() : hits(0), misses(0), stale(0), evictions(0) {}
+
+      // checkouts satisfied from the pool
+      unsigned long hits;
+
+      // checkouts that required a new connection
+      unsigned long misses;
+
+      // pooled connections found to have been closed by the peer
+      unsigned long stale;
+
+      // pooled connections closed due to the idle timeout or pool limits
+      unsigned long evictions;
+   };
+
+public:
+   LocalStreamConnectionPool(
+         std::size_t maxIdlePerStream = 4,
+         const boost::posix_time::time_duration& idleTimeout =
+                                             boost::posix_time::seconds(60));
+
+   virtual ~LocalStreamConnectionPool();
+
+   // get an idle connection to the specified stream (returns an empty
+   // pointer if there is no healthy idle connection available)
+   boost::shared_ptr<LocalStreamSocket> checkout(
+                                 boost::asio::io_service& ioService,
+                                 const std::string& streamPath);
+
+   // return a connection whose response has been fully read to the pool
+   void checkin(boost::asio::io_service& ioService,
+                const std::string& streamPath,
+                const boost::shared_ptr<LocalStreamSocket>& pSocket);
+
+   // note that a connection previously handed out by checkout turned out
+   // to have been closed by the peer
+   void recordStale();
+
+   // close all idle connections to the specified stream
+   void clear(const std::string& streamPath);
+
+   Stats stats();
+
+private:
+   struct IdleConnection
+   {
+      boost::asio::io_service* pIoService;
+      boost::shared_ptr<LocalStreamSocket> pSocket;
+      boost::posix_time::ptime idleSince;
+   };
+
+   typedef std::deque<IdleConnection> IdleConnections;
+
+   void evictExpired(const boost::posix_time::ptime& now);
+   void logStats();
+
+private:
+   std::size_t maxIdlePerStream_;
+   boost::posix_time::time_duration idleTimeout_;
+   boost::posix_time::ptime lastEviction_;
+   std::map<std::string, IdleConnections> idle_;
+   Stats stats_;
+   Stats loggedStats_;
+   boost::mutex mutex_;
+};
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_HTTP_LOCAL_STREAM_CONNECTION_POOL_HPP
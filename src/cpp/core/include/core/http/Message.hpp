@@ -21,6 +21,7 @@
 #include <algorithm>
 
 #include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/utility.hpp>
 
 namespace RSTUDIO_BOOST_NAMESPACE {
@@ -41,6 +42,7 @@ namespace http {
 
 // encodings
 extern const char * const kGzipEncoding;         
+extern const char * const kDeflateEncoding;
 extern const char * const kTransferEncoding;
 extern const char * const kChunkedTransferEncoding;
 
@@ -90,7 +92,10 @@ public:
 
    const Headers& headers() const  { return headers_; }
    
-   const std::string& body() const { return body_; }
+   const std::string& body() const
+   {
+      return pSharedBody_ ? *pSharedBody_ : body_;
+   }
    
    void reset();
    
@@ -105,6 +110,10 @@ protected:
    // RVO for potentially large buffers). note this means that you MUST always
    // remember to call setContentLength after setting the body!
    std::string body_;
+
+   // body shared with other messages (e.g. the contents of a cached file);
+   // takes the place of body_ when set
+   boost::shared_ptr<const std::string> pSharedBody_;
    
    void appendSpaceBuffer(
          std::vector<boost::asio::const_buffer>& buffers) const ;
@@ -115,6 +124,7 @@ protected:
    void assign(const Message& message, const Headers& extraHeaders)
    {
       body_ = message.body_;
+      pSharedBody_ = message.pSharedBody_;
       httpVersionMajor_ = message.httpVersionMajor_;
       httpVersionMinor_ = message.httpVersionMinor_;
       headers_ = message.headers_;
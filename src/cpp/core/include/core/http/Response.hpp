@@ -25,6 +25,7 @@
 
 #ifndef _WIN32
 #include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
 #endif
 
 #include <core/BrowserUtils.hpp>
@@ -186,15 +187,21 @@ public:
          if ( !boost::is_same<Filter, NullOutputFilter>::value )
             filteringStream.push(filter, buffSize);
 
-         // handle gzip
-         if (contentEncoding() == kGzipEncoding)
+         // handle gzip and deflate
+         if (contentEncoding() == kGzipEncoding ||
+             contentEncoding() == kDeflateEncoding)
+         {
 #ifdef _WIN32
-            // never gzip on win32
+            // never compress on win32
             removeHeader("Content-Encoding");
 #else
-            // add gzip compressor on posix
-            filteringStream.push(boost::iostreams::gzip_compressor(), buffSize);
+            // add compressor on posix
+            if (contentEncoding() == kGzipEncoding)
+               filteringStream.push(boost::iostreams::gzip_compressor(), buffSize);
+            else
+               filteringStream.push(boost::iostreams::zlib_compressor(), buffSize);
 #endif
+         }
 
          // buffer to write to
          std::ostringstream bodyStream;
@@ -205,6 +212,7 @@ public:
          
          // set body 
          body_ = bodyStream.str();
+         pSharedBody_.reset();
 
          if (padding && body_.length() < 1024)
          {
@@ -329,6 +337,11 @@ public:
       }
    }
 
+   // Serve a file from the static file cache (falling back to reading it
+   // from disk when it can't be cached), validating it with both an entity
+   // tag and the modified time
+   void setStaticFile(const FilePath& filePath, const Request& request);
+
    void setRangeableFile(const FilePath& filePath, const Request& request);
 
    void setRangeableFile(const std::string& contents,
@@ -337,6 +350,7 @@ public:
 
    // these calls do no stream io or encoding so don't return errors
    void setBodyUnencoded(const std::string& body);
+   void setSharedBody(const boost::shared_ptr<const std::string>& pBody);
    void setError(int statusCode, const std::string& message);
    void setNotFoundError(const std::string& uri);
    void setError(const Error& error);
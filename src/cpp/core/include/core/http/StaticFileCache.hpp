@@ -0,0 +1,95 @@
+/*
+ * StaticFileCache.hpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_HTTP_STATIC_FILE_CACHE_HPP
+#define CORE_HTTP_STATIC_FILE_CACHE_HPP
+
+#include <ctime>
+#include <map>
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/utility.hpp>
+
+namespace rstudio {
+namespace core {
+
+class Error;
+class FilePath;
+
+namespace http {
+
+// The contents of a static file (along with its gzip encoding, when gzip
+// is supported, the content type is compressible and compressing makes the
+// file smaller), held in buffers which are shared by the responses that
+// send them
+struct StaticFile
+{
+   StaticFile() : lastWriteTime(0), fileSize(0) {}
+
+   std::string contentType;
+   std::time_t lastWriteTime;
+   std::size_t fileSize;
+
+   // strong entity tags for each encoding
+   std::string eTag;
+   std::string gzipETag;
+
+   boost::shared_ptr<const std::string> pContent;
+   boost::shared_ptr<const std::string> pGzipContent;
+};
+
+// In-memory cache of static files (e.g. the files of the web application),
+// so that they are read and compressed once rather than for every request.
+// Cached files are reloaded when they change on disk. Files larger than
+// maxFileSize aren't cached, and files stop being added once the cache
+// holds maxBytes. Safe to use from multiple threads.
+class StaticFileCache : boost::noncopyable
+{
+public:
+   StaticFileCache(std::size_t maxFileSize, std::size_t maxBytes);
+
+   // load the files within the given directory (and its subdirectories)
+   Error addDirectory(const FilePath& directory);
+
+   // Get the given file, loading it if it isn't cached (or has changed).
+   // Returns an empty pointer if the file doesn't exist, is too large to
+   // cache or couldn't be read; such files should be served from disk.
+   boost::shared_ptr<const StaticFile> file(const FilePath& filePath);
+
+   std::size_t size();
+   std::size_t bytes();
+
+private:
+   bool addFile(const FilePath& filePath,
+                boost::shared_ptr<const StaticFile>* pFile);
+
+   std::size_t maxFileSize_;
+   std::size_t maxBytes_;
+
+   boost::mutex mutex_;
+   std::size_t bytes_;
+   std::map<std::string, boost::shared_ptr<const StaticFile> > files_;
+};
+
+// global cache of static files
+StaticFileCache& staticFileCache();
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_HTTP_STATIC_FILE_CACHE_HPP
@@ -23,6 +23,8 @@
 #include <core/Error.hpp>
 #include <core/Log.hpp>
 
+#include <boost/utility.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/type_traits/is_same.hpp>
 #include <boost/optional.hpp>
 
@@ -220,6 +222,40 @@ void writeFormatted(const Value& value, std::ostream& os);
 std::string write(const Value& value);
 std::string writeFormatted(const Value& value);
 
+// SAX-style writer for producing large documents (e.g. long arrays of
+// events or rows) element by element without first building the entire
+// json::Value. keys are written with key and followed by a value (or a
+// nested object/array); output is buffered until flush or destruction
+// (or, when writing to a string, appended to it directly)
+class StreamWriter : boost::noncopyable
+{
+public:
+   explicit StreamWriter(std::ostream& os);
+   explicit StreamWriter(std::string* pOutput);
+   virtual ~StreamWriter();
+
+   void startObject();
+   void endObject();
+
+   void startArray();
+   void endArray();
+
+   void key(const std::string& name);
+   void value(const Value& value);
+
+   // write values without constructing a json::Value
+   void stringValue(const char* str, std::size_t length);
+   void intValue(int value);
+
+   void flush();
+
+private:
+   void beginElement();
+
+   struct Impl;
+   boost::scoped_ptr<Impl> pImpl_;
+};
+
 } // namespace json
 } // namespace core
 } // namespace rstudio
@@ -56,6 +56,9 @@ namespace json_spirit
 
         Value_impl& operator=( const Value_impl& lhs );
 
+        // NOTE: added by RStudio (lets the parser build values in place)
+        void swap( Value_impl& other );
+
         Value_type type() const;
 
         bool is_uint64() const;
@@ -308,6 +311,14 @@ namespace json_spirit
         return *this;
     }
 
+    template< class Config >
+    void Value_impl< Config >::swap( Value_impl& other )
+    {
+        std::swap( type_, other.type_ );
+        v_.swap( other.v_ );
+        std::swap( is_uint64_, other.is_uint64_ );
+    }
+
     template< class Config >
     bool Value_impl< Config >::operator==( const Value_impl& lhs ) const
     {
@@ -17,6 +17,8 @@
 #ifndef CORE_R_UTIL_ACTIVE_SESSIONS_HPP
 #define CORE_R_UTIL_ACTIVE_SESSIONS_HPP
 
+#include <map>
+
 #include <boost/noncopyable.hpp>
 
 #include <core/Error.hpp>
@@ -37,23 +39,32 @@ class ActiveSession : boost::noncopyable
 {
 private:
    friend class ActiveSessions;
-   ActiveSession() {}
+   ActiveSession()
+      : propertiesLoaded_(false)
+   {
+   }
 
-   explicit ActiveSession(const std::string& id) : id_(id) 
+   explicit ActiveSession(const std::string& id)
+      : id_(id), propertiesLoaded_(false)
    {
    }
 
    explicit ActiveSession(const std::string& id, const FilePath& scratchPath)
-      : id_(id), scratchPath_(scratchPath)
+      : id_(id), scratchPath_(scratchPath),
+        propertiesLoaded_(false)
    {
       core::Error error = scratchPath_.ensureDirectory();
       if (error)
          LOG_ERROR(error);
 
+      // properties are stored together in a single record, other than those
+      // which change frequently (which each have a file within the properties
+      // directory). sessions created by earlier versions stored every property
+      // in the properties directory; these are copied to the record when the
+      // session is first read (and the properties which earlier versions
+      // need to validate a session are still written to their files too)
       propertiesPath_ = scratchPath_.childPath("properites");
-      error = propertiesPath_.ensureDirectory();
-      if (error)
-         LOG_ERROR(error);
+      recordPath_ = scratchPath_.childPath("session-properties");
    }
 
 public:
@@ -134,11 +145,7 @@ public:
    void setLastUsed()
    {
       if (!empty())
-      {
-         double now = date_time::millisecondsSinceEpoch();
-         std::string value = safe_convert::numberToString(now);
-         writeProperty("last-used", value);
-      }
+         writeProperty("last-used", lastUsedNow());
    }
 
    bool executing() const
@@ -232,9 +239,11 @@ public:
    {
       if (!empty())
       {
-         writeProperty("r-version", rVersion);
-         writeProperty("r-version-home", rVersionHome);
-         writeProperty("r-version-label", rVersionLabel);
+         std::map<std::string,std::string> properties;
+         properties["r-version"] = rVersion;
+         properties["r-version-home"] = rVersionHome;
+         properties["r-version-label"] = rVersionLabel;
+         writeProperties(properties);
       }
    }
 
@@ -256,16 +265,28 @@ public:
                      const std::string& rVersionHome,
                      const std::string& rVersionLabel = "")
    {
-      setLastUsed();
-      setRunning(true);
-      setRVersion(rVersion, rVersionHome, rVersionLabel);
+      if (!empty())
+      {
+         std::map<std::string,std::string> properties;
+         properties["last-used"] = lastUsedNow();
+         properties["running"] = safe_convert::numberToString(true);
+         properties["r-version"] = rVersion;
+         properties["r-version-home"] = rVersionHome;
+         properties["r-version-label"] = rVersionLabel;
+         writeProperties(properties);
+      }
    }
 
    void endSession()
    {
-      setLastUsed();
-      setRunning(false);
-      setExecuting(false);
+      if (!empty())
+      {
+         std::map<std::string,std::string> properties;
+         properties["last-used"] = lastUsedNow();
+         properties["running"] = safe_convert::numberToString(false);
+         properties["executing"] = safe_convert::numberToString(false);
+         writeProperties(properties);
+      }
    }
 
    uintmax_t suspendSize()
@@ -288,8 +309,9 @@ public:
    bool validate(const FilePath& userHomePath,
                  bool projectSharingEnabled) const
    {
-      // ensure the scratch path and properties paths exist
-      if (!scratchPath_.exists() || !propertiesPath_.exists())
+      // ensure the scratch path and properties exist
+      if (!scratchPath_.exists() ||
+          (!recordPath_.exists() && !propertiesPath_.exists()))
          return false;
 
       // ensure the properties are there
@@ -332,13 +354,46 @@ private:
       }
    }
 
+   static std::string lastUsedNow()
+   {
+      double now = date_time::millisecondsSinceEpoch();
+      return safe_convert::numberToString(now);
+   }
+
    void writeProperty(const std::string& name, const std::string& value) const;
+   void writeProperties(
+               const std::map<std::string,std::string>& properties) const;
    std::string readProperty(const std::string& name) const;
 
+   static bool isVolatileProperty(const std::string& name);
+   static bool isLegacyProperty(const std::string& name);
+   std::string readVolatileProperty(const std::string& name) const;
+   core::Error writeVolatileProperty(const std::string& name,
+                                     const std::string& value) const;
+   core::Error writePropertyFile(const std::string& name,
+                                 const std::string& value) const;
+
+   core::Error loadProperties() const;
+   core::Error migrateProperties() const;
+   core::Error writeRecord() const;
+
 private:
    std::string id_;
    FilePath scratchPath_;
    FilePath propertiesPath_;
+   FilePath recordPath_;
+
+   // cached copies of the record and of the volatile properties (each is
+   // reloaded when the stamp of its file changes)
+   struct CachedProperty
+   {
+      std::string stamp;
+      std::string value;
+   };
+   mutable bool propertiesLoaded_;
+   mutable std::map<std::string,std::string> properties_;
+   mutable std::string recordStamp_;
+   mutable std::map<std::string,CachedProperty> volatileProperties_;
 };
 
 
@@ -380,6 +435,10 @@ public:
 
 private:
    core::FilePath storagePath_;
+
+   // sessions found by the last call to list (reused by the next one, so
+   // that only the records which have changed are read again)
+   mutable std::map<std::string, boost::shared_ptr<ActiveSession> > index_;
 };
 
 // active session as tracked by rserver processes
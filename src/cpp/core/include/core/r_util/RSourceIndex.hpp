@@ -196,6 +196,13 @@ public:
    RSourceIndex(const std::string& context,
                 const std::string& code);
 
+   // Create an empty index; items and inferred packages are then added
+   // explicitly (used when restoring a previously serialized index)
+   explicit RSourceIndex(const std::string& context)
+      : context_(context)
+   {
+   }
+
    const std::string& context() const { return context_; }
 
    template <typename OutputIterator>
@@ -291,7 +298,7 @@ public:
       return s_allInferredPkgNames_;
    }
 
-   const std::vector<std::string>& getInferredPackages()
+   const std::vector<std::string>& getInferredPackages() const
    {
       return inferredPkgNames_;
    }
@@ -300,6 +307,7 @@ public:
                                      const PackageInformation& info)
    {
       s_packageInformation_[package] = info;
+      ++s_packageInformationGeneration_;
    }
 
    static bool hasInformation(const std::string& package)
@@ -383,6 +391,7 @@ public:
       s_importedPackages_.clear();
       s_importedPackages_.insert(pkgNames.begin(), pkgNames.end());
       s_allInferredPkgNames_.insert(pkgNames.begin(), pkgNames.end());
+      ++s_packageInformationGeneration_;
    }
    
    static const std::set<std::string>& getImportedPackages()
@@ -399,6 +408,7 @@ public:
       {
          s_allInferredPkgNames_.insert(pkg);
       }
+      ++s_packageInformationGeneration_;
    }
    
    static ImportFromMap& getImportFromDirectives()
@@ -406,6 +416,14 @@ public:
       return s_importFromDirectives_;
    }
    
+   // incremented whenever the shared package information, imports or
+   // 'importFrom' directives change (allows clients to cache state
+   // derived from them)
+   static std::size_t getPackageInformationGeneration()
+   {
+      return s_packageInformationGeneration_;
+   }
+   
    void addSourceItem(const RSourceItem& item)
    {
       items_.push_back(item);
@@ -432,6 +450,7 @@ private:
    // NOTE: All source indexes share a set of completions
    static std::map<std::string, PackageInformation> s_packageInformation_;
    static FunctionInformation s_noSuchFunction_;
+   static std::size_t s_packageInformationGeneration_;
    
 };
 
@@ -0,0 +1,130 @@
+/*
+ * RSourceIndexCache.hpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_R_UTIL_R_SOURCE_INDEX_CACHE_HPP
+#define CORE_R_UTIL_R_SOURCE_INDEX_CACHE_HPP
+
+#include <ctime>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+#include <core/r_util/RSourceIndex.hpp>
+
+namespace rstudio {
+namespace core {
+
+class Error;
+class FilePath;
+
+namespace r_util {
+
+// Persistent store of source indexes keyed by file path, last write time
+// and size. The cache is written as a single flat binary file which is
+// memory mapped when read back, so that a session can restore the indexes
+// for all unchanged files without re-tokenizing them. Entries read back
+// are only decoded from the mapped file when looked up, and entries
+// recorded by update share the caller's index rather than copying it.
+class RSourceIndexCache : boost::noncopyable
+{
+public:
+   RSourceIndexCache();
+
+   // Read the cache from disk, replacing the current contents. A missing
+   // file is not an error. The tag is an opaque string identifying the
+   // conditions the indexes were built under (e.g. the encoding used to
+   // read the files); a cache written with a different tag is discarded.
+   Error read(const FilePath& cacheFile, const std::string& tag);
+
+   // Write the cache to disk (via a temporary file which is then renamed
+   // into place) and mark it clean
+   Error write(const FilePath& cacheFile, const std::string& tag);
+
+   // Restore the index for the given path, provided the cached entry was
+   // recorded for the same last write time and size. Returns a null
+   // pointer if there is no matching entry.
+   boost::shared_ptr<RSourceIndex> lookup(const std::string& path,
+                                          std::time_t lastWriteTime,
+                                          uintmax_t size,
+                                          const std::string& context) const;
+
+   // Record (or replace) the index for the given path
+   void update(const std::string& path,
+               std::time_t lastWriteTime,
+               uintmax_t size,
+               const boost::shared_ptr<RSourceIndex>& pIndex);
+
+   void remove(const std::string& path);
+
+   // Drop all entries whose path is not in the given set (e.g. files which
+   // were removed while no session was running)
+   void retain(const std::set<std::string>& paths);
+
+   void clear();
+
+   // true if the cache has been modified since it was last read or written
+   bool dirty() const { return dirty_; }
+
+   std::size_t size() const { return entries_.size(); }
+
+private:
+   struct Entry
+   {
+      Entry() : lastWriteTime(0), size(0), offset(0), length(0) {}
+
+      boost::int64_t lastWriteTime;
+      boost::uint64_t size;
+
+      // either the index recorded by update or the location of the encoded
+      // index within the storage
+      boost::shared_ptr<RSourceIndex> pIndex;
+      std::size_t offset;
+      std::size_t length;
+   };
+
+   // offset and length of an encoded index
+   typedef std::pair<std::size_t, std::size_t> Location;
+
+   bool decode(const std::string& tag);
+   void encode(const std::string& tag,
+               std::string* pBuffer,
+               std::map<std::string, Location>* pLocations) const;
+   boost::shared_ptr<RSourceIndex> decodeIndex(const Entry& entry,
+                                               const std::string& context) const;
+   void setStorage(const boost::shared_ptr<void>& pStorage,
+                   const char* pData,
+                   std::size_t size);
+
+   std::map<std::string, Entry> entries_;
+
+   // the mapped cache file (or the buffer it was written from) holding the
+   // encoded indexes of entries read from or written to disk
+   boost::shared_ptr<void> pStorage_;
+   const char* pData_;
+   std::size_t dataSize_;
+
+   bool dirty_;
+};
+
+} // namespace r_util
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_R_UTIL_R_SOURCE_INDEX_CACHE_HPP
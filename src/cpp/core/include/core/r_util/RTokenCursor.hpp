@@ -39,8 +39,10 @@ using namespace core::r_util::token_utils;
 // tokens are valid.
 class RTokenCursor
 {
-private:
+public:
    
+   // a cursor that treats the token at 'n - 1' as the end of the
+   // token stream (tokens beyond it can still be peeked at)
    RTokenCursor(const core::r_util::RTokens &rTokens,
                std::size_t offset,
                std::size_t n)
@@ -49,8 +51,6 @@ private:
         n_(n)
    {}
    
-public:
-   
    explicit RTokenCursor(const core::r_util::RTokens& rTokens)
       : rTokens_(rTokens), offset_(0), n_(rTokens.size()) {}
    
@@ -259,6 +259,7 @@ public:
       return currentToken().content();
    }
    
+   // (see RToken::contentAsUtf8 for the lifetime of the reference)
    const std::string& contentAsUtf8() const
    {
       return currentToken().contentAsUtf8();
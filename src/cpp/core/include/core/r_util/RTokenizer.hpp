@@ -95,6 +95,12 @@ public:
    // accessors
    TokenType type() const { return type_; }
    std::wstring content() const { return std::wstring(begin_, end_); }
+   // NOTE: the returned reference is into a bounded per-thread cache of
+   // conversions. it remains valid until the calling thread has converted
+   // 16384 further distinct tokens (when the generation holding it is
+   // discarded), so it may be used within an expression or short scope but
+   // must be copied if it is kept any longer (e.g. stored in a container or
+   // held while other documents are tokenized) or handed to another thread
    const std::string& contentAsUtf8() const;
    std::size_t offset() const { return offset_; }
    std::size_t length() const { return end_ - begin_; }
@@ -222,8 +228,7 @@ private:
    wchar_t peek();
    wchar_t peek(std::size_t lookahead);
    wchar_t eat();
-   std::size_t tokenLength(const boost::wregex& regex);
-   void eatUntil(const boost::wregex& regex);
+   void eatUntilQuoteOrEscape();
    RToken consumeToken(RToken::TokenType tokenType, std::size_t length);
    
 private:
@@ -541,6 +546,7 @@ inline std::string getSymbolName(const RToken& rToken)
           std::wstring(rToken.begin() + 1, rToken.end() - 1));
    }
    
+   // (copied, since callers keep symbol names)
    return rToken.contentAsUtf8();
 }
 
@@ -566,8 +572,22 @@ inline bool canFollowBinaryOperator(const RToken& rToken)
 
 inline bool isPipeOperator(const RToken& rToken)
 {
-   static const boost::wregex rePipe(L"^%[^>]*>+[^>]*%$");
-   return regex_utils::match(rToken.begin(), rToken.end(), rePipe);
+   // %[^>]*>+[^>]*% -- a user operator containing a single run of '>'
+   if (rToken.length() < 3 ||
+       *rToken.begin() != L'%' ||
+       *(rToken.end() - 1) != L'%')
+   {
+      return false;
+   }
+
+   std::wstring::const_iterator end = rToken.end() - 1;
+   std::wstring::const_iterator it = std::find(rToken.begin() + 1, end, L'>');
+   if (it == end)
+      return false;
+
+   while (it != end && *it == L'>')
+      ++it;
+   return std::find(it, end, L'>') == end;
 }
 
 namespace {
@@ -215,6 +215,18 @@ public:
    // poll for input and exit status
    void poll();
 
+#ifndef _WIN32
+   // descriptors which become readable when the child has output to be
+   // read or (where supported) when it exits. returns false if the child
+   // must be polled without waiting for events (it hasn't started yet)
+   bool getEventDescriptors(std::vector<int>* pFds) const;
+
+   // poll, reading output and checking for exit only if the event
+   // descriptors reported activity (exit is checked regardless if it
+   // can't be detected through a descriptor)
+   void poll(bool hasEvents);
+#endif
+
    // has it exited?
    virtual bool exited();
 
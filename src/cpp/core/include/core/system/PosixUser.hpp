@@ -59,6 +59,16 @@ bool exists(const std::string& username);
 core::Error userFromUsername(const std::string& username, User* pUser);
 core::Error userFromId(UidType uid, User* pUser);
 
+// cached variant of userFromUsername for use on hot paths (e.g. once per
+// proxied request) where a blocking NSS lookup is too expensive. entries
+// expire after 5 minutes and failed lookups are cached (for 30 seconds) so
+// that unknown users don't hit NSS either
+core::Error cachedUserFromUsername(const std::string& username, User* pUser);
+
+// remove a user (or all users) from the cache
+void invalidateCachedUser(const std::string& username);
+void invalidateCachedUsers();
+
    
 } // namespace user
 } // namespace system
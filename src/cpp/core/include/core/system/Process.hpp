@@ -53,6 +53,22 @@ enum Mode
 
 } // BusyDetectionMode
 
+namespace supervisor_mode {
+
+enum Mode
+{
+   // check every child's output streams and exit status on each poll
+   Polling = 0,
+
+   // wait on the children's output streams (and, where supported, process
+   // descriptors signalled on exit) so that poll only services children
+   // with pending events and waiting wakes as soon as there is activity.
+   // Behaves like Polling where this isn't supported (Windows)
+   EventDriven = 1
+};
+
+} // namespace supervisor_mode
+
 
 ////////////////////////////////////////////////////////////////////////////////
 //
@@ -345,7 +361,8 @@ ProcessCallbacks createProcessCallbacks(
 class ProcessSupervisor : boost::noncopyable
 {
 public:
-   ProcessSupervisor();
+   explicit ProcessSupervisor(
+            supervisor_mode::Mode mode = supervisor_mode::Polling);
    virtual ~ProcessSupervisor();
 
    // Run a child asynchronously, invoking callbacks as the process starts,
@@ -410,6 +427,11 @@ public:
    // are still children being supervised after the poll
    bool poll();
 
+   // Block until a child has output or exits, or until the timeout
+   // elapses (in Polling mode this always waits for the timeout). Returns
+   // true if there may be events for poll to handle
+   bool waitForEvents(const boost::posix_time::time_duration& timeout);
+
    // Terminate all running children
    void terminateAll();
 
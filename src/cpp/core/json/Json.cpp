@@ -16,17 +16,20 @@
 #include <core/json/Json.hpp>
 #include <core/json/JsonRpc.hpp>
 
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <clocale>
+#include <cstdint>
 #include <sstream>
+#include <algorithm>
 
 #include <boost/format.hpp>
 #include <boost/foreach.hpp>
 #include <boost/scoped_array.hpp>
 
 #include <core/Log.hpp>
-#include <core/Thread.hpp>
-
-#include "spirit/json_spirit.h"
 
 namespace rstudio {
 namespace core {
@@ -116,44 +119,772 @@ bool fillMap(const Object& object, std::map< std::string, std::vector<std::strin
    return true;
 }
 
-bool parse(const std::string& input, Value* pValue)
+namespace {
+
+// maximum nesting of arrays/objects we'll parse (guards against stack
+// exhaustion on malicious or corrupt input)
+const int kMaxParseDepth = 1024;
+
+// recursive descent parser which builds json::Values in place and decodes
+// strings directly from the input buffer (no intermediate token stream).
+// accepts the same input as the json_spirit reader it replaced, including
+// trailing content after the first value
+class Parser
 {
-   // two threads simultaneously using the json parser has been observed
-   // to crash the process. protect it globally with a mutex. note this was
-   // probably a result of not defining BOOST_SPIRIT_THREADSAFE (which we
-   // have subsequently defined) however since there isn't much documentation 
-   // on the behavior of boost spirit w/ threads and the specific behavior
-   // of this constant we leave in mutex just to be sure   
-      
-   static boost::mutex s_spiritMutex ;
-   LOCK_MUTEX(s_spiritMutex)
+public:
+   Parser(const char* begin, const char* end)
+      : pos_(begin), end_(end), depth_(0)
    {
-      return json_spirit::read(input, *pValue);
    }
-   END_LOCK_MUTEX
-   
-   // mutex related error
-   return false;
+
+   bool parse(Value* pValue)
+   {
+      skipWhitespace();
+      return parseValue(pValue);
+   }
+
+private:
+   bool parseValue(Value* pValue)
+   {
+      if (pos_ == end_)
+         return false;
+
+      switch (*pos_)
+      {
+      case '{':
+         return parseObject(pValue);
+      case '[':
+         return parseArray(pValue);
+      case '"':
+      {
+         std::string str;
+         if (!parseString(&str))
+            return false;
+         Value value(str);
+         pValue->swap(value);
+         return true;
+      }
+      case 't':
+         return parseLiteral("true", Value(true), pValue);
+      case 'f':
+         return parseLiteral("false", Value(false), pValue);
+      case 'n':
+         return parseLiteral("null", Value(), pValue);
+      default:
+         return parseNumber(pValue);
+      }
+   }
+
+   bool parseObject(Value* pValue)
+   {
+      if (++depth_ > kMaxParseDepth)
+         return false;
+
+      ++pos_; // '{'
+      Value emptyObject = Value(Object());
+      pValue->swap(emptyObject);
+      Object& object = pValue->get_obj();
+
+      skipWhitespace();
+      if (consume('}'))
+      {
+         --depth_;
+         return true;
+      }
+
+      while (true)
+      {
+         skipWhitespace();
+         std::string name;
+         if (pos_ == end_ || *pos_ != '"' || !parseString(&name))
+            return false;
+
+         skipWhitespace();
+         if (!consume(':'))
+            return false;
+
+         // parse directly into the member (last duplicate wins)
+         skipWhitespace();
+         if (!parseValue(&object[name]))
+            return false;
+
+         skipWhitespace();
+         if (consume(','))
+            continue;
+         else if (consume('}'))
+            break;
+         else
+            return false;
+      }
+
+      --depth_;
+      return true;
+   }
+
+   bool parseArray(Value* pValue)
+   {
+      if (++depth_ > kMaxParseDepth)
+         return false;
+
+      ++pos_; // '['
+      Value emptyArray = Value(Array());
+      pValue->swap(emptyArray);
+      Array& array = pValue->get_array();
+
+      skipWhitespace();
+      if (consume(']'))
+      {
+         --depth_;
+         return true;
+      }
+
+      while (true)
+      {
+         skipWhitespace();
+         array.push_back(Value());
+         if (!parseValue(&array.back()))
+            return false;
+
+         skipWhitespace();
+         if (consume(','))
+            continue;
+         else if (consume(']'))
+            break;
+         else
+            return false;
+      }
+
+      --depth_;
+      return true;
+   }
+
+   bool parseString(std::string* pStr)
+   {
+      ++pos_; // opening quote
+
+      // fast path: scan for the closing quote and copy the run of
+      // characters in one go if there are no escapes
+      const char* start = pos_;
+      while (pos_ != end_ && *pos_ != '"' && *pos_ != '\\')
+         ++pos_;
+      if (pos_ == end_)
+         return false;
+      pStr->assign(start, pos_);
+      if (*pos_ == '"')
+      {
+         ++pos_;
+         return true;
+      }
+
+      // slow path: decode escapes
+      while (pos_ != end_)
+      {
+         char ch = *pos_++;
+         if (ch == '"')
+            return true;
+         else if (ch != '\\')
+         {
+            pStr->push_back(ch);
+            continue;
+         }
+
+         if (pos_ == end_)
+            return false;
+
+         char esc = *pos_++;
+         switch (esc)
+         {
+         case '"':  pStr->push_back('"');  break;
+         case '\\': pStr->push_back('\\'); break;
+         case '/':  pStr->push_back('/');  break;
+         case 'b':  pStr->push_back('\b'); break;
+         case 'f':  pStr->push_back('\f'); break;
+         case 'n':  pStr->push_back('\n'); break;
+         case 'r':  pStr->push_back('\r'); break;
+         case 't':  pStr->push_back('\t'); break;
+         case 'x':
+         {
+            unsigned int ch;
+            if (!parseHex(2, &ch))
+               return false;
+            pStr->push_back(static_cast<char>(ch));
+            break;
+         }
+         case 'u':
+         {
+            unsigned int codepoint;
+            if (!parseHex(4, &codepoint))
+               return false;
+
+            // combine surrogate pairs
+            if (codepoint >= 0xD800 && codepoint <= 0xDBFF &&
+                (end_ - pos_) >= 6 && pos_[0] == '\\' && pos_[1] == 'u')
+            {
+               const char* save = pos_;
+               pos_ += 2;
+               unsigned int low;
+               if (parseHex(4, &low) && low >= 0xDC00 && low <= 0xDFFF)
+                  codepoint = 0x10000 + ((codepoint - 0xD800) << 10) +
+                              (low - 0xDC00);
+               else
+                  pos_ = save;
+            }
+
+            appendUtf8(codepoint, pStr);
+            break;
+         }
+         default:
+            // unknown escapes are dropped
+            break;
+         }
+      }
+
+      return false;
+   }
+
+   bool parseHex(int digits, unsigned int* pValue)
+   {
+      if ((end_ - pos_) < digits)
+         return false;
+
+      unsigned int value = 0;
+      for (int i = 0; i < digits; i++)
+      {
+         char ch = *pos_++;
+         value <<= 4;
+         if (ch >= '0' && ch <= '9')
+            value += ch - '0';
+         else if (ch >= 'a' && ch <= 'f')
+            value += ch - 'a' + 10;
+         else if (ch >= 'A' && ch <= 'F')
+            value += ch - 'A' + 10;
+         else
+            return false;
+      }
+
+      *pValue = value;
+      return true;
+   }
+
+   static void appendUtf8(unsigned int codepoint, std::string* pStr)
+   {
+      if (codepoint < 0x80)
+      {
+         pStr->push_back(static_cast<char>(codepoint));
+      }
+      else if (codepoint < 0x800)
+      {
+         pStr->push_back(static_cast<char>(0xC0 | (codepoint >> 6)));
+         pStr->push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+      }
+      else if (codepoint < 0x10000)
+      {
+         pStr->push_back(static_cast<char>(0xE0 | (codepoint >> 12)));
+         pStr->push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+         pStr->push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+      }
+      else
+      {
+         pStr->push_back(static_cast<char>(0xF0 | (codepoint >> 18)));
+         pStr->push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F)));
+         pStr->push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+         pStr->push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+      }
+   }
+
+   bool parseLiteral(const char* literal, const Value& value, Value* pValue)
+   {
+      std::size_t length = std::strlen(literal);
+      if (static_cast<std::size_t>(end_ - pos_) < length ||
+          std::strncmp(pos_, literal, length) != 0)
+      {
+         return false;
+      }
+
+      pos_ += length;
+      *pValue = value;
+      return true;
+   }
+
+   bool parseNumber(Value* pValue)
+   {
+      const char* start = pos_;
+      bool negative = consume('-');
+      if (!negative)
+         consume('+');
+
+      // integer part
+      const char* digitsStart = pos_;
+      boost::uint64_t magnitude = 0;
+      bool overflow = false;
+      while (pos_ != end_ && *pos_ >= '0' && *pos_ <= '9')
+      {
+         unsigned int digit = *pos_ - '0';
+         if (magnitude > (UINT64_MAX - digit) / 10)
+            overflow = true;
+         magnitude = magnitude * 10 + digit;
+         ++pos_;
+      }
+      bool haveIntegerDigits = pos_ != digitsStart;
+
+      // fraction and exponent make this a real
+      bool real = false;
+      if (pos_ != end_ && *pos_ == '.')
+      {
+         real = true;
+         ++pos_;
+         const char* fractionStart = pos_;
+         while (pos_ != end_ && *pos_ >= '0' && *pos_ <= '9')
+            ++pos_;
+         if (!haveIntegerDigits && pos_ == fractionStart)
+            return false;
+      }
+      else if (!haveIntegerDigits)
+      {
+         return false;
+      }
+
+      if (pos_ != end_ && (*pos_ == 'e' || *pos_ == 'E'))
+      {
+         const char* exponentStart = pos_;
+         ++pos_;
+         if (!consume('-'))
+            consume('+');
+         const char* exponentDigits = pos_;
+         while (pos_ != end_ && *pos_ >= '0' && *pos_ <= '9')
+            ++pos_;
+         if (pos_ == exponentDigits)
+            pos_ = exponentStart; // not an exponent after all
+         else
+            real = true;
+      }
+
+      if (real || overflow)
+         return parseReal(start, pos_, pValue);
+
+      if (negative)
+      {
+         if (magnitude > static_cast<boost::uint64_t>(INT64_MAX) + 1)
+            return parseReal(start, pos_, pValue);
+         *pValue = Value(static_cast<boost::int64_t>(0 - magnitude));
+      }
+      else if (magnitude > static_cast<boost::uint64_t>(INT64_MAX))
+      {
+         *pValue = Value(magnitude);
+      }
+      else
+      {
+         *pValue = Value(static_cast<boost::int64_t>(magnitude));
+      }
+
+      return true;
+   }
+
+   static bool parseReal(const char* begin, const char* end, Value* pValue)
+   {
+      // strtod needs a null terminated string and honors the locale's
+      // decimal point so normalize the number before converting
+      std::string number(begin, end);
+      const char* decimalPoint = std::localeconv()->decimal_point;
+      if (decimalPoint && decimalPoint[0] != '.')
+         std::replace(number.begin(), number.end(), '.', decimalPoint[0]);
+
+      char* pEnd = NULL;
+      double value = std::strtod(number.c_str(), &pEnd);
+      if (pEnd == number.c_str())
+         return false;
+
+      *pValue = Value(value);
+      return true;
+   }
+
+   void skipWhitespace()
+   {
+      while (pos_ != end_ && std::isspace(static_cast<unsigned char>(*pos_)))
+         ++pos_;
+   }
+
+   bool consume(char ch)
+   {
+      if (pos_ != end_ && *pos_ == ch)
+      {
+         ++pos_;
+         return true;
+      }
+      return false;
+   }
+
+private:
+   const char* pos_;
+   const char* end_;
+   int depth_;
+};
+
+// writes json text to a stream via an intermediate buffer (so that we
+// don't pay for a virtual call through the streambuf on every character)
+class Generator
+{
+public:
+   Generator(std::ostream& os, bool pretty)
+      : pOs_(&os), buffer_(streamBuffer_), pretty_(pretty), indent_(0)
+   {
+      buffer_.reserve(kBufferSize);
+   }
+
+   // write directly to a string (no intermediate buffer)
+   Generator(std::string* pOutput, bool pretty)
+      : pOs_(NULL), buffer_(*pOutput), pretty_(pretty), indent_(0)
+   {
+   }
+
+   ~Generator()
+   {
+      try
+      {
+         flush();
+      }
+      catch(...)
+      {
+      }
+   }
+
+   void output(const Value& value)
+   {
+      switch (value.type())
+      {
+      case json_spirit::obj_type:
+         output(value.get_obj());
+         break;
+      case json_spirit::array_type:
+         output(value.get_array());
+         break;
+      case json_spirit::str_type:
+         outputString(value.get_str());
+         break;
+      case json_spirit::bool_type:
+         buffer_.append(value.get_bool() ? "true" : "false");
+         break;
+      case json_spirit::int_type:
+         outputInt(value);
+         break;
+      case json_spirit::real_type:
+         outputReal(value.get_real());
+         break;
+      case json_spirit::null_type:
+         buffer_.append("null");
+         break;
+      }
+
+      flushIfFull();
+   }
+
+   void output(const Object& object)
+   {
+      startContainer('{');
+      for (Object::const_iterator it = object.begin(); it != object.end(); )
+      {
+         indent();
+         outputMember(it->first);
+         output(it->second);
+         if (++it != object.end())
+            buffer_.push_back(',');
+         newLine();
+      }
+      endContainer('}');
+   }
+
+   void output(const Array& array)
+   {
+      startContainer('[');
+      for (Array::const_iterator it = array.begin(); it != array.end(); )
+      {
+         indent();
+         output(*it);
+         if (++it != array.end())
+            buffer_.push_back(',');
+         newLine();
+      }
+      endContainer(']');
+   }
+
+   void outputRaw(char ch)
+   {
+      buffer_.push_back(ch);
+   }
+
+   void outputMember(const std::string& name)
+   {
+      outputString(name);
+      space();
+      buffer_.push_back(':');
+      space();
+   }
+
+   void outputString(const std::string& str)
+   {
+      outputString(str.data(), str.size());
+   }
+
+   void outputString(const char* str, std::size_t length)
+   {
+      buffer_.push_back('"');
+
+      const char* begin = str;
+      const char* end = begin + length;
+      const char* run = begin;
+      for (const char* it = begin; it != end; ++it)
+      {
+         unsigned char ch = static_cast<unsigned char>(*it);
+         if (ch >= 0x20 && ch != '"' && ch != '\\')
+            continue;
+
+         buffer_.append(run, it);
+         run = it + 1;
+
+         switch (ch)
+         {
+         case '"':  buffer_.append("\\\""); break;
+         case '\\': buffer_.append("\\\\"); break;
+         case '\b': buffer_.append("\\b");  break;
+         case '\f': buffer_.append("\\f");  break;
+         case '\n': buffer_.append("\\n");  break;
+         case '\r': buffer_.append("\\r");  break;
+         case '\t': buffer_.append("\\t");  break;
+         default:
+         {
+            char escaped[7];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04X", ch);
+            buffer_.append(escaped);
+            break;
+         }
+         }
+      }
+      buffer_.append(run, end);
+
+      buffer_.push_back('"');
+   }
+
+   void outputInt(int value)
+   {
+      char number[16];
+      std::snprintf(number, sizeof(number), "%d", value);
+      buffer_.append(number);
+   }
+
+   void outputInt(const Value& value)
+   {
+      char number[32];
+      if (value.is_uint64())
+         std::snprintf(number, sizeof(number), "%llu",
+                       static_cast<unsigned long long>(value.get_uint64()));
+      else
+         std::snprintf(number, sizeof(number), "%lld",
+                       static_cast<long long>(value.get_int64()));
+      buffer_.append(number);
+   }
+
+   void outputReal(double value)
+   {
+      // equivalent to std::showpoint << std::setprecision(16)
+      char number[64];
+      std::snprintf(number, sizeof(number), "%#.16g", value);
+      const char* decimalPoint = std::localeconv()->decimal_point;
+      if (decimalPoint && decimalPoint[0] != '.')
+         std::replace(number, number + std::strlen(number), decimalPoint[0], '.');
+      buffer_.append(number);
+   }
+
+   void startContainer(char ch)
+   {
+      buffer_.push_back(ch);
+      newLine();
+      ++indent_;
+   }
+
+   void endContainer(char ch)
+   {
+      --indent_;
+      indent();
+      buffer_.push_back(ch);
+   }
+
+   void indent()
+   {
+      if (pretty_)
+         buffer_.append(indent_ * 4, ' ');
+   }
+
+   void space()
+   {
+      if (pretty_)
+         buffer_.push_back(' ');
+   }
+
+   void newLine()
+   {
+      if (pretty_)
+         buffer_.push_back('\n');
+   }
+
+   void flushIfFull()
+   {
+      if (pOs_ && buffer_.size() >= kBufferSize)
+         flush();
+   }
+
+   void flush()
+   {
+      if (pOs_ && !buffer_.empty())
+      {
+         pOs_->write(buffer_.data(), buffer_.size());
+         buffer_.clear();
+      }
+   }
+
+private:
+   static const std::size_t kBufferSize = 8192;
+
+   std::ostream* pOs_;
+   std::string streamBuffer_;
+   std::string& buffer_;
+   bool pretty_;
+   int indent_;
+};
+
+} // anonymous namespace
+
+bool parse(const std::string& input, Value* pValue)
+{
+   Parser parser(input.data(), input.data() + input.size());
+   return parser.parse(pValue);
 }
 
 void write(const Value& value, std::ostream& os)
 {
-   json_spirit::write(value, os);
+   Generator(os, false).output(value);
 }
 
 void writeFormatted(const Value& value, std::ostream& os)
 {
-   json_spirit::write_formatted(value, os);
+   Generator(os, true).output(value);
 }
 
 std::string write(const Value& value)
 {
-   return json_spirit::write(value);
+   std::string output;
+   Generator(&output, false).output(value);
+   return output;
 }
 
 std::string writeFormatted(const Value& value)
 {
-   return json_spirit::write_formatted(value);
+   std::string output;
+   Generator(&output, true).output(value);
+   return output;
+}
+
+struct StreamWriter::Impl
+{
+   Impl(std::ostream& os) : generator(os, false), pendingKey(false) {}
+   Impl(std::string* pOutput) : generator(pOutput, false), pendingKey(false) {}
+
+   Generator generator;
+
+   // for each open container, whether we've written an element yet
+   std::vector<bool> started;
+
+   // whether a key was just written (so the next value belongs to it)
+   bool pendingKey;
+};
+
+StreamWriter::StreamWriter(std::ostream& os)
+   : pImpl_(new Impl(os))
+{
+}
+
+StreamWriter::StreamWriter(std::string* pOutput)
+   : pImpl_(new Impl(pOutput))
+{
+}
+
+StreamWriter::~StreamWriter()
+{
+}
+
+void StreamWriter::startObject()
+{
+   beginElement();
+   pImpl_->generator.startContainer('{');
+   pImpl_->started.push_back(false);
+}
+
+void StreamWriter::endObject()
+{
+   pImpl_->started.pop_back();
+   pImpl_->generator.endContainer('}');
+}
+
+void StreamWriter::startArray()
+{
+   beginElement();
+   pImpl_->generator.startContainer('[');
+   pImpl_->started.push_back(false);
+}
+
+void StreamWriter::endArray()
+{
+   pImpl_->started.pop_back();
+   pImpl_->generator.endContainer(']');
+}
+
+void StreamWriter::key(const std::string& name)
+{
+   beginElement();
+   pImpl_->generator.outputMember(name);
+
+   // the value which follows belongs to this member
+   pImpl_->pendingKey = true;
+}
+
+void StreamWriter::value(const Value& value)
+{
+   beginElement();
+   pImpl_->generator.output(value);
+}
+
+void StreamWriter::stringValue(const char* str, std::size_t length)
+{
+   beginElement();
+   pImpl_->generator.outputString(str, length);
+   pImpl_->generator.flushIfFull();
+}
+
+void StreamWriter::intValue(int value)
+{
+   beginElement();
+   pImpl_->generator.outputInt(value);
+   pImpl_->generator.flushIfFull();
+}
+
+void StreamWriter::flush()
+{
+   pImpl_->generator.flush();
+}
+
+void StreamWriter::beginElement()
+{
+   if (pImpl_->pendingKey)
+   {
+      pImpl_->pendingKey = false;
+      return;
+   }
+
+   if (!pImpl_->started.empty())
+   {
+      if (pImpl_->started.back())
+         pImpl_->generator.outputRaw(',');
+      pImpl_->started.back() = true;
+   }
 }
 
 } // namespace json
@@ -0,0 +1,278 @@
+/*
+ * JsonTests.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <iostream>
+#include <sstream>
+
+#include <boost/format.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+#include <core/json/Json.hpp>
+
+namespace rstudio {
+namespace core {
+namespace tests {
+
+namespace {
+
+// documents with their serialization (compact and formatted) as produced by
+// the json_spirit implementation we replaced (NULL when they don't parse)
+struct CompatibilityCase
+{
+   const char* input;
+   const char* output;
+   const char* formattedOutput;
+};
+
+const CompatibilityCase kCompatibilityCases[] = {
+   { "{}",
+     "{}",
+     "{\n}" },
+   { "[]",
+     "[]",
+     "[\n]" },
+   { "{\"a\":1,\"b\":[1,2.5,-3,true,false,null,\"x\"]}",
+     "{\"a\":1,\"b\":[1,2.500000000000000,-3,true,false,null,\"x\"]}",
+     "{\n"
+     "    \"a\" : 1,\n"
+     "    \"b\" : [\n"
+     "        1,\n"
+     "        2.500000000000000,\n"
+     "        -3,\n"
+     "        true,\n"
+     "        false,\n"
+     "        null,\n"
+     "        \"x\"\n"
+     "    ]\n"
+     "}" },
+   { "  [ 1 , 2 ] trailing content",
+     "[1,2]",
+     "[\n    1,\n    2\n]" },
+   { "\"a\\\"b\\\\c\\n\\t\\/\"",
+     "\"a\\\"b\\\\c\\n\\t/\"",
+     "\"a\\\"b\\\\c\\n\\t/\"" },
+   { "1e5",
+     "100000.0000000000",
+     "100000.0000000000" },
+   { "-1.5E-3",
+     "-0.001500000000000000",
+     "-0.001500000000000000" },
+   { "9223372036854775807",
+     "9223372036854775807",
+     "9223372036854775807" },
+   { "9223372036854775808",
+     "9223372036854775808",
+     "9223372036854775808" },
+   { "-9223372036854775808",
+     "-9223372036854775808",
+     "-9223372036854775808" },
+   { "18446744073709551615",
+     "18446744073709551615",
+     "18446744073709551615" },
+   { "5.",
+     "5.000000000000000",
+     "5.000000000000000" },
+   { ".5",
+     "0.5000000000000000",
+     "0.5000000000000000" },
+   { "{\"a\":1,\"a\":2}",
+     "{\"a\":2}",
+     "{\n    \"a\" : 2\n}" },
+   { "{\"x\":{\"y\":{\"z\":[{}]}}}",
+     "{\"x\":{\"y\":{\"z\":[{}]}}}",
+     "{\n"
+     "    \"x\" : {\n"
+     "        \"y\" : {\n"
+     "            \"z\" : [\n"
+     "                {\n"
+     "                }\n"
+     "            ]\n"
+     "        }\n"
+     "    }\n"
+     "}" },
+   { "[1,]", NULL, NULL },
+   { "{\"a\"}", NULL, NULL },
+   { "{\"a\":}", NULL, NULL },
+   { "[1 2]", NULL, NULL },
+   { "", NULL, NULL },
+   { "tru", NULL, NULL },
+};
+
+// a representative rpc request (as sent by the client)
+std::string rpcRequest()
+{
+   return "{\"method\":\"console_input\",\"params\":[\"print(head(mtcars))\","
+          "\"\",0],\"clientId\":\"33E600BB-c1b2-46e2-a6ab-2d6a0e4c1ddd\","
+          "\"clientVersion\":\"\"}";
+}
+
+// a representative get_events response (a long array of client events)
+std::string eventsResponse(int count)
+{
+   std::ostringstream os;
+   os << "{\"result\":[";
+   for (int i = 0; i < count; i++)
+   {
+      if (i > 0)
+         os << ",";
+      os << boost::format("{\"id\":%1%,\"type\":\"console_output\","
+                          "\"data\":{\"text\":\"[%1%] \\\"value\\\"\\t1.5\\n\","
+                          "\"console\":\"\"}}") % i;
+   }
+   os << "],\"ev\":\"false\"}";
+   return os.str();
+}
+
+double secondsSince(const boost::posix_time::ptime& start)
+{
+   using namespace boost::posix_time;
+   return (microsec_clock::universal_time() - start).total_microseconds() /
+          1000000.0;
+}
+
+// the json_spirit reader and writer are no longer in the tree so the
+// baseline is the time per operation (in microseconds) they took for the
+// same payloads, recorded alongside the new implementation in an optimized
+// build on one machine (compare ratios rather than absolute times)
+void benchmark(const std::string& name,
+               const std::string& input,
+               int iterations,
+               double spiritParseMicros,
+               double spiritWriteMicros)
+{
+   using namespace boost::posix_time;
+
+   ptime start = microsec_clock::universal_time();
+   json::Value value;
+   for (int i = 0; i < iterations; i++)
+      json::parse(input, &value);
+   double parseMicros = secondsSince(start) * 1000000.0 / iterations;
+
+   start = microsec_clock::universal_time();
+   for (int i = 0; i < iterations; i++)
+      json::write(value);
+   double writeMicros = secondsSince(start) * 1000000.0 / iterations;
+
+   std::cerr << boost::format("%1%: parse %2$.2fus (json_spirit %3$.2fus), "
+                              "write %4$.2fus (json_spirit %5$.2fus)")
+                % name % parseMicros % spiritParseMicros
+                % writeMicros % spiritWriteMicros
+             << std::endl;
+}
+
+} // anonymous namespace
+
+TEST_CASE("json")
+{
+   SECTION("parse and write are compatible with json_spirit")
+   {
+      std::size_t count = sizeof(kCompatibilityCases) / sizeof(CompatibilityCase);
+      for (std::size_t i = 0; i < count; i++)
+      {
+         const CompatibilityCase& compatibilityCase = kCompatibilityCases[i];
+
+         json::Value value;
+         bool parsed = json::parse(compatibilityCase.input, &value);
+         CHECK(parsed == (compatibilityCase.output != NULL));
+         if (parsed)
+         {
+            CHECK(json::write(value) == compatibilityCase.output);
+            CHECK(json::writeFormatted(value) ==
+                  compatibilityCase.formattedOutput);
+         }
+      }
+   }
+
+   SECTION("unicode escapes are decoded as utf-8")
+   {
+      json::Value value;
+      REQUIRE(json::parse("\"\\u00e9\\ud83d\\ude00\"", &value));
+      CHECK(value.get_str() == "\xc3\xa9\xf0\x9f\x98\x80");
+   }
+
+   SECTION("control characters are escaped")
+   {
+      CHECK(json::write(json::Value(std::string("a\x01", 2))) ==
+            "\"a\\u0001\"");
+   }
+
+   SECTION("deeply nested input is rejected")
+   {
+      json::Value value;
+      CHECK_FALSE(json::parse(std::string(100000, '['), &value));
+   }
+
+   SECTION("stream writer produces the same output as write")
+   {
+      json::Array events;
+      std::ostringstream os;
+      {
+         json::StreamWriter writer(os);
+         writer.startObject();
+         writer.key("ev");
+         writer.value(json::Value("false"));
+         writer.key("result");
+         writer.startArray();
+         for (int i = 0; i < 3; i++)
+         {
+            json::Object event;
+            event["id"] = i;
+            events.push_back(event);
+            writer.value(event);
+         }
+         writer.endArray();
+         writer.endObject();
+      }
+
+      json::Object response;
+      response["result"] = events;
+      response["ev"] = "false";
+      CHECK(os.str() == json::write(response));
+   }
+
+   SECTION("stream writer writes raw values to a string")
+   {
+      std::string output;
+      {
+         json::StreamWriter writer(&output);
+         writer.startArray();
+         writer.intValue(-42);
+         std::string text("a \"quoted\"\nvalue\x01 and more");
+         writer.stringValue(text.c_str(), text.find(" and more"));
+         writer.value(json::Value(true));
+         writer.endArray();
+      }
+
+      json::Array expected;
+      expected.push_back(-42);
+      expected.push_back("a \"quoted\"\nvalue\x01");
+      expected.push_back(true);
+      CHECK(output == json::write(expected));
+   }
+}
+
+// not run by default (select it with [benchmark])
+TEST_CASE("json throughput", "[.][benchmark]")
+{
+   benchmark("rpc request", rpcRequest(), 10000, 1.97, 1.12);
+   benchmark("events response", eventsResponse(1000), 50, 1640, 1170);
+}
+
+} // namespace tests
+} // namespace core
+} // namespace rstudio
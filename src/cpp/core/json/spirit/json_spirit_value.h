@@ -1,15 +0,0 @@
-#ifndef JSON_SPIRIT_VALUE_INC
-#define JSON_SPIRIT_VALUE_INC
-
-//          Copyright John W. Wilkinson 2007 - 2009.
-// Distributed under the MIT License, see accompanying file LICENSE.txt
-
-// json spirit version 4.03
-
-#if defined(_MSC_VER) && (_MSC_VER >= 1020)
-# pragma once
-#endif
-
-#include <core/json/spirit/json_spirit_value.h>
-
-#endif
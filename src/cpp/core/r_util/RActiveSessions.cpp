@@ -15,7 +15,12 @@
 
 #include <core/r_util/RActiveSessions.hpp>
 
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
 #include <boost/bind.hpp>
+#include <boost/format.hpp>
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
@@ -35,6 +40,42 @@ namespace r_util {
 
 namespace {
 
+// identifies the version of a file on disk (or is empty if it doesn't
+// exist). files are replaced rather than written in place, so each version
+// has a new inode; the modification time (to the nanosecond) and size guard
+// against an inode being reused
+std::string fileStamp(const FilePath& filePath)
+{
+#ifndef _WIN32
+   struct stat st;
+   if (::stat(filePath.absolutePath().c_str(), &st) == -1)
+      return std::string();
+
+#ifdef __APPLE__
+   const struct timespec& mtime = st.st_mtimespec;
+#else
+   const struct timespec& mtime = st.st_mtim;
+#endif
+   return boost::str(boost::format("%1%:%2%.%3%:%4%")
+                     % st.st_ino % mtime.tv_sec % mtime.tv_nsec % st.st_size);
+#else
+   if (!filePath.exists())
+      return std::string();
+
+   return safe_convert::numberToString(filePath.lastWriteTime()) + ":" +
+          safe_convert::numberToString(filePath.size());
+#endif
+}
+
+// move a temporary file into place, so that readers never see a partially
+// written file
+Error replaceFile(const FilePath& tempPath, const FilePath& filePath)
+{
+   Error error = tempPath.move(filePath, FilePath::MoveDirect);
+   if (error)
+      tempPath.removeIfExists();
+   return error;
+}
 
 } // anonymous namespace
 
@@ -42,31 +83,223 @@ namespace {
 void ActiveSession::writeProperty(const std::string& name,
                                  const std::string& value) const
 {
-   FilePath propertyFile = propertiesPath_.childPath(name);
-   Error error = core::writeStringToFile(propertyFile, value);
+   std::map<std::string,std::string> properties;
+   properties[name] = value;
+   writeProperties(properties);
+}
+
+void ActiveSession::writeProperties(
+               const std::map<std::string,std::string>& properties) const
+{
+   // volatile properties are written to their own files (so they don't need
+   // a read-modify-write of the record, which could lose a concurrent update)
+   std::map<std::string,std::string> recordProperties;
+   typedef std::pair<const std::string,std::string> Property;
+   BOOST_FOREACH(const Property& property, properties)
+   {
+      if (isVolatileProperty(property.first))
+      {
+         Error error = writeVolatileProperty(property.first, property.second);
+         if (error)
+            LOG_ERROR(error);
+      }
+      else
+      {
+         recordProperties.insert(property);
+
+         if (isLegacyProperty(property.first))
+         {
+            Error error = writePropertyFile(property.first, property.second);
+            if (error)
+               LOG_ERROR(error);
+         }
+      }
+   }
+
+   if (recordProperties.empty())
+      return;
+
+   // update the latest version of the record. note that the record is only
+   // written at creation and then by the session itself
+   Error error = loadProperties();
+   if (error)
+      LOG_ERROR(error);
+
+   BOOST_FOREACH(const Property& property, recordProperties)
+   {
+      properties_[property.first] = property.second;
+   }
+
+   error = writeRecord();
    if (error)
       LOG_ERROR(error);
 }
 
 std::string ActiveSession::readProperty(const std::string& name) const
 {
-   using namespace rstudio::core;
-   FilePath readPath = propertiesPath_.childPath(name);
-   if (readPath.exists())
+   if (isVolatileProperty(name))
+      return readVolatileProperty(name);
+
+   Error error = loadProperties();
+   if (error)
+   {
+      LOG_ERROR(error);
+      return std::string();
+   }
+
+   std::map<std::string,std::string>::const_iterator it = properties_.find(name);
+   if (it != properties_.end())
+      return it->second;
+   else
+      return std::string();
+}
+
+bool ActiveSession::isVolatileProperty(const std::string& name)
+{
+   // properties written by the server as well as the session, or on each
+   // console input
+   return name == "executing" || name == "last-used" || name == "running";
+}
+
+bool ActiveSession::isLegacyProperty(const std::string& name)
+{
+   // properties which earlier versions require in order to validate a
+   // session (without them a server or session of an earlier version, e.g.
+   // after a downgrade, would consider the session invalid and remove it)
+   return name == "project" || name == "working-dir";
+}
+
+std::string ActiveSession::readVolatileProperty(const std::string& name) const
+{
+   FilePath propertyPath = propertiesPath_.childPath(name);
+   std::string stamp = fileStamp(propertyPath);
+
+   CachedProperty& cached = volatileProperties_[name];
+   if (stamp.empty())
+   {
+      cached = CachedProperty();
+   }
+   else if (stamp != cached.stamp)
    {
       std::string value;
-      Error error = core::readStringFromFile(readPath, &value);
+      Error error = core::readStringFromFile(propertyPath, &value);
       if (error)
       {
          LOG_ERROR(error);
          return std::string();
       }
-      return boost::algorithm::trim_copy(value);
+      cached.stamp = stamp;
+      cached.value = boost::algorithm::trim_copy(value);
    }
-   else
+
+   return cached.value;
+}
+
+Error ActiveSession::writeVolatileProperty(const std::string& name,
+                                           const std::string& value) const
+{
+   Error error = writePropertyFile(name, value);
+   if (error)
+      return error;
+
+   CachedProperty& cached = volatileProperties_[name];
+   cached.stamp = fileStamp(propertiesPath_.childPath(name));
+   cached.value = value;
+   return Success();
+}
+
+Error ActiveSession::writePropertyFile(const std::string& name,
+                                       const std::string& value) const
+{
+   Error error = propertiesPath_.ensureDirectory();
+   if (error)
+      return error;
+
+   FilePath tempPath = scratchPath_.childPath(
+      name + "." + core::system::generateShortenedUuid());
+   error = core::writeStringToFile(tempPath, value);
+   if (error)
+      return error;
+
+   return replaceFile(tempPath, propertiesPath_.childPath(name));
+}
+
+Error ActiveSession::loadProperties() const
+{
+   if (!recordPath_.exists() && propertiesPath_.exists())
    {
-      return std::string();
+      Error error = migrateProperties();
+      if (error)
+         return error;
+   }
+
+   // nothing to do if the record hasn't changed since we read it
+   std::string stamp = fileStamp(recordPath_);
+   if (propertiesLoaded_ && stamp == recordStamp_)
+      return Success();
+
+   std::map<std::string,std::string> properties;
+   if (!stamp.empty())
+   {
+      Error error = readStringMapFromFile(recordPath_, &properties);
+      if (error)
+         return error;
    }
+
+   properties_.swap(properties);
+   propertiesLoaded_ = true;
+   recordStamp_ = stamp;
+   return Success();
+}
+
+Error ActiveSession::migrateProperties() const
+{
+   // read the file for each property (other than the volatile properties,
+   // which remain in their files)
+   std::vector<FilePath> propertyFiles;
+   Error error = propertiesPath_.children(&propertyFiles);
+   if (error)
+      return error;
+
+   std::map<std::string,std::string> properties;
+   BOOST_FOREACH(const FilePath& propertyFile, propertyFiles)
+   {
+      if (propertyFile.isDirectory() ||
+          isVolatileProperty(propertyFile.filename()))
+      {
+         continue;
+      }
+
+      std::string value;
+      error = core::readStringFromFile(propertyFile, &value);
+      if (error)
+         return error;
+      properties[propertyFile.filename()] = boost::algorithm::trim_copy(value);
+   }
+
+   // write them to the record. their files are left in place, since
+   // earlier versions (e.g. after a downgrade, or while a mixed version
+   // rollout is in progress) still read them. this also makes concurrent
+   // migrations harmless: each writes the same record
+   properties_.swap(properties);
+   return writeRecord();
+}
+
+Error ActiveSession::writeRecord() const
+{
+   FilePath tempPath = scratchPath_.childPath(
+      recordPath_.filename() + "." + core::system::generateShortenedUuid());
+   Error error = writeStringMapToFile(tempPath, properties_);
+   if (error)
+      return error;
+
+   error = replaceFile(tempPath, recordPath_);
+   if (error)
+      return error;
+
+   propertiesLoaded_ = true;
+   recordStamp_ = fileStamp(recordPath_);
+   return Success();
 }
 
 Error ActiveSessions::create(const std::string& project,
@@ -92,11 +325,13 @@ Error ActiveSessions::create(const std::string& project,
 
    // write initial settings
    ActiveSession activeSession(id, dir);
-   activeSession.setProject(project);
-   activeSession.setWorkingDir(workingDir);
-   activeSession.setInitial(initial);
-   activeSession.setLastUsed();
-   activeSession.setRunning(false);
+   std::map<std::string,std::string> properties;
+   properties["project"] = project;
+   properties["working-dir"] = workingDir;
+   properties["initial"] = safe_convert::numberToString(initial);
+   properties["last-used"] = ActiveSession::lastUsedNow();
+   properties["running"] = safe_convert::numberToString(false);
+   activeSession.writeProperties(properties);
 
    // return the id
    *pId = id;
@@ -105,30 +340,47 @@ Error ActiveSessions::create(const std::string& project,
 
 namespace {
 
-bool compareActivityLevel(boost::shared_ptr<ActiveSession> a,
-                          boost::shared_ptr<ActiveSession> b)
+// properties of a session which determine its activity level (read once
+// up front rather than on each comparison)
+struct SessionActivity
+{
+   explicit SessionActivity(boost::shared_ptr<ActiveSession> pSession)
+      : executing(pSession->executing()),
+        running(pSession->running()),
+        lastUsed(pSession->lastUsed()),
+        pSession(pSession)
+   {
+   }
+
+   bool executing;
+   bool running;
+   double lastUsed;
+   boost::shared_ptr<ActiveSession> pSession;
+};
+
+bool compareActivityLevel(const SessionActivity& a, const SessionActivity& b)
 {
-   if (a->executing() == b->executing())
+   if (a.executing == b.executing)
    {
-      if (a->running() == b->running())
+      if (a.running == b.running)
       {
-         if (a->lastUsed() == b->lastUsed())
+         if (a.lastUsed == b.lastUsed)
          {
-            return a->id() > b->id();
+            return a.pSession->id() > b.pSession->id();
          }
          else
          {
-            return a->lastUsed() > b->lastUsed();
+            return a.lastUsed > b.lastUsed;
          }
       }
       else
       {
-         return a->running();
+         return a.running;
       }
    }
    else
    {
-      return a->executing();
+      return a.executing;
    }
 }
 
@@ -149,18 +401,34 @@ std::vector<boost::shared_ptr<ActiveSession> > ActiveSessions::list(
       LOG_ERROR(error);
       return sessions;
    }
+   std::vector<SessionActivity> activity;
+   std::map<std::string, boost::shared_ptr<ActiveSession> > index;
    std::string prefix = kSessionDirPrefix;
    BOOST_FOREACH(const FilePath& child, children)
    {
       if (boost::algorithm::starts_with(child.filename(), prefix))
       {
+         // reuse the session from the last listing if we have it
          std::string id = child.filename().substr(prefix.length());
-         boost::shared_ptr<ActiveSession> pSession = get(id);
+         std::map<std::string, boost::shared_ptr<ActiveSession> >::const_iterator
+               it = index_.find(id);
+         boost::shared_ptr<ActiveSession> pSession =
+               it != index_.end() ? it->second : get(id);
          if (!pSession->empty())
          {
+            // skip (rather than remove) sessions whose properties can't be
+            // read right now, as this needn't mean that they are invalid
+            Error error = pSession->loadProperties();
+            if (error)
+            {
+               LOG_ERROR(error);
+               continue;
+            }
+
             if (pSession->validate(userHomePath, projectSharingEnabled))
             {
-               sessions.push_back(pSession);
+               activity.push_back(SessionActivity(pSession));
+               index[id] = pSession;
             }
             else
             {
@@ -177,8 +445,14 @@ std::vector<boost::shared_ptr<ActiveSession> > ActiveSessions::list(
 
    }
 
+   index_.swap(index);
+
    // sort by activity level (most active sessions first)
-   std::sort(sessions.begin(), sessions.end(), compareActivityLevel);
+   std::sort(activity.begin(), activity.end(), compareActivityLevel);
+   BOOST_FOREACH(const SessionActivity& session, activity)
+   {
+      sessions.push_back(session.pSession);
+   }
 
    // return
    return sessions;
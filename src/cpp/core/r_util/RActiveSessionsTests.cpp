@@ -0,0 +1,171 @@
+/*
+ * RActiveSessionsTests.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/r_util/RActiveSessions.hpp>
+
+namespace rstudio {
+namespace core {
+namespace unit_tests {
+
+using namespace core::r_util;
+
+TEST_CASE("RActiveSessions")
+{
+   SECTION("Properties are stored in a single record")
+   {
+      FilePath rootPath;
+      REQUIRE_FALSE(FilePath::tempFilePath(&rootPath));
+      ActiveSessions sessions(rootPath);
+
+      std::string id;
+      REQUIRE_FALSE(sessions.create(kProjectNone, "~/work", &id));
+      boost::shared_ptr<ActiveSession> pSession = sessions.get(id);
+      REQUIRE_FALSE(pSession->empty());
+      CHECK(pSession->project() == kProjectNone);
+      CHECK(pSession->workingDir() == "~/work");
+      CHECK_FALSE(pSession->running());
+      CHECK(pSession->lastUsed() > 0);
+
+      pSession->setLabel("label with \"quotes\"\nand a newline");
+      pSession->beginSession("3.4.4", "/usr/lib/R", "R 3.4.4");
+
+      // another instance sees the changes
+      boost::shared_ptr<ActiveSession> pOther = sessions.get(id);
+      CHECK(pOther->label() == "label with \"quotes\"\nand a newline");
+      CHECK(pOther->running());
+      CHECK(pOther->rVersion() == "3.4.4");
+      CHECK(pOther->rVersionHome() == "/usr/lib/R");
+      CHECK(pOther->rVersionLabel() == "R 3.4.4");
+
+      // and writes from it don't lose them
+      pOther->setExecuting(true);
+      pSession->setWorkingDir("~/other");
+      CHECK(sessions.get(id)->executing());
+      CHECK(sessions.get(id)->workingDir() == "~/other");
+
+      // rewrites of the same size are seen (even within the same second)
+      CHECK(pOther->workingDir() == "~/other");
+      pSession->setWorkingDir("~/again");
+      CHECK(pOther->workingDir() == "~/again");
+      pSession->setExecuting(false);
+      CHECK_FALSE(pOther->executing());
+
+      // the volatile properties are kept out of the record
+      FilePath propertiesPath = pSession->scratchPath().childPath("properites");
+      CHECK(pSession->scratchPath().childPath("session-properties").exists());
+      CHECK(propertiesPath.childPath("executing").exists());
+      CHECK(propertiesPath.childPath("running").exists());
+      CHECK_FALSE(propertiesPath.childPath("label").exists());
+
+      // and the properties earlier versions validate are in their files too
+      std::string workingDir;
+      REQUIRE_FALSE(readStringFromFile(propertiesPath.childPath("working-dir"),
+                                       &workingDir));
+      CHECK(workingDir == "~/again");
+      CHECK(propertiesPath.childPath("project").exists());
+
+      rootPath.removeIfExists();
+   }
+
+   SECTION("Properties stored in separate files are migrated")
+   {
+      FilePath rootPath;
+      REQUIRE_FALSE(FilePath::tempFilePath(&rootPath));
+      ActiveSessions sessions(rootPath);
+
+      FilePath scratchPath = sessions.storagePath().childPath("session-1234");
+      FilePath propertiesPath = scratchPath.childPath("properites");
+      REQUIRE_FALSE(propertiesPath.ensureDirectory());
+      REQUIRE_FALSE(writeStringToFile(propertiesPath.childPath("project"),
+                                      kProjectNone));
+      REQUIRE_FALSE(writeStringToFile(propertiesPath.childPath("working-dir"),
+                                      "~\n"));
+      REQUIRE_FALSE(writeStringToFile(propertiesPath.childPath("last-used"),
+                                      "1500000000000"));
+
+      std::vector<boost::shared_ptr<ActiveSession> > list =
+            sessions.list(FilePath(), false);
+      REQUIRE(list.size() == 1);
+      CHECK(list[0]->id() == "1234");
+      CHECK(list[0]->workingDir() == "~");
+      CHECK(list[0]->lastUsed() == 1500000000000.0);
+      CHECK(scratchPath.childPath("session-properties").exists());
+
+      // (the files are left for earlier versions)
+      CHECK(propertiesPath.childPath("project").exists());
+      CHECK(propertiesPath.childPath("working-dir").exists());
+      CHECK(propertiesPath.childPath("last-used").exists());
+
+      rootPath.removeIfExists();
+   }
+
+   SECTION("Sessions whose properties can't be read are skipped")
+   {
+      FilePath rootPath;
+      REQUIRE_FALSE(FilePath::tempFilePath(&rootPath));
+      ActiveSessions sessions(rootPath);
+
+      // (a record which can't be read)
+      FilePath scratchPath = sessions.storagePath().childPath("session-1234");
+      REQUIRE_FALSE(scratchPath.childPath("session-properties").ensureDirectory());
+
+      CHECK(sessions.list(FilePath(), false).empty());
+      CHECK(scratchPath.exists());
+
+      rootPath.removeIfExists();
+   }
+
+   SECTION("Sessions are listed by activity level")
+   {
+      FilePath rootPath;
+      REQUIRE_FALSE(FilePath::tempFilePath(&rootPath));
+      ActiveSessions sessions(rootPath);
+
+      std::string idle, running, executing;
+      REQUIRE_FALSE(sessions.create(kProjectNone, "~", &idle));
+      REQUIRE_FALSE(sessions.create(kProjectNone, "~", &running));
+      REQUIRE_FALSE(sessions.create(kProjectNone, "~", &executing));
+      sessions.get(running)->beginSession("3.4.4", "/usr/lib/R");
+      sessions.get(executing)->setExecuting(true);
+
+      std::vector<boost::shared_ptr<ActiveSession> > list =
+            sessions.list(FilePath(), false);
+      REQUIRE(list.size() == 3);
+      CHECK(list[0]->id() == executing);
+      CHECK(list[1]->id() == running);
+      CHECK(list[2]->id() == idle);
+
+      // listing again picks up changes and removed sessions
+      sessions.get(running)->endSession();
+      REQUIRE_FALSE(sessions.get(idle)->destroy());
+      list = sessions.list(FilePath(), false);
+      REQUIRE(list.size() == 2);
+      CHECK(list[0]->id() == executing);
+      CHECK_FALSE(list[1]->running());
+      CHECK(sessions.count(FilePath(), false) == 2);
+
+      rootPath.removeIfExists();
+   }
+}
+
+} // namespace unit_tests
+} // namespace core
+} // namespace rstudio
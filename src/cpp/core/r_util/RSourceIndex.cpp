@@ -41,6 +41,7 @@ std::set<std::string> RSourceIndex::s_importedPackages_;
 RSourceIndex::ImportFromMap RSourceIndex::s_importFromDirectives_;
 std::map<std::string, PackageInformation> RSourceIndex::s_packageInformation_;
 FunctionInformation RSourceIndex::s_noSuchFunction_;
+std::size_t RSourceIndex::s_packageInformationGeneration_ = 0;
 
 namespace {
 
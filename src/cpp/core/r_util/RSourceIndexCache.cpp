@@ -0,0 +1,498 @@
+/*
+ * RSourceIndexCache.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/r_util/RSourceIndexCache.hpp>
+
+#include <cstring>
+
+#include <boost/foreach.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Log.hpp>
+#include <core/system/System.hpp>
+
+namespace rstudio {
+namespace core {
+namespace r_util {
+
+namespace {
+
+// File layout (all integers little endian, strings length-prefixed):
+//
+//   magic     char[4]  "RSIC"
+//   version   u32
+//   tag       string
+//   count     u32
+//   entries   count x { path, mtime i64, size u64, length u32, index }
+//
+// where each index (length bytes, decoded only when looked up) is
+//
+//   packages u32 x string,
+//   items u32 x { type i32, name, braceLevel i32, line u32, column u32,
+//                 params u32 x { name, type } }
+//
+const char kMagic[] = { 'R', 'S', 'I', 'C' };
+const boost::uint32_t kVersion = 2;
+
+void writeU32(boost::uint32_t value, std::string* pBuffer)
+{
+   for (int i = 0; i < 4; i++)
+      pBuffer->push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+}
+
+void writeU64(boost::uint64_t value, std::string* pBuffer)
+{
+   for (int i = 0; i < 8; i++)
+      pBuffer->push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+}
+
+void writeString(const std::string& value, std::string* pBuffer)
+{
+   writeU32(static_cast<boost::uint32_t>(value.size()), pBuffer);
+   pBuffer->append(value);
+}
+
+void encodeIndex(const RSourceIndex& index, std::string* pBuffer)
+{
+   writeU32(static_cast<boost::uint32_t>(index.getInferredPackages().size()),
+            pBuffer);
+   BOOST_FOREACH(const std::string& package, index.getInferredPackages())
+   {
+      writeString(package, pBuffer);
+   }
+
+   writeU32(static_cast<boost::uint32_t>(index.items().size()), pBuffer);
+   BOOST_FOREACH(const RSourceItem& item, index.items())
+   {
+      writeU32(static_cast<boost::uint32_t>(item.type()), pBuffer);
+      writeString(item.name(), pBuffer);
+      writeU32(static_cast<boost::uint32_t>(item.braceLevel()), pBuffer);
+      writeU32(static_cast<boost::uint32_t>(item.line()), pBuffer);
+      writeU32(static_cast<boost::uint32_t>(item.column()), pBuffer);
+
+      writeU32(static_cast<boost::uint32_t>(item.signature().size()), pBuffer);
+      BOOST_FOREACH(const RS4MethodParam& param, item.signature())
+      {
+         writeString(param.name(), pBuffer);
+         writeString(param.type(), pBuffer);
+      }
+   }
+}
+
+// bounds-checked cursor over the mapped cache file; every read fails
+// (rather than overrunning) if the file is truncated or corrupt
+class Reader
+{
+public:
+   Reader(const char* pData, std::size_t length)
+      : pData_(pData), length_(length), offset_(0)
+   {
+   }
+
+   bool readBytes(std::size_t n, const char** ppBytes)
+   {
+      if (length_ - offset_ < n)
+         return false;
+      *ppBytes = pData_ + offset_;
+      offset_ += n;
+      return true;
+   }
+
+   bool readU32(boost::uint32_t* pValue)
+   {
+      const char* pBytes;
+      if (!readBytes(4, &pBytes))
+         return false;
+
+      boost::uint32_t value = 0;
+      for (int i = 3; i >= 0; i--)
+         value = (value << 8) | static_cast<unsigned char>(pBytes[i]);
+      *pValue = value;
+      return true;
+   }
+
+   bool readU64(boost::uint64_t* pValue)
+   {
+      const char* pBytes;
+      if (!readBytes(8, &pBytes))
+         return false;
+
+      boost::uint64_t value = 0;
+      for (int i = 7; i >= 0; i--)
+         value = (value << 8) | static_cast<unsigned char>(pBytes[i]);
+      *pValue = value;
+      return true;
+   }
+
+   bool readString(std::string* pValue)
+   {
+      boost::uint32_t size;
+      const char* pBytes;
+      if (!readU32(&size) || !readBytes(size, &pBytes))
+         return false;
+      pValue->assign(pBytes, size);
+      return true;
+   }
+
+   bool atEnd() const { return offset_ == length_; }
+
+private:
+   const char* pData_;
+   std::size_t length_;
+   std::size_t offset_;
+};
+
+} // anonymous namespace
+
+RSourceIndexCache::RSourceIndexCache()
+   : pData_(NULL), dataSize_(0), dirty_(false)
+{
+}
+
+Error RSourceIndexCache::read(const FilePath& cacheFile, const std::string& tag)
+{
+   clear();
+   dirty_ = false;
+
+   if (!cacheFile.exists() || cacheFile.size() == 0)
+      return Success();
+
+   try
+   {
+      boost::shared_ptr<boost::iostreams::mapped_file_source> pMapped(
+         new boost::iostreams::mapped_file_source(cacheFile.absolutePath()));
+      setStorage(pMapped, pMapped->data(), pMapped->size());
+   }
+   catch(const std::exception& e)
+   {
+      Error error = systemError(boost::system::errc::io_error,
+                                ERROR_LOCATION);
+      error.addProperty("what", e.what());
+      error.addProperty("path", cacheFile.absolutePath());
+      return error;
+   }
+
+   if (!decode(tag))
+   {
+      // stale format or corrupt file -- start again from scratch and
+      // make sure we overwrite it the next time we write
+      clear();
+      dirty_ = true;
+   }
+
+   return Success();
+}
+
+Error RSourceIndexCache::write(const FilePath& cacheFile, const std::string& tag)
+{
+   boost::shared_ptr<std::string> pBuffer(new std::string());
+   std::map<std::string, Location> locations;
+   encode(tag, pBuffer.get(), &locations);
+
+   // the buffer is now the storage for every entry (this releases the
+   // previous storage and our references to indexes recorded by update)
+   for (std::map<std::string, Entry>::iterator it = entries_.begin();
+        it != entries_.end();
+        ++it)
+   {
+      it->second.pIndex.reset();
+      it->second.offset = locations[it->first].first;
+      it->second.length = locations[it->first].second;
+   }
+   setStorage(pBuffer, pBuffer->data(), pBuffer->size());
+
+   // write to a temporary file and rename it into place so that a reader
+   // never observes a partially written cache
+   Error error = cacheFile.parent().ensureDirectory();
+   if (error)
+      return error;
+
+   FilePath tempFile = cacheFile.parent().childPath(
+      cacheFile.filename() + "." + core::system::generateShortenedUuid());
+   error = writeStringToFile(tempFile, *pBuffer);
+   if (!error)
+      error = tempFile.move(cacheFile);
+   if (error)
+   {
+      Error removeError = tempFile.removeIfExists();
+      if (removeError)
+         LOG_ERROR(removeError);
+      return error;
+   }
+
+   // the file has the same contents as the buffer so map it instead (if
+   // we can't we just keep the buffer)
+   try
+   {
+      boost::shared_ptr<boost::iostreams::mapped_file_source> pMapped(
+         new boost::iostreams::mapped_file_source(cacheFile.absolutePath()));
+      if (pMapped->size() == pBuffer->size())
+         setStorage(pMapped, pMapped->data(), pMapped->size());
+   }
+   catch(const std::exception&)
+   {
+   }
+
+   dirty_ = false;
+   return Success();
+}
+
+boost::shared_ptr<RSourceIndex> RSourceIndexCache::lookup(
+                                          const std::string& path,
+                                          std::time_t lastWriteTime,
+                                          uintmax_t size,
+                                          const std::string& context) const
+{
+   std::map<std::string, Entry>::const_iterator it = entries_.find(path);
+   if (it == entries_.end())
+      return boost::shared_ptr<RSourceIndex>();
+
+   const Entry& entry = it->second;
+   if (entry.lastWriteTime != static_cast<boost::int64_t>(lastWriteTime) ||
+       entry.size != static_cast<boost::uint64_t>(size))
+   {
+      return boost::shared_ptr<RSourceIndex>();
+   }
+
+   if (entry.pIndex && entry.pIndex->context() == context)
+      return entry.pIndex;
+
+   return decodeIndex(entry, context);
+}
+
+void RSourceIndexCache::update(const std::string& path,
+                               std::time_t lastWriteTime,
+                               uintmax_t size,
+                               const boost::shared_ptr<RSourceIndex>& pIndex)
+{
+   if (!pIndex)
+   {
+      remove(path);
+      return;
+   }
+
+   Entry& entry = entries_[path];
+   entry.lastWriteTime = lastWriteTime;
+   entry.size = size;
+   entry.pIndex = pIndex;
+   entry.offset = 0;
+   entry.length = 0;
+   dirty_ = true;
+}
+
+void RSourceIndexCache::remove(const std::string& path)
+{
+   if (entries_.erase(path) > 0)
+      dirty_ = true;
+}
+
+void RSourceIndexCache::retain(const std::set<std::string>& paths)
+{
+   std::map<std::string, Entry>::iterator it = entries_.begin();
+   while (it != entries_.end())
+   {
+      if (paths.count(it->first) == 0)
+      {
+         entries_.erase(it++);
+         dirty_ = true;
+      }
+      else
+      {
+         ++it;
+      }
+   }
+}
+
+void RSourceIndexCache::clear()
+{
+   if (!entries_.empty())
+      dirty_ = true;
+   entries_.clear();
+   setStorage(boost::shared_ptr<void>(), NULL, 0);
+}
+
+bool RSourceIndexCache::decode(const std::string& tag)
+{
+   Reader reader(pData_, dataSize_);
+
+   const char* pMagic;
+   if (!reader.readBytes(sizeof(kMagic), &pMagic) ||
+       std::memcmp(pMagic, kMagic, sizeof(kMagic)) != 0)
+   {
+      return false;
+   }
+
+   boost::uint32_t version;
+   std::string fileTag;
+   if (!reader.readU32(&version) || version != kVersion ||
+       !reader.readString(&fileTag) || fileTag != tag)
+   {
+      return false;
+   }
+
+   boost::uint32_t count;
+   if (!reader.readU32(&count))
+      return false;
+
+   for (boost::uint32_t i = 0; i < count; i++)
+   {
+      std::string path;
+      Entry entry;
+      boost::uint64_t lastWriteTime;
+      boost::uint32_t length;
+      const char* pIndex;
+      if (!reader.readString(&path) ||
+          !reader.readU64(&lastWriteTime) ||
+          !reader.readU64(&entry.size) ||
+          !reader.readU32(&length) ||
+          !reader.readBytes(length, &pIndex))
+      {
+         return false;
+      }
+      entry.lastWriteTime = static_cast<boost::int64_t>(lastWriteTime);
+      entry.offset = pIndex - pData_;
+      entry.length = length;
+
+      entries_[path] = entry;
+   }
+
+   return reader.atEnd();
+}
+
+boost::shared_ptr<RSourceIndex> RSourceIndexCache::decodeIndex(
+                                          const Entry& entry,
+                                          const std::string& context) const
+{
+   boost::shared_ptr<RSourceIndex> pIndex(new RSourceIndex(context));
+
+   // an index for another context is copied from the recorded one
+   if (entry.pIndex)
+   {
+      BOOST_FOREACH(const std::string& package,
+                    entry.pIndex->getInferredPackages())
+      {
+         pIndex->addInferredPackage(package);
+      }
+      BOOST_FOREACH(const RSourceItem& item, entry.pIndex->items())
+      {
+         pIndex->addSourceItem(item);
+      }
+      return pIndex;
+   }
+
+   // a corrupt index is treated as a miss (the file is just re-indexed)
+   Reader reader(pData_ + entry.offset, entry.length);
+
+   boost::uint32_t packageCount;
+   if (!reader.readU32(&packageCount))
+      return boost::shared_ptr<RSourceIndex>();
+   for (boost::uint32_t i = 0; i < packageCount; i++)
+   {
+      std::string package;
+      if (!reader.readString(&package))
+         return boost::shared_ptr<RSourceIndex>();
+      pIndex->addInferredPackage(package);
+   }
+
+   boost::uint32_t itemCount;
+   if (!reader.readU32(&itemCount))
+      return boost::shared_ptr<RSourceIndex>();
+   for (boost::uint32_t i = 0; i < itemCount; i++)
+   {
+      boost::uint32_t type, braceLevel, line, column, paramCount;
+      std::string name;
+      if (!reader.readU32(&type) ||
+          !reader.readString(&name) ||
+          !reader.readU32(&braceLevel) ||
+          !reader.readU32(&line) ||
+          !reader.readU32(&column) ||
+          !reader.readU32(&paramCount))
+      {
+         return boost::shared_ptr<RSourceIndex>();
+      }
+
+      std::vector<RS4MethodParam> signature;
+      for (boost::uint32_t j = 0; j < paramCount; j++)
+      {
+         std::string paramName, paramType;
+         if (!reader.readString(&paramName) ||
+             !reader.readString(&paramType))
+         {
+            return boost::shared_ptr<RSourceIndex>();
+         }
+         signature.push_back(RS4MethodParam(paramName, paramType));
+      }
+
+      pIndex->addSourceItem(RSourceItem(static_cast<int>(type),
+                                        name,
+                                        signature,
+                                        static_cast<int>(braceLevel),
+                                        line,
+                                        column));
+   }
+
+   if (!reader.atEnd())
+      return boost::shared_ptr<RSourceIndex>();
+
+   return pIndex;
+}
+
+void RSourceIndexCache::encode(const std::string& tag,
+                               std::string* pBuffer,
+                               std::map<std::string, Location>* pLocations) const
+{
+   pBuffer->append(kMagic, sizeof(kMagic));
+   writeU32(kVersion, pBuffer);
+   writeString(tag, pBuffer);
+   writeU32(static_cast<boost::uint32_t>(entries_.size()), pBuffer);
+
+   std::string index;
+   for (std::map<std::string, Entry>::const_iterator it = entries_.begin();
+        it != entries_.end();
+        ++it)
+   {
+      const Entry& entry = it->second;
+      writeString(it->first, pBuffer);
+      writeU64(static_cast<boost::uint64_t>(entry.lastWriteTime), pBuffer);
+      writeU64(entry.size, pBuffer);
+
+      // indexes read from disk are copied across still encoded
+      index.clear();
+      if (entry.pIndex)
+         encodeIndex(*entry.pIndex, &index);
+      else
+         index.assign(pData_ + entry.offset, entry.length);
+
+      writeU32(static_cast<boost::uint32_t>(index.size()), pBuffer);
+      (*pLocations)[it->first] = std::make_pair(pBuffer->size(), index.size());
+      pBuffer->append(index);
+   }
+}
+
+void RSourceIndexCache::setStorage(const boost::shared_ptr<void>& pStorage,
+                                   const char* pData,
+                                   std::size_t size)
+{
+   pStorage_ = pStorage;
+   pData_ = pData;
+   dataSize_ = size;
+}
+
+} // namespace r_util
+} // namespace core
+} // namespace rstudio
@@ -0,0 +1,221 @@
+/*
+ * RSourceIndexCacheTests.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/r_util/RSourceIndexCache.hpp>
+
+namespace rstudio {
+namespace core {
+namespace unit_tests {
+
+using namespace core::r_util;
+
+namespace {
+
+const char* const kCode =
+      "library(dplyr)\n"
+      "foo <- function(x, y) x + y\n"
+      "setGeneric(\"area\", function(shape) standardGeneric(\"area\"))\n"
+      "setMethod(\"area\", signature(shape = \"Circle\"), function(shape) 1)\n";
+
+boost::shared_ptr<RSourceIndex> makeIndex()
+{
+   return boost::shared_ptr<RSourceIndex>(new RSourceIndex("~/foo.R", kCode));
+}
+
+bool sameItems(const RSourceIndex& lhs, const RSourceIndex& rhs)
+{
+   if (lhs.items().size() != rhs.items().size())
+      return false;
+
+   for (std::size_t i = 0; i < lhs.items().size(); i++)
+   {
+      const RSourceItem& a = lhs.items()[i];
+      const RSourceItem& b = rhs.items()[i];
+      if (a.type() != b.type() ||
+          a.name() != b.name() ||
+          a.braceLevel() != b.braceLevel() ||
+          a.line() != b.line() ||
+          a.column() != b.column() ||
+          a.signature().size() != b.signature().size())
+      {
+         return false;
+      }
+
+      for (std::size_t j = 0; j < a.signature().size(); j++)
+      {
+         if (a.signature()[j].name() != b.signature()[j].name() ||
+             a.signature()[j].type() != b.signature()[j].type())
+         {
+            return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+} // anonymous namespace
+
+TEST_CASE("RSourceIndexCache")
+{
+   SECTION("Lookups only hit when last write time and size match")
+   {
+      RSourceIndexCache cache;
+      cache.update("/a/foo.R", 100, 42, makeIndex());
+      CHECK(cache.dirty());
+
+      CHECK(cache.lookup("/a/foo.R", 100, 42, "~/foo.R"));
+      CHECK_FALSE(cache.lookup("/a/foo.R", 101, 42, "~/foo.R"));
+      CHECK_FALSE(cache.lookup("/a/foo.R", 100, 43, "~/foo.R"));
+      CHECK_FALSE(cache.lookup("/a/bar.R", 100, 42, "~/bar.R"));
+
+      cache.remove("/a/foo.R");
+      CHECK_FALSE(cache.lookup("/a/foo.R", 100, 42, "~/foo.R"));
+   }
+
+   SECTION("Retain drops entries for paths no longer present")
+   {
+      RSourceIndexCache cache;
+      cache.update("/a/foo.R", 100, 42, makeIndex());
+      cache.update("/a/bar.R", 100, 42, makeIndex());
+
+      std::set<std::string> paths;
+      paths.insert("/a/bar.R");
+      cache.retain(paths);
+
+      CHECK(cache.size() == 1);
+      CHECK_FALSE(cache.lookup("/a/foo.R", 100, 42, "~/foo.R"));
+      CHECK(cache.lookup("/a/bar.R", 100, 42, "~/bar.R"));
+   }
+
+   SECTION("Indexes round trip through the cache file")
+   {
+      FilePath cacheFile;
+      CHECK_FALSE(FilePath::tempFilePath(&cacheFile));
+
+      boost::shared_ptr<RSourceIndex> pIndex = makeIndex();
+      CHECK(pIndex->items().size() > 0);
+
+      RSourceIndexCache cache;
+      cache.update("/a/foo.R", 100, 42, pIndex);
+      cache.update("/a/empty.R", 5, 0,
+                   boost::shared_ptr<RSourceIndex>(new RSourceIndex("~/empty.R")));
+      CHECK_FALSE(cache.write(cacheFile, "UTF-8"));
+      CHECK_FALSE(cache.dirty());
+
+      RSourceIndexCache restored;
+      CHECK_FALSE(restored.read(cacheFile, "UTF-8"));
+      CHECK_FALSE(restored.dirty());
+      CHECK(restored.size() == 2);
+
+      boost::shared_ptr<RSourceIndex> pRestored =
+            restored.lookup("/a/foo.R", 100, 42, "~/foo.R");
+      CHECK(pRestored);
+      CHECK(pRestored->context() == "~/foo.R");
+      CHECK(sameItems(*pIndex, *pRestored));
+      CHECK(pRestored->getInferredPackages() == pIndex->getInferredPackages());
+
+      cacheFile.removeIfExists();
+   }
+
+   SECTION("Entries read from disk are written back as they were")
+   {
+      FilePath cacheFile;
+      CHECK_FALSE(FilePath::tempFilePath(&cacheFile));
+
+      boost::shared_ptr<RSourceIndex> pIndex = makeIndex();
+      RSourceIndexCache cache;
+      cache.update("/a/foo.R", 100, 42, pIndex);
+      CHECK_FALSE(cache.write(cacheFile, "UTF-8"));
+
+      RSourceIndexCache restored;
+      CHECK_FALSE(restored.read(cacheFile, "UTF-8"));
+      restored.update("/a/bar.R", 200, 84, makeIndex());
+      CHECK_FALSE(restored.write(cacheFile, "UTF-8"));
+
+      // the cache can still be used after it has been written
+      boost::shared_ptr<RSourceIndex> pRestored =
+            restored.lookup("/a/bar.R", 200, 84, "~/foo.R");
+      CHECK(pRestored);
+      CHECK(sameItems(*pIndex, *pRestored));
+
+      RSourceIndexCache reread;
+      CHECK_FALSE(reread.read(cacheFile, "UTF-8"));
+      CHECK(reread.size() == 2);
+      pRestored = reread.lookup("/a/foo.R", 100, 42, "~/foo.R");
+      CHECK(pRestored);
+      CHECK(sameItems(*pIndex, *pRestored));
+      pRestored = reread.lookup("/a/bar.R", 200, 84, "~/bar.R");
+      CHECK(pRestored);
+      CHECK(sameItems(*pIndex, *pRestored));
+
+      cacheFile.removeIfExists();
+   }
+
+   SECTION("Cache files written with another tag are discarded")
+   {
+      FilePath cacheFile;
+      CHECK_FALSE(FilePath::tempFilePath(&cacheFile));
+
+      RSourceIndexCache cache;
+      cache.update("/a/foo.R", 100, 42, makeIndex());
+      CHECK_FALSE(cache.write(cacheFile, "UTF-8"));
+
+      RSourceIndexCache restored;
+      CHECK_FALSE(restored.read(cacheFile, "ISO-8859-1"));
+      CHECK(restored.size() == 0);
+
+      cacheFile.removeIfExists();
+   }
+
+   SECTION("Corrupt cache files are discarded")
+   {
+      FilePath cacheFile;
+      CHECK_FALSE(FilePath::tempFilePath(&cacheFile));
+
+      RSourceIndexCache cache;
+      cache.update("/a/foo.R", 100, 42, makeIndex());
+      CHECK_FALSE(cache.write(cacheFile, "UTF-8"));
+
+      // truncate the file part way through the entry
+      std::string contents;
+      CHECK_FALSE(readStringFromFile(cacheFile, &contents));
+      CHECK_FALSE(writeStringToFile(cacheFile, contents.substr(0, contents.size() / 2)));
+
+      RSourceIndexCache restored;
+      CHECK_FALSE(restored.read(cacheFile, "UTF-8"));
+      CHECK(restored.size() == 0);
+      CHECK(restored.dirty());
+
+      cacheFile.removeIfExists();
+   }
+
+   SECTION("A missing cache file yields an empty cache")
+   {
+      RSourceIndexCache cache;
+      CHECK_FALSE(cache.read(FilePath("/no/such/cache/file"), "UTF-8"));
+      CHECK(cache.size() == 0);
+   }
+}
+
+} // namespace unit_tests
+} // namespace core
+} // namespace rstudio
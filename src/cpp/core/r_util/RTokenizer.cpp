@@ -13,27 +13,15 @@
  *
  */
 
-// A very low level assertion (line 595 of cpp_regex_traits.hpp) is firing
-// on WindowsXP when we create a boost::wregex within R session. This code
-// is part of boost attempting to detect the sort syntax, and the assertion
-// is that there are no nulls in a buffer after a call to locale->transform.
-// Within the same method there are workarounds for both borland c++ and
-// dinkumware c++ std library to strip embedded nulls, so it seems as if
-// there is some variation in whether nulls come out of the call to transforn.
-// Note also that boost has a macro titled BOOST_REGEX_NO_WIN32 which we are
-// not using, which means that boost regex does call into native windows APIs
-// for locale oriented functions (thus explaining a difference in runtime
-// behavior across platforms). Tokenization appears to continue to work
-// correctly in the presence of the assertion (with the annoying side effect
-// of logging an assertion every time the product starts up)
-
 #include <core/r_util/RTokenizer.hpp>
 
-#include <boost/regex.hpp>
-
 #include <iostream>
 #include <sstream>
 
+#include <boost/functional/hash.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/unordered_map.hpp>
+
 #include <core/Error.hpp>
 #include <core/Log.hpp>
 #include <core/StringUtils.hpp>
@@ -45,37 +33,145 @@ namespace r_util {
 
 namespace {
 
-class TokenPatterns
+// The tokenizer matches tokens with hand-written scanners rather than
+// regular expressions. Characters in the ASCII range are classified with a
+// lookup table; anything outside it falls back to the (BMP-wide) tables in
+// string_utils.
+enum CharClass
 {
-private:
-   friend TokenPatterns& tokenPatterns();
-   TokenPatterns()
-      : NUMBER(L"[0-9]*(\\.[0-9]*)?([eE][+-]?[0-9]*)?[Li]?"),
-        HEX_NUMBER(L"0x[0-9a-fA-F]*L?"),
-        USER_OPERATOR(L"%[^%]*%"),
-        QUOTED_IDENTIFIER(L"`[^`]*`"),
-        UNTIL_END_QUOTE(L"[\\\\\'\"]"),
-        WHITESPACE(L"[\\s\x00A0\x3000]+"),
-        COMMENT(L"#[^\\n]*$")
+   kHexDigit   = 1 << 0,  // [0-9a-fA-F]
+   kIdentifier = 1 << 1,  // [A-Za-z0-9._]
+   kWhitespace = 1 << 2   // \s
+};
+
+class AsciiClasses
+{
+public:
+   AsciiClasses()
    {
+      std::fill(classes_, classes_ + 128, 0);
+
+      for (int c = '0'; c <= '9'; c++)
+         classes_[c] |= kHexDigit | kIdentifier;
+      for (int c = 'a'; c <= 'z'; c++)
+         classes_[c] |= kIdentifier;
+      for (int c = 'A'; c <= 'Z'; c++)
+         classes_[c] |= kIdentifier;
+      for (int c = 'a'; c <= 'f'; c++)
+         classes_[c] |= kHexDigit;
+      for (int c = 'A'; c <= 'F'; c++)
+         classes_[c] |= kHexDigit;
+      classes_['.'] |= kIdentifier;
+      classes_['_'] |= kIdentifier;
+
+      const char whitespace[] = " \t\n\v\f\r";
+      for (const char* p = whitespace; *p; p++)
+         classes_[static_cast<int>(*p)] |= kWhitespace;
    }
 
-public:
-   const boost::wregex NUMBER;
-   const boost::wregex HEX_NUMBER;
-   const boost::wregex USER_OPERATOR;
-   const boost::wregex QUOTED_IDENTIFIER;
-   const boost::wregex UNTIL_END_QUOTE;
-   const boost::wregex WHITESPACE;
-   const boost::wregex COMMENT;
+   bool is(wchar_t c, int mask) const
+   {
+      return c >= 0 && c < 128 && (classes_[c] & mask) != 0;
+   }
+
+private:
+   unsigned char classes_[128];
 };
 
-TokenPatterns& tokenPatterns()
+const AsciiClasses& asciiClasses()
 {
-   static TokenPatterns instance;
+   static AsciiClasses instance;
    return instance;
 }
 
+inline bool isDigit(wchar_t c)
+{
+   return c >= L'0' && c <= L'9';
+}
+
+inline bool isHexDigit(wchar_t c)
+{
+   return asciiClasses().is(c, kHexDigit);
+}
+
+inline bool isIdentifierChar(wchar_t c)
+{
+   if (c < 128)
+      return asciiClasses().is(c, kIdentifier);
+   return string_utils::isalnum(c);
+}
+
+inline bool isWhitespace(wchar_t c)
+{
+   if (c < 128)
+      return asciiClasses().is(c, kWhitespace);
+
+   // the remaining unicode whitespace characters (as matched by \s)
+   switch (c)
+   {
+   case 0x0085: case 0x00A0: case 0x1680:
+   case 0x2028: case 0x2029: case 0x202F:
+   case 0x205F: case 0x3000:
+      return true;
+   default:
+      return c >= 0x2000 && c <= 0x200A;
+   }
+}
+
+typedef std::wstring::const_iterator Iterator;
+
+// [0-9]*(\.[0-9]*)?([eE][+-]?[0-9]*)?[Li]?
+Iterator scanDecimal(Iterator pos, Iterator end)
+{
+   while (pos != end && isDigit(*pos))
+      ++pos;
+
+   if (pos != end && *pos == L'.')
+   {
+      ++pos;
+      while (pos != end && isDigit(*pos))
+         ++pos;
+   }
+
+   if (pos != end && (*pos == L'e' || *pos == L'E'))
+   {
+      ++pos;
+      if (pos != end && (*pos == L'+' || *pos == L'-'))
+         ++pos;
+      while (pos != end && isDigit(*pos))
+         ++pos;
+   }
+
+   if (pos != end && (*pos == L'L' || *pos == L'i'))
+      ++pos;
+
+   return pos;
+}
+
+// 0x[0-9a-fA-F]*L? (returns 'pos' if there is no hex prefix)
+Iterator scanHex(Iterator pos, Iterator end)
+{
+   if (end - pos < 2 || pos[0] != L'0' || pos[1] != L'x')
+      return pos;
+
+   Iterator it = pos + 2;
+   while (it != end && isHexDigit(*it))
+      ++it;
+
+   if (it != end && *it == L'L')
+      ++it;
+
+   return it;
+}
+
+// a token delimited by 'ch' at both ends (e.g. `name` or %op%); returns
+// 'pos' if the closing delimiter is missing
+Iterator scanDelimited(Iterator pos, Iterator end, wchar_t ch)
+{
+   Iterator close = std::find(pos + 1, end, ch);
+   return close == end ? pos : close + 1;
+}
+
 void updatePosition(std::wstring::const_iterator pos,
                     std::size_t length,
                     std::size_t* pRow,
@@ -214,7 +310,11 @@ RToken RTokenizer::nextToken()
 
 RToken RTokenizer::matchWhitespace()
 {
-   return consumeToken(RToken::WHITESPACE, tokenLength(tokenPatterns().WHITESPACE));
+   Iterator it = pos_;
+   while (it != end_ && isWhitespace(*it))
+      ++it;
+
+   return consumeToken(RToken::WHITESPACE, it - pos_);
 }
 
 RToken RTokenizer::matchStringLiteral()
@@ -224,7 +324,7 @@ RToken RTokenizer::matchStringLiteral()
 
    while (!eol())
    {
-      eatUntil(tokenPatterns().UNTIL_END_QUOTE);
+      eatUntilQuoteOrEscape();
 
       if (eol())
          break ;
@@ -268,18 +368,18 @@ RToken RTokenizer::matchStringLiteral()
 
 RToken RTokenizer::matchNumber()
 {
-   std::size_t length = tokenLength(tokenPatterns().HEX_NUMBER);
-   if (length == 0)
-      length = tokenLength(tokenPatterns().NUMBER);
+   Iterator end = scanHex(pos_, end_);
+   if (end == pos_)
+      end = scanDecimal(pos_, end_);
 
-   return consumeToken(RToken::NUMBER, length);
+   return consumeToken(RToken::NUMBER, end - pos_);
 }
 
 RToken RTokenizer::matchIdentifier()
 {
    std::wstring::const_iterator start = pos_ ;
    eat();
-   while (string_utils::isalnum(peek()) || peek() == L'.' || peek() == L'_')
+   while (!eol() && isIdentifierChar(*pos_))
       eat();
    
    std::size_t row = row_;
@@ -296,25 +396,31 @@ RToken RTokenizer::matchIdentifier()
 
 RToken RTokenizer::matchQuotedIdentifier()
 {
-   std::size_t length = tokenLength(tokenPatterns().QUOTED_IDENTIFIER);
-   if (length == 0)
+   Iterator end = scanDelimited(pos_, end_, L'`');
+   if (end == pos_)
       return consumeToken(RToken::ERR, 1);
    else
-      return consumeToken(RToken::ID, length);
+      return consumeToken(RToken::ID, end - pos_);
 }
 
 RToken RTokenizer::matchComment()
 {
-   return consumeToken(RToken::COMMENT, tokenLength(tokenPatterns().COMMENT));
+   // the comment runs to the end of the line (not including the '\r' of a
+   // Windows line ending)
+   Iterator end = std::find(pos_, end_, L'\n');
+   if (end != end_ && *(end - 1) == L'\r' && end - 1 != pos_)
+      --end;
+
+   return consumeToken(RToken::COMMENT, end - pos_);
 }
 
 RToken RTokenizer::matchUserOperator()
 {
-   std::size_t length = tokenLength(tokenPatterns().USER_OPERATOR);
-   if (length == 0)
+   Iterator end = scanDelimited(pos_, end_, L'%');
+   if (end == pos_)
       return consumeToken(RToken::ERR, 1);
    else
-      return consumeToken(RToken::UOPER, length);
+      return consumeToken(RToken::UOPER, end - pos_);
 }
 
 
@@ -402,29 +508,15 @@ wchar_t RTokenizer::eat()
    return result ;
 }
 
-std::size_t RTokenizer::tokenLength(const boost::wregex& regex)
+void RTokenizer::eatUntilQuoteOrEscape()
 {
-   boost::wsmatch match;
-   std::wstring::const_iterator end = data_.end();
-   boost::match_flag_type flg = boost::match_default | boost::match_continuous;
-   if (regex_utils::search(pos_, end, match, regex, flg))
-      return match.length();
-   else
-      return 0;
-}
-
-void RTokenizer::eatUntil(const boost::wregex& regex)
-{
-   boost::wsmatch match;
-   std::wstring::const_iterator end = data_.end();
-   if (regex_utils::search(pos_, end, match, regex))
-   {
-      pos_ = match[0].first;
-   }
-   else
+   // eats everything if there is no closing quote
+   while (pos_ != end_)
    {
-      // eat all on failure to match
-      pos_ = data_.end();
+      wchar_t c = *pos_;
+      if (c == L'\\' || c == L'\'' || c == L'"')
+         break;
+      ++pos_;
    }
 }
 
@@ -460,47 +552,97 @@ RToken RTokenizer::consumeToken(RToken::TokenType tokenType,
                  column);
 }
 
-class ConversionCache
+namespace {
+
+// Interned UTF-8 conversions of token contents. The table is bounded: once
+// the current generation fills up it is retired (replacing the previous
+// retired generation) and a new one is started, so frequently used tokens
+// are carried forward while memory use stays proportional to kMaxEntries.
+// Each thread has its own table, so no locking is required and a reference
+// returned to a thread can only be invalidated by that thread converting
+// more than kMaxEntries further distinct tokens.
+const std::size_t kMaxEntries = 16384;
+
+class ConversionCache : boost::noncopyable
 {
 public:
-   
-   typedef std::wstring key_type;
-   typedef std::string mapped_type;
-   
-   bool contains(const RToken& token) const
+   const std::string& get(const RToken& token)
    {
-      return database_.count(token.content());
+      Span span(token.begin(), token.end());
+
+      Table::const_iterator it = current_.find(span, SpanHash(), SpanEqual());
+      if (it != current_.end())
+         return it->second;
+
+      if (current_.size() >= kMaxEntries)
+      {
+         previous_.swap(current_);
+         current_.clear();
+      }
+
+      // carry forward a conversion from the previous generation (copying
+      // it, since references into that generation may still be held)
+      std::wstring key(token.begin(), token.end());
+      it = previous_.find(span, SpanHash(), SpanEqual());
+      if (it != previous_.end())
+         return current_.insert(std::make_pair(key, it->second)).first->second;
+
+      return current_.insert(
+               std::make_pair(key, string_utils::wideToUtf8(key))).first->second;
    }
-   
-   std::string& get(const RToken& token)
+
+private:
+   typedef std::pair<std::wstring::const_iterator,
+                     std::wstring::const_iterator> Span;
+
+   // hashing and equality that allow a table keyed by std::wstring to be
+   // probed with a span of the tokenized document (avoiding a copy)
+   struct SpanHash
    {
-      return database_[token.content()];
-   }
-   
-   void put(const RToken& token, const mapped_type& value)
+      std::size_t operator()(const std::wstring& value) const
+      {
+         return boost::hash_range(value.begin(), value.end());
+      }
+
+      std::size_t operator()(const Span& span) const
+      {
+         return boost::hash_range(span.first, span.second);
+      }
+   };
+
+   struct SpanEqual
    {
-      database_[token.content()] = value;
-   }
-   
-private:
-   std::map<key_type, mapped_type> database_;
+      bool operator()(const Span& span, const std::wstring& value) const
+      {
+         return static_cast<std::size_t>(span.second - span.first) == value.size() &&
+                std::equal(span.first, span.second, value.begin());
+      }
+
+      bool operator()(const std::wstring& lhs, const std::wstring& rhs) const
+      {
+         return lhs == rhs;
+      }
+   };
+
+   typedef boost::unordered_map<std::wstring, std::string, SpanHash, SpanEqual> Table;
+
+   Table current_;
+   Table previous_;
 };
 
 ConversionCache& conversionCache()
 {
-   static ConversionCache instance;
-   return instance;
+   static boost::thread_specific_ptr<ConversionCache> s_pCache;
+   if (s_pCache.get() == NULL)
+      s_pCache.reset(new ConversionCache());
+   return *s_pCache;
 }
 
+} // anonymous namespace
+
 const std::string& RToken::contentAsUtf8() const
 {
-   ConversionCache& cache = conversionCache();
-   if (cache.contains(*this))
-      return cache.get(*this);
-   
-   std::string result = string_utils::wideToUtf8(content());
-   cache.put(*this, result);
-   return cache.get(*this);
+   return conversionCache().get(*this);
 }
 
 std::string RToken::asString() const
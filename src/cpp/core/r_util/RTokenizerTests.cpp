@@ -20,6 +20,8 @@
 #include <iostream>
 
 #include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <tests/TestThat.hpp>
 
@@ -228,8 +230,31 @@ void testWhitespace()
    v.verify(L"\x00A0") ;
    v.verify(L"  \x3000  ") ;
    v.verify(L" \x00A0\t\x3000\r  ") ;
+   v.verify(L" \x2003\x2028\x202F\x0085") ;
 }
 
+// generate R source resembling a package-sized source tree
+std::wstring generateSource(std::size_t functionCount)
+{
+   std::wstring source;
+   for (std::size_t i = 0; i < functionCount; i++)
+   {
+      std::wstring n = string_utils::utf8ToWide(boost::str(boost::format("%1%") % i));
+      source +=
+            L"#' Summarise the values in group " + n + L"\n"
+            L"#' @export\n"
+            L"summarise_group_" + n + L" <- function(data, by = NULL, na.rm = TRUE, ...) {\n"
+            L"  if (is.null(by)) by <- names(data)[[1L]]\n"
+            L"  result <- data %>%\n"
+            L"    dplyr::group_by(.data[[by]]) %>%\n"
+            L"    dplyr::summarise(total = sum(value, na.rm = na.rm), mean = mean(value) * 1.5e-3)\n"
+            L"  stopifnot(nrow(result) >= 0x" + n + L"L, `my var` != 'a \\'quoted\\' string')\n"
+            L"  for (j in seq_len(nrow(result))) result$index[j] <- j %% 2 == 0 || j ^ 2 > 10\n"
+            L"  invisible(result) # return silently\n"
+            L"}\n\n";
+   }
+   return source;
+}
 
 } // anonymous namespace
 
@@ -269,6 +294,68 @@ context("RTokenizer")
       expect_true(rTokens.at(2).isType(RToken::OPER));
       expect_true(rTokens.at(2).contentEquals(L"**"));
    }
+
+   test_that("Pipe operators are recognized")
+   {
+      RTokens rTokens(L"a %>% b %<>% c %T>% d %% e %>>% f %in% g %>a>% h");
+      std::vector<std::wstring> pipes;
+      for (std::size_t i = 0; i < rTokens.size(); i++)
+      {
+         if (token_utils::isPipeOperator(rTokens.at(i)))
+            pipes.push_back(rTokens.at(i).content());
+      }
+
+      expect_true(pipes.size() == 4);
+      expect_true(pipes[0] == L"%>%");
+      expect_true(pipes[1] == L"%<>%");
+      expect_true(pipes[2] == L"%T>%");
+      expect_true(pipes[3] == L"%>>%");
+   }
+
+   test_that("UTF-8 conversions remain correct as the conversion table is recycled")
+   {
+      std::wstring source;
+      for (int i = 0; i < 50000; i++)
+         source += string_utils::utf8ToWide(boost::str(boost::format("x%1%\xC3\xA9 ") % i));
+
+      RTokens rTokens(source);
+      std::size_t i = 0;
+      for (; i < rTokens.size(); i++)
+      {
+         const RToken& token = rTokens.at(i);
+         if (token.contentAsUtf8() != string_utils::wideToUtf8(token.content()))
+            break;
+      }
+      expect_true(i == rTokens.size());
+      expect_true(rTokens.at(0).contentAsUtf8() == "x0\xC3\xA9");
+   }
+}
+
+// not run by default (select it with [benchmark])
+TEST_CASE("RTokenizer throughput", "[.][benchmark]")
+{
+   using namespace boost::posix_time;
+
+   // roughly the size of a large CRAN package's R sources
+   std::wstring source = generateSource(5000);
+
+   ptime start = microsec_clock::universal_time();
+   std::size_t count = 0;
+   std::size_t length = 0;
+   RTokenizer tokenizer(source);
+   while (RToken token = tokenizer.nextToken())
+   {
+      ++count;
+      length += token.length();
+   }
+   double elapsed = (microsec_clock::universal_time() - start).total_microseconds() / 1.0E6;
+
+   std::cerr << boost::format("RTokenizer: %1% tokens (%2% KB) in %3%s (%4% tokens/sec)\n")
+                % count % (source.size() / 1024) % elapsed
+                % static_cast<std::size_t>(count / std::max(elapsed, 1.0E-6));
+
+   // every character of the source belongs to exactly one token
+   CHECK(length == source.size());
 }
 
 } // namespace r_util
@@ -0,0 +1,88 @@
+/*
+ * ChildProcessReactor.hpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_SYSTEM_CHILD_PROCESS_REACTOR_HPP
+#define CORE_SYSTEM_CHILD_PROCESS_REACTOR_HPP
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include <boost/utility.hpp>
+
+namespace rstudio {
+namespace core {
+
+class Error;
+
+namespace system {
+
+class AsyncChildProcess;
+
+// Waits for activity on the descriptors of a set of child processes (their
+// output streams and, where supported, a process descriptor which becomes
+// readable when the child exits). Uses epoll on Linux and poll elsewhere.
+//
+// Each child's descriptors are registered with watch(), which is cheap to
+// call repeatedly with an unchanged set. Descriptors are level-triggered:
+// a child stays ready until its output has been read (or it is reaped).
+//
+// The reactor watches its own duplicate of each descriptor so that it can
+// always unregister it: an epoll registration outlives close() of the
+// original descriptor while any other process (e.g. a forked child) still
+// holds a copy, and a closed pipe would then be reported as ready forever.
+class ChildProcessReactor : boost::noncopyable
+{
+public:
+   ChildProcessReactor();
+   ~ChildProcessReactor();
+
+   // false if the reactor couldn't be created (the caller should fall
+   // back to polling every child)
+   bool valid() const;
+
+   // watch exactly the given descriptors for the child
+   void watch(AsyncChildProcess* pChild, const std::vector<int>& fds);
+
+   // stop watching all of the child's descriptors
+   void unwatch(AsyncChildProcess* pChild);
+
+   // wait up to timeoutMs (0 to return immediately, -1 to wait forever)
+   // for activity, adding children with activity to pReady
+   Error wait(int timeoutMs, std::set<AsyncChildProcess*>* pReady);
+
+   // number of waits which returned with activity
+   std::size_t wakeups() const { return wakeups_; }
+
+private:
+   int add(AsyncChildProcess* pChild, int fd);
+   void remove(int watchFd);
+
+   int epollFd_;
+
+   // child owning each of our duplicate descriptors
+   std::map<int, AsyncChildProcess*> owners_;
+
+   // each child's descriptors (mapped to our duplicates of them)
+   std::map<AsyncChildProcess*, std::map<int, int> > watched_;
+   std::set<AsyncChildProcess*> unwatchable_;
+   std::size_t wakeups_;
+};
+
+} // namespace system
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_SYSTEM_CHILD_PROCESS_REACTOR_HPP
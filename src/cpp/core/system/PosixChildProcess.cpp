@@ -32,6 +32,10 @@
 #include <sys/wait.h>
 #include <sys/types.h>
 
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 
@@ -842,13 +846,47 @@ struct AsyncChildProcess::AsyncImpl
       : calledOnStarted_(false),
         finishedStdout_(false),
         finishedStderr_(false),
-        exited_(false)
+        exited_(false),
+        fdPid_(-1)
+   {
+   }
+
+   ~AsyncImpl()
    {
+      try
+      {
+         closePidFD();
+      }
+      catch(...)
+      {
+      }
    }
+
+   // open a descriptor which becomes readable when the child exits (only
+   // supported on Linux 5.3 and later; if unavailable we poll for exit)
+   void openPidFD(PidType pid)
+   {
+#if defined(__linux__) && defined(SYS_pidfd_open)
+      fdPid_ = static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+      if (fdPid_ != -1)
+         ::fcntl(fdPid_, F_SETFD, FD_CLOEXEC);
+#endif
+   }
+
+   void closePidFD()
+   {
+      if (fdPid_ != -1)
+      {
+         ::close(fdPid_);
+         fdPid_ = -1;
+      }
+   }
+
    bool calledOnStarted_;
    bool finishedStdout_;
    bool finishedStderr_;
    bool exited_;
+   int fdPid_;
    boost::scoped_ptr<ChildProcessSubprocPoll> pSubprocPoll_;
 };
 
@@ -934,11 +972,33 @@ bool AsyncChildProcess::hasRecentOutput() const
       return true;
 }
 
+bool AsyncChildProcess::getEventDescriptors(std::vector<int>* pFds) const
+{
+   if (pAsyncImpl_->exited_)
+      return true;
+
+   if (!pAsyncImpl_->finishedStdout_ && pImpl_->fdStdout != -1)
+      pFds->push_back(pImpl_->fdStdout);
+   if (!pAsyncImpl_->finishedStderr_ && pImpl_->fdStderr != -1)
+      pFds->push_back(pImpl_->fdStderr);
+   if (pAsyncImpl_->fdPid_ != -1)
+      pFds->push_back(pAsyncImpl_->fdPid_);
+
+   return pAsyncImpl_->calledOnStarted_;
+}
+
 void AsyncChildProcess::poll()
+{
+   poll(true);
+}
+
+void AsyncChildProcess::poll(bool hasEvents)
 {
    // call onStarted if we haven't yet
    if (!(pAsyncImpl_->calledOnStarted_))
    {
+      hasEvents = true;
+
       // make sure the output pipes are setup for async reading
       setPipeNonBlocking(pImpl_->fdStdout);
 
@@ -957,6 +1017,9 @@ void AsyncChildProcess::poll()
          options().subprocWhitelist,
          options().trackCwd ? core::system::currentWorkingDir : NULL));
 
+      // watch for exit (for event-driven supervisors)
+      pAsyncImpl_->openPidFD(pImpl_->pid);
+
       if (callbacks_.onStarted)
          callbacks_.onStarted(*this);
       pAsyncImpl_->calledOnStarted_ = true;
@@ -976,7 +1039,7 @@ void AsyncChildProcess::poll()
    bool hasRecentOutput = false;
 
    // check stdout and fire event if we got output
-   if (!pAsyncImpl_->finishedStdout_)
+   if (hasEvents && !pAsyncImpl_->finishedStdout_)
    {
       bool eof;
       std::string out;
@@ -999,7 +1062,7 @@ void AsyncChildProcess::poll()
    }
 
    // check stderr and fire event if we got output
-   if (!pAsyncImpl_->finishedStderr_)
+   if (hasEvents && !pAsyncImpl_->finishedStderr_)
    {
       bool eof;
       std::string err;
@@ -1027,16 +1090,22 @@ void AsyncChildProcess::poll()
    // not be able to reap the child due to an error (typically ECHILD,
    // which occurs if the child was reaped by a global handler) in which
    // case we'll allow the exit sequence to proceed and simply pass -1 as
-   // the exit status.
+   // the exit status. If we have a process descriptor we only need to
+   // check when it (or one of the pipes) reported activity.
    int status;
-   PidType result = posixCall<PidType>(
-            boost::bind(::waitpid, pImpl_->pid, &status, WNOHANG));
+   PidType result = 0;
+   if (hasEvents || pAsyncImpl_->fdPid_ == -1)
+   {
+      result = posixCall<PidType>(
+               boost::bind(::waitpid, pImpl_->pid, &status, WNOHANG));
+   }
 
    // either a normal exit or an error while waiting
    if (result != 0)
    {
       // close all of our pipes
       pImpl_->closeAll(ERROR_LOCATION);
+      pAsyncImpl_->closePidFD();
 
       // fire exit event
       if (callbacks_.onExit)
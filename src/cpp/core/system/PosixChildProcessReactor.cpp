@@ -0,0 +1,258 @@
+/*
+ * PosixChildProcessReactor.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "ChildProcessReactor.hpp"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+#include <boost/foreach.hpp>
+
+#include <core/Error.hpp>
+#include <core/Log.hpp>
+
+namespace rstudio {
+namespace core {
+namespace system {
+
+namespace {
+
+// longest we'll wait when a child's descriptors couldn't be registered
+// (such children are reported as ready on every wait)
+const int kUnwatchableWaitMs = 50;
+
+bool contains(const std::vector<int>& fds, int fd)
+{
+   return std::find(fds.begin(), fds.end(), fd) != fds.end();
+}
+
+bool sameDescriptors(const std::map<int, int>& watched,
+                     const std::vector<int>& fds)
+{
+   if (watched.size() != fds.size())
+      return false;
+
+   BOOST_FOREACH(int fd, fds)
+   {
+      if (watched.find(fd) == watched.end())
+         return false;
+   }
+   return true;
+}
+
+} // anonymous namespace
+
+ChildProcessReactor::ChildProcessReactor()
+   : epollFd_(-1), wakeups_(0)
+{
+#ifdef __linux__
+   epollFd_ = ::epoll_create1(EPOLL_CLOEXEC);
+   if (epollFd_ == -1)
+      LOG_ERROR(systemError(errno, ERROR_LOCATION));
+#endif
+}
+
+ChildProcessReactor::~ChildProcessReactor()
+{
+   try
+   {
+      while (!owners_.empty())
+         remove(owners_.begin()->first);
+
+      if (epollFd_ != -1)
+         ::close(epollFd_);
+   }
+   catch(...)
+   {
+   }
+}
+
+bool ChildProcessReactor::valid() const
+{
+#ifdef __linux__
+   return epollFd_ != -1;
+#else
+   return true;
+#endif
+}
+
+void ChildProcessReactor::watch(AsyncChildProcess* pChild,
+                                const std::vector<int>& fds)
+{
+   std::map<int, int>& current = watched_[pChild];
+   if (sameDescriptors(current, fds))
+      return;
+
+   for (std::map<int, int>::iterator it = current.begin();
+        it != current.end(); )
+   {
+      if (!contains(fds, it->first))
+      {
+         remove(it->second);
+         current.erase(it++);
+      }
+      else
+      {
+         ++it;
+      }
+   }
+
+   BOOST_FOREACH(int fd, fds)
+   {
+      if (current.find(fd) != current.end())
+         continue;
+
+      int watchFd = add(pChild, fd);
+      if (watchFd == -1)
+         unwatchable_.insert(pChild);
+      else
+         current[fd] = watchFd;
+   }
+}
+
+void ChildProcessReactor::unwatch(AsyncChildProcess* pChild)
+{
+   std::map<AsyncChildProcess*, std::map<int, int> >::iterator it =
+                                                      watched_.find(pChild);
+   if (it == watched_.end())
+      return;
+
+   for (std::map<int, int>::const_iterator fdIt = it->second.begin();
+        fdIt != it->second.end();
+        ++fdIt)
+   {
+      remove(fdIt->second);
+   }
+   watched_.erase(it);
+   unwatchable_.erase(pChild);
+}
+
+int ChildProcessReactor::add(AsyncChildProcess* pChild, int fd)
+{
+   int watchFd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+   if (watchFd == -1)
+   {
+      LOG_ERROR(systemError(errno, ERROR_LOCATION));
+      return -1;
+   }
+
+#ifdef __linux__
+   struct epoll_event event;
+   event.events = EPOLLIN;
+   event.data.fd = watchFd;
+   if (::epoll_ctl(epollFd_, EPOLL_CTL_ADD, watchFd, &event) == -1)
+   {
+      LOG_ERROR(systemError(errno, ERROR_LOCATION));
+      ::close(watchFd);
+      return -1;
+   }
+#endif
+
+   owners_[watchFd] = pChild;
+   return watchFd;
+}
+
+void ChildProcessReactor::remove(int watchFd)
+{
+   owners_.erase(watchFd);
+
+#ifdef __linux__
+   struct epoll_event event;
+   if (::epoll_ctl(epollFd_, EPOLL_CTL_DEL, watchFd, &event) == -1)
+      LOG_ERROR(systemError(errno, ERROR_LOCATION));
+#endif
+
+   ::close(watchFd);
+}
+
+Error ChildProcessReactor::wait(int timeoutMs,
+                                std::set<AsyncChildProcess*>* pReady)
+{
+   if (!unwatchable_.empty())
+   {
+      pReady->insert(unwatchable_.begin(), unwatchable_.end());
+      if (timeoutMs < 0 || timeoutMs > kUnwatchableWaitMs)
+         timeoutMs = kUnwatchableWaitMs;
+   }
+
+#ifdef __linux__
+   std::vector<struct epoll_event> events(std::max<std::size_t>(owners_.size(), 1));
+   int count = ::epoll_wait(epollFd_,
+                            &events[0],
+                            static_cast<int>(events.size()),
+                            timeoutMs);
+   if (count == -1)
+   {
+      if (errno == EINTR)
+         return Success();
+      return systemError(errno, ERROR_LOCATION);
+   }
+
+   for (int i = 0; i < count; i++)
+   {
+      std::map<int, AsyncChildProcess*>::const_iterator it =
+                                          owners_.find(events[i].data.fd);
+      if (it != owners_.end())
+         pReady->insert(it->second);
+   }
+#else
+   std::vector<struct pollfd> fds;
+   fds.reserve(owners_.size());
+   for (std::map<int, AsyncChildProcess*>::const_iterator it = owners_.begin();
+        it != owners_.end();
+        ++it)
+   {
+      struct pollfd pfd;
+      pfd.fd = it->first;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      fds.push_back(pfd);
+   }
+
+   int count = ::poll(fds.empty() ? NULL : &fds[0],
+                      static_cast<nfds_t>(fds.size()),
+                      timeoutMs);
+   if (count == -1)
+   {
+      if (errno == EINTR)
+         return Success();
+      return systemError(errno, ERROR_LOCATION);
+   }
+
+   BOOST_FOREACH(const struct pollfd& pfd, fds)
+   {
+      if (pfd.revents != 0)
+         pReady->insert(owners_[pfd.fd]);
+   }
+#endif
+
+   if (count > 0)
+      ++wakeups_;
+
+   return Success();
+}
+
+} // namespace system
+} // namespace core
+} // namespace rstudio
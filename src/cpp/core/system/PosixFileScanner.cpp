@@ -1,7 +1,7 @@
 /*
  * PosixFileScanner.cpp
  *
- * Copyright (C) 2009-12 by RStudio, Inc.
+ * Copyright (C) 2009-18 by RStudio, Inc.
  *
  * Unless you have received this program directly from RStudio pursuant
  * to the terms of a commercial license agreement with RStudio, then
@@ -16,14 +16,21 @@
 #include <core/system/FileScanner.hpp>
 
 #include <dirent.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 
+#include <algorithm>
+#include <vector>
+
 #include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
 
 #include <core/Error.hpp>
 #include <core/Log.hpp>
 #include <core/FilePath.hpp>
 #include <core/BoostThread.hpp>
+#include <core/Thread.hpp>
 
 #include "config.h"
 
@@ -33,110 +40,91 @@ namespace system {
 
 namespace {
 
-#if defined(__APPLE__) && !defined(HAVE_SCANDIR_POSIX)
-int entryFilter(struct dirent *entry)
-#else
-int entryFilter(const struct dirent *entry)
-#endif
-{
-   if (::strcmp(entry->d_name, ".") == 0 || ::strcmp(entry->d_name, "..") == 0)
-      return 0;
-   else
-      return 1;
-}
+// maximum number of threads used to read directories during a recursive
+// scan (directory reads are dominated by I/O latency, particularly on
+// network file systems, so this is deliberately independent of the
+// number of cores)
+const std::size_t kMaxScanThreads = 8;
 
-// note: because R may change LC_COLLATE, we cannot
-// use strcoll (otherwise we run into race issues where
-// the file monitor attempts to access LC_COLLATE just as
-// R is replacing it). to avoid this, we use strcmp and
-// don't sort according to locale.
-#if !defined(HAVE_SCANDIR_POSIX)
-int alphasort(const void* voidlhs, const void* voidrhs)
+struct DirEntry
 {
-   const dirent** lhs = (const dirent**)voidlhs;
-   const dirent** rhs = (const dirent**)voidrhs;
-#else
-int alphasort(const dirent** lhs, const dirent** rhs)
-{
-#endif
-   return strcmp((*lhs)->d_name, (*rhs)->d_name);
-}
+   DirEntry(const std::string& name, unsigned char type)
+      : name(name), type(type)
+   {
+   }
+
+   // note: because R may change LC_COLLATE, we cannot
+   // use strcoll (otherwise we run into race issues where
+   // the file monitor attempts to access LC_COLLATE just as
+   // R is replacing it). to avoid this, we compare bytes and
+   // don't sort according to locale.
+   bool operator<(const DirEntry& other) const
+   {
+      return name < other.name;
+   }
+
+   std::string name;
+   unsigned char type;
+};
 
-// wrapper for scandir api
-Error scanDir(const std::string& dirPath, std::vector<std::string>* pNames)
+// read the contents of a directory (sorted by name). the type reported by
+// readdir is used to avoid stat'ing directories; other entries are stat'ed
+// relative to the open directory so the path isn't resolved again
+Error readDirectory(const std::string& dirPath, std::vector<FileInfo>* pEntries)
 {
-   // read directory contents into namelist
-   struct dirent **namelist;
-   int entries = ::scandir(dirPath.c_str(),
-                           &namelist,
-                           entryFilter,
-                           alphasort);
-   if (entries == -1)
+   DIR* pDir = ::opendir(dirPath.c_str());
+   if (pDir == NULL)
    {
       Error error = systemError(errno, ERROR_LOCATION);
       error.addProperty("path", dirPath);
       return error;
    }
 
-   // extract the namelist then free it
-   for(int i=0; i<entries; i++)
+   std::vector<DirEntry> names;
+   for (;;)
    {
-      // get the name (then free it)
-      std::string name(namelist[i]->d_name,
-#ifdef __APPLE__
-                       namelist[i]->d_namlen);
-#else
-                       namelist[i]->d_reclen);
-#endif
-      ::free(namelist[i]);
+      errno = 0;
+      struct dirent* pEntry = ::readdir(pDir);
+      if (pEntry == NULL)
+         break;
 
-      // add to the vector
-      pNames->push_back(name);
-   }
-   ::free(namelist);
-
-   return Success();
-}
-
-} // anonymous namespace
-
-Error scanFiles(const tree<FileInfo>::iterator_base& fromNode,
-                const FileScannerOptions& options,
-                tree<FileInfo>* pTree)
-{
-   // clear all existing
-   pTree->erase_children(fromNode);
-
-   // create FilePath for root
-   FilePath rootPath(fromNode->absolutePath());
+      if (::strcmp(pEntry->d_name, ".") == 0 || ::strcmp(pEntry->d_name, "..") == 0)
+         continue;
 
-   // yield if requested (only applies to recursive scans)
-   if (options.recursive && options.yield)
-      boost::this_thread::yield();
+      names.push_back(DirEntry(pEntry->d_name, pEntry->d_type));
+   }
 
-   // call onBeforeScanDir hook
-   if (options.onBeforeScanDir)
+   if (errno != 0)
    {
-      Error error = options.onBeforeScanDir(*fromNode);
-      if (error)
-         return error;
+      Error error = systemError(errno, ERROR_LOCATION);
+      error.addProperty("path", dirPath);
+      ::closedir(pDir);
+      return error;
    }
 
-   // read directory contents
-   std::vector<std::string> names;
-   Error error = scanDir(fromNode->absolutePath(), &names);
-   if (error)
-      return error;
+   std::sort(names.begin(), names.end());
+
+   std::string prefix = dirPath;
+   if (prefix.empty() || prefix[prefix.length() - 1] != '/')
+      prefix.push_back('/');
 
-   // iterate over the names
-   BOOST_FOREACH(const std::string& name, names)
+   int dirFd = ::dirfd(pDir);
+   pEntries->reserve(names.size());
+   BOOST_FOREACH(const DirEntry& entry, names)
    {
       // compute the path
-      std::string path = rootPath.childPath(name).absolutePath();
+      std::string path = prefix + entry.name;
+
+      // directories need no further attributes
+      if (entry.type == DT_DIR)
+      {
+         pEntries->push_back(FileInfo(path, true, false));
+         continue;
+      }
 
       // get the attributes
       struct stat st;
-      int res = ::lstat(path.c_str(), &st);
+      int res = ::fstatat(dirFd, entry.name.c_str(), &st, AT_SYMLINK_NOFOLLOW);
       if (res == -1)
       {
          if (errno != ENOENT && errno != EACCES)
@@ -149,58 +137,316 @@ Error scanFiles(const tree<FileInfo>::iterator_base& fromNode,
       }
 
       // create the FileInfo
-      FileInfo fileInfo;
       bool isSymlink = S_ISLNK(st.st_mode);
       if (S_ISDIR(st.st_mode))
       {
-         fileInfo = FileInfo(path, true, isSymlink);
+         pEntries->push_back(FileInfo(path, true, isSymlink));
       }
       else
       {
-         fileInfo = FileInfo(path,
-                             false,
-                             st.st_size,
+         pEntries->push_back(FileInfo(path,
+                                      false,
+                                      st.st_size,
 #ifdef __APPLE__
-                             st.st_mtimespec.tv_sec,
+                                      st.st_mtimespec.tv_sec,
 #else
-                             st.st_mtime,
+                                      st.st_mtime,
 #endif
-                             isSymlink);
+                                      isSymlink));
       }
+   }
 
-      // apply the filter (if any)
-      if (!options.filter || options.filter(fileInfo))
+   ::closedir(pDir);
+   return Success();
+}
+
+// a directory whose contents are being read (possibly on another thread)
+struct Listing
+{
+   enum State
+   {
+      Pending,
+      Reading,
+      Done
+   };
+
+   explicit Listing(const std::string& path)
+      : path(path), state(Pending)
+   {
+   }
+
+   std::string path;
+   State state;
+   Error error;
+   std::vector<FileInfo> entries;
+};
+
+// reads directories ahead of a recursive scan using a small pool of
+// worker threads. the scanning thread enqueues each subdirectory as soon
+// as it is discovered and later collects its listing; work is taken from
+// the queue most-recently-enqueued first so that the workers stay just
+// ahead of the (depth-first) scan. if the scanning thread needs a listing
+// that no worker has started yet it reads the directory itself.
+class DirectoryReader : boost::noncopyable
+{
+public:
+   DirectoryReader()
+      : threadCount_(0), idleCount_(0), stopping_(false)
+   {
+   }
+
+   ~DirectoryReader()
+   {
+      try
+      {
+         {
+            boost::mutex::scoped_lock lock(mutex_);
+            stopping_ = true;
+            queue_.clear();
+         }
+         workAvailable_.notify_all();
+         threads_.join_all();
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+   }
+
+   boost::shared_ptr<Listing> enqueue(const std::string& path)
+   {
+      boost::shared_ptr<Listing> pListing(new Listing(path));
+
+      boost::mutex::scoped_lock lock(mutex_);
+      queue_.push_back(pListing);
+
+      // start another worker if none are free to pick this up
+      if (idleCount_ == 0 && threadCount_ < kMaxScanThreads)
+      {
+         // if the thread can't be launched (safeLaunchThread logs why) the
+         // listing will be read by the scanning thread instead
+         boost::thread* pThread = new boost::thread();
+         core::thread::safeLaunchThread(
+                  boost::bind(&DirectoryReader::work, this), pThread);
+         if (pThread->joinable())
+         {
+            threads_.add_thread(pThread);
+            ++threadCount_;
+         }
+         else
+         {
+            delete pThread;
+         }
+      }
+      else
       {
-         // add the correct type of FileEntry
-         if (fileInfo.isDirectory())
+         workAvailable_.notify_one();
+      }
+
+      return pListing;
+   }
+
+   // wait for the listing to be read (reading it on this thread if no
+   // worker has started it yet)
+   void collect(const boost::shared_ptr<Listing>& pListing)
+   {
+      {
+         boost::mutex::scoped_lock lock(mutex_);
+         if (pListing->state == Listing::Pending)
          {
-            tree<FileInfo>::iterator_base child = pTree->append_child(fromNode,
-                                                                      fileInfo);
-            // recurse if requested and this isn't a link
-            if (options.recursive && !fileInfo.isSymlink())
+            // (the listing we need is almost always the most recent one)
+            for (std::size_t i = queue_.size(); i > 0; i--)
             {
-               // try to scan the files in the subdirectory -- if we fail
-               // we continue because we don't want one "bad" directory
-               // to cause us to abort the entire scan. yes the tree
-               // will be incomplete however it will be even more incompete
-               // if we fail entirely
-               Error error = scanFiles(child, options, pTree);
-               if (error)
-                  LOG_ERROR(error);
+               if (queue_[i - 1] == pListing)
+               {
+                  queue_.erase(queue_.begin() + (i - 1));
+                  break;
+               }
             }
+            pListing->state = Listing::Reading;
          }
          else
          {
-            pTree->append_child(fromNode, fileInfo);
+            while (pListing->state != Listing::Done)
+               listingDone_.wait(lock);
+            return;
          }
       }
+
+      pListing->error = readDirectory(pListing->path, &pListing->entries);
+
+      boost::mutex::scoped_lock lock(mutex_);
+      pListing->state = Listing::Done;
+   }
+
+private:
+   void work()
+   {
+      try
+      {
+         for (;;)
+         {
+            boost::shared_ptr<Listing> pListing;
+            {
+               boost::mutex::scoped_lock lock(mutex_);
+               ++idleCount_;
+               while (queue_.empty() && !stopping_)
+                  workAvailable_.wait(lock);
+               --idleCount_;
+
+               if (stopping_)
+                  return;
+
+               pListing = queue_.back();
+               queue_.pop_back();
+               pListing->state = Listing::Reading;
+            }
+
+            Error error = readDirectory(pListing->path, &pListing->entries);
+
+            {
+               boost::mutex::scoped_lock lock(mutex_);
+               pListing->error = error;
+               pListing->state = Listing::Done;
+            }
+            listingDone_.notify_all();
+         }
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+   }
+
+   boost::mutex mutex_;
+   boost::condition_variable workAvailable_;
+   boost::condition_variable listingDone_;
+   std::vector<boost::shared_ptr<Listing> > queue_;
+   boost::thread_group threads_;
+   std::size_t threadCount_;
+   std::size_t idleCount_;
+   bool stopping_;
+};
+
+struct Subdirectory
+{
+   explicit Subdirectory(const tree<FileInfo>::iterator_base& node)
+      : node(node)
+   {
+   }
+
+   tree<FileInfo>::iterator_base node;
+   boost::shared_ptr<Listing> pListing;
+   Error error;
+};
+
+Error scanListing(const tree<FileInfo>::iterator_base& fromNode,
+                  const boost::shared_ptr<Listing>& pListing,
+                  const FileScannerOptions& options,
+                  DirectoryReader* pReader,
+                  tree<FileInfo>* pTree)
+{
+   // yield if requested (only applies to recursive scans)
+   if (options.recursive && options.yield)
+      boost::this_thread::yield();
+
+   // read directory contents
+   std::vector<FileInfo> entries;
+   if (pListing)
+   {
+      pReader->collect(pListing);
+      if (pListing->error)
+         return pListing->error;
+      entries.swap(pListing->entries);
+   }
+   else
+   {
+      Error error = readDirectory(fromNode->absolutePath(), &entries);
+      if (error)
+         return error;
+   }
+
+   // subdirectories to descend into once this directory is complete
+   std::vector<Subdirectory> subdirectories;
+
+   // iterate over the entries
+   BOOST_FOREACH(const FileInfo& fileInfo, entries)
+   {
+      // apply the filter (if any)
+      if (options.filter && !options.filter(fileInfo))
+         continue;
+
+      tree<FileInfo>::iterator_base child = pTree->append_child(fromNode,
+                                                                fileInfo);
+
+      // recurse if requested and this isn't a link
+      if (fileInfo.isDirectory() && options.recursive && !fileInfo.isSymlink())
+      {
+         // call onBeforeScanDir hook (before the directory is read, so
+         // that e.g. file monitor watches don't miss any changes)
+         Subdirectory subdirectory(child);
+         if (options.onBeforeScanDir)
+            subdirectory.error = options.onBeforeScanDir(fileInfo);
+
+         subdirectories.push_back(subdirectory);
+      }
+   }
+
+   // queue the subdirectories to be read -- in reverse order so that the
+   // first subdirectory (which we'll scan next) is read first
+   for (std::vector<Subdirectory>::reverse_iterator it = subdirectories.rbegin();
+        it != subdirectories.rend();
+        ++it)
+   {
+      if (!it->error)
+         it->pListing = pReader->enqueue(it->node->absolutePath());
+   }
+
+   // try to scan the files in each subdirectory -- if we fail
+   // we continue because we don't want one "bad" directory
+   // to cause us to abort the entire scan. yes the tree
+   // will be incomplete however it will be even more incompete
+   // if we fail entirely
+   BOOST_FOREACH(const Subdirectory& subdirectory, subdirectories)
+   {
+      Error error = subdirectory.error;
+      if (!error)
+      {
+         error = scanListing(subdirectory.node,
+                             subdirectory.pListing,
+                             options,
+                             pReader,
+                             pTree);
+      }
+      if (error)
+         LOG_ERROR(error);
    }
 
    // return success
    return Success();
 }
 
+} // anonymous namespace
+
+Error scanFiles(const tree<FileInfo>::iterator_base& fromNode,
+                const FileScannerOptions& options,
+                tree<FileInfo>* pTree)
+{
+   // clear all existing
+   pTree->erase_children(fromNode);
+
+   // call onBeforeScanDir hook
+   if (options.onBeforeScanDir)
+   {
+      Error error = options.onBeforeScanDir(*fromNode);
+      if (error)
+         return error;
+   }
+
+   // recursive scans read subdirectories in parallel (the tree, filter
+   // and hooks are only ever touched on this thread)
+   DirectoryReader reader;
+   return scanListing(fromNode,
+                      boost::shared_ptr<Listing>(),
+                      options,
+                      &reader,
+                      pTree);
+}
+
 } // namespace system
 } // namespace core
 } // namespace rstudio
-
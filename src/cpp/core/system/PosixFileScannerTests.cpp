@@ -0,0 +1,194 @@
+/*
+ * PosixFileScannerTests.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef _WIN32
+
+#include <unistd.h>
+
+#include <set>
+
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/system/FileScanner.hpp>
+
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace system {
+namespace tests {
+
+namespace {
+
+// create a tree of the given depth with 'width' directories and files
+// per directory
+void createTree(const FilePath& dir, int depth, int width)
+{
+   dir.ensureDirectory();
+   for (int i = 0; i < width; i++)
+   {
+      writeStringToFile(dir.childPath((boost::format("file%1%.R") % i).str()), "x <- 1\n");
+      if (depth > 0)
+         createTree(dir.childPath((boost::format("dir%1%") % i).str()), depth - 1, width);
+   }
+}
+
+bool excludeDir1(const FileInfo& fileInfo)
+{
+   return !boost::algorithm::ends_with(fileInfo.absolutePath(), "/dir1");
+}
+
+Error recordScannedDir(std::vector<std::string>* pDirs, const FileInfo& fileInfo)
+{
+   pDirs->push_back(fileInfo.absolutePath());
+   return Success();
+}
+
+Error failOnDir2(const FileInfo& fileInfo)
+{
+   if (boost::algorithm::ends_with(fileInfo.absolutePath(), "/dir2"))
+      return systemError(boost::system::errc::permission_denied, ERROR_LOCATION);
+   return Success();
+}
+
+} // anonymous namespace
+
+context("PosixFileScannerTests")
+{
+   FilePath root;
+   FilePath::tempFilePath(&root);
+   createTree(root, 3, 4);
+   ::symlink(root.childPath("dir0").absolutePath().c_str(),
+             root.childPath("link").absolutePath().c_str());
+
+   test_that("Recursive scans produce a complete, sorted depth-first tree")
+   {
+      FileScannerOptions options;
+      options.recursive = true;
+      options.yield = true;
+
+      tree<FileInfo> files;
+      expect_false(scanFiles(FileInfo(root), options, &files));
+
+      // 4 + 16 + 64 + 256 files, 4 + 16 + 64 directories, plus the root and link
+      expect_true(files.size() == 340 + 84 + 2);
+
+      std::vector<std::string> paths;
+      for (tree<FileInfo>::iterator it = files.begin(); it != files.end(); ++it)
+         paths.push_back(it->absolutePath());
+
+      expect_true(paths[0] == root.absolutePath());
+      expect_true(paths[1] == root.childPath("dir0").absolutePath());
+      expect_true(paths[2] == root.childPath("dir0/dir0").absolutePath());
+
+      // every path is unique and each directory's children are sorted
+      std::set<std::string> unique(paths.begin(), paths.end());
+      expect_true(unique.size() == paths.size());
+      for (tree<FileInfo>::iterator it = files.begin(); it != files.end(); ++it)
+      {
+         tree<FileInfo>::sibling_iterator child = files.begin(it);
+         tree<FileInfo>::sibling_iterator end = files.end(it);
+         std::string previous;
+         for (; child != end; ++child)
+         {
+            expect_true(previous < child->absolutePath());
+            previous = child->absolutePath();
+         }
+      }
+
+      // files carry their size; symlinks are reported but not traversed
+      for (tree<FileInfo>::iterator it = files.begin(); it != files.end(); ++it)
+      {
+         if (it->absolutePath() == root.childPath("file0.R").absolutePath())
+         {
+            expect_true(it->size() == 7);
+         }
+         if (it->absolutePath() == root.childPath("link").absolutePath())
+         {
+            expect_true(it->isSymlink());
+            expect_true(files.number_of_children(it) == 0);
+         }
+      }
+   }
+
+   test_that("Filters prune directories and hooks run for each scanned directory")
+   {
+      std::vector<std::string> scannedDirs;
+
+      FileScannerOptions options;
+      options.recursive = true;
+      options.filter = excludeDir1;
+      options.onBeforeScanDir = boost::bind(recordScannedDir, &scannedDirs, _1);
+
+      tree<FileInfo> files;
+      expect_false(scanFiles(FileInfo(root), options, &files));
+
+      // each excluded 'dir1' removes itself and its subtree at every level
+      for (tree<FileInfo>::iterator it = files.begin(); it != files.end(); ++it)
+         expect_false(boost::algorithm::ends_with(it->absolutePath(), "/dir1"));
+
+      // directories (other than the root) reported to the hook match those
+      // in the tree
+      std::size_t dirCount = 0;
+      for (tree<FileInfo>::iterator it = files.begin(); it != files.end(); ++it)
+      {
+         if (it->isDirectory() && !it->isSymlink())
+            ++dirCount;
+      }
+      expect_true(scannedDirs.size() == dirCount);
+      expect_true(scannedDirs[0] == root.absolutePath());
+   }
+
+   test_that("Hook failures skip only the affected directory")
+   {
+      FileScannerOptions options;
+      options.recursive = true;
+      options.onBeforeScanDir = failOnDir2;
+
+      tree<FileInfo> files;
+      expect_false(scanFiles(FileInfo(root), options, &files));
+
+      for (tree<FileInfo>::iterator it = files.begin(); it != files.end(); ++it)
+      {
+         if (boost::algorithm::ends_with(it->absolutePath(), "/dir2"))
+         {
+            expect_true(files.number_of_children(it) == 0);
+         }
+      }
+      expect_true(files.size() > 100);
+   }
+
+   test_that("Non-recursive scans list only the immediate children")
+   {
+      FileScannerOptions options;
+
+      tree<FileInfo> files;
+      expect_false(scanFiles(FileInfo(root), options, &files));
+      expect_true(files.size() == 1 + 4 + 4 + 1);
+   }
+
+   root.removeIfExists();
+}
+
+} // namespace tests
+} // namespace system
+} // namespace core
+} // namespace rstudio
+
+#endif // _WIN32
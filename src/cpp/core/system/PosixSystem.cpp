@@ -21,6 +21,7 @@
 #include <vector>
 
 #include <boost/foreach.hpp>
+#include <boost/function.hpp>
 #include <boost/algorithm/string.hpp>
 
 #include <signal.h>
@@ -186,9 +187,59 @@ namespace {
 // main log writer
 LogWriter* s_pLogWriter = NULL;
 
+// creates the main log writer (kept so that a daemonized child, which
+// inherits neither the writer's threads nor its open files, can create
+// another one)
+boost::function<LogWriter*()> s_createLogWriter;
+bool s_logToStderr = false;
+
 // additional log writers
 std::vector<boost::shared_ptr<LogWriter> > s_logWriters;
 
+LogWriter* createSystemLogWriter(const std::string& programIdentity,
+                                 int logLevel)
+{
+   return new SyslogLogWriter(programIdentity, logLevel);
+}
+
+LogWriter* createStderrLogWriter(const std::string& programIdentity,
+                                 int logLevel)
+{
+   return new StderrLogWriter(programIdentity, logLevel);
+}
+
+LogWriter* createFileLogWriter(const std::string& programIdentity,
+                               int logLevel,
+                               const FilePath& logDir)
+{
+   return new FileLogWriter(programIdentity, logLevel, logDir);
+}
+
+void setLogWriter(const boost::function<LogWriter*()>& createLogWriter)
+{
+   // (clear the writer first as creating the new one may log)
+   delete s_pLogWriter;
+   s_pLogWriter = NULL;
+
+   s_createLogWriter = createLogWriter;
+   s_pLogWriter = createLogWriter();
+   if (s_logToStderr)
+      s_pLogWriter->setLogToStderr(true);
+}
+
+// create the main log writer again in a forked child. the previous writer
+// is leaked rather than destroyed: its thread doesn't exist in the child
+// and its mutexes may have been held by other threads at the time of fork
+void restartLogWriter()
+{
+   if (!s_createLogWriter)
+      return;
+
+   s_pLogWriter = s_createLogWriter();
+   if (s_logToStderr)
+      s_pLogWriter->setLogToStderr(true);
+}
+
 } // anonymous namespace
      
 void initHook()
@@ -197,32 +248,27 @@ void initHook()
 
 void initializeSystemLog(const std::string& programIdentity, int logLevel)
 {
-   if (s_pLogWriter)
-      delete s_pLogWriter;
-
-   s_pLogWriter = new SyslogLogWriter(programIdentity, logLevel);
+   setLogWriter(boost::bind(createSystemLogWriter, programIdentity, logLevel));
 }
 
 void initializeStderrLog(const std::string& programIdentity, int logLevel)
 {
-   if (s_pLogWriter)
-      delete s_pLogWriter;
-
-   s_pLogWriter = new StderrLogWriter(programIdentity, logLevel);
+   setLogWriter(boost::bind(createStderrLogWriter, programIdentity, logLevel));
 }
 
 void initializeLog(const std::string& programIdentity,
                    int logLevel,
                    const FilePath& logDir)
 {
-   if (s_pLogWriter)
-      delete s_pLogWriter;
-
-   s_pLogWriter = new FileLogWriter(programIdentity, logLevel, logDir);
+   setLogWriter(boost::bind(createFileLogWriter,
+                            programIdentity,
+                            logLevel,
+                            logDir));
 }
 
 void setLogToStderr(bool logToStderr)
 {
+   s_logToStderr = logToStderr;
    if (s_pLogWriter)
       s_pLogWriter->setLogToStderr(logToStderr);
 }
@@ -1245,6 +1291,10 @@ Error daemonize()
    // attach file descriptors 0, 1, and 2 to /dev/null
    core::system::attachStdFileDescriptorsToDevNull();
 
+   // the log writer's thread (and its open log file or syslog connection)
+   // didn't survive the fork, so start another writer for this process
+   restartLogWriter();
+
    // note: ignoring of terminal signals are handled by an optional
    // separate call (ignoreTerminalSignals)
 
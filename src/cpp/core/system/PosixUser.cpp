@@ -21,15 +21,18 @@
 
 #include <sys/socket.h>
 
+#include <map>
 #include <iostream>
 
 #include <boost/lexical_cast.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <core/Error.hpp>
 #include <core/Log.hpp>
 #include <core/Exec.hpp>
 #include <core/FilePath.hpp>
 #include <core/SafeConvert.hpp>
+#include <core/Thread.hpp>
 #include <core/system/System.hpp>
 
 #include "config.h"
@@ -143,6 +146,119 @@ Error userFromId(uid_t uid, User* pUser)
    return userFrom<uid_t>(::getpwuid_r, uid, pUser);
 }
 
+namespace {
+
+struct CachedUser
+{
+   User user;
+   Error error;
+   boost::posix_time::ptime expires;
+};
+
+boost::mutex s_userCacheMutex;
+std::map<std::string, CachedUser> s_userCache;
+
+const boost::posix_time::time_duration kUserCacheTimeout =
+                                          boost::posix_time::minutes(5);
+const boost::posix_time::time_duration kUserCacheNegativeTimeout =
+                                          boost::posix_time::seconds(30);
+
+// bound on the number of cached users (expired entries are swept out
+// when the cache reaches it)
+const std::size_t kMaxCachedUsers = 4096;
+
+boost::posix_time::ptime now()
+{
+   return boost::posix_time::microsec_clock::universal_time();
+}
+
+// must be called with s_userCacheMutex held
+void sweepUserCache()
+{
+   boost::posix_time::ptime time = now();
+   std::map<std::string, CachedUser>::iterator it = s_userCache.begin();
+   while (it != s_userCache.end())
+   {
+      if (it->second.expires <= time)
+         s_userCache.erase(it++);
+      else
+         ++it;
+   }
+
+   // if every entry is still live (e.g. a flood of lookups for unknown
+   // users) then start over rather than growing without bound
+   if (s_userCache.size() >= kMaxCachedUsers)
+      s_userCache.clear();
+}
+
+} // anonymous namespace
+
+Error cachedUserFromUsername(const std::string& username, User* pUser)
+{
+   // check the cache
+   LOCK_MUTEX(s_userCacheMutex)
+   {
+      std::map<std::string, CachedUser>::const_iterator it =
+                                                s_userCache.find(username);
+      if (it != s_userCache.end() && now() < it->second.expires)
+      {
+         if (it->second.error)
+            return it->second.error;
+
+         *pUser = it->second.user;
+         return Success();
+      }
+   }
+   END_LOCK_MUTEX
+
+   // perform the lookup outside of the lock so that a slow NSS backend
+   // doesn't stall lookups for other (already cached) users
+   CachedUser entry;
+   entry.error = userFromUsername(username, &entry.user);
+
+   // don't cache unexpected errors (e.g. transient NSS failures) since
+   // we want the next request to try again
+   bool notFound = entry.error &&
+                   entry.error.code().value() == kNotFoundError;
+   if (!entry.error || notFound)
+   {
+      LOCK_MUTEX(s_userCacheMutex)
+      {
+         if (s_userCache.size() >= kMaxCachedUsers)
+            sweepUserCache();
+
+         entry.expires = now() + (entry.error ? kUserCacheNegativeTimeout
+                                              : kUserCacheTimeout);
+         s_userCache[username] = entry;
+      }
+      END_LOCK_MUTEX
+   }
+
+   if (entry.error)
+      return entry.error;
+
+   *pUser = entry.user;
+   return Success();
+}
+
+void invalidateCachedUser(const std::string& username)
+{
+   LOCK_MUTEX(s_userCacheMutex)
+   {
+      s_userCache.erase(username);
+   }
+   END_LOCK_MUTEX
+}
+
+void invalidateCachedUsers()
+{
+   LOCK_MUTEX(s_userCacheMutex)
+   {
+      s_userCache.clear();
+   }
+   END_LOCK_MUTEX
+}
+
 
 } // namespace user
 } // namespace system
@@ -0,0 +1,73 @@
+/*
+ * PosixUserTests.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef _WIN32
+
+#include <core/Error.hpp>
+#include <core/system/PosixSystem.hpp>
+#include <core/system/PosixUser.hpp>
+
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace system {
+namespace tests {
+
+context("PosixUserTests")
+{
+   test_that("Cached user lookup matches direct lookup")
+   {
+      user::User current;
+      expect_false(user::currentUser(&current));
+
+      user::User cached;
+      expect_false(user::cachedUserFromUsername(current.username, &cached));
+      expect_true(cached.userId == current.userId);
+      expect_true(cached.groupId == current.groupId);
+      expect_true(cached.homeDirectory == current.homeDirectory);
+
+      // second lookup is served from the cache
+      user::User cachedAgain;
+      expect_false(user::cachedUserFromUsername(current.username, &cachedAgain));
+      expect_true(cachedAgain.userId == current.userId);
+
+      user::invalidateCachedUser(current.username);
+      expect_false(user::cachedUserFromUsername(current.username, &cached));
+      expect_true(cached.userId == current.userId);
+   }
+
+   test_that("Unknown users are reported as not found")
+   {
+      std::string username = "rstudio-no-such-user-a8f3";
+
+      user::User user;
+      Error error = user::cachedUserFromUsername(username, &user);
+      expect_true(isUserNotFoundError(error));
+
+      // negative result is cached
+      error = user::cachedUserFromUsername(username, &user);
+      expect_true(isUserNotFoundError(error));
+
+      user::invalidateCachedUsers();
+   }
+}
+
+} // namespace tests
+} // namespace system
+} // namespace core
+} // namespace rstudio
+
+#endif // !_WIN32
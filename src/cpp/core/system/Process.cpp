@@ -29,6 +29,10 @@
 #include <core/PerformanceTimer.hpp>
 #include <core/system/ChildProcess.hpp>
 
+#ifndef _WIN32
+#include "ChildProcessReactor.hpp"
+#endif
+
 namespace rstudio {
 namespace core {
 namespace system {
@@ -69,13 +73,48 @@ Error runCommand(const std::string& command,
 
 struct ProcessSupervisor::Impl
 {
-   Impl() : isPolling(false) {}
+   explicit Impl(supervisor_mode::Mode mode)
+      : isPolling(false)
+   {
+#ifndef _WIN32
+      if (mode == supervisor_mode::EventDriven)
+      {
+         pReactor.reset(new ChildProcessReactor());
+         if (!pReactor->valid())
+            pReactor.reset();
+      }
+#endif
+   }
+
    bool isPolling;
    std::vector<boost::shared_ptr<AsyncChildProcess> > children;
+
+#ifndef _WIN32
+   // sync the reactor with the children's current descriptors. returns
+   // false if some child needs to be polled without waiting for events
+   bool watchChildren(
+         const std::vector<boost::shared_ptr<AsyncChildProcess> >& children)
+   {
+      bool canWait = true;
+      std::vector<int> fds;
+      BOOST_FOREACH(const boost::shared_ptr<AsyncChildProcess>& pChild,
+                    children)
+      {
+         fds.clear();
+         if (!pChild->getEventDescriptors(&fds))
+            canWait = false;
+         pReactor->watch(pChild.get(), fds);
+      }
+      return canWait;
+   }
+
+   // null unless running in event-driven mode
+   boost::scoped_ptr<ChildProcessReactor> pReactor;
+#endif
 };
 
-ProcessSupervisor::ProcessSupervisor()
-   : pImpl_(new Impl())
+ProcessSupervisor::ProcessSupervisor(supervisor_mode::Mode mode)
+   : pImpl_(new Impl(mode))
 {
 }
 
@@ -325,14 +364,46 @@ bool ProcessSupervisor::poll()
    // the children vector and if this requried a realloc would invalidate
    // all of the iterators currently pointing into the container
    std::vector<boost::shared_ptr<AsyncChildProcess> > children = pImpl_->children;
-   std::for_each(children.begin(),
-                 children.end(),
-                 boost::bind(&AsyncChildProcess::poll, _1));
+#ifndef _WIN32
+   if (pImpl_->pReactor)
+   {
+      // find out which children have output or have exited, and only
+      // read from / wait on those
+      std::set<AsyncChildProcess*> ready;
+      pImpl_->watchChildren(children);
+      Error error = pImpl_->pReactor->wait(0, &ready);
+      if (error)
+         LOG_ERROR(error);
+
+      BOOST_FOREACH(const boost::shared_ptr<AsyncChildProcess>& pChild,
+                    children)
+      {
+         pChild->poll(error || ready.count(pChild.get()) > 0);
+      }
+   }
+   else
+#endif
+   {
+      std::for_each(children.begin(),
+                    children.end(),
+                    boost::bind(&AsyncChildProcess::poll, _1));
+   }
 
    // remove any children who have exited from our list. note that it's safe
    // in this case to use pImpl_->children directly because the call to
    // AsyncChildProcess::exited just checks a member variable rather than
    // executing code that could cause re-entry
+#ifndef _WIN32
+   if (pImpl_->pReactor)
+   {
+      BOOST_FOREACH(const boost::shared_ptr<AsyncChildProcess>& pChild,
+                    pImpl_->children)
+      {
+         if (pChild->exited())
+            pImpl_->pReactor->unwatch(pChild.get());
+      }
+   }
+#endif
    pImpl_->children.erase(std::remove_if(
                              pImpl_->children.begin(),
                              pImpl_->children.end(),
@@ -343,6 +414,31 @@ bool ProcessSupervisor::poll()
    return hasRunningChildren();
 }
 
+bool ProcessSupervisor::waitForEvents(
+      const boost::posix_time::time_duration& timeout)
+{
+#ifndef _WIN32
+   // (don't block if called re-entrantly from within poll)
+   if (pImpl_->pReactor && !pImpl_->isPolling)
+   {
+      // children which haven't started yet need polling right away
+      if (!pImpl_->watchChildren(pImpl_->children))
+         return true;
+
+      std::set<AsyncChildProcess*> ready;
+      Error error = pImpl_->pReactor->wait(
+               static_cast<int>(timeout.total_milliseconds()), &ready);
+      if (!error)
+         return !ready.empty();
+
+      LOG_ERROR(error);
+   }
+#endif
+
+   boost::this_thread::sleep(timeout);
+   return true;
+}
+
 void ProcessSupervisor::terminateAll()
 {
    // call terminate on all of our children
@@ -365,8 +461,9 @@ bool ProcessSupervisor::wait(
 
    while (poll())
    {
-      // wait the specified polling interval
-      boost::this_thread::sleep(pollingInterval);
+      // wait the specified polling interval (or until there is activity
+      // if we are event-driven)
+      waitForEvents(pollingInterval);
 
       // check for timeout if appropriate
       if (!timeoutTime.is_not_a_date_time())
@@ -16,8 +16,10 @@
 #ifndef _WIN32
 
 #include <atomic>
+#include <iostream>
 
 #include <boost/bind.hpp>
+#include <boost/format.hpp>
 #include <boost/foreach.hpp>
 #include <boost/thread.hpp>
 
@@ -55,6 +57,68 @@ void appendOutput(const std::string& output, std::string* pOutput)
    pOutput->append(output);
 }
 
+void appendResultOutput(const ProcessResult& result, std::string* pOutput)
+{
+   pOutput->append(result.stdOut);
+}
+
+struct SupervisorRun
+{
+   SupervisorRun() : iterations(0), idleIterations(0), exited(0), bytes(0) {}
+
+   int iterations;
+   int idleIterations;
+   int exited;
+   std::size_t bytes;
+   boost::posix_time::time_duration elapsed;
+};
+
+void countExit(int exitCode, int* pExited)
+{
+   if (exitCode == 0)
+      ++*pExited;
+}
+
+void countOutput(const std::string& output, std::size_t* pBytes)
+{
+   *pBytes += output.size();
+}
+
+// run 'count' copies of a command under a supervisor, waiting for events
+// between polls as a session's event loop would
+SupervisorRun runChildren(supervisor_mode::Mode mode,
+                          const std::string& command,
+                          int count,
+                          const boost::posix_time::time_duration& interval)
+{
+   using namespace boost::posix_time;
+
+   SupervisorRun run;
+   ProcessSupervisor supervisor(mode);
+   ptime start = microsec_clock::universal_time();
+
+   for (int i = 0; i < count; i++)
+   {
+      ProcessCallbacks callbacks;
+      callbacks.onExit = boost::bind(countExit, _1, &run.exited);
+      callbacks.onStdout = boost::bind(countOutput, _2, &run.bytes);
+      supervisor.runCommand(command, ProcessOptions(), callbacks);
+   }
+
+   while (supervisor.poll())
+   {
+      // count wakeups before any child has done anything
+      if (run.bytes == 0 && run.exited == 0)
+         ++run.idleIterations;
+
+      supervisor.waitForEvents(interval);
+      ++run.iterations;
+   }
+
+   run.elapsed = microsec_clock::universal_time() - start;
+   return run;
+}
+
 struct IoServiceFixture
 {
    boost::asio::io_service ioService;
@@ -378,6 +442,105 @@ context("ProcessTests")
          CHECK(outputs[i] == "Hello, " + safe_convert::numberToString(i) + "\n");
       }
    }
+
+   test_that("Event-driven ProcessSupervisor returns correct results")
+   {
+      ProcessSupervisor supervisor(supervisor_mode::EventDriven);
+
+      int exitCodes[10];
+      std::string outputs[10];
+      for (int i = 0; i < 10; ++i)
+      {
+         exitCodes[i] = -1;
+
+         ProcessCallbacks callbacks;
+         callbacks.onExit = boost::bind(&checkExitCode, _1, exitCodes + i);
+         callbacks.onStdout = boost::bind(&appendOutput, _2, outputs + i);
+
+         // odd children get their output back from standard input
+         std::vector<std::string> args;
+         args.push_back("Hello, " + safe_convert::numberToString(i));
+         if (i % 2 == 0)
+            supervisor.runProgram("/bin/echo", args, ProcessOptions(), callbacks);
+         else
+            supervisor.runCommand("cat", args[0] + "\n", ProcessOptions(),
+                                  boost::bind(&appendResultOutput, _1, outputs + i));
+      }
+
+      CHECK(supervisor.wait(boost::posix_time::milliseconds(100),
+                            boost::posix_time::seconds(10)));
+
+      for (int i = 0; i < 10; ++i)
+      {
+         if (i % 2 == 0)
+            CHECK(exitCodes[i] == 0);
+         CHECK(outputs[i] == "Hello, " + safe_convert::numberToString(i) + "\n");
+      }
+   }
+
+   test_that("Event-driven ProcessSupervisor wakes only for child activity")
+   {
+      // the supervisor is woken by the child's output rather than at the
+      // interval, so it polls (at most) once or twice while the child sleeps
+      SupervisorRun run = runChildren(supervisor_mode::EventDriven,
+                                      "sleep 1; echo done",
+                                      1,
+                                      boost::posix_time::seconds(5));
+
+      CHECK(run.exited == 1);
+      CHECK(run.bytes == 5);
+      CHECK(run.idleIterations <= 2);
+   }
+}
+
+// compares wakeups and throughput of the polling and event-driven modes with
+// many concurrent children. it takes a while and its numbers depend on the
+// machine so it isn't run by default (select it with [benchmark])
+TEST_CASE("ProcessSupervisor throughput", "[.][benchmark]")
+{
+   // the polling supervisor needs a short interval to deliver output
+   // promptly; the event-driven one is woken as soon as there's activity
+   boost::posix_time::milliseconds pollInterval(50);
+   boost::posix_time::milliseconds eventInterval(1000);
+   const int kChildren = 50;
+
+   // idle children: polling wakes on every interval while the event-driven
+   // supervisor sleeps until the children produce output
+   const std::string idleCommand = "sleep 1; echo done";
+   SupervisorRun polled = runChildren(supervisor_mode::Polling,
+                                      idleCommand, kChildren, pollInterval);
+   SupervisorRun evented = runChildren(supervisor_mode::EventDriven,
+                                       idleCommand, kChildren, eventInterval);
+   CHECK(polled.exited == kChildren);
+   CHECK(evented.exited == kChildren);
+   CHECK(evented.bytes == polled.bytes);
+
+   std::cerr << boost::format("Idle children: polling %1% wakeups (%2% idle) in %3%ms, "
+                              "event-driven %4% wakeups (%5% idle) in %6%ms")
+                % polled.iterations % polled.idleIterations
+                % polled.elapsed.total_milliseconds()
+                % evented.iterations % evented.idleIterations
+                % evented.elapsed.total_milliseconds()
+             << std::endl;
+
+   // busy children: output is delivered as it arrives rather than at the
+   // polling interval
+   const std::string busyCommand = "seq 1 200000";
+   polled = runChildren(supervisor_mode::Polling,
+                        busyCommand, kChildren, pollInterval);
+   evented = runChildren(supervisor_mode::EventDriven,
+                         busyCommand, kChildren, eventInterval);
+   CHECK(polled.exited == kChildren);
+   CHECK(evented.exited == kChildren);
+   CHECK(evented.bytes == polled.bytes);
+
+   std::cerr << boost::format("Busy children: polling %1%MB/s (%2% wakeups), "
+                              "event-driven %3%MB/s (%4% wakeups)")
+                % (polled.bytes / std::max<long>(1, polled.elapsed.total_microseconds()))
+                % polled.iterations
+                % (evented.bytes / std::max<long>(1, evented.elapsed.total_microseconds()))
+                % evented.iterations
+             << std::endl;
 }
 
 } // end namespace tests
@@ -362,6 +362,84 @@ void listEnvironment(SEXP env,
    }
 }
 
+namespace {
+
+void addFrameSymbols(SEXP frameSEXP,
+                     bool includeAll,
+                     std::vector<SEXP>* pSymbols)
+{
+   for (; frameSEXP != R_NilValue; frameSEXP = CDR(frameSEXP))
+   {
+      SEXP symbolSEXP = TAG(frameSEXP);
+      if (includeAll || CHAR(PRINTNAME(symbolSEXP))[0] != '.')
+         pSymbols->push_back(symbolSEXP);
+   }
+}
+
+} // anonymous namespace
+
+void listEnvironmentUnsorted(SEXP env,
+                             bool includeAll,
+                             bool includeLastDotValue,
+                             Protect* pProtect,
+                             std::vector<Variable>* pVariables)
+{
+   // the base environment keeps its bindings in the symbol table and user
+   // databases (and environments with a class) may not have an ordinary
+   // frame, so list these the usual way
+   if (env == R_BaseEnv || env == R_BaseNamespace || OBJECT(env))
+   {
+      listEnvironment(env, includeAll, includeLastDotValue, pProtect, pVariables);
+      return;
+   }
+
+   // reset passed vars
+   pVariables->clear();
+
+   // collect the bound symbols from the environment's hash table (or
+   // from its frame if it isn't hashed)
+   std::vector<SEXP> symbols;
+   SEXP hashTableSEXP = HASHTAB(env);
+   if (hashTableSEXP != R_NilValue)
+   {
+      int buckets = Rf_length(hashTableSEXP);
+      for (int i = 0; i < buckets; i++)
+         addFrameSymbols(VECTOR_ELT(hashTableSEXP, i), includeAll, &symbols);
+   }
+   else
+   {
+      addFrameSymbols(FRAME(env), includeAll, &symbols);
+   }
+
+   // add in .Last.value if it exists
+   if (!includeAll && includeLastDotValue)
+   {
+      SEXP lastValueSymbolSEXP = Rf_install(".Last.value");
+      if (Rf_findVar(lastValueSymbolSEXP, env) != R_UnboundValue)
+         symbols.push_back(lastValueSymbolSEXP);
+   }
+
+   // populate pVariables (reading values through R so that any bindings
+   // R stores specially are handled)
+   pVariables->reserve(symbols.size());
+   BOOST_FOREACH(SEXP symbolSEXP, symbols)
+   {
+      std::string var(CHAR(PRINTNAME(symbolSEXP)));
+
+      // don't fire active bindings (see listEnvironment)
+      SEXP varSEXP = R_NilValue;
+      if (!isActiveBinding(var, env))
+      {
+         varSEXP = Rf_findVar(symbolSEXP, env);
+         if (varSEXP == R_UnboundValue)
+            continue;
+      }
+
+      pProtect->add(varSEXP);
+      pVariables->push_back(std::make_pair(var, varSEXP));
+   }
+}
+
 
 void listNamedAttributes(SEXP obj, Protect *pProtect, std::vector<Variable>* pVariables)
 {
@@ -65,6 +65,14 @@ void listEnvironment(SEXP env,
                      bool includeLastDotValue,
                      Protect* pProtect,
                      std::vector<Variable>* pVariables);
+
+// as above, but lists the variables in the order R stores them (avoiding
+// the cost of collating and sorting their names)
+void listEnvironmentUnsorted(SEXP env,
+                             bool includeAll,
+                             bool includeLastDotValue,
+                             Protect* pProtect,
+                             std::vector<Variable>* pVariables);
       
 // object info
 SEXP findVar(const std::string& name,
@@ -56,6 +56,7 @@ struct is_error_code_enum<rstudio::r::session::graphics::errc::errc_t>
 #include <vector>
 
 #include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/signal.hpp>
 
 #include <core/Error.hpp>
@@ -157,6 +158,11 @@ public:
 
    // retrieve image path based on filename
    virtual core::FilePath imagePath(const std::string& imageFilename) const = 0;
+
+   // retrieve a rendered image held in memory (returns an empty pointer if
+   // the image isn't cached)
+   virtual boost::shared_ptr<const std::string> cachedImage(
+                                 const std::string& imageFilename) const = 0;
    
    // clear the display (closes the device)
    virtual void clear() = 0;
@@ -698,6 +698,7 @@ Error initialize(
    GraphicsDeviceFunctions graphicsDevice;
    graphicsDevice.isActive = isActive;
    graphicsDevice.displaySize = displaySize;
+   graphicsDevice.devicePixelRatio = devicePixelRatio;
    graphicsDevice.convert = convert;
    graphicsDevice.saveSnapshot = saveSnapshot;
    graphicsDevice.restoreSnapshot = restoreSnapshot;
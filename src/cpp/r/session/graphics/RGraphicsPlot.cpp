@@ -14,12 +14,14 @@
  */
 
 #include "RGraphicsPlot.hpp"
+#include "RGraphicsPlotImageCache.hpp"
 
 #include <iostream>
 
 #include <boost/format.hpp>
 
 #include <core/Error.hpp>
+#include <core/FileSerializer.hpp>
 #include <core/Log.hpp>
 
 #include <core/system/System.hpp>
@@ -41,6 +43,8 @@ Plot::Plot(const GraphicsDeviceFunctions& graphicsDevice,
    : graphicsDevice_(graphicsDevice), 
      baseDirPath_(baseDirPath),
      needsUpdate_(false),
+     contentId_(core::system::generateUuid()),
+     imageDevicePixelRatio_(0),
      manipulator_(manipulatorSEXP)
 {
 }
@@ -54,6 +58,9 @@ Plot::Plot(const GraphicsDeviceFunctions& graphicsDevice,
      storageUuid_(storageUuid),
      renderedSize_(renderedSize),
      needsUpdate_(false),
+     contentId_(core::system::generateUuid()),
+     imageSize_(renderedSize),
+     imageDevicePixelRatio_(graphicsDevice.devicePixelRatio()),
      manipulator_()
 {
    // invalidate if the image file doesn't exist (allows the server
@@ -61,6 +68,17 @@ Plot::Plot(const GraphicsDeviceFunctions& graphicsDevice,
    if (!imageFilePath(storageUuid_).exists())
       invalidate();
 } 
+
+Plot::~Plot()
+{
+   try
+   {
+      plotImageCache().remove(contentId_);
+   }
+   catch(...)
+   {
+   }
+}
    
 std::string Plot::storageUuid() const
 {  
@@ -74,7 +92,7 @@ bool Plot::hasValidStorage() const
 
 void Plot::invalidate()
 {
-   needsUpdate_ = true;
+   contentChanged();
 }
 
 bool Plot::hasManipulator() const
@@ -121,13 +139,39 @@ void Plot::saveManipulator() const
    
 Error Plot::renderFromDisplay()
 {
-   // we can use our cached representation if we don't need an update and our 
-   // rendered size is the same as the current graphics device size
+   // we can use our current image if we don't need an update and its
+   // size is the same as the current graphics device size
+   DisplaySize displaySize = graphicsDevice_.displaySize();
+   double devicePixelRatio = graphicsDevice_.devicePixelRatio();
    if ( !needsUpdate_ &&
-        (renderedSize() == graphicsDevice_.displaySize()) )
+        (imageSize_ == displaySize) &&
+        (imageDevicePixelRatio_ == devicePixelRatio) )
    {
       return Success();
    }
+
+   // if only the size has changed then use an image we've already rendered
+   // at this size (e.g. when the plots pane is resized back)
+   std::string cachedImageFilename;
+   boost::shared_ptr<const std::string> pCachedImage;
+   if (!needsUpdate_ && hasStorage() &&
+       plotImageCache().find(contentId_,
+                             displaySize,
+                             devicePixelRatio,
+                             &cachedImageFilename))
+   {
+      pCachedImage = plotImageCache().image(cachedImageFilename);
+   }
+
+   if (pCachedImage)
+   {
+      Error error = restoreCachedImage(pCachedImage);
+      if (!error)
+         return Success();
+
+      // fall back to rendering the image
+      LOG_ERROR(error);
+   }
    
    // generate a new storage uuid
    std::string storageUuid = core::system::generateUuid();
@@ -139,17 +183,23 @@ Error Plot::renderFromDisplay()
       return Error(errc::PlotRenderingError, error, ERROR_LOCATION);
    
    // save rendered size
-   renderedSize_ = graphicsDevice_.displaySize();
+   renderedSize_ = displaySize;
    
    // save manipulator (if any)
    saveManipulator(storageUuid);
 
+   // keep the image in memory (so it can be served without reading it and
+   // re-used if we are resized back to this size)
+   cacheImage(storageUuid);
+
    // delete existing files (if any)
    Error removeError = removeFiles();
         
    // update state
    storageUuid_ = storageUuid;
    needsUpdate_ = false;
+   imageSize_ = displaySize;
+   imageDevicePixelRatio_ = devicePixelRatio;
    
    // return error status 
    return removeError;
@@ -192,7 +242,7 @@ Error Plot::renderFromDisplaySnapshot(SEXP snapshot)
    
    // update state
    storageUuid_ = storageUuid;
-   needsUpdate_ = true;
+   contentChanged();
    
    // return error status
    return removeError;
@@ -249,6 +299,77 @@ bool Plot::hasStorage() const
    return !storageUuid_.empty();
 }
 
+void Plot::contentChanged()
+{
+   // images rendered for the previous content are now stale (note that
+   // we only need to do this once per update)
+   if (!needsUpdate_)
+   {
+      plotImageCache().remove(contentId_);
+      contentId_ = core::system::generateUuid();
+      needsUpdate_ = true;
+   }
+}
+
+void Plot::cacheImage(const std::string& storageUuid) const
+{
+   FilePath imageFile = imageFilePath(storageUuid);
+   boost::shared_ptr<std::string> pImage(new std::string());
+   Error error = readStringFromFile(imageFile, pImage.get());
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   plotImageCache().insert(contentId_,
+                           graphicsDevice_.displaySize(),
+                           graphicsDevice_.devicePixelRatio(),
+                           imageFile.filename(),
+                           pImage);
+}
+
+Error Plot::restoreCachedImage(
+                     const boost::shared_ptr<const std::string>& pImage)
+{
+   // the file the image was rendered to was removed when we were rendered
+   // at another size, so write it (and a copy of our snapshot) to new
+   // storage so that it can still be served once it leaves the cache
+   std::string storageUuid = core::system::generateUuid();
+   FilePath imageFile = imageFilePath(storageUuid);
+   Error error = snapshotFilePath().copy(snapshotFilePath(storageUuid));
+   if (!error)
+      error = writeStringToFile(imageFile, *pImage);
+   if (error)
+   {
+      snapshotFilePath(storageUuid).removeIfExists();
+      imageFile.removeIfExists();
+      return Error(errc::PlotFileError, error, ERROR_LOCATION);
+   }
+
+   saveManipulator(storageUuid);
+
+   // re-key the cached image by its new filename
+   DisplaySize displaySize = graphicsDevice_.displaySize();
+   double devicePixelRatio = graphicsDevice_.devicePixelRatio();
+   plotImageCache().insert(contentId_,
+                           displaySize,
+                           devicePixelRatio,
+                           imageFile.filename(),
+                           pImage);
+
+   Error removeError = removeFiles();
+
+   storageUuid_ = storageUuid;
+   renderedSize_ = displaySize;
+   imageSize_ = displaySize;
+   imageDevicePixelRatio_ = devicePixelRatio;
+
+   if (removeError)
+      LOG_ERROR(removeError);
+   return Success();
+}
+
 FilePath Plot::snapshotFilePath() const
 {
    return snapshotFilePath(storageUuid());
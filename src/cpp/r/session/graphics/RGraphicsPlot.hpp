@@ -18,6 +18,7 @@
 
 #include <string>
 
+#include <boost/shared_ptr.hpp>
 #include <boost/utility.hpp>
 
 #include <core/FilePath.hpp>
@@ -53,6 +54,8 @@ public:
         const core::FilePath& baseDirPath, 
         const std::string& storageUuid,
         const DisplaySize& renderedSize);
+
+   ~Plot();
    
    std::string storageUuid() const;  
    bool hasValidStorage() const;
@@ -78,6 +81,11 @@ public:
 private:
    bool hasStorage() const;
 
+   void contentChanged();
+   void cacheImage(const std::string& storageUuid) const;
+   core::Error restoreCachedImage(
+                  const boost::shared_ptr<const std::string>& pImage);
+
    core::FilePath snapshotFilePath() const ;
    core::FilePath snapshotFilePath(const std::string& storageUuid) const;
    core::FilePath imageFilePath(const std::string& storageUuid) const;
@@ -94,6 +102,14 @@ private:
    DisplaySize renderedSize_ ;
    bool needsUpdate_;
 
+   // identifies the plot's content (changes whenever the plot is drawn on,
+   // but not when it is resized)
+   std::string contentId_;
+
+   // the size and pixel ratio of our current image
+   DisplaySize imageSize_;
+   double imageDevicePixelRatio_;
+
    // manipulator and protection scope for it
    mutable PlotManipulator manipulator_;
 };
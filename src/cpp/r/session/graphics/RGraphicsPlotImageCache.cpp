@@ -0,0 +1,163 @@
+/*
+ * RGraphicsPlotImageCache.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "RGraphicsPlotImageCache.hpp"
+
+#include <boost/format.hpp>
+
+namespace rstudio {
+namespace r {
+namespace session {
+namespace graphics {
+
+namespace {
+
+// enough for the images of a typical plot history at a few sizes
+const std::size_t kMaxPlotImageBytes = 32 * 1024 * 1024;
+
+} // anonymous namespace
+
+PlotImageCache& plotImageCache()
+{
+   // (never destroyed, as plots release their images when they are
+   // destroyed, which may happen during static destruction)
+   static PlotImageCache* pInstance = new PlotImageCache(kMaxPlotImageBytes);
+   return *pInstance;
+}
+
+PlotImageCache::PlotImageCache(std::size_t maxBytes)
+   : maxBytes_(maxBytes), bytes_(0)
+{
+}
+
+std::string PlotImageCache::entryKey(const std::string& contentId,
+                                     const DisplaySize& size,
+                                     double devicePixelRatio)
+{
+   boost::format fmt("%1%:%2%x%3%@%4%");
+   return boost::str(fmt % contentId % size.width % size.height %
+                     devicePixelRatio);
+}
+
+void PlotImageCache::insert(const std::string& contentId,
+                            const DisplaySize& size,
+                            double devicePixelRatio,
+                            const std::string& imageFilename,
+                            const boost::shared_ptr<const std::string>& pImage)
+{
+   // images larger than the whole budget are never cached
+   if (!pImage || pImage->size() > maxBytes_)
+      return;
+
+   std::string key = entryKey(contentId, size, devicePixelRatio);
+
+   // replace any existing entries for this key or filename
+   std::map<std::string, EntryIterator>::iterator it = byKey_.find(key);
+   if (it != byKey_.end())
+      erase(it->second);
+   it = byFilename_.find(imageFilename);
+   if (it != byFilename_.end())
+      erase(it->second);
+
+   Entry entry;
+   entry.key = key;
+   entry.contentId = contentId;
+   entry.imageFilename = imageFilename;
+   entry.pImage = pImage;
+   entries_.push_front(entry);
+   byKey_[key] = entries_.begin();
+   byFilename_[imageFilename] = entries_.begin();
+   bytes_ += pImage->size();
+
+   evict();
+}
+
+bool PlotImageCache::find(const std::string& contentId,
+                          const DisplaySize& size,
+                          double devicePixelRatio,
+                          std::string* pImageFilename)
+{
+   std::map<std::string, EntryIterator>::iterator it =
+         byKey_.find(entryKey(contentId, size, devicePixelRatio));
+   if (it == byKey_.end())
+      return false;
+
+   *pImageFilename = it->second->imageFilename;
+   touch(it->second);
+   return true;
+}
+
+boost::shared_ptr<const std::string> PlotImageCache::image(
+                                          const std::string& imageFilename)
+{
+   std::map<std::string, EntryIterator>::iterator it =
+         byFilename_.find(imageFilename);
+   if (it == byFilename_.end())
+      return boost::shared_ptr<const std::string>();
+
+   boost::shared_ptr<const std::string> pImage = it->second->pImage;
+   touch(it->second);
+   return pImage;
+}
+
+void PlotImageCache::remove(const std::string& contentId)
+{
+   EntryIterator it = entries_.begin();
+   while (it != entries_.end())
+   {
+      EntryIterator next = it;
+      ++next;
+      if (it->contentId == contentId)
+         erase(it);
+      it = next;
+   }
+}
+
+void PlotImageCache::clear()
+{
+   entries_.clear();
+   byKey_.clear();
+   byFilename_.clear();
+   bytes_ = 0;
+}
+
+void PlotImageCache::touch(EntryIterator it)
+{
+   // (splicing doesn't invalidate the iterators held by the indexes)
+   entries_.splice(entries_.begin(), entries_, it);
+}
+
+void PlotImageCache::erase(EntryIterator it)
+{
+   bytes_ -= it->pImage->size();
+   byKey_.erase(it->key);
+   byFilename_.erase(it->imageFilename);
+   entries_.erase(it);
+}
+
+void PlotImageCache::evict()
+{
+   while (bytes_ > maxBytes_ && !entries_.empty())
+   {
+      EntryIterator last = entries_.end();
+      --last;
+      erase(last);
+   }
+}
+
+} // namespace graphics
+} // namespace session
+} // namespace r
+} // namespace rstudio
@@ -0,0 +1,104 @@
+/*
+ * RGraphicsPlotImageCache.hpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef R_SESSION_GRAPHICS_PLOT_IMAGE_CACHE_HPP
+#define R_SESSION_GRAPHICS_PLOT_IMAGE_CACHE_HPP
+
+#include <list>
+#include <map>
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+#include "RGraphicsTypes.hpp"
+
+namespace rstudio {
+namespace r {
+namespace session {
+namespace graphics {
+
+// In-memory cache of rendered plot images, keyed by the plot's content and
+// the size (and device pixel ratio) it was rendered at. Images are also
+// available by their (strongly named) image filename so they can be served
+// without going to disk. The least recently used images are evicted once
+// the cache exceeds its byte budget.
+class PlotImageCache : boost::noncopyable
+{
+public:
+   explicit PlotImageCache(std::size_t maxBytes);
+
+   void insert(const std::string& contentId,
+               const DisplaySize& size,
+               double devicePixelRatio,
+               const std::string& imageFilename,
+               const boost::shared_ptr<const std::string>& pImage);
+
+   // find the filename of the image rendered for the given content and size
+   // (returns false if there isn't one)
+   bool find(const std::string& contentId,
+             const DisplaySize& size,
+             double devicePixelRatio,
+             std::string* pImageFilename);
+
+   // get the image with the given filename (returns an empty pointer if it
+   // isn't cached)
+   boost::shared_ptr<const std::string> image(const std::string& imageFilename);
+
+   // remove all of the images rendered for the given content
+   void remove(const std::string& contentId);
+
+   void clear();
+
+   std::size_t size() const { return entries_.size(); }
+   std::size_t bytes() const { return bytes_; }
+
+private:
+   struct Entry
+   {
+      std::string key;
+      std::string contentId;
+      std::string imageFilename;
+      boost::shared_ptr<const std::string> pImage;
+   };
+   typedef std::list<Entry>::iterator EntryIterator;
+
+   static std::string entryKey(const std::string& contentId,
+                               const DisplaySize& size,
+                               double devicePixelRatio);
+
+   void touch(EntryIterator it);
+   void erase(EntryIterator it);
+   void evict();
+
+   std::size_t maxBytes_;
+   std::size_t bytes_;
+
+   // entries in most recently used order
+   std::list<Entry> entries_;
+   std::map<std::string, EntryIterator> byKey_;
+   std::map<std::string, EntryIterator> byFilename_;
+};
+
+// singleton
+PlotImageCache& plotImageCache();
+
+} // namespace graphics
+} // namespace session
+} // namespace r
+} // namespace rstudio
+
+
+#endif // R_SESSION_GRAPHICS_PLOT_IMAGE_CACHE_HPP
@@ -37,6 +37,7 @@
 #include "RGraphicsUtils.hpp"
 #include "RGraphicsDevice.hpp"
 #include "RGraphicsPlotManipulatorManager.hpp"
+#include "RGraphicsPlotImageCache.hpp"
 
 using namespace rstudio::core;
 
@@ -490,14 +491,17 @@ void PlotManager::render(boost::function<void(DisplayState)> outputFunction)
    }
    else  // write "empty" image 
    {
-      // create an empty file
+      // create an empty file (if we haven't already)
       FilePath emptyImageFilePath = graphicsPath_.complete(emptyImageFilename());
-      error = writeStringToFile(emptyImageFilePath, std::string());
-      if (error)
+      if (!emptyImageFilePath.exists())
       {
-         Error graphicsError(errc::PlotRenderingError, error, ERROR_LOCATION);
-         logAndReportError(graphicsError, ERROR_LOCATION);
-         return;
+         error = writeStringToFile(emptyImageFilePath, std::string());
+         if (error)
+         {
+            Error graphicsError(errc::PlotRenderingError, error, ERROR_LOCATION);
+            logAndReportError(graphicsError, ERROR_LOCATION);
+            return;
+         }
       }
    }
    
@@ -533,6 +537,12 @@ FilePath PlotManager::imagePath(const std::string& imageFilename) const
    return graphicsPath_.complete(imageFilename);
 }
 
+boost::shared_ptr<const std::string> PlotManager::cachedImage(
+                                 const std::string& imageFilename) const
+{
+   return plotImageCache().image(imageFilename);
+}
+
 void PlotManager::clear()
 {
    graphicsDevice_.close();
@@ -805,7 +815,9 @@ void PlotManager::onDeviceResized()
    if (suppressDeviceEvents_)
       return;
    
-   invalidateActivePlot();
+   // the plot's content is unchanged (it will be re-rendered at the new
+   // size, or use an image already rendered at that size, when we render)
+   setDisplayHasChanges(true);
 }
 
 void PlotManager::onDeviceClosed()
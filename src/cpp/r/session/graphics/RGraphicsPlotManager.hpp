@@ -107,6 +107,9 @@ public:
    
     // retrieve image path based on filename
    virtual core::FilePath imagePath(const std::string& imageFilename) const;
+
+   virtual boost::shared_ptr<const std::string> cachedImage(
+                                 const std::string& imageFilename) const;
    
    virtual void clear();
 
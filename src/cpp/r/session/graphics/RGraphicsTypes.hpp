@@ -65,6 +65,7 @@ struct GraphicsDeviceFunctions
 {
    boost::function<bool()> isActive;
    boost::function<DisplaySize()> displaySize;
+   boost::function<double()> devicePixelRatio;
    UnitConversionFunctions convert;
    boost::function<core::Error(const core::FilePath&,
                                const core::FilePath&)> saveSnapshot;
@@ -278,7 +278,7 @@ Error writeToPNG(const FilePath& targetPath, DeviceContext* pDC)
    // turn the shadow device off to write the file
    shadowDevOff(pDC);
 
-   // if the targetPath != the bitmap path then copy it
+   // if the targetPath != the bitmap path then move it there
    Error error;
    if (targetPath != pDC->targetPath)
    {
@@ -290,28 +290,23 @@ Error writeToPNG(const FilePath& targetPath, DeviceContext* pDC)
       }
       else
       {
-         error = pDC->targetPath.copy(targetPath);
-
-         Error deleteError = pDC->targetPath.remove();
-         if (deleteError)
-            LOG_ERROR(error);
+         // (falls back to copying if the paths are on different devices)
+         error = pDC->targetPath.move(targetPath);
+         if (error)
+         {
+            Error removeError = pDC->targetPath.removeIfExists();
+            if (removeError)
+               LOG_ERROR(removeError);
+         }
       }
    }
 
-   // regenerate the shadow device
-   pDevDesc dev = pDC->dev;
-   int width = pDC->width;
-   int height = pDC->height;
-   double devicePixelRatio = pDC->devicePixelRatio;
-   handler::destroy(pDC);
-   pDC = handler::allocate(dev);
-   dev->deviceSpecific = pDC;
-
-   // re-create with the correct size
-   if (!handler::initialize(width, height, devicePixelRatio, pDC))
-      return systemError(boost::system::errc::not_connected, ERROR_LOCATION);
+   // point the shadow device at a new file (it is regenerated on demand
+   // with the device's current size)
+   pDC->targetPath = tempFile("png");
 
    // now update the device structure
+   pDevDesc dev = pDC->dev;
    handler::setSize(dev);
 
    // replay the rstudio graphics device context onto the png
@@ -30,6 +30,7 @@
 #include <core/http/URL.hpp>
 #include <core/http/AsyncUriHandler.hpp>
 #include <core/http/SecureCookie.hpp>
+#include <core/http/StaticFileCache.hpp>
 #include <core/http/TcpIpAsyncServer.hpp>
 
 #include <core/gwt/GwtLogHandler.hpp>
@@ -222,6 +223,12 @@ void httpServerAddHandlers()
 
    // add default handler for gwt app
    uri_handlers::setBlockingDefault(blockingFileHandler());
+
+   // load (and compress) the gwt app's files up front rather than on the
+   // first request for each of them
+   Error error = http::staticFileCache().addDirectory(wwwPath);
+   if (error)
+      LOG_ERROR(error);
 }
 
 
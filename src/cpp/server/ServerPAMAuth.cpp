@@ -366,6 +366,9 @@ void doSignIn(const http::Request& request,
 
    onUserUnauthenticated(username);
 
+   // make sure we validate against the current system view of the user
+   core::system::user::invalidateCachedUser(username);
+
    if ( pamLogin(username, password) && server::auth::validateUser(username))
    {
       if (appUri.size() > 0 && appUri[0] != '/')
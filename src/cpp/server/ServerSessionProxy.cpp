@@ -15,11 +15,13 @@
 
 #include <server/ServerSessionProxy.hpp>
 
+#include <deque>
 #include <vector>
 #include <sstream>
 #include <map>
 
 #include <boost/regex.hpp>
+#include <boost/enable_shared_from_this.hpp>
 #include <boost/algorithm/string/join.hpp>
 
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -42,6 +44,7 @@
 #include <core/http/Request.hpp>
 #include <core/http/Response.hpp>
 #include <core/http/LocalStreamAsyncClient.hpp>
+#include <core/http/LocalStreamConnectionPool.hpp>
 #include <core/http/Util.hpp>
 #include <core/http/URL.hpp>
 #include <core/system/PosixSystem.hpp>
@@ -522,25 +525,189 @@ void handleEventsError(
    ptrConnection->writeResponse();
 }
 
-Error userIdForUsername(const std::string& username, UidType* pUID)
+// forwards a streamed (chunked) session response to the client as its chunks
+// arrive rather than collecting the entire body first. writes are queued so
+// that only one is outstanding on the client connection at a time
+class ChunkedResponseForwarder
+   : public boost::enable_shared_from_this<ChunkedResponseForwarder>
 {
-   static core::thread::ThreadsafeMap<std::string, UidType> cache;
+public:
+   ChunkedResponseForwarder(
+         boost::shared_ptr<core::http::AsyncConnection> ptrConnection,
+         const r_util::SessionContext& context)
+      : ptrConnection_(ptrConnection),
+        context_(context),
+        started_(false),
+        writing_(false),
+        complete_(false),
+        failed_(false)
+   {
+   }
+
+   void handleChunk(const http::Response& response, const std::string& chunk)
+   {
+      bool writeHeaders = false;
+      LOCK_MUTEX(mutex_)
+      {
+         if (failed_)
+            return;
+
+         // the first chunk sends the session's response headers
+         if (!started_)
+         {
+            sessionManager().removePendingLaunch(context_);
+            started_ = true;
+            writing_ = true;
+            writeHeaders = true;
+         }
+
+         if (chunk.empty())
+         {
+            // the final (empty) chunk terminates the body
+            pending_.push_back("0\r\n\r\n");
+            complete_ = true;
+         }
+         else
+         {
+            std::ostringstream ostr;
+            ostr << std::hex << chunk.size() << "\r\n";
+            pending_.push_back(ostr.str() + chunk + "\r\n");
+         }
+      }
+      END_LOCK_MUTEX
+
+      if (writeHeaders)
+      {
+         http::Response& clientResponse = ptrConnection_->response();
+         clientResponse.assign(response);
+         clientResponse.setHeader("Connection", "close");
+         ptrConnection_->writeResponseHeaders(
+                  boost::bind(&ChunkedResponseForwarder::handleWrite,
+                              shared_from_this(),
+                              _1,
+                              false));
+      }
+      else
+      {
+         writeNext();
+      }
+   }
 
-   if (cache.contains(username))
+   void handleError(const http::ErrorHandler& errorHandler, const Error& error)
    {
-      *pUID = cache.get(username);
+      bool started = false;
+      LOCK_MUTEX(mutex_)
+      {
+         started = started_;
+         failed_ = true;
+      }
+      END_LOCK_MUTEX
+
+      // once streaming has started the client already has our response
+      // headers so all we can do is drop the connection
+      if (started)
+      {
+         logIfNotConnectionTerminated(error, ptrConnection_->request());
+         ptrConnection_->close();
+      }
+      else
+      {
+         errorHandler(error);
+      }
    }
-   else
+
+private:
+   void writeNext()
+   {
+      const std::string* pBuffer = NULL;
+      bool close = false;
+      LOCK_MUTEX(mutex_)
+      {
+         if (writing_ || failed_)
+            return;
+
+         if (pending_.empty())
+         {
+            close = complete_;
+         }
+         else
+         {
+            writing_ = true;
+            pBuffer = &pending_.front();
+         }
+      }
+      END_LOCK_MUTEX
+
+      if (pBuffer != NULL)
+      {
+         std::vector<boost::asio::const_buffer> buffers;
+         buffers.push_back(boost::asio::buffer(*pBuffer));
+         ptrConnection_->asyncWrite(
+                  buffers,
+                  boost::bind(&ChunkedResponseForwarder::handleWrite,
+                              shared_from_this(),
+                              _1,
+                              true));
+      }
+      else if (close)
+      {
+         ptrConnection_->close();
+      }
+   }
+
+   void handleWrite(const boost::system::error_code& ec, bool wroteChunk)
    {
-      core::system::user::User user;
-      Error error = core::system::user::userFromUsername(username, &user);
-      if (error)
-         return error;
+      bool failed = false;
+      LOCK_MUTEX(mutex_)
+      {
+         writing_ = false;
+         if (wroteChunk)
+            pending_.pop_front();
+         if (ec)
+            failed = failed_ = true;
+      }
+      END_LOCK_MUTEX
 
-      *pUID = user.userId;
-      cache.set(username, *pUID);
+      if (failed)
+      {
+         logIfNotConnectionTerminated(Error(ec, ERROR_LOCATION),
+                                      ptrConnection_->request());
+         ptrConnection_->close();
+      }
+      else
+      {
+         writeNext();
+      }
    }
 
+private:
+   boost::shared_ptr<core::http::AsyncConnection> ptrConnection_;
+   r_util::SessionContext context_;
+   boost::mutex mutex_;
+   std::deque<std::string> pending_;
+   bool started_;
+   bool writing_;
+   bool complete_;
+   bool failed_;
+};
+
+// idle keep-alive connections to sessions (reused across proxied requests
+// to avoid a connect/accept/close cycle for every rpc and event poll)
+boost::shared_ptr<http::LocalStreamConnectionPool> sessionConnectionPool()
+{
+   static boost::shared_ptr<http::LocalStreamConnectionPool> s_pPool(
+                                    new http::LocalStreamConnectionPool());
+   return s_pPool;
+}
+
+Error userIdForUsername(const std::string& username, UidType* pUID)
+{
+   core::system::user::User user;
+   Error error = core::system::user::cachedUserFromUsername(username, &user);
+   if (error)
+      return error;
+
+   *pUID = user.userId;
    return Success();
 }
 
@@ -609,9 +776,12 @@ void proxyRequest(
    // create client
    // if the user is available on the system pass in the uid for validation to ensure
    // that we only connect to the socket if it was created by the user
-    boost::shared_ptr<http::IAsyncClient> pClient(new http::LocalStreamAsyncClient(
+    boost::shared_ptr<http::LocalStreamAsyncClient> pLocalStreamClient(
+                                  new http::LocalStreamAsyncClient(
                                                      ptrConnection->ioService(),
                                                      streamPath, false, validateUid));
+    pLocalStreamClient->setConnectionPool(sessionConnectionPool());
+    boost::shared_ptr<http::IAsyncClient> pClient = pLocalStreamClient;
 
     // setup retry context
     if (!connectionRetryProfile.empty())
@@ -620,8 +790,24 @@ void proxyRequest(
     // assign request
     pClient->request().assign(*pRequest);
 
-    pClient->execute(boost::bind(handleProxyResponse, ptrConnection, context, _1),
-                     errorHandler);
+    // events responses may be streamed by the session so forward their
+    // chunks as they arrive (other responses are forwarded whole)
+    if (requestType == RequestType::Events)
+    {
+       boost::shared_ptr<ChunkedResponseForwarder> pForwarder(
+                         new ChunkedResponseForwarder(ptrConnection, context));
+       pClient->execute(
+             boost::bind(handleProxyResponse, ptrConnection, context, _1),
+             boost::bind(&ChunkedResponseForwarder::handleError,
+                         pForwarder, errorHandler, _1),
+             boost::bind(&ChunkedResponseForwarder::handleChunk,
+                         pForwarder, _1, _2));
+    }
+    else
+    {
+       pClient->execute(boost::bind(handleProxyResponse, ptrConnection, context, _1),
+                        errorHandler);
+    }
 }
 
 // function used to periodically validate that the user is valid (has an
@@ -824,6 +1010,11 @@ void proxyLocalhostRequest(
             onError);
 }
 
+http::LocalStreamConnectionPool::Stats connectionPoolStats()
+{
+   return sessionConnectionPool()->stats();
+}
+
 bool requiresSession(const http::Request& request)
 {
    return !request.headerValue(kRStudioSessionRequiredHeader).empty();
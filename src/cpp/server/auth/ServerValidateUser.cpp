@@ -43,9 +43,9 @@ bool validateUser(const std::string& username,
    if (!server::options().authValidateUsers())
       return true;
    
-   // get the user
+   // get the user (cached since we validate on every proxied request)
    core::system::user::User user;
-   Error error = userFromUsername(username, &user);
+   Error error = cachedUserFromUsername(username, &user);
    if (error)
    {
       // log the error only if it is unexpected
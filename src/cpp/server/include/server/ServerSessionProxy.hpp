@@ -20,6 +20,7 @@
 
 #include <core/http/AsyncConnection.hpp>
 #include <core/http/TcpIpAsyncClient.hpp>
+#include <core/http/LocalStreamConnectionPool.hpp>
 
 #include <core/r_util/RSessionContext.hpp>
 
@@ -107,6 +108,9 @@ void proxyLocalhostRequest(
    
 bool requiresSession(const core::http::Request& request);
 
+// statistics for the pool of keep-alive connections to sessions
+core::http::LocalStreamConnectionPool::Stats connectionPoolStats();
+
 typedef boost::function<bool(
     boost::shared_ptr<core::http::AsyncConnection>,
     const core::r_util::SessionContext&
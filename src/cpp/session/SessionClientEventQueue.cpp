@@ -17,12 +17,16 @@
 
 #include "modules/SessionConsole.hpp"
 
-#include <boost/foreach.hpp>
+#include <map>
+#include <algorithm>
 
+#include <boost/foreach.hpp>
+#include <boost/checked_delete.hpp>
 
 #include <core/BoostThread.hpp>
 #include <core/Thread.hpp>
 #include <core/json/Json.hpp>
+#include <core/SafeConvert.hpp>
 #include <core/StringUtils.hpp>
 
 #include <r/session/RConsoleActions.hpp>
@@ -33,9 +37,43 @@ namespace rstudio {
 namespace session {
  
 namespace {
+
 ClientEventQueue* s_pClientEventQueue = NULL;
+
+// default limit on console output pending delivery to the client
+const std::size_t kDefaultMaxPendingBytes = 4 * 1024 * 1024;
+
+long long nowMicroseconds()
+{
+   using namespace boost::posix_time;
+   static const ptime epoch(boost::gregorian::date(1970, 1, 1));
+   return (microsec_clock::universal_time() - epoch).total_microseconds();
+}
+
+boost::posix_time::ptime timeFromMicroseconds(long long microseconds)
+{
+   using namespace boost::posix_time;
+   static const ptime epoch(boost::gregorian::date(1970, 1, 1));
+   return epoch + boost::posix_time::microseconds(microseconds);
 }
 
+bool isConsoleTextEvent(const ClientEvent& event)
+{
+   return (event.type() == client_events::kConsoleWriteOutput ||
+           event.type() == client_events::kConsoleWriteError) &&
+          event.data().type() == json::StringType;
+}
+
+std::size_t pendingBytesForEvent(const ClientEvent& event)
+{
+   if (isConsoleTextEvent(event))
+      return event.data().get_str().size();
+   else
+      return 0;
+}
+
+} // anonymous namespace
+
 void initializeClientEventQueue()
 {
    BOOST_ASSERT(s_pClientEventQueue == NULL);
@@ -48,103 +86,224 @@ ClientEventQueue& clientEventQueue()
 }
    
 ClientEventQueue::ClientEventQueue()
-   :  pMutex_(new boost::mutex()),
+   :  pHead_(NULL),
+      pMutex_(new boost::mutex()),
       pWaitForEventCondition_(new boost::condition()),
-      lastEventAddTime_(boost::posix_time::not_a_date_time)
+      pTakeMutex_(new boost::mutex()),
+      eventWaiters_(0),
+      addCount_(0),
+      pActiveConsole_(new std::string()),
+      lastEventAddTime_(0),
+      pendingBytes_(0),
+      maxPendingBytes_(kDefaultMaxPendingBytes)
 {
+   // these events carry the complete state of what they describe so
+   // pending instances are superseded by newer ones
+   coalesceEvents_.insert(client_events::kPlotsStateChanged);
+   coalesceEvents_.insert(client_events::kEnvironmentRefresh);
+   coalesceEvents_.insert(client_events::kContextDepthChanged);
+}
+
+ClientEventQueue::~ClientEventQueue()
+{
+   try
+   {
+      deleteNodes(takeAll());
+   }
+   catch(...)
+   {
+   }
 }
 
 bool ClientEventQueue::setActiveConsole(const std::string& console)
 {
-   bool changed = false;
+   // console output captures the active console when it is added so
+   // output added prior to the switch is still attributed to the
+   // previous console
+   boost::shared_ptr<const std::string> pActiveConsole =
+                                       boost::atomic_load(&pActiveConsole_);
+   if (*pActiveConsole == console)
+      return false;
+
+   boost::atomic_store(&pActiveConsole_,
+                       boost::shared_ptr<const std::string>(
+                                             new std::string(console)));
+   return true;
+}
+
+void ClientEventQueue::setCoalesceEvents(int type, bool coalesce)
+{
    LOCK_MUTEX(*pMutex_)
    {
-      if (activeConsole_ != console)
-      {
-         // flush events to the previous console
-         flushPendingConsoleOutput();
-         
-         // switch to the new one
-         activeConsole_ = console;
-         changed = true;
-      }
+      if (coalesce)
+         coalesceEvents_.insert(type);
+      else
+         coalesceEvents_.erase(type);
    }
    END_LOCK_MUTEX
-   return changed;
+}
+
+void ClientEventQueue::setMaxPendingBytes(std::size_t maxPendingBytes)
+{
+   maxPendingBytes_ = maxPendingBytes;
 }
 
 void ClientEventQueue::add(const ClientEvent& event)
 { 
-   LOCK_MUTEX(*pMutex_)
+   // console output which isn't a string is dropped (as it always has been)
+   if (event.type() == client_events::kConsoleWriteOutput &&
+       event.data().type() != json::StringType)
    {
-      // console output is batched up for compactness/efficiency.
-      if (event.type() == client_events::kConsoleWriteOutput)
-      {
-         if (event.data().type() == json::StringType)
-            pendingConsoleOutput_ += event.data().get_str();
-      }
-      else if (event.type() == client_events::kConsoleWriteError &&
-               event.data().type() == json::StringType)
-      {
-         flushPendingConsoleOutput();
-         enqueueClientOutputEvent(event.type(), event.data().get_str());
-      }
-      else
+      return;
+   }
+
+   // create the node (console output is batched up for compactness and
+   // efficiency when events are removed)
+   bool consoleText = isConsoleTextEvent(event);
+   Node* pNode = new Node(event);
+   if (consoleText)
+      pNode->pConsole = boost::atomic_load(&pActiveConsole_);
+   std::size_t bytes = pendingBytesForEvent(event);
+
+   pendingBytes_ += bytes;
+   push(pNode);
+
+   // drop the oldest console output if the client isn't keeping up with
+   // it (we never block the producer, which is usually the R thread)
+   if (consoleText && pendingBytes_ > maxPendingBytes_)
+      trimPendingOutput();
+
+   lastEventAddTime_ = nowMicroseconds();
+
+   // notify listeners that an event has been added. we only take the
+   // lock if someone is actually waiting (the waiter registers itself
+   // before sampling addCount_ so we can't miss it)
+   ++addCount_;
+   if (eventWaiters_ > 0)
+   {
+      LOCK_MUTEX(*pMutex_)
       {
-         // flush existing console output prior to adding an 
-         // action of another type
-         flushPendingConsoleOutput() ;
-         
-         // add event to queue
-         pendingEvents_.push_back(event) ;
+         pWaitForEventCondition_->notify_all();
       }
-      
-      lastEventAddTime_ = boost::posix_time::microsec_clock::universal_time();
+      END_LOCK_MUTEX
    }
-   END_LOCK_MUTEX
-   
-   // notify listeners that an event has been added
-   pWaitForEventCondition_->notify_all();
 }
    
 bool ClientEventQueue::hasEvents() 
 {
-   LOCK_MUTEX(*pMutex_)
-   {
-      return pendingEvents_.size() > 0 || pendingConsoleOutput_.length() > 0;
-   }
-   END_LOCK_MUTEX
-   
-   // keep compiler happy
-   return false ;
+   return pHead_.load() != NULL;
 }
   
 void ClientEventQueue::remove(std::vector<ClientEvent>* pEvents)
 {
+   // take all of the pending events (they come off the stack most recent
+   // first so reverse them into the order they were added)
+   Node* pHead = NULL;
+   LOCK_MUTEX(*pTakeMutex_)
+   {
+      pHead = takeAll();
+   }
+   END_LOCK_MUTEX
+
+   std::vector<Node*> nodes;
+   for (Node* pNode = pHead; pNode != NULL; pNode = pNode->pNext)
+      nodes.push_back(pNode);
+   std::reverse(nodes.begin(), nodes.end());
+
+   std::set<int> coalesceEvents;
    LOCK_MUTEX(*pMutex_)
    {
-      // flush any pending output
-      flushPendingConsoleOutput();
-      
-      // copy the events to the caller
-      pEvents->insert(pEvents->begin(), 
-                      pendingEvents_.begin(), 
-                      pendingEvents_.end());
-   
-      // clear pending events
-      pendingEvents_.clear();
-   } 
+      coalesceEvents = coalesceEvents_;
+   }
    END_LOCK_MUTEX
+
+   // for coalesced types only the last instance is delivered
+   std::map<int, std::size_t> lastIndexOfType;
+   for (std::size_t i = 0; i < nodes.size(); i++)
+   {
+      int type = nodes[i]->event.type();
+      if (coalesceEvents.count(type))
+         lastIndexOfType[type] = i;
+   }
+
+   pEvents->reserve(pEvents->size() + nodes.size());
+
+   std::string pendingConsoleOutput;
+   boost::shared_ptr<const std::string> pPendingConsole;
+   std::size_t bytes = 0;
+   for (std::size_t i = 0; i < nodes.size(); i++)
+   {
+      const ClientEvent& event = nodes[i]->event;
+      int type = event.type();
+      bytes += pendingBytesForEvent(event);
+
+      // consecutive console output for the same console is batched up
+      if (type == client_events::kConsoleWriteOutput)
+      {
+         if (!pendingConsoleOutput.empty() &&
+             *pPendingConsole != *nodes[i]->pConsole)
+         {
+            enqueueClientOutputEvent(type, pendingConsoleOutput,
+                                     *pPendingConsole, pEvents);
+            pendingConsoleOutput.clear();
+         }
+
+         pendingConsoleOutput += event.data().get_str();
+         pPendingConsole = nodes[i]->pConsole;
+         continue;
+      }
+
+      // flush existing console output prior to adding an event of
+      // another type
+      if (!pendingConsoleOutput.empty())
+      {
+         enqueueClientOutputEvent(client_events::kConsoleWriteOutput,
+                                  pendingConsoleOutput,
+                                  *pPendingConsole,
+                                  pEvents);
+         pendingConsoleOutput.clear();
+      }
+
+      if (type == client_events::kConsoleWriteError && nodes[i]->pConsole)
+      {
+         enqueueClientOutputEvent(type, event.data().get_str(),
+                                  *nodes[i]->pConsole, pEvents);
+      }
+      else
+      {
+         std::map<int, std::size_t>::const_iterator it =
+                                                lastIndexOfType.find(type);
+         if (it == lastIndexOfType.end() || it->second == i)
+            pEvents->push_back(event);
+      }
+   }
+
+   if (!pendingConsoleOutput.empty())
+   {
+      enqueueClientOutputEvent(client_events::kConsoleWriteOutput,
+                               pendingConsoleOutput,
+                               *pPendingConsole,
+                               pEvents);
+   }
+
+   std::for_each(nodes.begin(), nodes.end(), boost::checked_deleter<Node>());
+
+   pendingBytes_ -= bytes;
 }
    
 void ClientEventQueue::clear()
 {
-   LOCK_MUTEX(*pMutex_)
+   std::size_t bytes = 0;
+   Node* pNode = NULL;
+   LOCK_MUTEX(*pTakeMutex_)
    {
-      pendingConsoleOutput_.clear();
-      pendingEvents_.clear();
+      pNode = takeAll();
    }
    END_LOCK_MUTEX
+   for (Node* pCurrent = pNode; pCurrent != NULL; pCurrent = pCurrent->pNext)
+      bytes += pendingBytesForEvent(pCurrent->event);
+   deleteNodes(pNode);
+   pendingBytes_ -= bytes;
 }
   
    
@@ -155,8 +314,14 @@ bool ClientEventQueue::waitForEvent(
    try
    {
       unique_lock<mutex> lock(*pMutex_);
+      ++eventWaiters_;
+      unsigned long addCount = addCount_;
       system_time timeoutTime = get_system_time() + waitDuration;
-      return pWaitForEventCondition_->timed_wait(lock, timeoutTime);
+      bool added = true;
+      while (addCount == addCount_ && added)
+         added = pWaitForEventCondition_->timed_wait(lock, timeoutTime);
+      --eventWaiters_;
+      return addCount != addCount_;
    }
    catch(const thread_resource_error& e) 
    { 
@@ -170,45 +335,147 @@ bool ClientEventQueue::waitForEvent(
 
 bool ClientEventQueue::eventAddedSince(const boost::posix_time::ptime& time)
 {
-   LOCK_MUTEX(*pMutex_)
+   long long lastEventAddTime = lastEventAddTime_;
+   if (lastEventAddTime == 0)
+      return false;
+   else
+      return timeFromMicroseconds(lastEventAddTime) >= time;
+}
+
+void ClientEventQueue::push(Node* pNode)
+{
+   pNode->pNext = pHead_.load(std::memory_order_relaxed);
+   while (!pHead_.compare_exchange_weak(pNode->pNext,
+                                        pNode,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed))
    {
-      if (lastEventAddTime_.is_not_a_date_time())
-         return false;
-      else
-         return lastEventAddTime_ >= time;
    }
-   END_LOCK_MUTEX
-   
-   // keep compiler happy
-   return false;
 }
-   
 
-void ClientEventQueue::flushPendingConsoleOutput()
+ClientEventQueue::Node* ClientEventQueue::takeAll()
 {
-   // NOTE: private helper so no lock required (mutex is not recursive) 
-   
-   if ( !pendingConsoleOutput_.empty() )
+   // NOTE: the consumer always takes the entire stack so there is no
+   // ABA hazard here
+   return pHead_.exchange(NULL, std::memory_order_acquire);
+}
+
+void ClientEventQueue::trimPendingOutput()
+{
+   // if the stack is already being taken (by the consumer or another
+   // producer trimming it) then there is nothing for us to do
+   boost::unique_lock<boost::mutex> lock(*pTakeMutex_, boost::try_to_lock);
+   if (!lock.owns_lock())
+      return;
+
+   // keep the most recent console output (up to half of the budget so we
+   // don't trim again on every subsequent add) and drop everything older.
+   // a notice of how much was dropped takes the place of the newest output
+   // dropped so the client sees it at the gap
+   std::size_t keepBytes = maxPendingBytes_ / 2;
+   std::size_t keptBytes = 0;
+   std::size_t droppedBytes = 0;
+   std::size_t freedBytes = 0;
+   Node* pGap = NULL;
+   Node* pKept = NULL;
+   Node** ppKeptTail = &pKept;
+   Node* pNode = takeAll();
+   while (pNode != NULL)
    {
-      // If there's more console output than the client can even show, then
-      // truncate it to the amount that the client can show. Too much output
-      // can overwhelm the client, causing it to become unresponsive.
-      int limit = r::session::consoleActions().capacity() + 1;
-      string_utils::trimLeadingLines(limit, &pendingConsoleOutput_);
+      Node* pNext = pNode->pNext;
+      pNode->pNext = NULL;
+
+      std::size_t bytes = pendingBytesForEvent(pNode->event);
+      bool drop = pGap != NULL ||
+                  (keptBytes > 0 && keptBytes + bytes > keepBytes);
+      if (bytes > 0 && drop)
+      {
+         // notices from earlier trims are folded into the new one
+         droppedBytes += pNode->droppedBytes > 0 ? pNode->droppedBytes : bytes;
+         freedBytes += bytes;
+         if (pGap == NULL)
+         {
+            pGap = pNode;
+            *ppKeptTail = pNode;
+            ppKeptTail = &pNode->pNext;
+         }
+         else
+         {
+            delete pNode;
+         }
+      }
+      else
+      {
+         keptBytes += bytes;
+         *ppKeptTail = pNode;
+         ppKeptTail = &pNode->pNext;
+      }
+
+      pNode = pNext;
+   }
+
+   if (pGap != NULL)
+   {
+      std::string notice = "\n[" + safe_convert::numberToString(droppedBytes) +
+                           " bytes of output were dropped since the client "
+                           "couldn't keep up]\n";
+      pGap->event = ClientEvent(client_events::kConsoleWriteError, notice);
+      pGap->droppedBytes = droppedBytes;
+      pendingBytes_ += notice.size();
+      pendingBytes_ -= freedBytes;
+   }
+
+   // put the kept events back beneath any added while we were trimming
+   // (nobody else can take the stack while we hold the lock so whatever
+   // was added is still there if the exchange fails)
+   while (pKept != NULL)
+   {
+      Node* pExpected = NULL;
+      if (pHead_.compare_exchange_strong(pExpected, pKept))
+         break;
+
+      Node* pAdded = takeAll();
+      Node* pTail = pAdded;
+      while (pTail->pNext != NULL)
+         pTail = pTail->pNext;
+      pTail->pNext = pKept;
+      pKept = pAdded;
+   }
+}
 
-      enqueueClientOutputEvent(client_events::kConsoleWriteOutput, 
-            pendingConsoleOutput_);
-      pendingConsoleOutput_.clear() ;
+void ClientEventQueue::deleteNodes(Node* pNode)
+{
+   while (pNode != NULL)
+   {
+      Node* pNext = pNode->pNext;
+      delete pNode;
+      pNode = pNext;
    }
 }
 
 void ClientEventQueue::enqueueClientOutputEvent(
-      int event, const std::string& text)
+      int event,
+      const std::string& text,
+      const std::string& console,
+      std::vector<ClientEvent>* pEvents)
 {
    json::Object output;
-   output[kConsoleText] = text;
-   output[kConsoleId]   = activeConsole_;
-   pendingEvents_.push_back(ClientEvent(event, output)); 
+   if (event == client_events::kConsoleWriteOutput)
+   {
+      // If there's more console output than the client can even show, then
+      // truncate it to the amount that the client can show. Too much output
+      // can overwhelm the client, causing it to become unresponsive.
+      std::string consoleOutput = text;
+      int limit = r::session::consoleActions().capacity() + 1;
+      string_utils::trimLeadingLines(limit, &consoleOutput);
+      output[kConsoleText] = consoleOutput;
+   }
+   else
+   {
+      output[kConsoleText] = text;
+   }
+   output[kConsoleId]   = console;
+   pEvents->push_back(ClientEvent(event, output));
 }
 
 } // namespace session
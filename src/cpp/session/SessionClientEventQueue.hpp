@@ -16,11 +16,14 @@
 #ifndef SESSION_SESSION_CLIENT_EVENT_QUEUE_HPP
 #define SESSION_SESSION_CLIENT_EVENT_QUEUE_HPP
 
+#include <set>
 #include <string>
 #include <vector>
+#include <atomic>
 
 #include <boost/function.hpp>
 #include <boost/utility.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <core/BoostThread.hpp>
@@ -37,12 +40,25 @@ void initializeClientEventQueue();
 class ClientEventQueue;
 ClientEventQueue& clientEventQueue();
 
+namespace tests {
+class ClientEventQueueTester;
+} // namespace tests
+
+// multi-producer/single-consumer queue of events destined for the client.
+// producers (the R thread and assorted background threads) push events
+// onto a lock-free stack; the consumer (the event service thread) takes
+// the whole stack at once in remove and performs console output batching
+// and coalescing of superseded events at that time
 class ClientEventQueue : boost::noncopyable
 {   
 private:
    ClientEventQueue() ;
    friend void initializeClientEventQueue();
-   
+   friend class tests::ClientEventQueueTester;
+
+public:
+   virtual ~ClientEventQueue();
+
 public:
    // COPYING: boost::noncopyable
      
@@ -67,28 +83,66 @@ public:
    // set the active console to be attached to console events; returns true if
    // the active console changed
    bool setActiveConsole(const std::string& console);
+
+   // events of the specified type supersede any pending events of the same
+   // type (only the most recently added one is delivered to the client)
+   void setCoalesceEvents(int type, bool coalesce = true);
+
+   // maximum bytes of console output pending delivery. once exceeded, the
+   // oldest pending output is dropped and replaced by a notice telling the
+   // client how much was dropped
+   void setMaxPendingBytes(std::size_t maxPendingBytes);
       
 private:   
-   void flushPendingConsoleOutput();
+   struct Node
+   {
+      Node(const ClientEvent& event)
+         : event(event), droppedBytes(0), pNext(NULL)
+      {
+      }
+      ClientEvent event;
+      boost::shared_ptr<const std::string> pConsole;
+      std::size_t droppedBytes; // non-zero for dropped output notices
+      Node* pNext;
+   };
+
+   void push(Node* pNode);
+   Node* takeAll();
+   void trimPendingOutput();
+   void deleteNodes(Node* pNode);
 
-   void enqueueClientOutputEvent(int event, const std::string& text);
+   void enqueueClientOutputEvent(int event,
+                                 const std::string& text,
+                                 const std::string& console,
+                                 std::vector<ClientEvent>* pEvents);
  
 private:
-   // synchronization objects. heap based so they are never destructed
-   // we don't want them destructed because in desktop mode we don't
-   // explicitly stop the queue and this sometimes results in mutex
-   // destroy assertions if someone is waiting on the queue while
-   // it is being destroyed
+   // pending events (most recently added first)
+   std::atomic<Node*> pHead_;
+
+   // synchronization objects (used only for waiting). heap based so they
+   // are never destructed: we don't want them destructed because in
+   // desktop mode we don't explicitly stop the queue and this sometimes
+   // results in mutex destroy assertions if someone is waiting on the
+   // queue while it is being destroyed
    boost::mutex* pMutex_ ;
    boost::condition* pWaitForEventCondition_ ;
 
+   // held by whoever takes the stack (the consumer or a producer trimming
+   // pending output) so that trimmed events are put back before the
+   // consumer can see anything added after them
+   boost::mutex* pTakeMutex_ ;
+   std::atomic<int> eventWaiters_;
+   std::atomic<unsigned long> addCount_;
+
    // instance data
-   std::string pendingConsoleOutput_ ;
-   std::string activeConsole_;
-   std::vector<ClientEvent> pendingEvents_ ; 
-   boost::posix_time::ptime lastEventAddTime_;
-   
+   boost::shared_ptr<const std::string> pActiveConsole_;
+   std::atomic<long long> lastEventAddTime_;
+   std::atomic<std::size_t> pendingBytes_;
+   std::atomic<std::size_t> maxPendingBytes_;
 
+   // coalesced event types (guarded by pMutex_, read by the consumer)
+   std::set<int> coalesceEvents_;
 };
 
 } // namespace session
@@ -0,0 +1,224 @@
+/*
+ * SessionClientEventQueueTests.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionClientEventQueue.hpp"
+
+#include "modules/SessionConsole.hpp"
+
+#include <iostream>
+
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <core/Thread.hpp>
+#include <core/BoostThread.hpp>
+
+#include <session/SessionClientEvent.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace tests {
+
+using namespace rstudio::core;
+
+// queues are otherwise only created by initializeClientEventQueue
+class ClientEventQueueTester
+{
+public:
+   static ClientEventQueue* create()
+   {
+      return new ClientEventQueue();
+   }
+};
+
+namespace {
+
+void addEvents(ClientEventQueue* pQueue, int count)
+{
+   for (int i = 0; i < count; i++)
+      pQueue->add(ClientEvent(client_events::kBusy, true));
+}
+
+json::Value eventField(const ClientEvent& event, const std::string& name)
+{
+   json::Object object = event.data().get_obj();
+   return object[name];
+}
+
+} // anonymous namespace
+
+TEST_CASE("Client event queue")
+{
+   SECTION("Events are removed in the order they were added")
+   {
+      boost::scoped_ptr<ClientEventQueue> pQueue(
+                                    ClientEventQueueTester::create());
+      pQueue->add(ClientEvent(client_events::kBusy, true));
+      pQueue->add(ClientEvent(client_events::kBusy, false));
+      CHECK(pQueue->hasEvents());
+
+      std::vector<ClientEvent> events;
+      pQueue->remove(&events);
+      REQUIRE(events.size() == 2);
+      CHECK(eventField(events[0], "value").get_bool());
+      CHECK_FALSE(eventField(events[1], "value").get_bool());
+      CHECK_FALSE(pQueue->hasEvents());
+   }
+
+   SECTION("Superseded events are coalesced")
+   {
+      boost::scoped_ptr<ClientEventQueue> pQueue(
+                                    ClientEventQueueTester::create());
+      pQueue->add(ClientEvent(client_events::kPlotsStateChanged, "first"));
+      pQueue->add(ClientEvent(client_events::kBusy, true));
+      pQueue->add(ClientEvent(client_events::kPlotsStateChanged, "second"));
+
+      std::vector<ClientEvent> events;
+      pQueue->remove(&events);
+      REQUIRE(events.size() == 2);
+      CHECK(events[0].type() == client_events::kBusy);
+      CHECK(events[1].type() == client_events::kPlotsStateChanged);
+      CHECK(events[1].data().get_str() == "second");
+   }
+
+   SECTION("Coalescing can be disabled for an event type")
+   {
+      boost::scoped_ptr<ClientEventQueue> pQueue(
+                                    ClientEventQueueTester::create());
+      pQueue->setCoalesceEvents(client_events::kPlotsStateChanged, false);
+      pQueue->add(ClientEvent(client_events::kPlotsStateChanged, "first"));
+      pQueue->add(ClientEvent(client_events::kPlotsStateChanged, "second"));
+
+      std::vector<ClientEvent> events;
+      pQueue->remove(&events);
+      CHECK(events.size() == 2);
+   }
+
+   SECTION("Consecutive console output is batched")
+   {
+      boost::scoped_ptr<ClientEventQueue> pQueue(
+                                    ClientEventQueueTester::create());
+      pQueue->add(ClientEvent(client_events::kConsoleWriteOutput, "a"));
+      pQueue->add(ClientEvent(client_events::kConsoleWriteOutput, "b"));
+      pQueue->add(ClientEvent(client_events::kConsoleWriteError, "c"));
+      pQueue->add(ClientEvent(client_events::kConsoleWriteOutput, "d"));
+
+      std::vector<ClientEvent> events;
+      pQueue->remove(&events);
+      REQUIRE(events.size() == 3);
+      CHECK(eventField(events[0], kConsoleText).get_str() == "ab");
+      CHECK(events[1].type() == client_events::kConsoleWriteError);
+      CHECK(eventField(events[2], kConsoleText).get_str() == "d");
+   }
+
+   SECTION("Console output is attributed to the console active when added")
+   {
+      boost::scoped_ptr<ClientEventQueue> pQueue(
+                                    ClientEventQueueTester::create());
+      pQueue->setActiveConsole("one");
+      pQueue->add(ClientEvent(client_events::kConsoleWriteOutput, "a"));
+      pQueue->setActiveConsole("two");
+      pQueue->add(ClientEvent(client_events::kConsoleWriteOutput, "b"));
+
+      std::vector<ClientEvent> events;
+      pQueue->remove(&events);
+      REQUIRE(events.size() == 2);
+      CHECK(eventField(events[0], kConsoleId).get_str() == "one");
+      CHECK(eventField(events[1], kConsoleId).get_str() == "two");
+   }
+
+   SECTION("The oldest console output beyond the pending limit is dropped")
+   {
+      boost::scoped_ptr<ClientEventQueue> pQueue(
+                                    ClientEventQueueTester::create());
+      pQueue->setMaxPendingBytes(8);
+      pQueue->add(ClientEvent(client_events::kConsoleWriteOutput, "abc"));
+      pQueue->add(ClientEvent(client_events::kBusy, true));
+      pQueue->add(ClientEvent(client_events::kConsoleWriteOutput, "de"));
+      pQueue->add(ClientEvent(client_events::kConsoleWriteOutput, "fgh"));
+      pQueue->add(ClientEvent(client_events::kConsoleWriteOutput, "ij"));
+
+      // the most recent output is kept and the notice is at the gap
+      std::vector<ClientEvent> events;
+      pQueue->remove(&events);
+      REQUIRE(events.size() == 3);
+      CHECK(events[0].type() == client_events::kBusy);
+      CHECK(events[1].type() == client_events::kConsoleWriteError);
+      CHECK(eventField(events[1], kConsoleText).get_str().find("[8 bytes") !=
+                                                            std::string::npos);
+      CHECK(eventField(events[2], kConsoleText).get_str() == "ij");
+
+      // output is accepted again once the client has caught up
+      events.clear();
+      pQueue->add(ClientEvent(client_events::kConsoleWriteOutput, "klm"));
+      pQueue->remove(&events);
+      REQUIRE(events.size() == 1);
+      CHECK(eventField(events[0], kConsoleText).get_str() == "klm");
+   }
+}
+
+// not run by default (select it with [benchmark])
+TEST_CASE("Client event queue throughput", "[.][benchmark]")
+{
+   const int kProducers = 4;
+   const int kEventsPerProducer = 100000;
+
+   boost::scoped_ptr<ClientEventQueue> pQueue(
+                                 ClientEventQueueTester::create());
+   boost::posix_time::ptime start =
+                  boost::posix_time::microsec_clock::universal_time();
+
+   std::vector<boost::shared_ptr<boost::thread> > producers;
+   for (int i = 0; i < kProducers; i++)
+   {
+      boost::shared_ptr<boost::thread> pThread(new boost::thread());
+      core::thread::safeLaunchThread(
+               boost::bind(addEvents, pQueue.get(), kEventsPerProducer),
+               pThread.get());
+      producers.push_back(pThread);
+   }
+
+   std::size_t received = 0;
+   std::vector<ClientEvent> events;
+   while (received < kProducers * kEventsPerProducer)
+   {
+      pQueue->waitForEvent(boost::posix_time::milliseconds(10));
+      events.clear();
+      pQueue->remove(&events);
+      received += events.size();
+   }
+   for (std::size_t i = 0; i < producers.size(); i++)
+      producers[i]->join();
+
+   boost::posix_time::time_duration elapsed =
+         boost::posix_time::microsec_clock::universal_time() - start;
+   double seconds = std::max(
+         static_cast<double>(elapsed.total_microseconds()), 1.0) / 1000000.0;
+   std::cerr << "ClientEventQueue: "
+             << static_cast<long>(received / seconds)
+             << " events/sec" << std::endl;
+
+   CHECK(received ==
+         static_cast<std::size_t>(kProducers * kEventsPerProducer));
+}
+
+} // namespace tests
+} // namespace session
+} // namespace rstudio
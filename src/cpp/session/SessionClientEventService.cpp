@@ -339,7 +339,10 @@ void ClientEventService::run()
             json::JsonRpcResponse response;
             setClientEventResult(&response);
             response.setField(kEventsPending, "false");
-            ptrConnection->sendJsonRpcResponse(response);
+            if (session::options().streamEvents())
+               ptrConnection->sendStreamedJsonRpcResponse(response);
+            else
+               ptrConnection->sendJsonRpcResponse(response);
          }
          else
          {
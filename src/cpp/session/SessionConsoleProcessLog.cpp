@@ -0,0 +1,417 @@
+/*
+ * SessionConsoleProcessLog.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionConsoleProcessLog.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include <boost/foreach.hpp>
+
+#include <core/Error.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Log.hpp>
+#include <core/SafeConvert.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace console_process {
+namespace console_persist {
+
+namespace {
+
+// records the segment (and offset within it) where the log starts
+const char * const kStartFile = "start";
+
+std::size_t countNewlines(const std::string& str)
+{
+   return std::count(str.begin(), str.end(), '\n');
+}
+
+Error segmentMismatchError(const FilePath& segmentPath,
+                           const ErrorLocation& location)
+{
+   Error error = systemError(boost::system::errc::io_error, location);
+   error.addProperty("description", "Terminal buffer segment changed unexpectedly");
+   error.addProperty("path", segmentPath.absolutePath());
+   return error;
+}
+
+} // anonymous namespace
+
+ConsoleProcessLog::ConsoleProcessLog(const FilePath& logDir,
+                                     std::size_t segmentSize)
+   : logDir_(logDir),
+     segmentSize_(segmentSize),
+     loaded_(false),
+     totalSize_(0),
+     totalNewlines_(0),
+     startOffset_(0),
+     startNewlines_(0)
+{
+}
+
+Error ConsoleProcessLog::append(const std::string& output)
+{
+   Error error = load();
+   if (error)
+      return error;
+
+   if (output.empty())
+      return Success();
+
+   // start a new segment if the last one is full
+   if (segments_.empty() || segments_.back().size >= segmentSize_)
+   {
+      error = logDir_.ensureDirectory();
+      if (error)
+         return error;
+
+      Segment segment;
+      segment.number = segments_.empty() ? 0 : segments_.back().number + 1;
+      segment.size = 0;
+      segment.newlines = 0;
+      segments_.push_back(segment);
+   }
+
+   Segment& segment = segments_.back();
+   error = appendToFile(segmentPath(segment.number), output);
+   if (error)
+      return error;
+
+   std::size_t newlines = countNewlines(output);
+   segment.size += output.size();
+   segment.newlines += newlines;
+   totalSize_ += output.size();
+   totalNewlines_ += newlines;
+   return Success();
+}
+
+Error ConsoleProcessLog::read(std::string* pOutput)
+{
+   pOutput->clear();
+
+   Error error = load();
+   if (error)
+      return error;
+
+   pOutput->reserve(size());
+   for (std::size_t i = 0; i < segments_.size(); i++)
+   {
+      std::string contents;
+      error = readStringFromFile(segmentPath(segments_[i].number), &contents);
+      if (error)
+         return error;
+
+      std::size_t offset = (i == 0) ? startOffset_ : 0;
+      if (offset < contents.size())
+         pOutput->append(contents, offset, std::string::npos);
+   }
+
+   return Success();
+}
+
+Error ConsoleProcessLog::trimLeadingLines(int maxLines)
+{
+   Error error = load();
+   if (error)
+      return error;
+
+   std::size_t lines = static_cast<std::size_t>(std::max(maxLines, 0));
+   if (size() <= lines * 2 || newlineCount() <= lines)
+      return Success();
+
+   // the log will start at this newline (counting from the current start);
+   // find the segment it is in
+   std::size_t target = newlineCount() - lines;
+   std::size_t preceding = 0;
+   std::size_t index = 0;
+   for (; index < segments_.size(); index++)
+   {
+      std::size_t newlines = segments_[index].newlines;
+      if (index == 0)
+         newlines -= startNewlines_;
+
+      if (preceding + newlines >= target)
+         break;
+      preceding += newlines;
+   }
+
+   if (index == segments_.size())
+      return Success();
+
+   // find the newline's offset within the segment
+   const Segment& segment = segments_[index];
+   std::string contents;
+   error = readStringFromFile(segmentPath(segment.number), &contents);
+   if (error)
+      return error;
+
+   std::size_t newlinesBefore = (index == 0) ? startNewlines_ : 0;
+   std::size_t pos = (index == 0) ? startOffset_ : 0;
+   for (std::size_t remaining = target - preceding; ; remaining--)
+   {
+      pos = contents.find('\n', pos);
+      if (pos == std::string::npos)
+      {
+         loaded_ = false;
+         return segmentMismatchError(segmentPath(segment.number), ERROR_LOCATION);
+      }
+
+      if (remaining == 1)
+         break;
+
+      newlinesBefore++;
+      pos++;
+   }
+
+   // record the new start before dropping the segments preceding it (so
+   // that if we're interrupted they're skipped when the log is loaded)
+   error = writeStart(segment.number, pos);
+   if (error)
+      return error;
+
+   startOffset_ = pos;
+   startNewlines_ = newlinesBefore;
+   return removeSegmentsBefore(index);
+}
+
+Error ConsoleProcessLog::removeLastLine()
+{
+   Error error = load();
+   if (error)
+      return error;
+
+   // find the last segment containing a newline
+   std::size_t index = segments_.size();
+   bool found = false;
+   while (index > 0 && !found)
+   {
+      --index;
+      std::size_t newlines = segments_[index].newlines;
+      if (index == 0)
+         newlines -= startNewlines_;
+      found = newlines > 0;
+   }
+
+   // no complete line in buffer, just blow it away
+   if (!found)
+      return remove();
+
+   // erase everything after the final newline
+   Segment& segment = segments_[index];
+   FilePath path = segmentPath(segment.number);
+   std::string contents;
+   error = readStringFromFile(path, &contents);
+   if (error)
+      return error;
+
+   std::size_t lastNewline = contents.find_last_of('\n');
+   if (lastNewline == std::string::npos)
+   {
+      loaded_ = false;
+      return segmentMismatchError(path, ERROR_LOCATION);
+   }
+
+   contents.erase(lastNewline + 1);
+   error = writeStringToFile(path, contents);
+   if (error)
+      return error;
+
+   totalSize_ -= segment.size - contents.size();
+   segment.size = contents.size();
+
+   // along with any segments following it
+   while (segments_.size() > index + 1)
+   {
+      const Segment& last = segments_.back();
+      error = segmentPath(last.number).removeIfExists();
+      if (error)
+      {
+         loaded_ = false;
+         return error;
+      }
+
+      totalSize_ -= last.size;
+      totalNewlines_ -= last.newlines;
+      segments_.pop_back();
+   }
+
+   return Success();
+}
+
+Error ConsoleProcessLog::remove()
+{
+   segments_.clear();
+   totalSize_ = 0;
+   totalNewlines_ = 0;
+   startOffset_ = 0;
+   startNewlines_ = 0;
+   loaded_ = true;
+
+   return logDir_.removeIfExists();
+}
+
+std::size_t ConsoleProcessLog::size()
+{
+   Error error = load();
+   if (error)
+      LOG_ERROR(error);
+
+   return totalSize_ - startOffset_;
+}
+
+std::size_t ConsoleProcessLog::newlineCount()
+{
+   Error error = load();
+   if (error)
+      LOG_ERROR(error);
+
+   return totalNewlines_ - startNewlines_;
+}
+
+Error ConsoleProcessLog::load()
+{
+   if (loaded_)
+      return Success();
+
+   segments_.clear();
+   totalSize_ = 0;
+   totalNewlines_ = 0;
+   startOffset_ = 0;
+   startNewlines_ = 0;
+
+   if (!logDir_.exists())
+   {
+      loaded_ = true;
+      return Success();
+   }
+
+   // read where the log starts (if it has been trimmed)
+   int startSegment = 0;
+   std::size_t startOffset = 0;
+   FilePath startPath = logDir_.complete(kStartFile);
+   if (startPath.exists())
+   {
+      std::string start;
+      Error error = readStringFromFile(startPath, &start);
+      if (error)
+         return error;
+
+      std::istringstream istr(start);
+      istr >> startSegment >> startOffset;
+      if (istr.fail())
+      {
+         startSegment = 0;
+         startOffset = 0;
+      }
+   }
+
+   std::vector<FilePath> children;
+   Error error = logDir_.children(&children);
+   if (error)
+      return error;
+
+   std::vector<int> numbers;
+   BOOST_FOREACH(const FilePath& child, children)
+   {
+      int number = safe_convert::stringTo<int>(child.filename(), -1);
+      if (number < 0)
+         continue;
+
+      // segments preceding the start remain if we were interrupted while
+      // trimming the log
+      if (number < startSegment)
+      {
+         error = child.removeIfExists();
+         if (error)
+            LOG_ERROR(error);
+         continue;
+      }
+
+      numbers.push_back(number);
+   }
+   std::sort(numbers.begin(), numbers.end());
+
+   BOOST_FOREACH(int number, numbers)
+   {
+      std::string contents;
+      error = readStringFromFile(segmentPath(number), &contents);
+      if (error)
+         return error;
+
+      if (segments_.empty() &&
+          number == startSegment &&
+          startOffset <= contents.size())
+      {
+         startOffset_ = startOffset;
+         startNewlines_ = std::count(contents.begin(),
+                                     contents.begin() + startOffset,
+                                     '\n');
+      }
+
+      Segment segment;
+      segment.number = number;
+      segment.size = contents.size();
+      segment.newlines = countNewlines(contents);
+      segments_.push_back(segment);
+
+      totalSize_ += segment.size;
+      totalNewlines_ += segment.newlines;
+   }
+
+   loaded_ = true;
+   return Success();
+}
+
+FilePath ConsoleProcessLog::segmentPath(int number) const
+{
+   return logDir_.complete(safe_convert::numberToString(number));
+}
+
+Error ConsoleProcessLog::writeStart(int segment, std::size_t offset) const
+{
+   std::ostringstream ostr;
+   ostr << segment << " " << offset;
+   return writeStringToFile(logDir_.complete(kStartFile), ostr.str());
+}
+
+Error ConsoleProcessLog::removeSegmentsBefore(std::size_t index)
+{
+   for (; index > 0; index--)
+   {
+      const Segment& first = segments_.front();
+      Error error = segmentPath(first.number).removeIfExists();
+      if (error)
+      {
+         loaded_ = false;
+         return error;
+      }
+
+      totalSize_ -= first.size;
+      totalNewlines_ -= first.newlines;
+      segments_.pop_front();
+   }
+
+   return Success();
+}
+
+} // namespace console_persist
+} // namespace console_process
+} // namespace session
+} // namespace rstudio
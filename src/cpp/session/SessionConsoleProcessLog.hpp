@@ -0,0 +1,99 @@
+/*
+ * SessionConsoleProcessLog.hpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_CONSOLE_PROCESS_LOG_HPP
+#define SESSION_CONSOLE_PROCESS_LOG_HPP
+
+#include <deque>
+#include <string>
+
+#include <boost/utility.hpp>
+
+#include <core/FilePath.hpp>
+
+namespace rstudio {
+namespace core {
+   class Error;
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace console_process {
+namespace console_persist {
+
+// Saved terminal output, stored in a directory as a series of numbered
+// segment files. Output is appended to the last segment (a new one is
+// started once it reaches the segment size), and the number of lines in
+// each segment is tracked so that the log can be trimmed to its last lines
+// by dropping whole segments and recording where the log starts within
+// the first remaining one, rather than rewriting it.
+class ConsoleProcessLog : boost::noncopyable
+{
+public:
+   explicit ConsoleProcessLog(const core::FilePath& logDir,
+                              std::size_t segmentSize = 64 * 1024);
+
+   core::Error append(const std::string& output);
+
+   // read the entire log
+   core::Error read(std::string* pOutput);
+
+   // Trim the log to its last maxLines lines (and the newline preceding
+   // them), in the same way string_utils::trimLeadingLines trims a string
+   core::Error trimLeadingLines(int maxLines);
+
+   // Remove everything after the final newline (removing the log entirely
+   // if it contains no newlines)
+   core::Error removeLastLine();
+
+   core::Error remove();
+
+   std::size_t size();
+   std::size_t newlineCount();
+
+private:
+   struct Segment
+   {
+      int number;
+      std::size_t size;
+      std::size_t newlines;
+   };
+
+   core::Error load();
+   core::FilePath segmentPath(int number) const;
+   core::Error writeStart(int segment, std::size_t offset) const;
+   core::Error removeSegmentsBefore(std::size_t index);
+
+   core::FilePath logDir_;
+   std::size_t segmentSize_;
+   bool loaded_;
+
+   std::deque<Segment> segments_;
+   std::size_t totalSize_;
+   std::size_t totalNewlines_;
+
+   // the log starts this far into the first segment (the output preceding
+   // it has been trimmed)
+   std::size_t startOffset_;
+   std::size_t startNewlines_;
+};
+
+} // namespace console_persist
+} // namespace console_process
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_CONSOLE_PROCESS_LOG_HPP
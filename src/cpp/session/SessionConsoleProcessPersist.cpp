@@ -15,13 +15,19 @@
 
 #include <session/SessionConsoleProcessPersist.hpp>
 
+#include <map>
+
 #include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <core/FileSerializer.hpp>
 
 #include <session/SessionModuleContext.hpp>
 #include <session/SessionOptions.hpp>
 
+#include "SessionConsoleProcessLog.hpp"
+
 using namespace rstudio::core;
 
 namespace rstudio {
@@ -50,7 +56,10 @@ namespace console_persist {
 //                Added autoClose, zombie
 // 2017/06/16 - console05 -> console06
 //                Added trackEnv
-#define kConsoleDir "console06"
+// 2026/10/17 - console06 -> console07
+//                Saved buffers stored as segmented logs (a directory per
+//                terminal) rather than a single file
+#define kConsoleDir "console07"
 
 namespace {
 
@@ -58,6 +67,11 @@ FilePath s_consoleProcPath;
 FilePath s_consoleProcIndexPath;
 bool s_inited = false;
 const std::string s_envFileExt = ".env";
+const std::string s_logDirExt = ".log";
+
+// saved buffers, by handle (loaded on first use)
+typedef std::map<std::string, boost::shared_ptr<ConsoleProcessLog> > Logs;
+Logs s_logs;
 
 void initialize()
 {
@@ -95,7 +109,7 @@ const FilePath& getConsoleProcIndexPath()
    return s_consoleProcIndexPath;
 }
 
-Error getLogFilePath(const std::string& handle, FilePath* pFile)
+Error getLogDirPath(const std::string& handle, FilePath* pDir)
 {
    initialize();
    Error error = getConsoleProcPath().ensureDirectory();
@@ -104,10 +118,32 @@ Error getLogFilePath(const std::string& handle, FilePath* pFile)
       return error;
    }
 
-   *pFile = getConsoleProcPath().complete(handle);
+   std::string logHandle = handle;
+   logHandle.append(s_logDirExt);
+   *pDir = getConsoleProcPath().complete(logHandle);
    return Success();
 }
 
+boost::shared_ptr<ConsoleProcessLog> getLog(const std::string& handle)
+{
+   Logs::const_iterator it = s_logs.find(handle);
+   if (it != s_logs.end())
+      return it->second;
+
+   FilePath logDir;
+   Error error = getLogDirPath(handle, &logDir);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return boost::shared_ptr<ConsoleProcessLog>();
+   }
+
+   boost::shared_ptr<ConsoleProcessLog> pLog =
+         boost::make_shared<ConsoleProcessLog>(logDir);
+   s_logs[handle] = pLog;
+   return pLog;
+}
+
 Error getEnvFilePath(const std::string& handle, FilePath* pFile)
 {
    initialize();
@@ -157,62 +193,49 @@ void saveConsoleProcesses(const std::string& metadata)
 std::string getSavedBuffer(const std::string& handle, int maxLines)
 {
    std::string content;
-   FilePath log;
-
-   Error error = getLogFilePath(handle, &log);
-   if (error)
-   {
-      LOG_ERROR(error);
+   boost::shared_ptr<ConsoleProcessLog> pLog = getLog(handle);
+   if (!pLog)
       return content;
-   }
 
-   if (!log.exists())
+   // Trim the buffer based on maxLines. Otherwise it can grow without
+   // bound until the terminal is closed or cleared.
+   if (maxLines > 0)
    {
-      return "";
+      Error error = pLog->trimLeadingLines(maxLines);
+      if (error)
+         LOG_ERROR(error);
    }
 
-   error = core::readStringFromFile(log, &content);
+   Error error = pLog->read(&content);
    if (error)
-   {
       LOG_ERROR(error);
-      return content;
-   }
 
-   if (maxLines < 1)
-      return content;
+   return content;
+}
 
-   // Trim the buffer based on maxLines. Otherwise it can grow without
-   // bound until the terminal is closed or cleared.
-   std::string trimmedOutput = content;
-   if (string_utils::trimLeadingLines(maxLines, &trimmedOutput))
+int getSavedBufferLineCount(const std::string& handle, int maxLines)
+{
+   boost::shared_ptr<ConsoleProcessLog> pLog = getLog(handle);
+   if (!pLog)
+      return 1;
+
+   if (maxLines > 0)
    {
-      error = core::writeStringToFile(log, trimmedOutput);
+      Error error = pLog->trimLeadingLines(maxLines);
       if (error)
-      {
-          LOG_ERROR(error);
-          return content;
-      }
+         LOG_ERROR(error);
    }
-   return trimmedOutput;
-}
 
-int getSavedBufferLineCount(const std::string& handle, int maxLines)
-{
-   std::string buffer = getSavedBuffer(handle, maxLines);
-   return static_cast<int>(string_utils::countNewlines(buffer) + 1);
+   return static_cast<int>(pLog->newlineCount() + 1);
 }
 
 void appendToOutputBuffer(const std::string& handle, const std::string& buffer)
 {
-   FilePath log;
-   Error error = getLogFilePath(handle, &log);
-   if (error)
-   {
-      LOG_ERROR(error);
+   boost::shared_ptr<ConsoleProcessLog> pLog = getLog(handle);
+   if (!pLog)
       return;
-   }
 
-   error = rstudio::core::appendToFile(log, buffer);
+   Error error = pLog->append(buffer);
    if (error)
    {
       LOG_ERROR(error);
@@ -221,54 +244,14 @@ void appendToOutputBuffer(const std::string& handle, const std::string& buffer)
 
 void deleteLogFile(const std::string &handle, bool lastLineOnly)
 {
-   FilePath log;
-   Error error = getLogFilePath(handle, &log);
-   if (error)
-   {
-      LOG_ERROR(error);
-      return;
-   }
-
-   if (!log.exists())
+   boost::shared_ptr<ConsoleProcessLog> pLog = getLog(handle);
+   if (!pLog)
       return;
 
-   if (!lastLineOnly)
-   {
-      // blow away the file
-      error = log.removeIfExists();
-      if (error)
-      {
-         LOG_ERROR(error);
-         return;
-      }
-   }
-   else
+   Error error = lastLineOnly ? pLog->removeLastLine() : pLog->remove();
+   if (error)
    {
-      // read the file, remove last line and rewrite buffer
-      std::string content;
-      error = core::readStringFromFile(log, &content);
-      if (error)
-      {
-         LOG_ERROR(error);
-         return;
-      }
-
-      size_t lastNewline = content.find_last_of('\n');
-
-      // no complete line in buffer, just blow it away
-      if (lastNewline == std::string::npos)
-      {
-         deleteLogFile(handle, false);
-         return;
-      }
-
-      // erase everything after the final newline
-      content.erase(++lastNewline);
-      error = core::writeStringToFile(log, content);
-      if (error)
-      {
-          LOG_ERROR(error);
-      }
+      LOG_ERROR(error);
    }
 }
 
@@ -287,14 +270,19 @@ void deleteOrphanedLogs(bool (*validHandle)(const std::string&))
    }
    BOOST_FOREACH(const FilePath& child, children)
    {
-      // Don't erase the INDEXnnn or any subfolders
-      if (!child.filename().compare(kConsoleIndex) || child.isDirectory())
+      // Don't erase the INDEXnnn or any subfolders other than saved buffers
+      if (!child.filename().compare(kConsoleIndex) ||
+          (child.isDirectory() && child.extension() != s_logDirExt))
       {
          continue;
       }
 
-      if (!validHandle(child.stem()))
+      std::string handle = child.stem();
+      if (!validHandle(handle))
       {
+         if (child.isDirectory())
+            s_logs.erase(handle);
+
          error = child.remove();
          if (error)
             LOG_ERROR(error);
@@ -170,6 +170,32 @@ TEST_CASE("ConsoleProcess Persistence")
       CHECK((loaded.compare(expect) == 0));
    }
 
+   SECTION("Write many long lines in chunks then trim and count them")
+   {
+      std::string padding(100, '-');
+      std::stringstream ss_expect;
+      ss_expect << '\n';
+      for (size_t i = 0; i < maxLines * 3; i++)
+      {
+         std::stringstream line;
+         line << i << padding << '\n';
+         console_persist::appendToOutputBuffer(handle2, line.str());
+         if (i >= maxLines * 2)
+            ss_expect << line.str();
+      }
+
+      std::string expect = ss_expect.str();
+      CHECK((console_persist::getSavedBufferLineCount(handle2, maxLines) ==
+             static_cast<int>(maxLines + 2)));
+      std::string loaded = console_persist::getSavedBuffer(handle2, maxLines);
+      CHECK((loaded.compare(expect) == 0));
+
+      console_persist::appendToOutputBuffer(handle2, "partial");
+      console_persist::deleteLogFile(handle2, true);
+      loaded = console_persist::getSavedBuffer(handle2, 0);
+      CHECK((loaded.compare(expect) == 0));
+   }
+
    SECTION("Delete unknown log files")
    {
       std::string orig1("hello how are you?\nthat is good\nhave a nice day");
@@ -1678,6 +1678,12 @@ int main (int argc, char * const argv[])
       // in main so that any other code which needs to enque an event
       // has access to the queue
       rsession::initializeClientEventQueue();
+      if (options.limitPendingConsoleOutputMb() > 0)
+      {
+         rsession::clientEventQueue().setMaxPendingBytes(
+            static_cast<std::size_t>(options.limitPendingConsoleOutputMb())
+                                                               * 1024 * 1024);
+      }
 
       // detect parent termination
       if (desktopMode)
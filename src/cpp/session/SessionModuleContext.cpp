@@ -2088,7 +2088,10 @@ Events& events()
 
 core::system::ProcessSupervisor& processSupervisor()
 {
-   static core::system::ProcessSupervisor instance;
+   // event-driven so that idle children (e.g. terminals) cost nothing to
+   // poll during background processing
+   static core::system::ProcessSupervisor instance(
+                              core::system::supervisor_mode::EventDriven);
    return instance;
 }
 
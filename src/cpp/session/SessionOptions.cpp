@@ -224,6 +224,9 @@ core::ProgramStatus Options::read(int argc, char * const argv[], std::ostream& o
       ("session-quit-child-processes-on-exit",
        value<bool>(&quitChildProcessesOnExit_)->default_value(false),
        "quit child processes on session exit")
+      ("session-stream-events",
+       value<bool>(&streamEvents_)->default_value(false),
+       "stream client events as compressed chunked responses")
       ("session-first-project-template-path",
        value<std::string>(&firstProjectTemplatePath_)->default_value(""),
        "first project template path")
@@ -335,6 +338,9 @@ core::ProgramStatus Options::read(int argc, char * const argv[], std::ostream& o
       ("limit-cpu-time-minutes",
        value<int>(&limitCpuTimeMinutes_)->default_value(0),
        "limit on time of top level computations")
+      ("limit-pending-console-output-mb",
+       value<int>(&limitPendingConsoleOutputMb_)->default_value(4),
+       "limit of console output pending delivery to the client")
       ("limit-xfs-disk-quota",
        value<bool>(&limitXfsDiskQuota_)->default_value(false),
        "limit xfs disk quota");
@@ -46,9 +46,12 @@
 #include <session/SessionModuleContext.hpp>
 #include <session/projects/SessionProjects.hpp>
 
+#include "SessionSourceDatabaseJournal.hpp"
 #include "SessionSourceDatabaseSupervisor.hpp"
 
 #define kContentsSuffix "-contents"
+#define kJournalSuffix "-journal"
+#define kTempSuffix "-tmp"
 
 // NOTE: if a file is deleted then its properties database entry is not
 // deleted. this has two implications:
@@ -95,6 +98,7 @@ Error getPropertiesDatabase(PropertiesDatabase* pDatabase)
       return error;
 
    pDatabase->indexFile = pDatabase->path.complete("INDEX");
+   pDatabase->index.clear();
 
    if (pDatabase->indexFile.exists())
       return readStringMapFromFile(pDatabase->indexFile, &(pDatabase->index));
@@ -102,39 +106,72 @@ Error getPropertiesDatabase(PropertiesDatabase* pDatabase)
       return Success();
 }
 
+// cached copy of the properties database (entries are never removed from
+// its index, so we only need to read it again when a path isn't found)
+PropertiesDatabase s_propertiesDB;
+
+// the properties last written for each (escaped) path
+std::map<std::string, std::string> s_writtenProperties;
+
+Error findPropertiesFile(const std::string& escapedPath,
+                         std::string* pPropertiesFile)
+{
+   std::map<std::string,std::string>::const_iterator it =
+                                       s_propertiesDB.index.find(escapedPath);
+   if (it == s_propertiesDB.index.end())
+   {
+      // another session may have added it
+      Error error = getPropertiesDatabase(&s_propertiesDB);
+      if (error)
+         return error;
+      it = s_propertiesDB.index.find(escapedPath);
+   }
+
+   if (it != s_propertiesDB.index.end())
+      *pPropertiesFile = it->second;
+   else
+      pPropertiesFile->clear();
+   return Success();
+}
+
 Error putProperties(const std::string& path, const json::Object& properties)
 {
    // url escape path (so we can use key=value persistence)
    std::string escapedPath = http::util::urlEncode(path);
 
-   // get properties database
-   PropertiesDatabase propertiesDB;
-   Error error = getPropertiesDatabase(&propertiesDB);
+   // nothing to do if these are the properties we last wrote
+   std::ostringstream ostr ;
+   json::writeFormatted(properties, ostr);
+   std::map<std::string,std::string>::const_iterator it =
+                                       s_writtenProperties.find(escapedPath);
+   if (it != s_writtenProperties.end() && it->second == ostr.str())
+      return Success();
+
+   // use existing properties file if it exists, otherwise create new
+   std::string propertiesFile;
+   Error error = findPropertiesFile(escapedPath, &propertiesFile);
    if (error)
       return error;
 
-   // use existing properties file if it exists, otherwise create new
    bool updateIndex = false;
-   std::string propertiesFile = propertiesDB.index[escapedPath];
    if (propertiesFile.empty())
    {
-      FilePath propFile = file_utils::uniqueFilePath(propertiesDB.path);
+      FilePath propFile = file_utils::uniqueFilePath(s_propertiesDB.path);
       propertiesFile = propFile.filename();
-      propertiesDB.index[escapedPath] = propertiesFile;
+      s_propertiesDB.index[escapedPath] = propertiesFile;
       updateIndex = true;
    }
 
    // write the file
-   std::ostringstream ostr ;
-   json::writeFormatted(properties, ostr);
-   FilePath propertiesFilePath = propertiesDB.path.complete(propertiesFile);
+   FilePath propertiesFilePath = s_propertiesDB.path.complete(propertiesFile);
    error = writeStringToFile(propertiesFilePath, ostr.str());
    if (error)
       return error;
+   s_writtenProperties[escapedPath] = ostr.str();
 
    // update the index if necessary
    if (updateIndex)
-      return writeStringMapToFile(propertiesDB.indexFile, propertiesDB.index);
+      return writeStringMapToFile(s_propertiesDB.indexFile, s_propertiesDB.index);
    else
       return Success();
 }
@@ -144,14 +181,11 @@ Error getProperties(const std::string& path, json::Object* pProperties)
    // url escape path (so we can use key=value persistence)
    std::string escapedPath = http::util::urlEncode(path);
 
-   // get properties database
-   PropertiesDatabase propertiesDB;
-   Error error = getPropertiesDatabase(&propertiesDB);
+   // check for properties file
+   std::string propertiesFile;
+   Error error = findPropertiesFile(escapedPath, &propertiesFile);
    if (error)
       return error;
-
-   // check for properties file
-   std::string propertiesFile = propertiesDB.index[escapedPath];
    if (propertiesFile.empty())
    {
       // return empty object if there is none
@@ -161,7 +195,7 @@ Error getProperties(const std::string& path, json::Object* pProperties)
 
    // read the properties file
    std::string contents ;
-   FilePath propertiesFilePath = propertiesDB.path.complete(propertiesFile);
+   FilePath propertiesFilePath = s_propertiesDB.path.complete(propertiesFile);
    error = readStringFromFile(propertiesFilePath, &contents,
                               options().sourceLineEnding());
    if (error)
@@ -291,6 +325,271 @@ bool isIntendedAsReadOnly(const std::string& contents,
    return false;
 }
 
+// journals are compacted into the document's files once they grow beyond
+// this size (plus the size of the document's contents)
+const std::size_t kMaxJournalSize = 512 * 1024;
+
+// a document as last written to the database; changes to it are appended
+// to its journal, and reads of it don't need to go to disk
+struct StoredDocument
+{
+   StoredDocument() : journalSize(0) {}
+
+   json::Object properties;
+   std::string contents;
+   std::string hash;
+   std::size_t journalSize;
+};
+
+// stored documents, keyed by the path of their properties file
+typedef std::map<std::string, boost::shared_ptr<StoredDocument> >
+                                                         StoredDocuments;
+StoredDocuments s_storedDocuments;
+
+FilePath contentsPathFor(const FilePath& propertiesPath)
+{
+   return FilePath(propertiesPath.absolutePath() + kContentsSuffix);
+}
+
+FilePath journalPathFor(const FilePath& propertiesPath)
+{
+   return FilePath(propertiesPath.absolutePath() + kJournalSuffix);
+}
+
+// write to a temporary file and move it into place, so that the file is
+// either entirely updated or not at all if we crash
+Error writeFileAtomically(const FilePath& filePath, const std::string& contents)
+{
+   FilePath tempPath(filePath.absolutePath() + kTempSuffix);
+   Error error = writeStringToFile(tempPath, contents);
+   if (error)
+      return error;
+
+   return tempPath.move(filePath, FilePath::MoveDirect);
+}
+
+// Write the document's contents and properties files, then remove its
+// journal. If we crash part way through then the journal is replayed on
+// the next read (see journal::replay for how the case where only the
+// contents were written is handled)
+Error compactStoredDocument(const FilePath& propertiesPath,
+                            StoredDocument* pStored)
+{
+   Error error = writeFileAtomically(contentsPathFor(propertiesPath),
+                                     pStored->contents);
+   if (error)
+      return error;
+
+   std::ostringstream oss;
+   json::writeFormatted(pStored->properties, oss);
+   error = writeFileAtomically(propertiesPath, oss.str());
+   if (error)
+      return error;
+
+   error = journalPathFor(propertiesPath).removeIfExists();
+   if (error)
+      return error;
+
+   pStored->journalSize = 0;
+   return Success();
+}
+
+Error readStoredDocument(const FilePath& propertiesPath,
+                         boost::shared_ptr<StoredDocument>* ppStored)
+{
+   StoredDocuments::const_iterator it =
+                     s_storedDocuments.find(propertiesPath.absolutePath());
+   if (it != s_storedDocuments.end())
+   {
+      *ppStored = it->second;
+      return Success();
+   }
+
+   // read the contents of the file
+   std::string properties;
+   Error error = readStringFromFile(propertiesPath,
+                                    &properties,
+                                    options().sourceLineEnding());
+   if (error)
+      return error;
+
+   // parse the json
+   json::Value value;
+   if (!json::parse(properties, &value))
+   {
+      return systemError(boost::system::errc::invalid_argument,
+                         ERROR_LOCATION);
+   }
+   json::Object jsonDoc = value.get_obj();
+
+   // migration: if we have a 'contents' field, but no '-contents' side-car
+   // file, perform a one-time generation of that sidecar file from contents
+   error = attemptContentsMigration(jsonDoc, propertiesPath);
+   if (error)
+      LOG_ERROR(error);
+
+   // read file contents from sidecar file if available
+   std::string contents;
+   bool cacheable = true;
+   FilePath contentsPath = contentsPathFor(propertiesPath);
+   if (contentsPath.exists())
+   {
+      error = readStringFromFile(contentsPath,
+                                 &contents,
+                                 options().sourceLineEnding());
+      if (error)
+      {
+         // don't keep the document around (its edits would be journaled
+         // against the wrong contents)
+         LOG_ERROR(error);
+         cacheable = false;
+      }
+   }
+   if (contents.empty() && json::isType<std::string>(jsonDoc["contents"]))
+      contents = jsonDoc["contents"].get_str();
+   jsonDoc["contents"] = std::string();
+
+   // apply the changes recorded in the journal
+   FilePath journalPath = journalPathFor(propertiesPath);
+   bool replayed = false;
+   if (journalPath.exists())
+   {
+      std::string journal;
+      error = readStringFromFile(journalPath, &journal);
+      if (error)
+         return error;
+
+      replayed = journal::replay(journal, &contents, &jsonDoc);
+   }
+
+   boost::shared_ptr<StoredDocument> pStored(new StoredDocument());
+   pStored->properties = jsonDoc;
+   pStored->contents = contents;
+   pStored->hash = hash::crc32Hash(contents);
+
+   // compact any journal we replayed (so that new changes aren't appended
+   // after a record which was partially written when we crashed)
+   if (replayed && cacheable)
+   {
+      error = compactStoredDocument(propertiesPath, pStored.get());
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   if (cacheable)
+      s_storedDocuments[propertiesPath.absolutePath()] = pStored;
+
+   *ppStored = pStored;
+   return Success();
+}
+
+// The document couldn't be read, so its journal couldn't be replayed (or
+// compacted). Keep the journal's edits for replay on the next read, and
+// record the properties in it too (as otherwise the journal's properties
+// would replace those just written)
+Error recordJournalProperties(const FilePath& propertiesPath,
+                              const json::Object& properties)
+{
+   FilePath journalPath = journalPathFor(propertiesPath);
+   if (!journalPath.exists())
+      return Success();
+
+   std::string journal;
+   Error error = readStringFromFile(journalPath, &journal);
+   if (error)
+      return error;
+
+   std::string record;
+   if (!journal::propertiesRecord(journal, properties, &record))
+      return journalPath.removeIfExists(); // nothing to replay
+
+   return appendToFile(journalPath, record);
+}
+
+Error writeStoredDocument(const FilePath& propertiesPath,
+                          const SourceDocument& doc,
+                          bool writeContents)
+{
+   json::Object properties;
+   doc.writeToJson(&properties, false);
+
+   boost::shared_ptr<StoredDocument> pStored;
+   if (propertiesPath.exists())
+   {
+      Error error = readStoredDocument(propertiesPath, &pStored);
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   std::string key = propertiesPath.absolutePath();
+   if (!pStored || !s_storedDocuments.count(key))
+   {
+      // without the contents we can only write the properties
+      if (!writeContents)
+      {
+         s_storedDocuments.erase(key);
+         Error error = doc.writeToFile(propertiesPath, false);
+         if (error)
+            return error;
+         return recordJournalProperties(propertiesPath, properties);
+      }
+
+      pStored.reset(new StoredDocument());
+      pStored->properties = properties;
+      pStored->contents = doc.contents();
+      pStored->hash = doc.hash();
+      Error error = compactStoredDocument(propertiesPath, pStored.get());
+      if (error)
+         return error;
+
+      s_storedDocuments[key] = pStored;
+      return Success();
+   }
+
+   // nothing to do if the document hasn't changed
+   std::string contents = writeContents ? doc.contents() : pStored->contents;
+   std::string hash = writeContents ? doc.hash() : pStored->hash;
+   if (contents == pStored->contents && properties == pStored->properties)
+      return Success();
+
+   // append the change to the journal
+   std::string record = journal::record(pStored->contents,
+                                        contents,
+                                        hash,
+                                        properties);
+   pStored->properties = properties;
+   pStored->contents = contents;
+   pStored->hash = hash;
+   pStored->journalSize += record.size();
+
+   Error error = appendToFile(journalPathFor(propertiesPath), record);
+   if (error)
+   {
+      // the record may have been partially written, so write everything
+      LOG_ERROR(error);
+      return compactStoredDocument(propertiesPath, pStored.get());
+   }
+
+   if (pStored->journalSize > kMaxJournalSize + pStored->contents.size())
+      return compactStoredDocument(propertiesPath, pStored.get());
+
+   return Success();
+}
+
+void compactStoredDocuments()
+{
+   BOOST_FOREACH(const StoredDocuments::value_type& stored, s_storedDocuments)
+   {
+      if (stored.second->journalSize > 0)
+      {
+         Error error = compactStoredDocument(FilePath(stored.first),
+                                             stored.second.get());
+         if (error)
+            LOG_ERROR(error);
+      }
+   }
+}
+
 }  // anonymous namespace
 
 SourceDocument::SourceDocument(const std::string& type)
@@ -641,58 +940,24 @@ Error get(const std::string& id, bool includeContents, boost::shared_ptr<SourceD
 {
    FilePath propertiesPath = source_database::path().complete(id);
    
-   // attempt to read file contents from sidecar file if available
-   std::string contents;
-   if (includeContents)
-   {
-      FilePath contentsPath(propertiesPath.absolutePath() + kContentsSuffix);
-      if (contentsPath.exists())
-      {
-         Error error = readStringFromFile(contentsPath,
-                                          &contents,
-                                          options().sourceLineEnding());
-         if (error)
-            LOG_ERROR(error);
-      }
-   }
-   
    if (propertiesPath.exists())
    {
-      // read the contents of the file
-      std::string properties;
-      Error error = readStringFromFile(propertiesPath,
-                                       &properties,
-                                       options().sourceLineEnding());
+      // read the document (from memory if we've already read it)
+      boost::shared_ptr<StoredDocument> pStored;
+      Error error = readStoredDocument(propertiesPath, &pStored);
       if (error)
          return error;
-   
-      // parse the json
-      json::Value value;
-      if (!json::parse(properties, &value))
-      {
-         return systemError(boost::system::errc::invalid_argument,
-                            ERROR_LOCATION);
-      }
-      
+
       // initialize doc from json
-      json::Object jsonDoc = value.get_obj();
-      
-      // migration: if we have a 'contents' field, but no '-contents' side-car
-      // file, perform a one-time generation of that sidecar file from contents
-      error = attemptContentsMigration(jsonDoc, propertiesPath);
-      if (error)
-         LOG_ERROR(error);
-      
-      if (includeContents && !contents.empty())
-         jsonDoc["contents"] = contents;
-      
-      if (!jsonDoc.count("contents"))
-         jsonDoc["contents"] = std::string();
+      json::Object jsonDoc = pStored->properties;
+      if (includeContents)
+         jsonDoc["contents"] = pStored->contents;
       
       return pDoc->readFromJson(&jsonDoc);
    }
    else
    {
+      s_storedDocuments.erase(propertiesPath.absolutePath());
       return systemError(boost::system::errc::no_such_file_or_directory,
                          ERROR_LOCATION);
    }
@@ -713,7 +978,9 @@ bool isSourceDocument(const FilePath& filePath)
        filename == "lock_file" ||
        filename == "suspend_file" ||
        filename == "restart_file" ||
-       boost::algorithm::ends_with(filename, kContentsSuffix))
+       boost::algorithm::ends_with(filename, kContentsSuffix) ||
+       boost::algorithm::ends_with(filename, kJournalSuffix) ||
+       boost::algorithm::ends_with(filename, kTempSuffix))
    {
       return false;
    }
@@ -837,9 +1104,9 @@ Error list(std::vector<FilePath>* pPaths)
    
 Error put(boost::shared_ptr<SourceDocument> pDoc, bool writeContents)
 {   
-   // write to file
+   // write to the database
    FilePath filePath = source_database::path().complete(pDoc->id());
-   Error error = pDoc->writeToFile(filePath, writeContents);
+   Error error = writeStoredDocument(filePath, *pDoc, writeContents);
    if (error)
       return error ;
 
@@ -856,11 +1123,20 @@ Error put(boost::shared_ptr<SourceDocument> pDoc, bool writeContents)
    
 Error remove(const std::string& id)
 {
-   return source_database::path().complete(id).removeIfExists();
+   FilePath filePath = source_database::path().complete(id);
+   s_storedDocuments.erase(filePath.absolutePath());
+
+   Error error = journalPathFor(filePath).removeIfExists();
+   if (error)
+      LOG_ERROR(error);
+
+   return filePath.removeIfExists();
 }
    
 Error removeAll()
 {
+   s_storedDocuments.clear();
+
    std::vector<FilePath> files ;
    Error error = source_database::path().children(&files);
    if (error)
@@ -969,6 +1245,9 @@ void onQuit()
 
 void onSuspend(const r::session::RSuspendOptions& options, core::Settings*)
 {
+   // leave only the documents' files behind
+   compactStoredDocuments();
+
    supervisor::suspendSourceDatabase(options.status);
 }
 
@@ -0,0 +1,191 @@
+/*
+ * SessionSourceDatabaseJournal.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionSourceDatabaseJournal.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include <boost/foreach.hpp>
+
+#include <core/Hash.hpp>
+#include <core/Log.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace source_database {
+namespace journal {
+
+namespace {
+
+bool isContinuationByte(char ch)
+{
+   return (static_cast<unsigned char>(ch) & 0xC0) == 0x80;
+}
+
+bool readRecord(const std::string& line, json::Object* pRecord)
+{
+   json::Value value;
+   if (!json::parse(line, &value) || !json::isType<json::Object>(value))
+      return false;
+
+   const json::Object& record = value.get_obj();
+   json::Object::const_iterator hashIt = record.find("hash");
+   json::Object::const_iterator propertiesIt = record.find("properties");
+   if (hashIt == record.end() ||
+       !json::isType<std::string>(hashIt->second) ||
+       propertiesIt == record.end() ||
+       !json::isType<json::Object>(propertiesIt->second))
+   {
+      return false;
+   }
+
+   *pRecord = record;
+   return true;
+}
+
+// read records up to the first one we can't read
+std::vector<json::Object> readRecords(const std::string& journal)
+{
+   std::vector<json::Object> records;
+   std::istringstream istr(journal);
+   std::string line;
+   while (std::getline(istr, line))
+   {
+      json::Object record;
+      if (!readRecord(line, &record))
+         break;
+      records.push_back(record);
+   }
+   return records;
+}
+
+bool applyEdit(const json::Object& record, std::string* pContents)
+{
+   json::Object::const_iterator offsetIt = record.find("offset");
+   if (offsetIt == record.end())
+      return true;
+
+   json::Object::const_iterator lengthIt = record.find("length");
+   json::Object::const_iterator textIt = record.find("text");
+   if (!json::isType<int>(offsetIt->second) ||
+       lengthIt == record.end() || !json::isType<int>(lengthIt->second) ||
+       textIt == record.end() || !json::isType<std::string>(textIt->second))
+   {
+      return false;
+   }
+
+   int offset = offsetIt->second.get_int();
+   int length = lengthIt->second.get_int();
+   if (offset < 0 || length < 0 ||
+       static_cast<std::size_t>(offset) + length > pContents->size())
+   {
+      return false;
+   }
+
+   pContents->replace(offset, length, textIt->second.get_str());
+   return true;
+}
+
+} // anonymous namespace
+
+std::string record(const std::string& oldContents,
+                   const std::string& newContents,
+                   const std::string& hash,
+                   const json::Object& properties)
+{
+   json::Object record;
+
+   if (oldContents != newContents)
+   {
+      // find the range which differs, keeping its bounds on UTF-8
+      // character boundaries
+      std::size_t size = std::min(oldContents.size(), newContents.size());
+      std::size_t prefix = 0;
+      while (prefix < size && oldContents[prefix] == newContents[prefix])
+         prefix++;
+      while (prefix > 0 && prefix < newContents.size() &&
+             isContinuationByte(newContents[prefix]))
+         prefix--;
+
+      std::size_t suffix = 0;
+      while (suffix < size - prefix &&
+             oldContents[oldContents.size() - suffix - 1] ==
+             newContents[newContents.size() - suffix - 1])
+         suffix++;
+      while (suffix > 0 &&
+             isContinuationByte(newContents[newContents.size() - suffix]))
+         suffix--;
+
+      record["offset"] = static_cast<int>(prefix);
+      record["length"] = static_cast<int>(oldContents.size() - prefix - suffix);
+      record["text"] = newContents.substr(prefix,
+                                          newContents.size() - prefix - suffix);
+   }
+
+   record["hash"] = hash;
+   record["properties"] = properties;
+   return json::write(record) + "\n";
+}
+
+bool propertiesRecord(const std::string& journal,
+                      const json::Object& properties,
+                      std::string* pRecord)
+{
+   std::vector<json::Object> records = readRecords(journal);
+   if (records.empty())
+      return false;
+
+   // (the contents are those of the last record, so there's no edit)
+   json::Object record;
+   record["hash"] = records.back().find("hash")->second;
+   record["properties"] = properties;
+   *pRecord = json::write(record) + "\n";
+   return true;
+}
+
+bool replay(const std::string& journal,
+            std::string* pContents,
+            json::Object* pProperties)
+{
+   std::vector<json::Object> records = readRecords(journal);
+   if (records.empty())
+      return false;
+
+   // apply the edits unless the contents already include them
+   const json::Object& last = records.back();
+   if (hash::crc32Hash(*pContents) != last.find("hash")->second.get_str())
+   {
+      BOOST_FOREACH(const json::Object& record, records)
+      {
+         if (!applyEdit(record, pContents))
+         {
+            LOG_WARNING_MESSAGE("Invalid source document journal record");
+            break;
+         }
+      }
+   }
+
+   *pProperties = last.find("properties")->second.get_obj();
+   return true;
+}
+
+} // namespace journal
+} // namespace source_database
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,63 @@
+/*
+ * SessionSourceDatabaseJournal.hpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_SOURCE_DATABASE_JOURNAL_HPP
+#define SESSION_SOURCE_DATABASE_JOURNAL_HPP
+
+#include <string>
+
+#include <core/json/Json.hpp>
+
+namespace rstudio {
+namespace session {
+namespace source_database {
+namespace journal {
+
+// Changes to a source document are appended to its journal (rather than
+// rewriting its contents and properties files) as one line per change.
+// Each record holds the edit made to the contents (if any), the hash of
+// the resulting contents and the document's new properties.
+
+// create the journal line recording the change from oldContents to
+// newContents (hash is the hash of newContents)
+std::string record(const std::string& oldContents,
+                   const std::string& newContents,
+                   const std::string& hash,
+                   const core::json::Object& properties);
+
+// create the journal line recording a change to the properties alone,
+// for appending to a journal which can't be replayed yet (e.g. because the
+// document's contents couldn't be read). Returns false if the journal has
+// no records (in which case it has nothing to replay).
+bool propertiesRecord(const std::string& journal,
+                      const core::json::Object& properties,
+                      std::string* pRecord);
+
+// Replay a journal onto the contents and properties read from the
+// document's files. Records following one which can't be read (e.g. one
+// which was partially written during a crash) are ignored. If the contents
+// already match the last record (i.e. the journal was compacted into the
+// files but not yet removed) only its properties are applied. Returns
+// false if there were no records to replay.
+bool replay(const std::string& journal,
+            std::string* pContents,
+            core::json::Object* pProperties);
+
+} // namespace journal
+} // namespace source_database
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_SOURCE_DATABASE_JOURNAL_HPP
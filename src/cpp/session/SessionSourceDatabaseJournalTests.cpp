@@ -0,0 +1,159 @@
+/*
+ * SessionSourceDatabaseJournalTests.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionSourceDatabaseJournal.hpp"
+
+#include <core/Hash.hpp>
+
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace session {
+namespace source_database {
+namespace tests {
+
+using namespace rstudio::core;
+using namespace journal;
+
+namespace {
+
+json::Object properties(const std::string& folds)
+{
+   json::Object properties;
+   properties["folds"] = folds;
+   return properties;
+}
+
+std::string change(const std::string& from, const std::string& to,
+                   const std::string& folds = "")
+{
+   return record(from, to, hash::crc32Hash(to), properties(folds));
+}
+
+} // anonymous namespace
+
+context("Source database journal")
+{
+   test_that("Edits are replayed in order")
+   {
+      std::string journal =
+            change("hello world", "hello there world", "1") +
+            change("hello there world", "hi there world", "2") +
+            change("hi there world", "hi there world\n", "3");
+
+      std::string contents = "hello world";
+      json::Object props;
+      expect_true(replay(journal, &contents, &props));
+      expect_true(contents == "hi there world\n");
+      expect_true(props["folds"].get_str() == "3");
+   }
+
+   test_that("Records only contain the changed range")
+   {
+      std::string line = change(std::string(1000, 'a'),
+                                std::string(500, 'a') + "b" + std::string(500, 'a'));
+      expect_true(line.size() < 200);
+
+      json::Value value;
+      expect_true(json::parse(line, &value));
+      json::Object record = value.get_obj();
+      expect_true(record["offset"].get_int() == 500);
+      expect_true(record["length"].get_int() == 0);
+      expect_true(record["text"].get_str() == "b");
+   }
+
+   test_that("Edits keep UTF-8 characters intact")
+   {
+      // both characters share their leading byte
+      std::string from = "x\xc3\xa9y";
+      std::string to = "x\xc3\xa8y";
+      std::string line = change(from, to);
+
+      json::Value value;
+      expect_true(json::parse(line, &value));
+      json::Object record = value.get_obj();
+      expect_true(record["offset"].get_int() == 1);
+      expect_true(record["length"].get_int() == 2);
+      expect_true(record["text"].get_str() == "\xc3\xa8");
+
+      std::string contents = from;
+      json::Object props;
+      expect_true(replay(line, &contents, &props));
+      expect_true(contents == to);
+   }
+
+   test_that("Property changes are replayed without edits")
+   {
+      std::string journal = change("abc", "abc", "folded");
+      std::string contents = "abc";
+      json::Object props;
+      expect_true(replay(journal, &contents, &props));
+      expect_true(contents == "abc");
+      expect_true(props["folds"].get_str() == "folded");
+   }
+
+   test_that("Partially written records are ignored")
+   {
+      std::string complete = change("one", "one two", "1");
+      std::string partial = change("one two", "one two three", "2");
+      partial = partial.substr(0, partial.size() / 2);
+
+      std::string contents = "one";
+      json::Object props;
+      expect_true(replay(complete + partial, &contents, &props));
+      expect_true(contents == "one two");
+      expect_true(props["folds"].get_str() == "1");
+
+      contents = "one";
+      expect_false(replay(partial, &contents, &props));
+      expect_true(contents == "one");
+   }
+
+   test_that("Properties can be recorded without the contents")
+   {
+      std::string journal = change("a", "ab", "1") + change("ab", "abc", "2");
+      std::string line;
+      expect_true(propertiesRecord(journal, properties("3"), &line));
+      journal += line;
+
+      std::string contents = "a";
+      json::Object props;
+      expect_true(replay(journal, &contents, &props));
+      expect_true(contents == "abc");
+      expect_true(props["folds"].get_str() == "3");
+
+      contents = "abc";
+      expect_true(replay(journal, &contents, &props));
+      expect_true(contents == "abc");
+      expect_true(props["folds"].get_str() == "3");
+
+      expect_false(propertiesRecord("", properties("3"), &line));
+   }
+
+   test_that("Journals already compacted into the contents aren't reapplied")
+   {
+      std::string journal = change("a", "ab", "1") + change("ab", "abc", "2");
+      std::string contents = "abc";
+      json::Object props;
+      expect_true(replay(journal, &contents, &props));
+      expect_true(contents == "abc");
+      expect_true(props["folds"].get_str() == "2");
+   }
+}
+
+} // namespace tests
+} // namespace source_database
+} // namespace session
+} // namespace rstudio
@@ -15,6 +15,15 @@
 
 #include "SessionUriHandlers.hpp"
 
+#include <vector>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <core/Thread.hpp>
+#include <core/http/Request.hpp>
+#include <core/http/Response.hpp>
+
 #include <session/SessionConstants.hpp>
 
 using namespace rstudio::core;
@@ -29,6 +38,61 @@ http::UriHandlers& handlers()
    return instance;
 }
 
+namespace {
+
+typedef std::pair<std::string, http::UriFilterFunction> BackgroundFilter;
+
+// filters are registered on the main thread and called on the listener
+// thread so access to them is synchronized
+boost::mutex s_backgroundFiltersMutex;
+
+std::vector<BackgroundFilter>& backgroundFilters()
+{
+   static std::vector<BackgroundFilter> instance;
+   return instance;
+}
+
+} // anonymous namespace
+
+void addBackgroundFilter(const std::string& prefix,
+                         const http::UriFilterFunction& filter)
+{
+   LOCK_MUTEX(s_backgroundFiltersMutex)
+   {
+      backgroundFilters().push_back(std::make_pair(prefix, filter));
+   }
+   END_LOCK_MUTEX
+}
+
+bool filterInBackground(const http::Request& request,
+                        http::Response* pResponse)
+{
+   std::vector<http::UriFilterFunction> filters;
+   LOCK_MUTEX(s_backgroundFiltersMutex)
+   {
+      for (std::vector<BackgroundFilter>::const_iterator it =
+              backgroundFilters().begin();
+           it != backgroundFilters().end();
+           ++it)
+      {
+         if (boost::algorithm::starts_with(request.uri(), it->first))
+            filters.push_back(it->second);
+      }
+   }
+   END_LOCK_MUTEX
+
+   for (std::vector<http::UriFilterFunction>::const_iterator it =
+           filters.begin();
+        it != filters.end();
+        ++it)
+   {
+      if ((*it)(request, pResponse))
+         return true;
+   }
+
+   return false;
+}
+
 } // namespace uri_handlers
 
 namespace module_context {
@@ -68,6 +132,13 @@ Error registerLocalUriHandler(const std::string& name,
    return Success();
 }
 
+Error registerBackgroundUriFilter(const std::string& name,
+                                  const http::UriFilterFunction& filterFunction)
+{
+   uri_handlers::addBackgroundFilter(name, filterFunction);
+   return Success();
+}
+
 } // namespace module_context
 } // namespace session
 } // namespace rstudio
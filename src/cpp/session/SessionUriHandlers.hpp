@@ -21,6 +21,16 @@ namespace uri_handlers {
 
 core::http::UriHandlers& handlers();
 
+// add a filter which is offered requests for uris with the given prefix on
+// the connection listener thread
+void addBackgroundFilter(const std::string& prefix,
+                         const core::http::UriFilterFunction& filter);
+
+// offer a request to the background filters registered for its uri (called
+// on the connection listener thread). returns true if a filter handled it
+bool filterInBackground(const core::http::Request& request,
+                        core::http::Response* pResponse);
+
 } // namespace uri_handlers
 } // namespace session
 } // namespace rstudio
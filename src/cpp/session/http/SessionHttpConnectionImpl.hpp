@@ -16,10 +16,13 @@
 #ifndef SESSION_HTTP_CONNECTION_IMPL_HPP
 #define SESSION_HTTP_CONNECTION_IMPL_HPP
 
+#include <utility>
 
 #include <boost/array.hpp>
 
 #include <boost/utility.hpp>
+#include <boost/format.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/write.hpp>
 #include <boost/asio/placeholders.hpp>
@@ -57,7 +60,7 @@ public:
 public:
    HttpConnectionImpl(boost::asio::io_service& ioService,
                       const Handler& handler)
-      : socket_(ioService), handler_(handler)
+      : socket_(ioService), handler_(handler), keepAlive_(false)
    {
    }
 
@@ -78,13 +81,51 @@ public:
    // request/resposne (used by Handler)
    virtual const core::http::Request& request() { return request_; }
 
+   virtual bool beginChunkedResponse(const core::http::Response& response)
+   {
+      return write(response.headerBuffers(
+                     core::http::Header::connectionClose()));
+   }
+
+   virtual bool writeChunk(const char* data, std::size_t length)
+   {
+      if (length == 0)
+         return true;
+
+      std::string size = (boost::format("%x\r\n") % length).str();
+      std::vector<boost::asio::const_buffer> buffers;
+      buffers.push_back(boost::asio::buffer(size));
+      buffers.push_back(boost::asio::buffer(data, length));
+      buffers.push_back(boost::asio::buffer("\r\n", 2));
+      return write(buffers);
+   }
+
+   virtual void endChunkedResponse()
+   {
+      std::vector<boost::asio::const_buffer> buffers;
+      buffers.push_back(boost::asio::buffer("0\r\n\r\n", 5));
+      write(buffers);
+
+      try
+      {
+         close();
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+   }
+
    virtual void sendResponse(const core::http::Response &response)
    {
+      // we can only keep the connection open if the client asked us to
+      // and the response is delimited by its Content-Length
+      bool keepAlive = keepAlive_ && response.containsHeader("Content-Length");
+
       try
       {
          // write the response
          boost::asio::write(socket_,
                             response.toBuffers(
+                               keepAlive ?
+                                  core::http::Header::connectionKeepAlive() :
                                   core::http::Header::connectionClose()));
       }
       catch(const boost::system::system_error& e)
@@ -96,13 +137,19 @@ public:
          // log the error if it wasn't connection terminated
          if (!core::http::isConnectionTerminatedError(error))
             LOG_ERROR(error);
+
+         keepAlive = false;
       }
       CATCH_UNEXPECTED_EXCEPTION
 
-      // always close connection
+      // close the connection unless we are keeping it alive, in which case
+      // it is handed off to a new connection object to read the next request
       try
       {
-         close();
+         if (keepAlive)
+            readNextRequest();
+         else
+            close();
       }
       CATCH_UNEXPECTED_EXCEPTION
    }
@@ -133,6 +180,45 @@ public:
 
 private:
 
+   bool write(const std::vector<boost::asio::const_buffer>& buffers)
+   {
+      try
+      {
+         boost::asio::write(socket_, buffers);
+         return true;
+      }
+      catch(const boost::system::system_error& e)
+      {
+         // establish error
+         core::Error error = core::Error(e.code(), ERROR_LOCATION);
+         error.addProperty("request-uri", request_.uri());
+
+         // log the error if it wasn't connection terminated
+         if (!core::http::isConnectionTerminatedError(error))
+            LOG_ERROR(error);
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+
+      return false;
+   }
+
+   HttpConnectionImpl(typename ProtocolType::socket& socket,
+                      const Handler& handler)
+      : socket_(std::move(socket)), handler_(handler), keepAlive_(false)
+   {
+   }
+
+   void readNextRequest()
+   {
+      // the handler (and anything else which retains a reference to this
+      // connection) may still inspect our request so rather than resetting
+      // our state we move the socket into a fresh connection
+      boost::shared_ptr<HttpConnectionImpl<ProtocolType> > ptrNext(
+                              new HttpConnectionImpl<ProtocolType>(socket_,
+                                                                   handler_));
+      ptrNext->startReading();
+   }
+
    // async request reading interface
    void readSome()
    {
@@ -187,6 +273,11 @@ private:
                // establish request id
                requestId_ = connection::rstudioRequestIdFromRequest(request_);
 
+               // note whether the client wants to reuse the connection
+               keepAlive_ = boost::algorithm::iequals(
+                                 request_.headerValue("Connection"),
+                                 "keep-alive");
+
                // call handler
                handler_(HttpConnectionImpl<ProtocolType>::shared_from_this());
 
@@ -220,6 +311,7 @@ private:
    core::http::Request request_;
    std::string requestId_;
    Handler handler_;
+   bool keepAlive_;
 };
 
 } // namespace session
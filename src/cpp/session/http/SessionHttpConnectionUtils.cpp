@@ -17,6 +17,8 @@
 #include "SessionHttpConnectionUtils.hpp"
 
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/iostreams/concepts.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
 
 #include <core/FilePath.hpp>
 #include <core/Log.hpp>
@@ -35,6 +37,8 @@
 #include <session/SessionOptions.hpp>
 #include <session/projects/ProjectsSettings.hpp>
 
+#include "../SessionUriHandlers.hpp"
+
 namespace rstudio {
 namespace session {
 
@@ -68,6 +72,88 @@ void HttpConnection::sendJsonRpcResponse(
    sendResponse(response);
 }
 
+namespace {
+
+// size of the chunks we write when streaming responses
+const std::streamsize kStreamedChunkSize = 16384;
+
+// iostreams sink which writes to the connection as a series of chunks
+class ChunkSink : public boost::iostreams::sink
+{
+public:
+   explicit ChunkSink(HttpConnection* pConnection)
+      : pConnection_(pConnection), failed_(false)
+   {
+   }
+
+   std::streamsize write(const char* s, std::streamsize n)
+   {
+      // once a write fails (e.g. the client went away) we just discard
+      // the remainder of the response
+      if (!failed_)
+         failed_ = !pConnection_->writeChunk(s, static_cast<std::size_t>(n));
+      return n;
+   }
+
+private:
+   HttpConnection* pConnection_;
+   bool failed_;
+};
+
+} // anonymous namespace
+
+void HttpConnection::sendStreamedJsonRpcResponse(
+                     const core::json::JsonRpcResponse& jsonRpcResponse)
+{
+   // setup response headers
+   core::http::Response response;
+   response.setNoCacheHeaders();
+   response.setContentType(core::json::kJsonContentType);
+   response.setHeader(core::http::kTransferEncoding,
+                      core::http::kChunkedTransferEncoding);
+
+#ifndef _WIN32
+   if (request().acceptsEncoding(core::http::kGzipEncoding))
+      response.setContentEncoding(core::http::kGzipEncoding);
+   else if (request().acceptsEncoding(core::http::kDeflateEncoding))
+      response.setContentEncoding(core::http::kDeflateEncoding);
+#endif
+
+   // fall back to a buffered response if we can't stream
+   if (!beginChunkedResponse(response))
+   {
+      sendJsonRpcResponse(jsonRpcResponse);
+      return;
+   }
+
+   // serialize directly into the (compressed) chunk stream
+   try
+   {
+      boost::iostreams::filtering_ostream os;
+#ifndef _WIN32
+      if (response.contentEncoding() == core::http::kGzipEncoding)
+         os.push(boost::iostreams::gzip_compressor(), kStreamedChunkSize);
+      else if (response.contentEncoding() == core::http::kDeflateEncoding)
+         os.push(boost::iostreams::zlib_compressor(), kStreamedChunkSize);
+#endif
+      os.push(ChunkSink(this), kStreamedChunkSize);
+
+      jsonRpcResponse.write(os);
+
+      // flush and finalize the compressed stream
+      os.reset();
+   }
+   catch(const std::exception& e)
+   {
+      core::Error error = systemError(boost::system::errc::io_error,
+                                      ERROR_LOCATION);
+      error.addProperty("what", e.what());
+      LOG_ERROR(error);
+   }
+
+   endChunkedResponse();
+}
+
 
 
 namespace connection {
@@ -212,6 +298,27 @@ bool checkForSuspend(boost::shared_ptr<HttpConnection> ptrConnection)
 }
 #endif
 
+bool checkForBackgroundFilter(boost::shared_ptr<HttpConnection> ptrConnection)
+{
+   // requests whose signatures need verifying wait for the foreground
+   if (session::options().verifySignatures() &&
+       session::options().standalone())
+   {
+      return false;
+   }
+
+   core::http::Response response;
+   if (uri_handlers::filterInBackground(ptrConnection->request(), &response))
+   {
+      ptrConnection->sendResponse(response);
+      return true;
+   }
+   else
+   {
+      return false;
+   }
+}
+
 bool authenticate(boost::shared_ptr<HttpConnection> ptrConnection,
                   const std::string& secret)
 {
@@ -374,6 +374,11 @@ private:
       if (connection::checkForSuspend(ptrHttpConnection))
          return;
 
+      // cached responses (e.g. help pages) can be served from here so they
+      // don't wait for R to finish whatever it's doing
+      if (connection::checkForBackgroundFilter(ptrHttpConnection))
+         return;
+
       // place the connection on the correct queue
       if (connection::isGetEvents(ptrHttpConnection))
          eventsConnectionQueue_.enqueConnection(ptrHttpConnection);
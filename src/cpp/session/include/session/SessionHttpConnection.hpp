@@ -67,6 +67,28 @@ public:
    void sendJsonRpcResponse(
                   const core::json::JsonRpcResponse& jsonRpcResponse);
 
+   // send a json rpc response as a (compressed if possible) chunked
+   // response which is written incrementally as it is serialized. falls
+   // back to sendJsonRpcResponse for connections which can't stream
+   void sendStreamedJsonRpcResponse(
+                  const core::json::JsonRpcResponse& jsonRpcResponse);
+
+   // chunked responses (optional). beginChunkedResponse writes the headers
+   // of the response and returns false if the connection doesn't support
+   // chunked responses; endChunkedResponse writes the terminating chunk and
+   // closes the connection
+   virtual bool beginChunkedResponse(const core::http::Response& response)
+   {
+      return false;
+   }
+   virtual bool writeChunk(const char* data, std::size_t length)
+   {
+      return false;
+   }
+   virtual void endChunkedResponse()
+   {
+   }
+
 
    // close (occurs automatically after writeResponse, here in case it
    // need to be closed in other circumstances
@@ -199,6 +199,14 @@ core::Error registerLocalUriHandler(
                         const std::string& name,
                         const core::http::UriHandlerFunction& handlerFunction);
 
+// register a filter which is offered requests for a uri (include a leading
+// slash) on the connection listener thread, so it can respond without
+// waiting for R. it returns false to leave the request to the uri handler
+// registered for it. these filters must be thread-safe and can't call R
+core::Error registerBackgroundUriFilter(
+                        const std::string& name,
+                        const core::http::UriFilterFunction& filterFunction);
+
 typedef boost::function<void(int, const std::string&)> PostbackHandlerContinuation;
 
 // register a postback handler. see docs in SessionPostback.cpp for 
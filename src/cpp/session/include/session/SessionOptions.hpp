@@ -238,6 +238,10 @@ public:
    // limits
    int limitFileUploadSizeMb() const { return limitFileUploadSizeMb_; }
    int limitCpuTimeMinutes() const { return limitCpuTimeMinutes_; }
+   int limitPendingConsoleOutputMb() const
+   {
+      return limitPendingConsoleOutputMb_;
+   }
 
    int limitRpcClientUid() const { return limitRpcClientUid_; }
 
@@ -532,6 +536,11 @@ public:
       return quitChildProcessesOnExit_;
    }
 
+   bool streamEvents() const
+   {
+      return streamEvents_;
+   }
+
    std::string firstProjectTemplatePath() const
    {
       return firstProjectTemplatePath_;
@@ -608,6 +617,7 @@ private:
    std::string defaultConsoleTerm_;
    bool defaultCliColorForce_;
    bool quitChildProcessesOnExit_;
+   bool streamEvents_;
    std::string firstProjectTemplatePath_;
    std::string signingKey_;
    bool verifySignatures_;
@@ -632,6 +642,7 @@ private:
    // limits
    int limitFileUploadSizeMb_;
    int limitCpuTimeMinutes_;
+   int limitPendingConsoleOutputMb_;
    int limitRpcClientUid_;
    bool limitXfsDiskQuota_;
    
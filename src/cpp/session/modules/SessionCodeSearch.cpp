@@ -19,6 +19,7 @@
 #include "SessionCodeSearch.hpp"
 
 #include <iostream>
+#include <limits>
 #include <vector>
 #include <set>
 
@@ -35,9 +36,11 @@
 #include <core/FilePath.hpp>
 #include <core/FileSerializer.hpp>
 #include <core/SafeConvert.hpp>
+#include <core/collection/FuzzyIndex.hpp>
 #include <core/collection/Tree.hpp>
 
 #include <core/r_util/RSourceIndex.hpp>
+#include <core/r_util/RSourceIndexCache.hpp>
 
 #include <core/system/FileChangeEvent.hpp>
 #include <core/system/FileMonitor.hpp>
@@ -446,11 +449,110 @@ private:
    
 };
 
+// NOTE: When modifying this code, you should ensure that corresponding
+// changes are made to the client side scoreMatch function as well
+// (See: CodeSearchOracle.java)
+int scoreMatch(std::string const& suggestion,
+               std::string const& query,
+               bool isFile)
+{
+   // No penalty for perfect matches
+   if (suggestion == query)
+      return 0;
+
+   // Penalties which depend only on the suggestion are applied to every
+   // matched character; compute them once up front
+   int suggestionPenalty = 0;
+
+   // More penalty for 'uninteresting' files
+   if (suggestion == "RcppExports.R" ||
+       suggestion == "RcppExports.cpp")
+      suggestionPenalty += 6;
+
+   // More penalty for 'uninteresting' extensions (e.g. .Rd)
+   std::string::size_type lastDotIndex = suggestion.rfind('.');
+   if (lastDotIndex != std::string::npos &&
+       suggestion.length() - lastDotIndex == 3 &&
+       std::tolower(suggestion[lastDotIndex + 1]) == 'r' &&
+       std::tolower(suggestion[lastDotIndex + 2]) == 'd')
+      suggestionPenalty += 6;
+
+   int totalPenalty = 0;
+   int matchCount = 0;
+
+   // Loop over the (greedy, left-to-right) subsequence matches of the
+   // query characters and assign a score
+   std::string::size_type prevMatchIndex = std::string::npos;
+   for (std::string::size_type i = 0, n = query.length(); i < n; i++)
+   {
+      std::string::size_type index = suggestion.find(query[i], prevMatchIndex + 1);
+      if (index == std::string::npos)
+         continue;
+      prevMatchIndex = index;
+
+      int j = matchCount++;
+      int matchPos = static_cast<int>(index);
+      int penalty = matchPos;
+
+      // Less penalty if character follows special delim
+      if (matchPos >= 1)
+      {
+         char prevChar = suggestion[matchPos - 1];
+         if (prevChar == '_' || prevChar == '-' || (!isFile && prevChar == '.'))
+         {
+            penalty = j + 1;
+         }
+      }
+
+      // Less penalty for perfect match (ie, reward case-sensitive match)
+      penalty -= suggestion[matchPos] == query[j];
+
+      totalPenalty += penalty + suggestionPenalty;
+   }
+
+   // Penalize files
+   if (isFile)
+      ++totalPenalty;
+
+   // Penalize unmatched characters
+   totalPenalty += static_cast<int>((query.size() - matchCount) * query.size());
+
+   return totalPenalty;
+}
+
+bool isRcppExportsContext(const std::string& context)
+{
+   return boost::algorithm::ends_with(context, "RcppExports.R") ||
+          boost::algorithm::ends_with(context, "RcppExports.cpp");
+}
+
 class SourceFileIndex : boost::noncopyable
 {
+private:
+   // file names are indexed along with whether they are source files
+   // (computed once, when the file is added)
+   struct FileName
+   {
+      FileName() : isSourceFile(false) {}
+      FileName(const std::string& path, bool isSourceFile)
+         : path(path), isSourceFile(isSourceFile)
+      {
+      }
+
+      std::string path;
+      bool isSourceFile;
+   };
+   typedef collection::FuzzyIndex<FileName> FileNames;
+
+   typedef std::pair<boost::shared_ptr<r_util::RSourceIndex>, std::size_t> SymbolRef;
+   typedef collection::FuzzyIndex<SymbolRef> SymbolNames;
+
 public:
    SourceFileIndex()
-      : pEntries_(new EntryTree()), indexing_(false)
+      : pEntries_(new EntryTree()),
+        generation_(0),
+        indexing_(false),
+        cacheLoaded_(false)
    {
    }
 
@@ -476,14 +578,35 @@ public:
    template <typename ForwardIterator>
    void enqueFiles(ForwardIterator begin, ForwardIterator end)
    {
-      // add all files to the indexing queue
+      // restore the indexes persisted by a previous session
+      loadCache();
+
+      // add all files to the indexing queue -- R source files which are
+      // unchanged since they were last indexed are restored from the cache
+      // immediately rather than queued for re-indexing
       using namespace rstudio::core::system;
+      std::set<std::string> paths;
+      bool restoredFromCache = false;
       for ( ; begin != end; ++begin)
       {
-         FileChangeEvent addEvent(FileChangeEvent::FileAdded, *begin);
+         const FileInfo& fileInfo = *begin;
+         paths.insert(fileInfo.absolutePath());
+         if (restoreIndexEntry(fileInfo))
+         {
+            restoredFromCache = true;
+            continue;
+         }
+
+         FileChangeEvent addEvent(FileChangeEvent::FileAdded, fileInfo);
          indexingQueue_.push(addEvent);
       }
 
+      // forget about files which no longer exist
+      cache_.retain(paths);
+
+      if (restoredFromCache)
+         r_packages::AsyncPackageInformationProcess::update();
+
       // schedule indexing if necessary. perform up to 200ms of work
       // immediately and then continue in periodic 20ms chunks until
       // we are completed.
@@ -769,6 +892,62 @@ public:
       }
    }
    
+   // Fuzzy search of project file names. Unlike searchFiles, which returns
+   // the first maxResults matches in tree order, this scores every matching
+   // file and returns the best maxResults (in order of score)
+   void searchFilesByScore(const std::string& term,
+                           std::size_t maxResults,
+                           bool sourceFilesOnly,
+                           std::vector<std::string>* pNames,
+                           std::vector<std::string>* pPaths,
+                           bool* pMoreAvailable)
+   {
+      // We allow the user to submit queries of the form e.g.
+      // <query>:<row><column>; only match on the query up to ':'
+      std::string query = term.substr(0, term.find(':'));
+
+      collection::TopScores<FileNames::Id> top(maxResults);
+      fileNames_.forEachSubsequenceMatch(
+               query,
+               boost::bind(&SourceFileIndex::scoreFileName,
+                           this, _1, term, sourceFilesOnly, &top));
+
+      typedef std::pair<int, FileNames::Id> ScoredId;
+      BOOST_FOREACH(const ScoredId& scored, top.sorted())
+      {
+         FilePath filePath(fileNames_.value(scored.second).path);
+         pNames->push_back(fileNames_.name(scored.second));
+         pPaths->push_back(module_context::createAliasedPath(filePath));
+      }
+
+      *pMoreAvailable = top.truncated();
+   }
+
+   // Fuzzy search of the symbols defined in project R files, returning the
+   // best maxResults (in order of score)
+   void searchSourceByScore(const std::string& term,
+                            std::size_t maxResults,
+                            const std::set<std::string>& excludeContexts,
+                            std::vector<r_util::RSourceItem>* pItems,
+                            bool* pMoreAvailable)
+   {
+      collection::TopScores<SymbolNames::Id> top(maxResults);
+      symbolNames_.forEachSubsequenceMatch(
+               term,
+               boost::bind(&SourceFileIndex::scoreSymbolName,
+                           this, _1, term, boost::cref(excludeContexts), &top));
+
+      typedef std::pair<int, SymbolNames::Id> ScoredId;
+      BOOST_FOREACH(const ScoredId& scored, top.sorted())
+      {
+         const SymbolRef& ref = symbolNames_.value(scored.second);
+         pItems->push_back(
+               ref.first->items()[ref.second].withContext(ref.first->context()));
+      }
+
+      *pMoreAvailable = top.truncated();
+   }
+
    void walkFiles(const FilePath& parentPath,
                   boost::function<void(const Entry&)> operation,
                   boost::function<bool(const Entry&)> filter = NULL)
@@ -793,9 +972,40 @@ public:
    
    void clear()
    {
+      // persist whatever we have indexed so far before dropping the cache
+      saveCache();
+      cache_.clear();
+      cacheLoaded_ = false;
+
       indexing_ = false;
       indexingQueue_ = std::queue<core::system::FileChangeEvent>();
       pEntries_->clear();
+
+      fileNames_.clear();
+      fileNameIds_.clear();
+      symbolNames_.clear();
+      symbolIds_.clear();
+
+      ++generation_;
+   }
+
+   // incremented whenever an entry is added, updated or removed
+   std::size_t generation() const
+   {
+      return generation_;
+   }
+
+   // persist the indexes (if they have changed since they were last saved).
+   // this is done periodically and at shutdown/suspend rather than every
+   // time the indexing queue drains
+   void saveCache()
+   {
+      if (!cacheLoaded_ || !cache_.dirty())
+         return;
+
+      Error error = cache_.write(cacheFilePath(), cacheTag());
+      if (error)
+         LOG_ERROR(error);
    }
 
 private:
@@ -837,6 +1047,123 @@ private:
       return indexing_;
    }
 
+   static FilePath cacheFilePath()
+   {
+      return module_context::scopedScratchPath().childPath(
+                                                   "source-index-cache");
+   }
+
+   static std::string cacheTag()
+   {
+      // indexes depend on the encoding used to read the source files
+      return projects::projectContext().defaultEncoding();
+   }
+
+   void loadCache()
+   {
+      if (cacheLoaded_)
+         return;
+
+      cacheLoaded_ = true;
+      Error error = cache_.read(cacheFilePath(), cacheTag());
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   bool restoreIndexEntry(const FileInfo& fileInfo)
+   {
+      if (fileInfo.isDirectory() || !hasIndexableExtension(fileInfo))
+         return false;
+
+      FilePath filePath(fileInfo.absolutePath());
+      boost::shared_ptr<r_util::RSourceIndex> pIndex = cache_.lookup(
+               fileInfo.absolutePath(),
+               fileInfo.lastWriteTime(),
+               fileInfo.size(),
+               module_context::createAliasedPath(filePath));
+      if (!pIndex)
+         return false;
+
+      if (isWithinIgnoredDirectory(filePath))
+         return false;
+
+      addEntry(Entry(fileInfo, pIndex));
+      return true;
+   }
+
+   void addEntry(const Entry& entry)
+   {
+      pEntries_->insertEntry(entry);
+      ++generation_;
+
+      if (entry.fileInfo.isDirectory())
+         return;
+
+      // (re)index the file and symbol names for fuzzy searches
+      const std::string& path = entry.fileInfo.absolutePath();
+      removeNames(path);
+
+      FilePath filePath(path);
+      FileName fileName(path,
+                        module_context::isUserFile(filePath) &&
+                        hasSourceFileName(filePath));
+      fileNameIds_[path] = fileNames_.insert(filePath.filename(), fileName);
+
+      if (entry.hasIndex())
+      {
+         std::vector<SymbolNames::Id>& ids = symbolIds_[path];
+         const std::vector<r_util::RSourceItem>& items = entry.pIndex->items();
+         for (std::size_t i = 0; i < items.size(); i++)
+         {
+            ids.push_back(symbolNames_.insert(items[i].name(),
+                                              SymbolRef(entry.pIndex, i)));
+         }
+      }
+   }
+
+   void removeNames(const std::string& path)
+   {
+      std::map<std::string, FileNames::Id>::iterator fileIt =
+            fileNameIds_.find(path);
+      if (fileIt != fileNameIds_.end())
+      {
+         fileNames_.remove(fileIt->second);
+         fileNameIds_.erase(fileIt);
+      }
+
+      std::map<std::string, std::vector<SymbolNames::Id> >::iterator symbolIt =
+            symbolIds_.find(path);
+      if (symbolIt != symbolIds_.end())
+      {
+         BOOST_FOREACH(SymbolNames::Id id, symbolIt->second)
+         {
+            symbolNames_.remove(id);
+         }
+         symbolIds_.erase(symbolIt);
+      }
+   }
+
+   void removeNamesWithin(const std::string& dirPath)
+   {
+      // collect the indexed paths below the directory (map keys are ordered
+      // so they form a contiguous range)
+      std::string prefix = dirPath + "/";
+      std::set<std::string> paths;
+      for (std::map<std::string, FileNames::Id>::const_iterator it =
+              fileNameIds_.lower_bound(prefix);
+           it != fileNameIds_.end() &&
+              boost::algorithm::starts_with(it->first, prefix);
+           ++it)
+      {
+         paths.insert(it->first);
+      }
+
+      BOOST_FOREACH(const std::string& path, paths)
+      {
+         removeNames(path);
+      }
+   }
+
    void updateIndexEntry(const FileInfo& fileInfo)
    {
       // index the source if necessary
@@ -869,14 +1196,17 @@ private:
             return;
          }
 
-         // add index entry
+         // add index entry (and remember it for future sessions)
          std::string context = module_context::createAliasedPath(filePath);
          pIndex.reset(new r_util::RSourceIndex(context, code));
+         cache_.update(fileInfo.absolutePath(),
+                       fileInfo.lastWriteTime(),
+                       fileInfo.size(),
+                       pIndex);
       }
 
       // attempt to add the entry
-      Entry entry(fileInfo, pIndex);
-      pEntries_->insertEntry(entry);
+      addEntry(Entry(fileInfo, pIndex));
 
       // kick off an update
       r_packages::AsyncPackageInformationProcess::update();
@@ -884,6 +1214,14 @@ private:
 
    void removeIndexEntry(const FileInfo& fileInfo)
    {
+      cache_.remove(fileInfo.absolutePath());
+      ++generation_;
+
+      if (fileInfo.isDirectory())
+         removeNamesWithin(fileInfo.absolutePath());
+      else
+         removeNames(fileInfo.absolutePath());
+
       // create a fake entry with a null source index to pass to find
       Entry entry(fileInfo, boost::shared_ptr<r_util::RSourceIndex>());
 
@@ -905,45 +1243,76 @@ private:
       if (!module_context::isUserFile(filePath))
          return false;
 
+      return !filePath.isDirectory() && hasSourceFileName(filePath);
+   }
+
+   static bool hasSourceFileName(const FilePath& filePath)
+   {
       // filter files by name and extension
       std::string ext = filePath.extensionLowerCase();
       std::string filename = filePath.filename();
-      return !filePath.isDirectory() &&
-              (ext == ".r" || ext == ".rnw" ||
-               ext == ".rmd" || ext == ".rmarkdown" ||
-               ext == ".rhtml" || ext == ".rd" ||
-               ext == ".h" || ext == ".hpp" ||
-               ext == ".c" || ext == ".cpp" ||
-               ext == ".json" || ext == ".tex" ||
-               ext == ".toml" || ext == ".scala" ||
-               filename == "DESCRIPTION" ||
-               filename == "NAMESPACE" ||
-               filename == "README" ||
-               filename == "NEWS" ||
-               filename == "Makefile" ||
-               filename == "configure" ||
-               filename == "configure.win" ||
-               filename == "cleanup" ||
-               filename == "cleanup.win" ||
-               filename == "Makevars" ||
-               filename == "Makevars.win" ||
-               filename == "LICENSE" ||
-               filename == "LICENCE" ||
-               filename == "CITATION" ||
-               filePath.hasTextMimeType());
+      return (ext == ".r" || ext == ".rnw" ||
+              ext == ".rmd" || ext == ".rmarkdown" ||
+              ext == ".rhtml" || ext == ".rd" ||
+              ext == ".h" || ext == ".hpp" ||
+              ext == ".c" || ext == ".cpp" ||
+              ext == ".json" || ext == ".tex" ||
+              ext == ".toml" || ext == ".scala" ||
+              filename == "DESCRIPTION" ||
+              filename == "NAMESPACE" ||
+              filename == "README" ||
+              filename == "NEWS" ||
+              filename == "Makefile" ||
+              filename == "configure" ||
+              filename == "configure.win" ||
+              filename == "cleanup" ||
+              filename == "cleanup.win" ||
+              filename == "Makevars" ||
+              filename == "Makevars.win" ||
+              filename == "LICENSE" ||
+              filename == "LICENCE" ||
+              filename == "CITATION" ||
+              filePath.hasTextMimeType());
+   }
+
+   void scoreFileName(FileNames::Id id,
+                      const std::string& term,
+                      bool sourceFilesOnly,
+                      collection::TopScores<FileNames::Id>* pTop) const
+   {
+      if (sourceFilesOnly && !fileNames_.value(id).isSourceFile)
+         return;
+
+      pTop->add(scoreMatch(fileNames_.name(id), term, true), id);
+   }
+
+   void scoreSymbolName(SymbolNames::Id id,
+                        const std::string& term,
+                        const std::set<std::string>& excludeContexts,
+                        collection::TopScores<SymbolNames::Id>* pTop) const
+   {
+      const std::string& context = symbolNames_.value(id).first->context();
+      if (isRcppExportsContext(context) || excludeContexts.count(context))
+         return;
+
+      pTop->add(scoreMatch(symbolNames_.name(id), term, false), id);
+   }
+
+   static bool hasIndexableExtension(const FileInfo& fileInfo)
+   {
+      std::string lowerExtension =
+            FilePath(fileInfo.absolutePath()).extensionLowerCase();
+      return
+            lowerExtension == ".r" ||
+            lowerExtension == ".s" ||
+            lowerExtension == ".q";
    }
 
    static bool isIndexableSourceFile(const FileInfo& fileInfo)
    {
       FilePath filePath(fileInfo.absolutePath());
       if (!filePath.isDirectory() && filePath.exists())
-      {
-         std::string lowerExtension = filePath.extensionLowerCase();
-         return
-               lowerExtension == ".r" ||
-               lowerExtension == ".s" ||
-               lowerExtension == ".q";
-      }
+         return hasIndexableExtension(fileInfo);
 
       return false;
 
@@ -956,10 +1325,22 @@ public:
 private:
    // index entries
    boost::shared_ptr<EntryTree> pEntries_;
+   std::size_t generation_;
 
    // indexing queue
    bool indexing_;
    std::queue<core::system::FileChangeEvent> indexingQueue_;
+
+   // persistent cache of indexes, keyed by path, last write time and size
+   bool cacheLoaded_;
+   r_util::RSourceIndexCache cache_;
+
+   // fuzzy indexes of file names and symbol names (keyed by absolute path
+   // so they can be updated as files change)
+   FileNames fileNames_;
+   std::map<std::string, FileNames::Id> fileNameIds_;
+   SymbolNames symbolNames_;
+   std::map<std::string, std::vector<SymbolNames::Id> > symbolIds_;
 };
 
 } // anonymous namespace
@@ -1278,64 +1659,6 @@ void searchFiles(const std::string& term,
    }
 }
 
-// NOTE: When modifying this code, you should ensure that corresponding
-// changes are made to the client side scoreMatch function as well
-// (See: CodeSearchOracle.java)
-int scoreMatch(std::string const& suggestion,
-               std::string const& query,
-               bool isFile)
-{
-   // No penalty for perfect matches
-   if (suggestion == query)
-      return 0;
-   
-   std::vector<int> matches =
-         string_utils::subsequenceIndices(suggestion, query);
-   
-   int totalPenalty = 0;
-
-   // Loop over the matches and assign a score
-   for (int j = 0, n = static_cast<int>(matches.size()); j < n; j++)
-   {
-      int matchPos = matches[j];
-      int penalty = matchPos;
-
-      // Less penalty if character follows special delim
-      if (matchPos >= 1)
-      {
-         char prevChar = suggestion[matchPos - 1];
-         if (prevChar == '_' || prevChar == '-' || (!isFile && prevChar == '.'))
-         {
-            penalty = j + 1;
-         }
-      }
-
-      // Less penalty for perfect match (ie, reward case-sensitive match)
-      penalty -= suggestion[matchPos] == query[j];
-      
-      // More penalty for 'uninteresting' files
-      if (suggestion == "RcppExports.R" ||
-          suggestion == "RcppExports.cpp")
-         penalty += 6;
-      
-      // More penalty for 'uninteresting' extensions (e.g. .Rd)
-      std::string extension = string_utils::getExtension(suggestion);
-      if (boost::algorithm::to_lower_copy(extension) == ".rd")
-         penalty += 6;
-
-      totalPenalty += penalty;
-   }
-   
-   // Penalize files
-   if (isFile)
-      ++totalPenalty;
-   
-   // Penalize unmatched characters
-   totalPenalty += static_cast<int>((query.size() - matches.size()) * query.size());
-
-   return totalPenalty;
-}
-
 struct ScorePairComparator
 {
    inline bool operator()(const std::pair<int, int> lhs,
@@ -1556,6 +1879,27 @@ json::Array toJsonArray(
 
 
 
+void searchSourceByScore(const std::string& term,
+                         std::size_t maxResults,
+                         std::vector<r_util::RSourceItem>* pItems,
+                         bool* pMoreAvailable)
+{
+   // search the source database (open documents) exhaustively
+   std::set<std::string> srcDBContexts;
+   searchSourceDatabase(term,
+                        std::numeric_limits<std::size_t>::max(),
+                        false,
+                        pItems,
+                        &srcDBContexts);
+
+   // then take the best scoring symbols from the rest of the project
+   s_projectIndex.searchSourceByScore(term,
+                                      maxResults,
+                                      srcDBContexts,
+                                      pItems,
+                                      pMoreAvailable);
+}
+
 Error searchCode(const json::JsonRpcRequest& request,
                  json::JsonRpcResponse* pResponse)
 {
@@ -1576,16 +1920,35 @@ Error searchCode(const json::JsonRpcRequest& request,
    std::vector<std::string> paths;
    bool moreFilesAvailable = false;
 
-   // TODO: Refactor searchSourceFiles, searchSource to no longer take maximum number
-   // of results (since we want to grab everything possible then filter before
-   // sending over the wire). Simiarly with the 'more*Available' bools
-   searchFiles(term, 100, true, &names, &paths, &moreFilesAvailable);
+   // when the project index is available use its fuzzy name indexes, which
+   // score every candidate and keep only the best; otherwise fall back to
+   // collecting the first 100 matches and scoring those
+   bool useProjectIndex =
+         session::projects::projectContext().hasFileMonitor() &&
+         term.find('*') == std::string::npos;
+
+   if (useProjectIndex)
+   {
+      s_projectIndex.searchFilesByScore(term,
+                                        maxResults,
+                                        true,
+                                        &names,
+                                        &paths,
+                                        &moreFilesAvailable);
+   }
+   else
+   {
+      searchFiles(term, 100, true, &names, &paths, &moreFilesAvailable);
+   }
 
    // search source and convert to source items
    std::vector<SourceItem> srcItems;
    std::vector<r_util::RSourceItem> rSrcItems;
    bool moreSourceItemsAvailable = false;
-   searchSource(term, 100, false, &rSrcItems, &moreSourceItemsAvailable);
+   if (useProjectIndex)
+      searchSourceByScore(term, maxResults, &rSrcItems, &moreSourceItemsAvailable);
+   else
+      searchSource(term, 100, false, &rSrcItems, &moreSourceItemsAvailable);
    std::transform(rSrcItems.begin(),
                   rSrcItems.end(),
                   std::back_inserter(srcItems),
@@ -1618,9 +1981,7 @@ Error searchCode(const json::JsonRpcRequest& request,
       const SourceItem& item = srcItems[i];
       
       // don't index auto-generated files
-      const std::string& context = item.context();
-      if (boost::algorithm::ends_with(context, "RcppExports.R") ||
-          boost::algorithm::ends_with(context, "RcppExports.cpp"))
+      if (isRcppExportsContext(item.context()))
          continue;
          
       int score = scoreMatch(item.name(), term, false);
@@ -1635,8 +1996,10 @@ Error searchCode(const json::JsonRpcRequest& request,
 
    filterScores(&fileScores, &srcItemScores, static_cast<int>(maxResults));
 
-   moreFilesAvailable = fileScoresSizeBefore > fileScores.size();
-   moreSourceItemsAvailable = srcItemScoresSizeBefore > srcItemScores.size();
+   moreFilesAvailable = moreFilesAvailable ||
+                        fileScoresSizeBefore > fileScores.size();
+   moreSourceItemsAvailable = moreSourceItemsAvailable ||
+                              srcItemScoresSizeBefore > srcItemScores.size();
 
    // get filtered results
    std::vector<std::string> namesFiltered;
@@ -2327,6 +2690,26 @@ void onFileMonitorDisabled()
    s_projectIndex.clear();
 }
 
+bool saveProjectIndexCache()
+{
+   s_projectIndex.saveCache();
+   return true;
+}
+
+void onShutdown(bool)
+{
+   s_projectIndex.saveCache();
+}
+
+void onSuspend(const r::session::RSuspendOptions&, core::Settings*)
+{
+   s_projectIndex.saveCache();
+}
+
+void onResume(const core::Settings&)
+{
+}
+
 SEXP rs_scoreMatches(SEXP suggestionsSEXP,
                      SEXP querySEXP)
 {
@@ -2497,6 +2880,15 @@ Error initialize()
    
    using boost::bind;
    using namespace module_context;
+
+   // persist the project index cache periodically (during idle time) as
+   // well as at shutdown and suspend
+   events().onShutdown.connect(onShutdown);
+   addSuspendHandler(SuspendHandler(onSuspend, onResume));
+   schedulePeriodicWork(boost::posix_time::minutes(5),
+                        saveProjectIndexCache,
+                        true,   // idle only
+                        false); // not immediate
    ExecBlock initBlock ;
    initBlock.addFunctions()
       (bind(registerRpcMethod, "search_code", searchCode))
@@ -2525,6 +2917,11 @@ void addAllProjectSymbols(const Entry& entry,
 
 } // namespace callbacks
 
+std::size_t projectSymbolsGeneration()
+{
+   return s_projectIndex.generation();
+}
+
 void addAllProjectSymbols(std::set<std::string>* pSymbols)
 {
    FilePath buildTarget = projects::projectContext().buildTargetPath();
@@ -111,6 +111,10 @@ void searchSource(const std::string& term,
 
 void addAllProjectSymbols(std::set<std::string>* pSymbols);
 
+// changes whenever the project index (and so the set of project
+// symbols) changes
+std::size_t projectSymbolsGeneration();
+
 core::Error initialize();
    
 } // namespace code_search
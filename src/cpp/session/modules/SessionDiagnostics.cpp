@@ -30,6 +30,7 @@
 #include <core/Exec.hpp>
 #include <core/Error.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/Thread.hpp>
 #include <core/YamlUtil.hpp>
 
 #include <session/SessionRUtil.hpp>
@@ -43,7 +44,9 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/range/adaptor/map.hpp>
+#include <boost/unordered_set.hpp>
 
 #include <r/RSexp.hpp>
 #include <r/RExec.hpp>
@@ -133,9 +136,142 @@ void checkDefinedButNotUsed(ParseResults& results)
    }
 }
 
+// The symbols available to a document are looked up in a number of hashed,
+// immutable layers (base packages, NAMESPACE imports, project symbols, the
+// search path, ...). Layers are shared between lint requests and only rebuilt
+// when the state they were built from changes; only the (small) set of
+// symbols specific to a document is assembled for each request.
+typedef boost::unordered_set<std::string> SymbolSet;
+typedef boost::shared_ptr<const SymbolSet> SymbolLayer;
+
+class AvailableSymbols : boost::noncopyable
+{
+public:
+   
+   void addLayer(const SymbolLayer& pLayer)
+   {
+      if (pLayer && !pLayer->empty())
+         layers_.push_back(pLayer);
+   }
+   
+   std::set<std::string>* localSymbols()
+   {
+      return &localSymbols_;
+   }
+   
+   bool contains(const std::string& symbol) const
+   {
+      if (localSymbols_.count(symbol))
+         return true;
+      
+      BOOST_FOREACH(const SymbolLayer& pLayer, layers_)
+      {
+         if (pLayer->count(symbol))
+            return true;
+      }
+      
+      return false;
+   }
+   
+private:
+   std::vector<SymbolLayer> layers_;
+   std::set<std::string> localSymbols_;
+};
+
+template <typename Container>
+SymbolLayer createSymbolLayer(const Container& symbols)
+{
+   return SymbolLayer(new SymbolSet(symbols.begin(), symbols.end()));
+}
+
+// a layer along with the state it was built from
+template <typename Key>
+struct CachedSymbolLayer
+{
+   CachedSymbolLayer() : valid(false) {}
+   
+   bool isCurrent(const Key& currentKey) const
+   {
+      return valid && key == currentKey;
+   }
+   
+   void update(const Key& currentKey, const SymbolLayer& pCurrentLayer)
+   {
+      key = currentKey;
+      pLayer = pCurrentLayer;
+      valid = true;
+   }
+   
+   bool valid;
+   Key key;
+   SymbolLayer pLayer;
+};
+
+// incremented when the search path changes (as packages and environments
+// are attached and detached) and as packages are loaded, since either may
+// change the symbols available to R code
+std::size_t s_searchPathGeneration = 0;
+std::size_t s_packageLoadCount = 0;
+
+// the search path as of the last console prompt
+std::vector<std::string> s_searchPath;
+
+void onConsolePrompt(const std::string&)
+{
+   // most console input leaves the search path alone so only treat it as
+   // having changed the available symbols if the search path has changed
+   std::vector<std::string> searchPath;
+   Error error = r::exec::RFunction("search").call(&searchPath);
+   if (error)
+   {
+      LOG_ERROR(error);
+      ++s_searchPathGeneration;
+      return;
+   }
+   
+   if (searchPath != s_searchPath)
+   {
+      s_searchPath.swap(searchPath);
+      ++s_searchPathGeneration;
+   }
+}
+
+void onPackageLoaded(const std::string&)
+{
+   ++s_packageLoadCount;
+}
+
+// exports and datasets of a package, as gathered by the async package
+// information process
+SymbolLayer packageInformationLayer(const std::string& package)
+{
+   static std::map<std::string, SymbolLayer> s_layers;
+   static std::size_t s_generation = 0;
+   
+   if (s_generation != RSourceIndex::getPackageInformationGeneration())
+   {
+      s_layers.clear();
+      s_generation = RSourceIndex::getPackageInformationGeneration();
+   }
+   
+   SymbolLayer& pLayer = s_layers[package];
+   if (!pLayer)
+   {
+      const PackageInformation& pkgInfo =
+            RSourceIndex::getPackageInformation(package);
+      
+      boost::shared_ptr<SymbolSet> pSymbols(new SymbolSet());
+      pSymbols->insert(pkgInfo.exports.begin(), pkgInfo.exports.end());
+      pSymbols->insert(pkgInfo.datasets.begin(), pkgInfo.datasets.end());
+      pLayer = pSymbols;
+   }
+   
+   return pLayer;
+}
+
 void addInferredSymbols(const FilePath& filePath,
                         const std::string& documentId,
-                        std::set<std::string>* pSymbols)
+                        AvailableSymbols* pAvailable)
 {
    using namespace code_search;
    using namespace source_database;
@@ -154,34 +290,35 @@ void addInferredSymbols(const FilePath& filePath,
    // 'library' calls, and add those here.
    BOOST_FOREACH(const std::string& package, pIndex->getInferredPackages())
    {
-      const PackageInformation& completions =
-            pIndex->getPackageInformation(package);
-      
-      core::algorithm::append(pSymbols, completions.exports);
-      core::algorithm::append(pSymbols, completions.datasets);
+      pAvailable->addLayer(packageInformationLayer(package));
    }
    
    // make 'shiny' implicitly available in shiny documents
    if (modules::shiny::getShinyFileType(filePath) != modules::shiny::ShinyNone)
-   {
-      const PackageInformation& completions = pIndex->getPackageInformation("shiny");
-      pSymbols->insert(completions.exports.begin(), completions.exports.end());
-   }
+      pAvailable->addLayer(packageInformationLayer("shiny"));
    
    // make 'params' implicitly available if we have a YAML header
    if (yaml::hasYamlHeader(filePath))
-      pSymbols->insert("params");
+      pAvailable->localSymbols()->insert("params");
    
    // make 'input', 'output' implicitly available in Shiny documents
    if (modules::shiny::isShinyRMarkdownDocument(filePath))
    {
-      pSymbols->insert("input");
-      pSymbols->insert("output");
+      pAvailable->localSymbols()->insert("input");
+      pAvailable->localSymbols()->insert("output");
    }
 }
 
-void addNamespaceSymbols(std::set<std::string>* pSymbols)
+SymbolLayer namespaceSymbolsLayer()
 {
+   static CachedSymbolLayer<std::size_t> s_cache;
+   
+   std::size_t generation = RSourceIndex::getPackageInformationGeneration();
+   if (s_cache.isCurrent(generation))
+      return s_cache.pLayer;
+   
+   boost::shared_ptr<SymbolSet> pSymbols(new SymbolSet());
+   
    // Add symbols specifically mentioned as 'importFrom'
    // directives in the NAMESPACE.
    BOOST_FOREACH(const std::set<std::string>& symbolNames,
@@ -200,62 +337,63 @@ void addNamespaceSymbols(std::set<std::string>* pSymbols)
             RSourceIndex::getPackageInformation(package);
       
       DEBUG("--- Adding " << pkgInfo.exports.size() << " symbols");
-      core::algorithm::append(pSymbols, pkgInfo.exports);
-      core::algorithm::append(pSymbols, pkgInfo.datasets);
+      pSymbols->insert(pkgInfo.exports.begin(), pkgInfo.exports.end());
+      pSymbols->insert(pkgInfo.datasets.begin(), pkgInfo.datasets.end());
    }
+   
+   s_cache.update(generation, pSymbols);
+   return pSymbols;
 }
 
 class PackageSymbolRegistry : boost::noncopyable
 {
 public:
    
-   typedef std::map<std::string, std::vector<std::string> > Registry;
+   typedef std::map<std::string, SymbolLayer> Registry;
    
-   void fillPackageSymbols(const std::string& pkgName,
-                           std::set<std::string>* pOutput)
+   SymbolLayer packageSymbols(const std::string& pkgName)
    {
       if (!registry_.count(pkgName))
       {
          SEXP envSEXP = r::sexp::asEnvironment(pkgName);
          if (envSEXP == R_EmptyEnv)
-            return;
+            return SymbolLayer();
          
-         Error error = r::sexp::objects(envSEXP, true, &registry_[pkgName]);
+         std::vector<std::string> symbols;
+         Error error = r::sexp::objects(envSEXP, true, &symbols);
          if (error) LOG_ERROR(error);
+         
+         registry_[pkgName] = createSymbolLayer(symbols);
       }
       
-      const std::vector<std::string>& symbols = registry_[pkgName];
-      pOutput->insert(
-               symbols.begin(),
-               symbols.end());
+      return registry_[pkgName];
    }
    
-   void fillNamespaceSymbols(const std::string& pkgName,
-                             std::set<std::string>* pOutput,
-                             bool exportsOnly = true)
+   SymbolLayer namespaceSymbols(const std::string& pkgName,
+                                bool exportsOnly = true)
    {
       if (!registry_.count(pkgName))
       {
          SEXP envSEXP = r::sexp::asNamespace(pkgName);
          if (envSEXP == R_EmptyEnv)
-            return;
-
+            return SymbolLayer();
+         
+         std::vector<std::string> symbols;
          if (exportsOnly)
          {
-            Error error = r::sexp::getNamespaceExports(envSEXP, &registry_[pkgName]);
+            Error error = r::sexp::getNamespaceExports(envSEXP, &symbols);
             if (error) LOG_ERROR(error);
          }
          else
          {
-            Error error = r::sexp::objects(envSEXP, true, &registry_[pkgName]);
+            Error error = r::sexp::objects(envSEXP, true, &symbols);
             if (error) LOG_ERROR(error);
          }
+         
+         registry_[pkgName] = createSymbolLayer(symbols);
       }
       
-      const std::vector<std::string>& symbols = registry_[pkgName];
-      pOutput->insert(
-               symbols.begin(),
-               symbols.end());
+      return registry_[pkgName];
    }
    
 private:
@@ -268,16 +406,55 @@ PackageSymbolRegistry& packageSymbolRegistry()
    return instance;
 }
 
-void addBaseSymbols(std::set<std::string>* pSymbols)
+void addBaseSymbols(AvailableSymbols* pAvailable)
 {
    PackageSymbolRegistry& registry = packageSymbolRegistry();
-   registry.fillPackageSymbols("base", pSymbols);
-   registry.fillPackageSymbols("datasets", pSymbols);
-   registry.fillPackageSymbols("graphics", pSymbols);
-   registry.fillPackageSymbols("grDevices", pSymbols);
-   registry.fillPackageSymbols("methods", pSymbols);
-   registry.fillPackageSymbols("stats", pSymbols);
-   registry.fillPackageSymbols("utils", pSymbols);
+   pAvailable->addLayer(registry.packageSymbols("base"));
+   pAvailable->addLayer(registry.packageSymbols("datasets"));
+   pAvailable->addLayer(registry.packageSymbols("graphics"));
+   pAvailable->addLayer(registry.packageSymbols("grDevices"));
+   pAvailable->addLayer(registry.packageSymbols("methods"));
+   pAvailable->addLayer(registry.packageSymbols("stats"));
+   pAvailable->addLayer(registry.packageSymbols("utils"));
+}
+
+// top-level symbols within the project (these also include native routines
+// registered by the package, which can change as the package is re-loaded)
+SymbolLayer projectSymbolsLayer()
+{
+   typedef std::pair<std::size_t, std::size_t> Key;
+   static CachedSymbolLayer<Key> s_cache;
+   
+   Key key(code_search::projectSymbolsGeneration(), s_packageLoadCount);
+   if (s_cache.isCurrent(key))
+      return s_cache.pLayer;
+   
+   std::set<std::string> symbols;
+   code_search::addAllProjectSymbols(&symbols);
+   
+   s_cache.update(key, createSymbolLayer(symbols));
+   return s_cache.pLayer;
+}
+
+// all symbols available on the search path
+Error searchPathSymbolsLayer(SymbolLayer* pLayer)
+{
+   typedef std::pair<std::size_t, std::size_t> Key;
+   static CachedSymbolLayer<Key> s_cache;
+   
+   Key key(s_searchPathGeneration, s_packageLoadCount);
+   if (!s_cache.isCurrent(key))
+   {
+      std::vector<std::string> symbols;
+      Error error = r::exec::RFunction(".rs.availableRSymbols").call(&symbols);
+      if (error)
+         return error;
+      
+      s_cache.update(key, createSymbolLayer(symbols));
+   }
+   
+   *pLayer = s_cache.pLayer;
+   return Success();
 }
 
 void addRcppExportedSymbols(const FilePath& filePath,
@@ -329,20 +506,20 @@ void addRcppExportedSymbols(const FilePath& filePath,
 // since they would not get properly resolved at runtime.
 Error getAvailableSymbolsForPackage(const FilePath& filePath,
                                     const std::string& documentId,
-                                    std::set<std::string>* pSymbols)
+                                    AvailableSymbols* pAvailable)
 {
    // Add project symbols (ie, top-level symbols within an R package)
-   code_search::addAllProjectSymbols(pSymbols);
+   pAvailable->addLayer(projectSymbolsLayer());
    
    // Symbols inferred from the NAMESPACE (importFrom, import)
-   addNamespaceSymbols(pSymbols);
+   pAvailable->addLayer(namespaceSymbolsLayer());
    
    // Add symbols made available by explicit `library()` calls
    // within this document.
-   addInferredSymbols(filePath, documentId, pSymbols);
+   addInferredSymbols(filePath, documentId, pAvailable);
    
    // Add in symbols that would be made available by `// [[Rcpp::export]]`
-   addRcppExportedSymbols(filePath, documentId, pSymbols);
+   addRcppExportedSymbols(filePath, documentId, pAvailable->localSymbols());
    
    // Symbols that are 'automatically' made available to packages. In other
    // words, symbols that packages can use without explicitly importing them.
@@ -352,7 +529,7 @@ Error getAvailableSymbolsForPackage(const FilePath& filePath,
    //
    //     base, graphics, grDevices, methods, stats, stats4, utils
    //
-   addBaseSymbols(pSymbols);
+   addBaseSymbols(pAvailable);
    
    return Success();
 }
@@ -362,24 +539,26 @@ Error getAvailableSymbolsForPackage(const FilePath& filePath,
 // the current search path.
 Error getAvailableSymbolsForProject(const FilePath& filePath,
                                     const std::string& documentId,
-                                    std::set<std::string>* pSymbols)
+                                    AvailableSymbols* pAvailable)
 {
    // Get all available symbols on the search path.
-   Error error = r::exec::RFunction(".rs.availableRSymbols").call(pSymbols);
+   SymbolLayer pSearchPathSymbols;
+   Error error = searchPathSymbolsLayer(&pSearchPathSymbols);
    if (error)
       return error;
+   pAvailable->addLayer(pSearchPathSymbols);
    
    // Add in symbols that would be made available by `// [[Rcpp::export]]`
-   addRcppExportedSymbols(filePath, documentId, pSymbols);
+   addRcppExportedSymbols(filePath, documentId, pAvailable->localSymbols());
    
    // Get all of the symbols made available by `library()` calls
    // within this document.
-   addInferredSymbols(filePath, documentId, pSymbols);
+   addInferredSymbols(filePath, documentId, pAvailable);
    
    return Success();
 }
 
-void addTestPackageSymbols(std::set<std::string>* pSymbols)
+void addTestPackageSymbols(AvailableSymbols* pAvailable)
 {
    if (!projects::projectContext().isPackageProject())
       return;
@@ -396,17 +575,17 @@ void addTestPackageSymbols(std::set<std::string>* pSymbols)
    packageFields += pkgInfo.suggests();
    
    if (packageFields.find("testthat") != std::string::npos)
-      registry.fillNamespaceSymbols("testthat", pSymbols, false);
+      pAvailable->addLayer(registry.namespaceSymbols("testthat", false));
    else if (packageFields.find("RUnit") != std::string::npos)
-      registry.fillNamespaceSymbols("RUnit", pSymbols, false);
+      pAvailable->addLayer(registry.namespaceSymbols("RUnit", false));
    else if (packageFields.find("assertthat") != std::string::npos)
-      registry.fillNamespaceSymbols("assertthat", pSymbols, false);
+      pAvailable->addLayer(registry.namespaceSymbols("assertthat", false));
 }
 
 Error getAllAvailableRSymbols(const FilePath& filePath,
                               const std::string& documentId,
                               const ParseResults& results,
-                              std::set<std::string>* pSymbols)
+                              AvailableSymbols* pAvailable)
 {
    // If this file lies within the current project, then
    // we want to pull symbols from specific places -- specifically,
@@ -421,12 +600,12 @@ Error getAllAvailableRSymbols(const FilePath& filePath,
    if (projects::projectContext().isPackageProject() && filePath.isWithin(projDir))
    {
       DEBUG("- Package file: '" << filePath.absolutePath() << "'");
-      error = getAvailableSymbolsForPackage(filePath, documentId, pSymbols);
+      error = getAvailableSymbolsForPackage(filePath, documentId, pAvailable);
    }
    else
    {
       DEBUG("- Project file: '" << filePath.absolutePath() << "'");
-      error = getAvailableSymbolsForProject(filePath, documentId, pSymbols);
+      error = getAvailableSymbolsForProject(filePath, documentId, pAvailable);
    }
    
    if (error) LOG_ERROR(error);
@@ -437,13 +616,13 @@ Error getAllAvailableRSymbols(const FilePath& filePath,
    if (filePath.isWithin(projDir.childPath("inst")) ||
        filePath.isWithin(projDir.childPath("tests")))
    {
-      addTestPackageSymbols(pSymbols);
+      addTestPackageSymbols(pAvailable);
    }
    
    if (filePath.isWithin(projects::projectContext().directory().childPath("tests/testthat")))
    {
       PackageSymbolRegistry& registry = packageSymbolRegistry();
-      registry.fillNamespaceSymbols("testthat", pSymbols, false);
+      pAvailable->addLayer(registry.namespaceSymbols("testthat", false));
    }
    
    // If the file is named 'server.R', 'ui.R' or 'app.R', we'll implicitly
@@ -456,10 +635,10 @@ Error getAllAvailableRSymbols(const FilePath& filePath,
        basename == "app.r")
    {
       PackageSymbolRegistry& registry = packageSymbolRegistry();
-      registry.fillNamespaceSymbols("shiny", pSymbols, false);
+      pAvailable->addLayer(registry.namespaceSymbols("shiny", false));
    }
    
-   pSymbols->insert(results.globals().begin(), results.globals().end());
+   pAvailable->localSymbols()->insert(results.globals().begin(), results.globals().end());
    
    return error;
       
@@ -477,7 +656,7 @@ void checkNoDefinitionInScope(const FilePath& origin,
    // Now, find all available R symbols -- that is, objects on the search path,
    // or symbols that would otherwise be made available at runtime (e.g.
    // package imports)
-   std::set<std::string> objects;
+   AvailableSymbols objects;
    Error error = getAllAvailableRSymbols(origin, documentId, results, &objects);
    if (error)
    {
@@ -491,7 +670,7 @@ void checkNoDefinitionInScope(const FilePath& origin,
    {
       if (!r::util::isRKeyword(item.symbol) &&
           !r::util::isWindowsOnlyFunction(item.symbol) &&
-          objects.count(string_utils::strippedOfBackQuotes(item.symbol)) == 0)
+          !objects.contains(string_utils::strippedOfBackQuotes(item.symbol)))
       {
          addUnreferencedSymbol(item, results.lint());
       }
@@ -632,14 +811,96 @@ void setFileLocalParseOptions(const std::wstring& rCode,
    applyOptions(options, pOptions);
 }
 
-} // end anonymous namespace
+// state, other than the contents of a document, that the parse of a
+// document depends on (the parser consults the packages loaded by the
+// document, the package information index and the search path)
+struct ParseContext
+{
+   ParseContext()
+      : packageInformationGeneration(0),
+        searchPathGeneration(0),
+        packageLoadCount(0)
+   {
+   }
+   
+   bool operator==(const ParseContext& other) const
+   {
+      return packageInformationGeneration == other.packageInformationGeneration &&
+             searchPathGeneration == other.searchPathGeneration &&
+             packageLoadCount == other.packageLoadCount &&
+             filePath == other.filePath &&
+             inferredPackages == other.inferredPackages;
+   }
+   
+   bool operator!=(const ParseContext& other) const
+   {
+      return !(*this == other);
+   }
+   
+   std::size_t packageInformationGeneration;
+   std::size_t searchPathGeneration;
+   std::size_t packageLoadCount;
+   std::string filePath;
+   std::vector<std::string> inferredPackages;
+};
 
-ParseResults parse(const std::wstring& rCode,
-                   const FilePath& origin,
-                   const std::string& documentId = std::string(),
-                   bool isExplicit = false)
+ParseContext currentParseContext(const FilePath& filePath)
+{
+   ParseContext context;
+   context.packageInformationGeneration = RSourceIndex::getPackageInformationGeneration();
+   context.searchPathGeneration = s_searchPathGeneration;
+   context.packageLoadCount = s_packageLoadCount;
+   context.filePath = filePath.absolutePath();
+   
+   if (filePath.exists())
+   {
+      boost::shared_ptr<RSourceIndex> pIndex =
+            code_search::rSourceIndex().get(filePath);
+      
+      if (pIndex)
+         context.inferredPackages = pIndex->getInferredPackages();
+   }
+   
+   return context;
+}
+
+// the parse of each open document, retained so that documents can be
+// re-linted by parsing only the top-level expressions that have changed
+struct DocumentParseCache
+{
+   ParseContext context;
+   boost::shared_ptr<ParseCache> pCache;
+};
+
+std::map<std::string, DocumentParseCache> s_documentParseCaches;
+
+ParseCache* documentParseCache(const FilePath& filePath,
+                               const std::string& documentId)
+{
+   ParseContext context = currentParseContext(filePath);
+   
+   DocumentParseCache& cache = s_documentParseCaches[documentId];
+   if (!cache.pCache)
+      cache.pCache.reset(new ParseCache());
+   else if (cache.context != context)
+      cache.pCache->clear();
+   
+   cache.context = context;
+   return cache.pCache.get();
+}
+
+void onDocRemoved(const std::string& id, const std::string&)
+{
+   s_documentParseCaches.erase(id);
+}
+
+void onRemoveAll()
+{
+   s_documentParseCaches.clear();
+}
+
+ParseOptions defaultParseOptions(bool isExplicit)
 {
-   ParseResults results;
    ParseOptions options;
    
    options.setLintRFunctions(
@@ -657,13 +918,17 @@ ParseResults parse(const std::wstring& rCode,
    options.setRecordStyleLint(
             userSettings().enableStyleDiagnostics());
    
-   bool noLint = false;
-   setFileLocalParseOptions(rCode, &options, &noLint);
-   if (noLint)
-      return ParseResults();
-   
-   results = rparser::parse(origin, rCode, options);
-   
+   return options;
+}
+
+// add the lint that requires the complete parse tree (and, for unresolved
+// symbols, R) to the results of parsing 'rCode'
+ParseResults checkParseResults(const std::wstring& rCode,
+                               const FilePath& origin,
+                               const std::string& documentId,
+                               const ParseOptions& options,
+                               ParseResults results)
+{
    ParseNode* pRoot = results.parseTree();
    if (!pRoot)
    {
@@ -690,6 +955,29 @@ ParseResults parse(const std::wstring& rCode,
    return results;
 }
 
+} // end anonymous namespace
+
+ParseResults parse(const std::wstring& rCode,
+                   const FilePath& origin,
+                   const std::string& documentId = std::string(),
+                   bool isExplicit = false)
+{
+   ParseResults results;
+   ParseOptions options = defaultParseOptions(isExplicit);
+   
+   bool noLint = false;
+   setFileLocalParseOptions(rCode, &options, &noLint);
+   if (noLint)
+      return ParseResults();
+   
+   if (documentId.empty())
+      results = rparser::parse(origin, rCode, options);
+   else
+      results = rparser::parse(origin, rCode, options, documentParseCache(origin, documentId));
+   
+   return checkParseResults(rCode, origin, documentId, options, results);
+}
+
 ParseResults parse(const std::string& rCode,
                    const FilePath& origin,
                    const std::string& documentId)
@@ -970,32 +1258,243 @@ void afterSessionInitHook(bool newSession)
    }
 }
 
-bool collectLint(int depth,
-                 const FilePath& path,
-                 std::map<FilePath, LintItems>* pLint)
+// maximum number of threads used to read and tokenize files during a
+// project-wide lint (parsing and linting itself happens on the main thread,
+// as the parser may need to call into R)
+const std::size_t kMaxLintThreads = 8;
+
+// the state, other than a file's contents, that the lint for a file
+// depends on
+struct LintContext
+{
+   LintContext()
+      : packageInformationGeneration(0),
+        searchPathGeneration(0),
+        packageLoadCount(0),
+        projectSymbolsGeneration(0)
+   {
+   }
+   
+   bool operator==(const LintContext& other) const
+   {
+      return packageInformationGeneration == other.packageInformationGeneration &&
+             searchPathGeneration == other.searchPathGeneration &&
+             packageLoadCount == other.packageLoadCount &&
+             projectSymbolsGeneration == other.projectSymbolsGeneration &&
+             options.parsesLike(other.options) &&
+             options.warnIfVariableIsDefinedButNotUsed() ==
+                other.options.warnIfVariableIsDefinedButNotUsed();
+   }
+   
+   bool operator!=(const LintContext& other) const
+   {
+      return !(*this == other);
+   }
+   
+   std::size_t packageInformationGeneration;
+   std::size_t searchPathGeneration;
+   std::size_t packageLoadCount;
+   std::size_t projectSymbolsGeneration;
+   ParseOptions options;
+};
+
+LintContext currentLintContext()
+{
+   LintContext context;
+   context.packageInformationGeneration = RSourceIndex::getPackageInformationGeneration();
+   context.searchPathGeneration = s_searchPathGeneration;
+   context.packageLoadCount = s_packageLoadCount;
+   context.projectSymbolsGeneration = code_search::projectSymbolsGeneration();
+   context.options = defaultParseOptions(true);
+   return context;
+}
+
+// lint from previous project-wide lints, keyed by file path (and valid only
+// for the file contents, and the context, it was generated from)
+struct CachedLint
 {
-   if (path.extensionLowerCase() != ".r")
-      return true;
+   CachedLint() : hash(0), size(0) {}
+   
+   std::size_t hash;
+   std::size_t size;
+   LintItems lint;
+};
+
+LintContext s_lintCacheContext;
+std::map<std::string, CachedLint> s_lintCache;
+
+// a file to be linted. files are read, hashed and tokenized by worker threads
+// (which skip tokenizing files whose lint is cached)
+struct LintTarget
+{
+   explicit LintTarget(const FilePath& path)
+      : path(path), hash(0), size(0), cached(false)
+   {
+   }
    
+   FilePath path;
+   Error error;
+   std::size_t hash;
+   std::size_t size;
+   bool cached;
+   std::wstring code;
+   boost::shared_ptr<RTokens> pTokens;
+};
+
+void prepareLintTarget(LintTarget* pTarget)
+{
    std::string contents;
-   Error error = core::readStringFromFile(
-            path,
+   pTarget->error = core::readStringFromFile(
+            pTarget->path,
             &contents,
             string_utils::LineEndingPosix);
    
-   if (error)
+   if (pTarget->error)
+      return;
+   
+   pTarget->hash = boost::hash<std::string>()(contents);
+   pTarget->size = contents.size();
+   
+   // (the cache isn't modified while workers are running)
+   std::map<std::string, CachedLint>::const_iterator it =
+         s_lintCache.find(pTarget->path.absolutePath());
+   
+   if (it != s_lintCache.end() &&
+       it->second.hash == pTarget->hash &&
+       it->second.size == pTarget->size)
    {
-      LOG_ERROR(error);
-      return true;
+      pTarget->cached = true;
+      return;
    }
    
-   ParseResults results = diagnostics::parse(
-            string_utils::utf8ToWide(contents),
-            path,
-            std::string(),
-            true);
+   pTarget->code = string_utils::utf8ToWide(contents);
+   if (pTarget->code.find_first_not_of(L" \r\n\t\v") != std::wstring::npos)
+      pTarget->pTokens.reset(new RTokens(pTarget->code, RTokens::StripComments));
+}
+
+void prepareLintTargets(std::vector<LintTarget>* pTargets,
+                        std::size_t* pNextTarget,
+                        boost::mutex* pMutex)
+{
+   try
+   {
+      for (;;)
+      {
+         std::size_t index = 0;
+         LOCK_MUTEX(*pMutex)
+         {
+            index = (*pNextTarget)++;
+         }
+         END_LOCK_MUTEX
+         
+         if (index >= pTargets->size())
+            return;
+         
+         prepareLintTarget(&(*pTargets)[index]);
+      }
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
+
+LintItems lintTarget(const LintTarget& target, const ParseOptions& defaultOptions)
+{
+   ParseOptions options = defaultOptions;
+   
+   bool noLint = false;
+   setFileLocalParseOptions(target.code, &options, &noLint);
+   if (noLint)
+      return LintItems();
+   
+   ParseResults results = target.pTokens ?
+            rparser::parse(target.path, *target.pTokens, options) :
+            rparser::parse(target.path, target.code, options);
+   
+   return checkParseResults(target.code, target.path, std::string(), options, results).lint();
+}
+
+} // anonymous namespace
+
+std::size_t lintFiles(const std::vector<FilePath>& paths,
+                      std::map<FilePath, LintItems>* pLint)
+{
+   LintContext context = currentLintContext();
+   if (context != s_lintCacheContext)
+   {
+      s_lintCache.clear();
+      s_lintCacheContext = context;
+   }
    
-   (*pLint)[path] = results.lint();
+   std::vector<LintTarget> targets;
+   targets.reserve(paths.size());
+   BOOST_FOREACH(const FilePath& path, paths)
+   {
+      targets.push_back(LintTarget(path));
+   }
+   
+   // read and tokenize the files on a pool of worker threads (falling back
+   // to this thread for any the workers didn't get to)
+   std::size_t nextTarget = 0;
+   boost::mutex mutex;
+   std::size_t threadCount = std::min(
+            std::max(boost::thread::hardware_concurrency(), 1u),
+            static_cast<unsigned int>(kMaxLintThreads));
+   
+   boost::thread_group threads;
+   for (std::size_t i = 0; i < threadCount && i < targets.size(); i++)
+   {
+      boost::thread* pThread = new boost::thread();
+      core::thread::safeLaunchThread(
+               boost::bind(prepareLintTargets, &targets, &nextTarget, &mutex),
+               pThread);
+      
+      // the launch failed (and was logged)
+      if (!pThread->joinable())
+      {
+         delete pThread;
+         break;
+      }
+      
+      threads.add_thread(pThread);
+   }
+   prepareLintTargets(&targets, &nextTarget, &mutex);
+   threads.join_all();
+   
+   // lint the files whose lint isn't already cached
+   std::size_t cachedCount = 0;
+   BOOST_FOREACH(const LintTarget& target, targets)
+   {
+      if (target.error)
+      {
+         LOG_ERROR(target.error);
+         continue;
+      }
+      
+      CachedLint& cached = s_lintCache[target.path.absolutePath()];
+      if (target.cached)
+      {
+         ++cachedCount;
+      }
+      else
+      {
+         cached.hash = target.hash;
+         cached.size = target.size;
+         cached.lint = lintTarget(target, context.options);
+      }
+      
+      (*pLint)[target.path] = cached.lint;
+   }
+   
+   return cachedCount;
+}
+
+namespace {
+
+bool collectRFile(int depth,
+                  const FilePath& path,
+                  std::vector<FilePath>* pPaths)
+{
+   if (path.extensionLowerCase() == ".r")
+      pPaths->push_back(path);
    return true;
 }
 
@@ -1006,15 +1505,18 @@ SEXP rs_lintDirectory(SEXP directorySEXP)
    if (!dirPath.exists())
       return R_NilValue;
    
-   std::map<FilePath, LintItems> lint;
+   std::vector<FilePath> paths;
    Error error = dirPath.childrenRecursive(
-            boost::bind(collectLint, _1, _2, &lint));
+            boost::bind(collectRFile, _1, _2, &paths));
    if (error)
    {
       LOG_ERROR(error);
       return R_NilValue;
    }
    
+   std::map<FilePath, LintItems> lint;
+   lintFiles(paths, &lint);
+   
    using namespace module_context;
    SourceMarkerSet markers = asSourceMarkerSet(lint);
    showSourceMarkers(markers, MarkerAutoSelectNone);
@@ -1030,6 +1532,10 @@ core::Error initialize()
    using namespace module_context;
    
    events().afterSessionInitHook.connect(afterSessionInitHook);
+   events().onConsolePrompt.connect(onConsolePrompt);
+   events().onPackageLoaded.connect(onPackageLoaded);
+   source_database::events().onDocRemoved.connect(onDocRemoved);
+   source_database::events().onRemoveAll.connect(onRemoveAll);
    
    session::projects::FileMonitorCallbacks cb;
    cb.onFilesChanged = onFilesChanged;
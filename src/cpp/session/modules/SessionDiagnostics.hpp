@@ -16,9 +16,13 @@
 #ifndef SESSION_MODULES_DIAGNOSTICS_HPP
 #define SESSION_MODULES_DIAGNOSTICS_HPP
 
+#include <map>
+#include <vector>
+
 namespace rstudio {
 namespace core {
    class Error;
+   class FilePath;
 }
 }
 
@@ -29,6 +33,23 @@ namespace diagnostics {
 
 core::Error initialize();
 
+} // namespace diagnostics
+
+namespace rparser {
+namespace linter {
+class LintItems;
+} // namespace linter
+} // namespace rparser
+
+namespace diagnostics {
+
+// lint R source files, re-using the lint of any which are unchanged since
+// they were last linted (provided that the context they were linted in, e.g.
+// the symbols on the search path, is unchanged too). returns the number of
+// files whose lint was re-used
+std::size_t lintFiles(const std::vector<core::FilePath>& paths,
+                      std::map<core::FilePath, rparser::linter::LintItems>* pLint);
+
 } // namespace diagnostics
 } // namespace modules
 } // namespace session
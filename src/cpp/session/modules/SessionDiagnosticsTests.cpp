@@ -23,10 +23,12 @@
 #include <core/FilePath.hpp>
 #include <core/system/FileScanner.hpp>
 #include <core/FileUtils.hpp>
+#include <core/FileSerializer.hpp>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
+#include <boost/format.hpp>
 
 #include <session/SessionOptions.hpp>
 #include "SessionRParser.hpp"
@@ -114,6 +116,32 @@ void lintRFilesInSubdirectory(const FilePath& path)
    }
 }
 
+std::string describeLint(const LintItems& lint)
+{
+   std::string description;
+   BOOST_FOREACH(const LintItem& item, lint)
+   {
+      description += boost::str(boost::format("%1%:%2%-%3%:%4% %5%\n") %
+                                item.startRow % item.startColumn %
+                                item.endRow % item.endColumn %
+                                item.message);
+   }
+   return description;
+}
+
+// parse each version of a document incrementally, and check that the results
+// match those of a full parse
+void expectIncrementalParsesMatch(const std::vector<std::wstring>& versions,
+                                  ParseCache* pCache)
+{
+   BOOST_FOREACH(const std::wstring& code, versions)
+   {
+      ParseResults expected = parse(FilePath(), code, s_parseOptions);
+      ParseResults actual = parse(FilePath(), code, s_parseOptions, pCache);
+      expect_true(describeLint(actual.lint()) == describeLint(expected.lint()));
+   }
+}
+
 void lintRStudioRFiles()
 {
    lintRFilesInSubdirectory(options().coreRSourcePath());
@@ -276,6 +304,73 @@ context("Diagnostics")
       EXPECT_NO_LINT("function() { i <- 1; function() { data[i] } }");
    }
    
+   test_that("incremental parses re-use unchanged top-level expressions")
+   {
+      ParseCache cache;
+      
+      std::vector<std::wstring> versions;
+      versions.push_back(L"a <- 1\nf <- function(x) {\n  x + a\n}\nf(b)\n");
+      
+      // insert a line above the function (positions shift down)
+      versions.push_back(L"a <- 1\nb <- 2\nf <- function(x) {\n  x + a\n}\nf(b)\n");
+      
+      // break, then repair, an expression within the function
+      versions.push_back(L"a <- 1\nb <- 2\nf <- function(x) {\n  x + \n}\nf(b)\n");
+      versions.push_back(L"a <- 1\nb <- 2\nf <- function(x) {\n  x + a + b\n}\nf(b)\n");
+      
+      // remove a definition that later expressions depend on
+      versions.push_back(L"a <- 1\nf <- function(x) {\n  x + a + b\n}\nf(b)\n");
+      versions.push_back(L"");
+      versions.push_back(L"if (a)\n  1 else\n  2\nfor (i in 1:10)\n  print(i)\n");
+      
+      expectIncrementalParsesMatch(versions, &cache);
+      
+      // an edit re-parses only the edited expression and those using
+      // the symbols it defines
+      parse(FilePath(), L"a <- 1\nb <- 2\nc <- a + b\nprint(c)\n", s_parseOptions, &cache);
+      parse(FilePath(), L"a <- 1\nb <- 3\nc <- a + b\nprint(c)\n", s_parseOptions, &cache);
+      expect_true(cache.size() == 4);
+      expect_true(cache.reparsedCount() == 2);
+   }
+   
+   test_that("pre-tokenized code is parsed as the code itself")
+   {
+      std::wstring code = L"f <- function(x) {\n  x +\n}\n# comment\nf(y)\n";
+      RTokens rTokens(code, RTokens::StripComments);
+      
+      ParseResults expected = parse(FilePath(), code, s_parseOptions);
+      ParseResults actual = parse(FilePath(), rTokens, s_parseOptions);
+      expect_true(describeLint(actual.lint()) == describeLint(expected.lint()));
+   }
+   
+   test_that("unchanged files are re-linted from the cache")
+   {
+      FilePath dir;
+      expect_false(FilePath::tempFilePath(&dir));
+      expect_false(dir.ensureDirectory());
+      
+      FilePath path = dir.childPath("lint.R");
+      expect_false(writeStringToFile(path, "f <- function(x) {\n  x +\n}\n"));
+      std::vector<FilePath> paths;
+      paths.push_back(path);
+      
+      std::map<FilePath, LintItems> lint;
+      expect_true(lintFiles(paths, &lint) == 0);
+      expect_true(lint[path].hasErrors());
+      
+      std::map<FilePath, LintItems> relint;
+      expect_true(lintFiles(paths, &relint) == 1);
+      expect_true(describeLint(relint[path]) == describeLint(lint[path]));
+      
+      // a changed file is linted again
+      expect_false(writeStringToFile(path, "f <- function(x) {\n  x + 1\n}\n"));
+      relint.clear();
+      expect_true(lintFiles(paths, &relint) == 0);
+      expect_false(relint[path].hasErrors());
+      
+      dir.removeIfExists();
+   }
+   
    lintRStudioRFiles();
 }
 
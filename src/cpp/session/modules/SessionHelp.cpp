@@ -16,8 +16,10 @@
 #include "SessionHelp.hpp"
 
 #include <algorithm>
+#include <deque>
 
 #include <boost/regex.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/function.hpp>
 #include <boost/format.hpp>
 #include <boost/range/iterator_range.hpp>
@@ -52,6 +54,7 @@
 #include "presentation/SlideRequestHandler.hpp"
 
 #include "SessionHelpHome.hpp"
+#include "SessionHelpCache.hpp"
 
 // protect R against windows TRUE/FALSE defines
 #undef TRUE
@@ -324,7 +327,8 @@ template <typename Filter>
 void handleHttpdResult(SEXP httpdSEXP, 
                        const http::Request& request, 
                        const Filter& htmlFilter,
-                       http::Response* pResponse)
+                       http::Response* pResponse,
+                       std::string* pRenderedHtml)
 {
    // NOTE: this function is a port of process_request in Rhttpd.c
    // (that function is coupled to sending its results via the R http daemon, 
@@ -441,6 +445,10 @@ void handleHttpdResult(SEXP httpdSEXP,
                                          request, 
                                          htmlFilter, 
                                          pResponse);
+
+               // provide the (unfiltered) html to callers who cache it
+               if (pRenderedHtml && headers.empty())
+                  *pRenderedHtml = content;
             }
             else
             {
@@ -685,7 +693,8 @@ void handleHttpdRequest(const std::string& location,
                         const HandlerSource& handlerSource,
                         const http::Request& request, 
                         const Filter& filter,
-                        http::Response* pResponse)
+                        http::Response* pResponse,
+                        std::string* pRenderedHtml = NULL)
 {
    // get the requested path
    std::string path = http::util::pathAfterPrefix(request, location);
@@ -772,7 +781,7 @@ void handleHttpdRequest(const std::string& location,
    // content returned from httpd
    else if (TYPEOF(httpdSEXP) == VECSXP && LENGTH(httpdSEXP) > 0)
    {
-      handleHttpdResult(httpdSEXP, request, filter, pResponse);
+      handleHttpdResult(httpdSEXP, request, filter, pResponse, pRenderedHtml);
    }
    
    // unexpected SEXP type returned from httpd
@@ -899,16 +908,267 @@ void handlePythonHelpRequest(const http::Request& request,
    
 }
 
+// help pages rendered by R (created during initialization)
+boost::shared_ptr<HelpPageCache> s_pHelpPageCache;
+
+// limit on the rendered help pages kept in memory
+const std::size_t kHelpPageCacheMemoryBytes = 16 * 1024 * 1024;
+
+// age after which the pages of package versions no longer in use are removed
+const int kHelpPageCacheMaxAgeDays = 30;
+
+bool helpPageForRequest(const http::Request& request,
+                        std::string* pPackage,
+                        std::string* pPage)
+{
+   if (!s_pHelpPageCache ||
+       request.method() != "GET" ||
+       !request.queryParams().empty())
+   {
+      return false;
+   }
+
+   std::string path = http::util::pathAfterPrefix(request, kHelpLocation);
+   return parseHelpPagePath(path, pPackage, pPage);
+}
+
+void setHelpPageResponse(const std::string& html,
+                         const http::Request& request,
+                         http::Response* pResponse)
+{
+   pResponse->setStatusCode(http::status::Ok);
+   pResponse->setContentType("text/html");
+   setDynamicContentResponse(html,
+                             request,
+                             HelpContentsFilter(request),
+                             pResponse);
+}
+
+// called on the connection listener thread to serve help pages we've already
+// rendered (so they don't wait on R when it's busy)
+bool handleCachedHelpRequest(const http::Request& request,
+                             http::Response* pResponse)
+{
+   std::string package, page, html;
+   if (!helpPageForRequest(request, &package, &page) ||
+       !s_pHelpPageCache->lookup(package, page, &html))
+   {
+      return false;
+   }
+
+   setHelpPageResponse(html, request, pResponse);
+   return true;
+}
+
+// note the installed versions of packages (so their pages can be cached)
+// and optionally return the paths to them (empty if not installed)
+Error notePackageVersions(const std::vector<std::string>& packages,
+                          std::vector<std::string>* pPaths = NULL)
+{
+   r::sexp::Protect rProtect;
+   SEXP infoSEXP;
+   Error error = r::exec::RFunction(".rs.helpPackageInfo", packages)
+                                                .call(&infoSEXP, &rProtect);
+   if (error)
+      return error;
+
+   std::vector<std::string> versions, paths;
+   error = r::sexp::getNamedListElement(infoSEXP, "version", &versions);
+   if (!error)
+      error = r::sexp::getNamedListElement(infoSEXP, "path", &paths);
+   if (error)
+      return error;
+
+   if (versions.size() != packages.size() || paths.size() != packages.size())
+      return systemError(boost::system::errc::protocol_error, ERROR_LOCATION);
+
+   for (std::size_t i = 0; i < packages.size(); i++)
+   {
+      if (versions[i].empty())
+         s_pHelpPageCache->removePackage(packages[i]);
+      else
+         s_pHelpPageCache->setPackageVersion(packages[i], versions[i]);
+   }
+
+   if (pPaths)
+      *pPaths = paths;
+
+   return Success();
+}
+
 // the ShowHelp event will result in the Help pane requesting the specified
 // help url. we handle this request directly by calling the R httpd function
-// to dynamically form the correct http response
-void handleHelpRequest(const http::Request& request, http::Response* pResponse)
+// to dynamically form the correct http response. (help pages rendered ahead
+// of time are only kept in memory; returns false if there wasn't room)
+bool renderHelpRequest(const http::Request& request,
+                       http::Response* pResponse,
+                       bool prerender)
 {
+   // serve rendered pages from the cache (or render and cache them)
+   std::string package, page;
+   bool isHelpPage = helpPageForRequest(request, &package, &page);
+   if (isHelpPage)
+   {
+      if (!s_pHelpPageCache->hasPackageVersion(package))
+      {
+         Error error = notePackageVersions(std::vector<std::string>(1, package));
+         if (error)
+            LOG_ERROR(error);
+      }
+
+      std::string html;
+      if (s_pHelpPageCache->lookup(package, page, &html))
+      {
+         setHelpPageResponse(html, request, pResponse);
+         return true;
+      }
+   }
+
+   std::string renderedHtml;
    handleHttpdRequest(kHelpLocation,
                       boost::bind(r::sexp::findFunction, "httpd", "tools"),
                       request,
                       HelpContentsFilter(request),
-                      pResponse);
+                      pResponse,
+                      isHelpPage ? &renderedHtml : NULL);
+
+   if (renderedHtml.empty())
+      return true;
+
+   if (prerender)
+      return s_pHelpPageCache->insertPrerendered(package, page, renderedHtml);
+
+   s_pHelpPageCache->insert(package, page, renderedHtml);
+   return true;
+}
+
+void handleHelpRequest(const http::Request& request, http::Response* pResponse)
+{
+   renderHelpRequest(request, pResponse, false);
+}
+
+// pages of attached packages waiting to be rendered ahead of time. a pass
+// is run in idle time after packages are loaded or the library changes
+// (both of which schedule a fresh collection of the pages to render), and
+// stops once the pages in memory reach the cache's memory limit
+std::deque<std::pair<std::string, std::string> > s_prerenderPages;
+bool s_prerenderCollect = false;
+bool s_prerenderScheduled = false;
+
+void collectPrerenderPages()
+{
+   s_prerenderPages.clear();
+
+   std::vector<std::string> packages;
+   Error error = r::exec::RFunction(".packages").call(&packages);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   std::vector<std::string> paths;
+   error = notePackageVersions(packages, &paths);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   for (std::size_t i = 0; i < packages.size(); i++)
+   {
+      if (paths[i].empty())
+         continue;
+
+      std::vector<std::string> pages;
+      error = readHelpPages(FilePath(paths[i]), &pages);
+      if (error)
+      {
+         // not all packages have help
+         if (!isPathNotFoundError(error))
+            LOG_ERROR(error);
+         continue;
+      }
+
+      for (std::vector<std::string>::const_iterator it = pages.begin();
+           it != pages.end();
+           ++it)
+      {
+         if (!s_pHelpPageCache->contains(packages[i], *it))
+            s_prerenderPages.push_back(std::make_pair(packages[i], *it));
+      }
+   }
+}
+
+bool prerenderHelpPage()
+{
+   if (s_prerenderCollect)
+   {
+      s_prerenderCollect = false;
+      collectPrerenderPages();
+      return true;
+   }
+
+   if (s_prerenderPages.empty())
+   {
+      s_prerenderScheduled = false;
+      return false;
+   }
+
+   std::pair<std::string, std::string> next = s_prerenderPages.front();
+   s_prerenderPages.pop_front();
+
+   // render the page as though it were requested
+   if (!s_pHelpPageCache->contains(next.first, next.second))
+   {
+      http::Request request;
+      request.setMethod("GET");
+      request.setUri(std::string(kHelpLocation) + "/library/" + next.first +
+                     "/html/" + next.second + ".html");
+      http::Response response;
+      if (!renderHelpRequest(request, &response, true))
+         s_prerenderPages.clear();
+   }
+
+   return true;
+}
+
+void schedulePrerender()
+{
+   s_prerenderCollect = true;
+   if (!s_prerenderScheduled)
+   {
+      s_prerenderScheduled = true;
+      module_context::scheduleIncrementalWork(
+                           boost::posix_time::milliseconds(20),
+                           prerenderHelpPage);
+   }
+}
+
+void onPackageLibraryMutated()
+{
+   // packages which were reinstalled or removed no longer have the versions
+   // we noted, so re-noting them removes their pages
+   std::vector<std::string> packages = s_pHelpPageCache->packages();
+   if (!packages.empty())
+   {
+      Error error = notePackageVersions(packages);
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   schedulePrerender();
+}
+
+void onDeferredInit(bool)
+{
+   s_pHelpPageCache->removeStalePages(kHelpPageCacheMaxAgeDays);
+   schedulePrerender();
+}
+
+void onPackageLoaded(const std::string&)
+{
+   schedulePrerender();
 }
 
 SEXP rs_previewRd(SEXP rdFileSEXP)
@@ -956,6 +1216,23 @@ Error initialize()
    if (error)
       return error;
 
+   // cache help pages we render (those of a given build of a package can
+   // be shared with other sessions)
+   FilePath helpCacheDir = module_context::userScratchPath()
+         .childPath("help-cache")
+         .childPath(module_context::rVersion());
+   s_pHelpPageCache.reset(new HelpPageCache(helpCacheDir,
+                                            kHelpPageCacheMemoryBytes));
+
+   error = registerBackgroundUriFilter(kHelpLocation, handleCachedHelpRequest);
+   if (error)
+      return error;
+
+   events().onDeferredInit.connect(onDeferredInit);
+   events().onPackageLoaded.connect(onPackageLoaded);
+   events().onPackageLibraryMutated.connect(onPackageLibraryMutated);
+   events().onLibPathsChanged.connect(boost::bind(onPackageLibraryMutated));
+
    // init help
    bool isDesktop = options().programMode() == kSessionProgramModeDesktop;
    int port = safe_convert::stringTo<int>(session::options().wwwPort(), 0);
@@ -0,0 +1,482 @@
+/*
+ * SessionHelpCache.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionHelpCache.hpp"
+
+#include <ctime>
+#include <set>
+
+#include <boost/regex.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <core/Error.hpp>
+#include <core/Log.hpp>
+#include <core/Hash.hpp>
+#include <core/Thread.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/RegexUtils.hpp>
+#include <core/system/System.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace help {
+
+namespace {
+
+// the pages of one package version live in <package>/<version hash>
+std::string versionDirName(const std::string& version)
+{
+   return hash::crc32HexHash(version);
+}
+
+} // anonymous namespace
+
+bool parseHelpPagePath(const std::string& path,
+                       std::string* pPackage,
+                       std::string* pPage)
+{
+   static const boost::regex reHelpPage(
+            "^/library/([A-Za-z][A-Za-z0-9.]*)/html/([A-Za-z0-9._\\-]+)\\.html$");
+
+   boost::smatch match;
+   if (!regex_utils::match(path, match, reHelpPage))
+      return false;
+
+   *pPackage = match[1];
+   *pPage = match[2];
+   return true;
+}
+
+Error readHelpPages(const FilePath& packagePath,
+                    std::vector<std::string>* pPages)
+{
+   std::vector<std::string> lines;
+   Error error = readStringVectorFromFile(
+            packagePath.childPath("help/AnIndex"), &lines);
+   if (error)
+      return error;
+
+   std::set<std::string> pages;
+   for (std::vector<std::string>::const_iterator it = lines.begin();
+        it != lines.end();
+        ++it)
+   {
+      std::string::size_type tab = it->find('\t');
+      if (tab == std::string::npos)
+         continue;
+
+      std::string page = it->substr(tab + 1);
+      if (!page.empty() && pages.insert(page).second)
+         pPages->push_back(page);
+   }
+
+   return Success();
+}
+
+HelpPageCache::HelpPageCache(const FilePath& cacheDir,
+                             std::size_t maxMemoryBytes)
+   : cacheDir_(cacheDir), maxMemoryBytes_(maxMemoryBytes), memoryBytes_(0)
+{
+}
+
+void HelpPageCache::setPackageVersion(const std::string& package,
+                                      const std::string& version)
+{
+   std::string previousVersion;
+   LOCK_MUTEX(mutex_)
+   {
+      std::map<std::string, std::string>::iterator it = versions_.find(package);
+      if (it != versions_.end())
+      {
+         if (it->second == version)
+            return;
+         previousVersion = it->second;
+      }
+      versions_[package] = version;
+   }
+   END_LOCK_MUTEX
+
+   if (!previousVersion.empty())
+      removePages(package, previousVersion);
+
+   // note that the version's pages are in use (so they aren't removed as
+   // stale by this or another session)
+   std::string key;
+   FilePath file;
+   locateVersion(package, version, std::string(), &key, &file);
+   if (file.parent().exists())
+      file.parent().setLastWriteTime();
+}
+
+bool HelpPageCache::hasPackageVersion(const std::string& package) const
+{
+   LOCK_MUTEX(mutex_)
+   {
+      return versions_.count(package) > 0;
+   }
+   END_LOCK_MUTEX
+
+   return false;
+}
+
+bool HelpPageCache::lookup(const std::string& package,
+                           const std::string& page,
+                           std::string* pHtml)
+{
+   std::string key;
+   FilePath file;
+   if (!locate(package, page, &key, &file))
+      return false;
+
+   bool found = false;
+   bool unwritten = false;
+   LOCK_MUTEX(mutex_)
+   {
+      std::map<std::string, std::list<Page>::iterator>::iterator it =
+            pageIndex_.find(key);
+      if (it != pageIndex_.end())
+      {
+         pages_.splice(pages_.begin(), pages_, it->second);
+         *pHtml = it->second->second;
+         found = true;
+         unwritten = unwritten_.erase(key) > 0;
+      }
+   }
+   END_LOCK_MUTEX
+
+   // a page rendered ahead of time is written to disk once it's requested
+   if (unwritten)
+      write(page, *pHtml, file);
+   if (found)
+      return true;
+
+   // read the page from disk (without holding the lock)
+   if (!file.exists())
+      return false;
+
+   Error error = readStringFromFile(file, pHtml);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return false;
+   }
+
+   remember(key, *pHtml);
+   return true;
+}
+
+bool HelpPageCache::contains(const std::string& package,
+                             const std::string& page) const
+{
+   std::string key;
+   FilePath file;
+   if (!locate(package, page, &key, &file))
+      return false;
+
+   LOCK_MUTEX(mutex_)
+   {
+      if (pageIndex_.count(key))
+         return true;
+   }
+   END_LOCK_MUTEX
+
+   return file.exists();
+}
+
+void HelpPageCache::insert(const std::string& package,
+                           const std::string& page,
+                           const std::string& html)
+{
+   std::string key;
+   FilePath file;
+   if (!locate(package, page, &key, &file))
+      return;
+
+   remember(key, html);
+   LOCK_MUTEX(mutex_)
+   {
+      unwritten_.erase(key);
+   }
+   END_LOCK_MUTEX
+
+   write(page, html, file);
+}
+
+bool HelpPageCache::insertPrerendered(const std::string& package,
+                                      const std::string& page,
+                                      const std::string& html)
+{
+   std::string key;
+   FilePath file;
+   // (pages too large to keep in memory are skipped)
+   if (!locate(package, page, &key, &file) || html.size() > maxMemoryBytes_)
+      return true;
+
+   LOCK_MUTEX(mutex_)
+   {
+      if (pageIndex_.count(key))
+         return true;
+
+      if (memoryBytes_ + html.size() > maxMemoryBytes_)
+         return false;
+
+      pages_.push_back(std::make_pair(key, html));
+      pageIndex_[key] = --pages_.end();
+      memoryBytes_ += html.size();
+      unwritten_.insert(key);
+   }
+   END_LOCK_MUTEX
+
+   return true;
+}
+
+void HelpPageCache::write(const std::string& page,
+                          const std::string& html,
+                          const FilePath& file)
+{
+   // write to a (uniquely named) temporary file and move it into place so
+   // that other sessions sharing the cache never read a partially written
+   // page
+   Error error = file.parent().ensureDirectory();
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   FilePath tempFile = file.parent().childPath(
+            page + "." + core::system::generateShortenedUuid());
+   error = writeStringToFile(tempFile, html);
+   if (!error)
+      error = tempFile.move(file);
+   if (error)
+   {
+      LOG_ERROR(error);
+      tempFile.removeIfExists();
+   }
+}
+
+std::vector<std::string> HelpPageCache::packages() const
+{
+   std::vector<std::string> packages;
+   LOCK_MUTEX(mutex_)
+   {
+      for (std::map<std::string, std::string>::const_iterator it =
+              versions_.begin();
+           it != versions_.end();
+           ++it)
+      {
+         packages.push_back(it->first);
+      }
+   }
+   END_LOCK_MUTEX
+
+   return packages;
+}
+
+void HelpPageCache::removePackage(const std::string& package)
+{
+   std::string version;
+   LOCK_MUTEX(mutex_)
+   {
+      std::map<std::string, std::string>::iterator it = versions_.find(package);
+      if (it == versions_.end())
+         return;
+      version = it->second;
+      versions_.erase(it);
+   }
+   END_LOCK_MUTEX
+
+   removePages(package, version);
+}
+
+void HelpPageCache::removeStalePages(int maxAgeDays)
+{
+   if (!cacheDir_.exists())
+      return;
+
+   // the directories of the versions we've noted
+   std::set<std::string> notedDirs;
+   LOCK_MUTEX(mutex_)
+   {
+      for (std::map<std::string, std::string>::const_iterator it =
+              versions_.begin();
+           it != versions_.end();
+           ++it)
+      {
+         notedDirs.insert(it->first + "/" + versionDirName(it->second));
+      }
+   }
+   END_LOCK_MUTEX
+
+   std::vector<FilePath> packageDirs;
+   Error error = cacheDir_.children(&packageDirs);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   std::time_t cutoff = ::time(NULL) - maxAgeDays * 24 * 60 * 60;
+   for (std::vector<FilePath>::const_iterator packageDir = packageDirs.begin();
+        packageDir != packageDirs.end();
+        ++packageDir)
+   {
+      if (!packageDir->isDirectory())
+         continue;
+
+      std::vector<FilePath> versionDirs;
+      error = packageDir->children(&versionDirs);
+      if (error)
+      {
+         LOG_ERROR(error);
+         continue;
+      }
+
+      for (std::vector<FilePath>::const_iterator versionDir = versionDirs.begin();
+           versionDir != versionDirs.end();
+           ++versionDir)
+      {
+         if (!versionDir->isDirectory() ||
+             notedDirs.count(packageDir->filename() + "/" +
+                             versionDir->filename()) ||
+             versionDir->lastWriteTime() >= cutoff)
+         {
+            continue;
+         }
+
+         error = versionDir->removeIfExists();
+         if (error)
+            LOG_ERROR(error);
+      }
+   }
+}
+
+std::size_t HelpPageCache::memoryBytes() const
+{
+   LOCK_MUTEX(mutex_)
+   {
+      return memoryBytes_;
+   }
+   END_LOCK_MUTEX
+
+   return 0;
+}
+
+bool HelpPageCache::locate(const std::string& package,
+                           const std::string& page,
+                           std::string* pKey,
+                           FilePath* pFile) const
+{
+   std::string version;
+   LOCK_MUTEX(mutex_)
+   {
+      std::map<std::string, std::string>::const_iterator it =
+            versions_.find(package);
+      if (it == versions_.end())
+         return false;
+      version = it->second;
+   }
+   END_LOCK_MUTEX
+
+   locateVersion(package, version, page, pKey, pFile);
+   return true;
+}
+
+void HelpPageCache::locateVersion(const std::string& package,
+                                  const std::string& version,
+                                  const std::string& page,
+                                  std::string* pKey,
+                                  FilePath* pFile) const
+{
+   std::string versionDir = versionDirName(version);
+   *pKey = package + "/" + versionDir + "/" + page;
+   *pFile = cacheDir_.childPath(package)
+                     .childPath(versionDir)
+                     .childPath(page + ".html");
+}
+
+void HelpPageCache::removePages(const std::string& package,
+                                const std::string& version)
+{
+   // the keys of the version's pages share the prefix of the key of a page
+   // with no name. note that we leave the pages on disk, as other sessions
+   // may still be using this version (they're removed once stale)
+   std::string prefix;
+   FilePath file;
+   locateVersion(package, version, std::string(), &prefix, &file);
+
+   LOCK_MUTEX(mutex_)
+   {
+      std::list<Page>::iterator it = pages_.begin();
+      while (it != pages_.end())
+      {
+         if (boost::algorithm::starts_with(it->first, prefix))
+         {
+            memoryBytes_ -= it->second.size();
+            pageIndex_.erase(it->first);
+            unwritten_.erase(it->first);
+            it = pages_.erase(it);
+         }
+         else
+         {
+            ++it;
+         }
+      }
+   }
+   END_LOCK_MUTEX
+}
+
+void HelpPageCache::remember(const std::string& key, const std::string& html)
+{
+   // pages too large to keep in memory are only cached on disk
+   if (html.size() > maxMemoryBytes_)
+      return;
+
+   LOCK_MUTEX(mutex_)
+   {
+      std::map<std::string, std::list<Page>::iterator>::iterator it =
+            pageIndex_.find(key);
+      if (it != pageIndex_.end())
+      {
+         memoryBytes_ -= it->second->second.size();
+         pages_.erase(it->second);
+         pageIndex_.erase(it);
+      }
+
+      pages_.push_front(std::make_pair(key, html));
+      pageIndex_[key] = pages_.begin();
+      memoryBytes_ += html.size();
+
+      // evict the least recently used pages
+      while (memoryBytes_ > maxMemoryBytes_)
+      {
+         const Page& oldest = pages_.back();
+         memoryBytes_ -= oldest.second.size();
+         pageIndex_.erase(oldest.first);
+         unwritten_.erase(oldest.first);
+         pages_.pop_back();
+      }
+   }
+   END_LOCK_MUTEX
+}
+
+} // namespace help
+} // namespace modules
+} // namespace session
+} // namespace rstudio
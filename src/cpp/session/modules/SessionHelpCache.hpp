@@ -0,0 +1,141 @@
+/*
+ * SessionHelpCache.hpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_HELP_CACHE_HPP
+#define SESSION_HELP_CACHE_HPP
+
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/utility.hpp>
+
+#include <core/FilePath.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace help {
+
+// determine the package and page of a help page path (relative to the help
+// location, e.g. /library/stats/html/lm.html). returns false for other paths
+bool parseHelpPagePath(const std::string& path,
+                       std::string* pPackage,
+                       std::string* pPage);
+
+// read the pages of an installed package from its help/AnIndex file (which
+// maps each topic alias to the page documenting it)
+core::Error readHelpPages(const core::FilePath& packagePath,
+                          std::vector<std::string>* pPages);
+
+// Help pages rendered by R, keyed by package, package version and page. The
+// most recently used pages are kept in memory (up to a limit) and pages
+// which have been requested are written beneath the cache directory (in a
+// directory for each package version) so they're available to other and
+// later sessions. Pages rendered ahead of time are only kept in memory
+// until they're requested. Pages are only
+// cached and found for packages whose installed version has been noted
+// (versions should identify a particular installation of a package, e.g.
+// include the time it was built). As sessions share the pages on disk, those
+// of a version are only removed once no session has noted the version for a
+// while. The cache is thread-safe: pages are rendered on the main thread but
+// may be served from other threads.
+class HelpPageCache : boost::noncopyable
+{
+public:
+   HelpPageCache(const core::FilePath& cacheDir, std::size_t maxMemoryBytes);
+
+   // note the installed version of a package (noting a new version removes
+   // the pages of the version previously noted from memory)
+   void setPackageVersion(const std::string& package,
+                          const std::string& version);
+   bool hasPackageVersion(const std::string& package) const;
+
+   // find a page in memory or on disk
+   bool lookup(const std::string& package,
+               const std::string& page,
+               std::string* pHtml);
+
+   // is the page cached (without reading it)
+   bool contains(const std::string& package, const std::string& page) const;
+
+   void insert(const std::string& package,
+               const std::string& page,
+               const std::string& html);
+
+   // keep a page rendered ahead of time (in memory only, until it's looked
+   // up) if there's room for it without evicting other pages. returns false
+   // if there wasn't room
+   bool insertPrerendered(const std::string& package,
+                          const std::string& page,
+                          const std::string& html);
+
+   // the packages whose versions have been noted
+   std::vector<std::string> packages() const;
+
+   // forget a package's version and remove the pages of that version from
+   // memory, e.g. after it has been removed
+   void removePackage(const std::string& package);
+
+   // remove the pages on disk of versions which haven't been noted (by any
+   // session) or had pages added in the given number of days
+   void removeStalePages(int maxAgeDays);
+
+   std::size_t memoryBytes() const;
+
+private:
+   bool locate(const std::string& package,
+               const std::string& page,
+               std::string* pKey,
+               core::FilePath* pFile) const;
+   void locateVersion(const std::string& package,
+                      const std::string& version,
+                      const std::string& page,
+                      std::string* pKey,
+                      core::FilePath* pFile) const;
+   void removePages(const std::string& package, const std::string& version);
+   void remember(const std::string& key, const std::string& html);
+   void write(const std::string& page,
+              const std::string& html,
+              const core::FilePath& file);
+
+   const core::FilePath cacheDir_;
+   const std::size_t maxMemoryBytes_;
+
+   mutable boost::mutex mutex_;
+
+   std::map<std::string, std::string> versions_;
+
+   // pages in memory (keyed by package/version/page) with the most
+   // recently used first
+   typedef std::pair<std::string, std::string> Page;
+   std::list<Page> pages_;
+   std::map<std::string, std::list<Page>::iterator> pageIndex_;
+   std::size_t memoryBytes_;
+
+   // the pages in memory which were rendered ahead of time and haven't yet
+   // been written to disk
+   std::set<std::string> unwritten_;
+};
+
+} // namespace help
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_HELP_CACHE_HPP
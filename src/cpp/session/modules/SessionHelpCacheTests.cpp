@@ -0,0 +1,242 @@
+/*
+ * SessionHelpCacheTests.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <core/FileSerializer.hpp>
+
+#include "SessionHelpCache.hpp"
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace help {
+
+context("Help page cache")
+{
+   test_that("Help page paths are recognized")
+   {
+      std::string package, page;
+      expect_true(parseHelpPagePath("/library/stats/html/lm.html",
+                                    &package, &page));
+      expect_true(package == "stats");
+      expect_true(page == "lm");
+
+      expect_true(parseHelpPagePath("/library/data.table/html/as.data.table.html",
+                                    &package, &page));
+      expect_true(package == "data.table");
+      expect_true(page == "as.data.table");
+
+      expect_false(parseHelpPagePath("/library/stats/help/lm", &package, &page));
+      expect_false(parseHelpPagePath("/library/stats/html/00Index", &package, &page));
+      expect_false(parseHelpPagePath("/library/stats/html/../../x.html",
+                                     &package, &page));
+      expect_false(parseHelpPagePath("/doc/html/index.html", &package, &page));
+   }
+
+   test_that("Pages are read from the package's alias index")
+   {
+      FilePath packageDir;
+      expect_false(FilePath::tempFilePath(&packageDir));
+      expect_false(packageDir.childPath("help").ensureDirectory());
+      expect_false(writeStringToFile(packageDir.childPath("help/AnIndex"),
+                                     "lm\tlm\n"
+                                     "print.lm\tlm\n"
+                                     "glm\tglm\n"));
+
+      std::vector<std::string> pages;
+      expect_false(readHelpPages(packageDir, &pages));
+      expect_true(pages.size() == 2);
+      expect_true(pages[0] == "lm");
+      expect_true(pages[1] == "glm");
+
+      packageDir.remove();
+   }
+
+   test_that("Pages are cached for the package version")
+   {
+      FilePath cacheDir;
+      expect_false(FilePath::tempFilePath(&cacheDir));
+      HelpPageCache cache(cacheDir, 1024);
+
+      // pages of packages of unknown versions aren't cached
+      std::string html;
+      cache.insert("stats", "lm", "<p>lm</p>");
+      expect_false(cache.lookup("stats", "lm", &html));
+      expect_false(cacheDir.exists());
+
+      cache.setPackageVersion("stats", "3.5.0");
+      expect_true(cache.hasPackageVersion("stats"));
+      cache.insert("stats", "lm", "<p>lm</p>");
+      expect_true(cache.contains("stats", "lm"));
+      expect_true(cache.lookup("stats", "lm", &html));
+      expect_true(html == "<p>lm</p>");
+
+      // pages are on disk for other sessions
+      HelpPageCache otherCache(cacheDir, 1024);
+      otherCache.setPackageVersion("stats", "3.5.0");
+      expect_true(otherCache.lookup("stats", "lm", &html));
+      expect_true(html == "<p>lm</p>");
+
+      // pages of the previous version are forgotten when a new one is noted
+      // (but remain on disk for other sessions)
+      cache.setPackageVersion("stats", "3.5.1");
+      expect_false(cache.contains("stats", "lm"));
+      expect_false(cache.lookup("stats", "lm", &html));
+      expect_true(cache.memoryBytes() == 0);
+      expect_true(otherCache.lookup("stats", "lm", &html));
+
+      cacheDir.remove();
+   }
+
+   test_that("Least recently used pages are only kept on disk")
+   {
+      FilePath cacheDir;
+      expect_false(FilePath::tempFilePath(&cacheDir));
+      HelpPageCache cache(cacheDir, 20);
+      cache.setPackageVersion("base", "3.5.0");
+
+      cache.insert("base", "c", "0123456789");
+      cache.insert("base", "paste", "0123456789");
+      expect_true(cache.memoryBytes() == 20);
+
+      std::string html;
+      expect_true(cache.lookup("base", "c", &html));
+      cache.insert("base", "sum", "0123456789");
+      expect_true(cache.memoryBytes() == 20);
+
+      // paste was evicted (but is read back from disk)
+      expect_true(cache.lookup("base", "paste", &html));
+      expect_true(html == "0123456789");
+
+      // pages larger than the memory limit are only on disk
+      cache.insert("base", "sapply", std::string(30, 'x'));
+      expect_true(cache.memoryBytes() == 20);
+      expect_true(cache.lookup("base", "sapply", &html));
+      expect_true(html.size() == 30);
+
+      cacheDir.remove();
+   }
+
+   test_that("Prerendered pages are only written to disk once requested")
+   {
+      FilePath cacheDir;
+      expect_false(FilePath::tempFilePath(&cacheDir));
+      HelpPageCache cache(cacheDir, 20);
+      cache.setPackageVersion("base", "3.5.0");
+
+      expect_true(cache.insertPrerendered("base", "c", "0123456789"));
+      expect_true(cache.contains("base", "c"));
+      HelpPageCache otherCache(cacheDir, 20);
+      otherCache.setPackageVersion("base", "3.5.0");
+      expect_false(otherCache.contains("base", "c"));
+
+      std::string html;
+      expect_true(cache.lookup("base", "c", &html));
+      expect_true(html == "0123456789");
+      expect_true(otherCache.contains("base", "c"));
+
+      // prerendered pages don't evict others
+      expect_true(cache.insertPrerendered("base", "paste", "0123456789"));
+      expect_false(cache.insertPrerendered("base", "sum", "0123456789"));
+      expect_false(cache.contains("base", "sum"));
+      expect_true(cache.memoryBytes() == 20);
+
+      // but are evicted first (and so never written)
+      cache.insert("base", "sum", "0123456789");
+      expect_false(cache.contains("base", "paste"));
+      expect_true(cache.contains("base", "c"));
+
+      cacheDir.remove();
+   }
+
+   test_that("Removing a package forgets its version and pages")
+   {
+      FilePath cacheDir;
+      expect_false(FilePath::tempFilePath(&cacheDir));
+      HelpPageCache cache(cacheDir, 1024);
+      cache.setPackageVersion("utils", "3.5.0");
+      cache.setPackageVersion("tools", "3.5.0");
+      cache.insert("utils", "head", "<p>head</p>");
+      cache.insert("tools", "md5sum", "<p>md5sum</p>");
+      expect_true(cache.packages().size() == 2);
+
+      cache.removePackage("utils");
+      expect_false(cache.hasPackageVersion("utils"));
+      expect_true(cache.packages().size() == 1);
+      expect_true(cache.memoryBytes() == std::string("<p>md5sum</p>").size());
+
+      std::string html;
+      expect_false(cache.lookup("utils", "head", &html));
+      expect_true(cache.lookup("tools", "md5sum", &html));
+
+      cacheDir.remove();
+   }
+
+   test_that("Pages of versions no longer in use are removed once stale")
+   {
+      FilePath cacheDir;
+      expect_false(FilePath::tempFilePath(&cacheDir));
+      HelpPageCache cache(cacheDir, 1024);
+      cache.setPackageVersion("utils", "3.5.0");
+      cache.insert("utils", "head", "<p>head</p>");
+      cache.setPackageVersion("utils", "3.5.1");
+      cache.insert("utils", "head", "<p>head</p>");
+
+      // age both versions' pages
+      std::time_t aged = ::time(NULL) - 60 * 24 * 60 * 60;
+      std::vector<FilePath> versionDirs;
+      expect_false(cacheDir.childPath("utils").children(&versionDirs));
+      expect_true(versionDirs.size() == 2);
+      for (std::size_t i = 0; i < versionDirs.size(); i++)
+      {
+         versionDirs[i].setLastWriteTime(aged);
+      }
+
+      // recently used versions are kept
+      cache.removeStalePages(90);
+      expect_true(versionDirs[0].exists() && versionDirs[1].exists());
+
+      // as is the version we've noted
+      cache.removeStalePages(30);
+      HelpPageCache otherCache(cacheDir, 1024);
+      otherCache.setPackageVersion("utils", "3.5.0");
+      expect_false(otherCache.contains("utils", "head"));
+      expect_true(cache.contains("utils", "head"));
+
+      // noting a version keeps its pages
+      cache.setPackageVersion("utils", "3.5.0");
+      cache.insert("utils", "head", "<p>head</p>");
+      versionDirs.clear();
+      expect_false(cacheDir.childPath("utils").children(&versionDirs));
+      for (std::size_t i = 0; i < versionDirs.size(); i++)
+      {
+         versionDirs[i].setLastWriteTime(aged);
+      }
+      otherCache.setPackageVersion("utils", "3.5.1");
+      cache.removeStalePages(30);
+      expect_true(cache.contains("utils", "head"));
+      expect_true(otherCache.contains("utils", "head"));
+
+      cacheDir.remove();
+   }
+}
+
+} // namespace help
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -58,7 +58,7 @@ void handleHelpHomeRequest(const core::http::Request& request,
    else
    {
       FilePath filePath = helpResPath.complete(path);
-      pResponse->setCacheableFile(filePath, request);
+      pResponse->setStaticFile(filePath, request);
    }
 }
 
@@ -50,7 +50,7 @@ FilePath historyDatabaseRotatedFilePath()
    return module_context::userScratchPath().complete(kHistoryDatabase ".1");
 }
 
-void rotateHistoryDatabase()
+bool rotateHistoryDatabase()
 {
    FilePath historyDB = historyDatabaseFilePath();
    if (historyDB.exists() && (historyDB.size() > kHistoryMaxBytes))
@@ -62,6 +62,11 @@ void rotateHistoryDatabase()
 
       // now rotate the file
       historyDB.move(rotatedHistoryDB);
+      return true;
+   }
+   else
+   {
+      return false;
    }
 }
 
@@ -129,23 +134,64 @@ HistoryArchive& historyArchive()
 
 Error HistoryArchive::add(const std::string& command)
 {
-   // reset the cache (since this write will invalidate the current one,
-   // no sense in keeping our cache around in memory)
-   entries_.clear();
-   entryCacheLastWriteTime_ = -1;
+   // our cache can be kept up to date by appending this entry to it if it
+   // currently reflects the history db (and the entry is a single line).
+   // the size is compared as well as the write time since the write time
+   // has a resolution of a second
+   FilePath historyDBPath = historyDatabaseFilePath();
+   bool appendToCache = entryCacheLastWriteTime_ != -1 &&
+                        historyDBPath.exists() &&
+                        historyDBPath.lastWriteTime() == entryCacheLastWriteTime_ &&
+                        historyDBPath.size() == entryCacheSize_ &&
+                        command.find('\n') == std::string::npos;
 
-   // rotate if necessary
-   rotateHistoryDatabase();
+   // rotate if necessary (this drops the entries in the previously
+   // rotated file so our cache needs to be re-read)
+   if (rotateHistoryDatabase())
+      appendToCache = false;
 
    // write the entry to the file
    std::ostringstream ostrEntry ;
    double currentTime = core::date_time::millisecondsSinceEpoch();
    writeEntry(currentTime, command, &ostrEntry);
-   ostrEntry << std::endl;
-   return appendToFile(historyDatabaseFilePath(), ostrEntry.str());
+   std::string line = ostrEntry.str();
+   Error error = appendToFile(historyDBPath, line + "\n");
+
+   // (the file should now be exactly our entry longer; if it isn't then
+   // another process wrote to it too)
+   if (error ||
+       !appendToCache ||
+       historyDBPath.size() != entryCacheSize_ + line.size() + 1)
+   {
+      clearEntryCache();
+      return error;
+   }
+
+   // add the entry to the cache (reading it back as it would be read from
+   // the file)
+   HistoryEntry entry;
+   int nextIndex = index_.entries().size();
+   if (readHistoryEntry(line, &entry, &nextIndex) == ReadCollectionAddLine)
+      index_.add(entry);
+   entryCacheLastWriteTime_ = historyDBPath.lastWriteTime();
+   entryCacheSize_ = historyDBPath.size();
+
+   return Success();
+}
+
+void HistoryArchive::clearEntryCache() const
+{
+   index_.clear();
+   entryCacheLastWriteTime_ = -1;
+   entryCacheSize_ = 0;
 }
 
 const std::vector<HistoryEntry>& HistoryArchive::entries() const
+{
+   return index().entries();
+}
+
+const HistoryIndex& HistoryArchive::index() const
 {
    // calculate path to history db
    FilePath historyDBPath = historyDatabaseFilePath();
@@ -153,33 +199,43 @@ const std::vector<HistoryEntry>& HistoryArchive::entries() const
    // if the file doesn't exist then clear the collection
    if (!historyDBPath.exists())
    {
-      entries_.clear();
+      clearEntryCache();
    }
 
-   // otherwise check for divergent lastWriteTime and read the file
-   // if our internal list isn't up to date
-   else if (historyDBPath.lastWriteTime() != entryCacheLastWriteTime_)
+   // otherwise check for divergent lastWriteTime (or size, since the
+   // write time has a resolution of a second) and read the file if our
+   // internal list isn't up to date
+   else if (historyDBPath.lastWriteTime() != entryCacheLastWriteTime_ ||
+            historyDBPath.size() != entryCacheSize_)
    {
-      entries_.clear();
+      clearEntryCache();
+
+      // (noted before reading so that a concurrent write causes a re-read)
+      time_t lastWriteTime = historyDBPath.lastWriteTime();
+      uintmax_t size = historyDBPath.size();
 
       // establish a next index counter
       int nextIndex = 0;
 
       // first read from rotated file if it exists
+      std::vector<HistoryEntry> entries;
       FilePath rotatedHistoryDBPath = historyDatabaseRotatedFilePath();
       if (rotatedHistoryDBPath.exists())
       {
          Error error = readCollectionFromFile<std::vector<HistoryEntry> >(
                            rotatedHistoryDBPath,
-                           &entries_,
+                           &entries,
                            boost::bind(readHistoryEntry, _1, _2, &nextIndex));
          if (error)
             LOG_ERROR(error);
       }
+      std::for_each(entries.begin(),
+                    entries.end(),
+                    boost::bind(&HistoryIndex::add, &index_, _1));
 
 
       // now read from main history db
-      std::vector<HistoryEntry> entries;
+      entries.clear();
       Error error = readCollectionFromFile<std::vector<HistoryEntry> >(
                            historyDBPath,
                            &entries,
@@ -190,17 +246,18 @@ const std::vector<HistoryEntry>& HistoryArchive::entries() const
       }
       else
       {
-         std::copy(entries.begin(),
-                   entries.end(),
-                   std::back_inserter(entries_));
+         std::for_each(entries.begin(),
+                       entries.end(),
+                       boost::bind(&HistoryIndex::add, &index_, _1));
 
-         entryCacheLastWriteTime_ = historyDBPath.lastWriteTime();
+         entryCacheLastWriteTime_ = lastWriteTime;
+         entryCacheSize_ = size;
       }
 
    }
 
-   // return entries
-   return entries_;
+   // return the index
+   return index_;
 }
 
 void HistoryArchive::migrateRhistoryIfNecessary()
@@ -21,6 +21,8 @@
 
 #include <boost/utility.hpp>
 
+#include "SessionHistoryIndex.hpp"
+
 namespace rstudio {
 namespace core {
    class Error;
@@ -33,25 +35,13 @@ namespace session {
 namespace modules { 
 namespace history {
    
-struct HistoryEntry
-{
-   HistoryEntry() : index(0), timestamp(0) {}
-   HistoryEntry(int index, double timestamp, const std::string& command)
-      : index(index), timestamp(timestamp), command(command)
-   {
-   }
-   int index;
-   double timestamp;
-   std::string command;
-};
-
 class HistoryArchive;
 HistoryArchive& historyArchive();
 
 class HistoryArchive : boost::noncopyable
 {
 private:
-   HistoryArchive() : entryCacheLastWriteTime_(-1) {}
+   HistoryArchive() : entryCacheLastWriteTime_(-1), entryCacheSize_(0) {}
    friend HistoryArchive& historyArchive();
 
 public:
@@ -60,10 +50,14 @@ public:
 public:
    core::Error add(const std::string& command);
    const std::vector<HistoryEntry>& entries() const;
+   const HistoryIndex& index() const;
 
 private:
+   void clearEntryCache() const;
+
    mutable time_t entryCacheLastWriteTime_;
-   mutable std::vector<HistoryEntry> entries_;
+   mutable uintmax_t entryCacheSize_;
+   mutable HistoryIndex index_;
 };
                        
 } // namespace history
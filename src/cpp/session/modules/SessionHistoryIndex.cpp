@@ -0,0 +1,179 @@
+/*
+ * SessionHistoryIndex.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionHistoryIndex.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <set>
+
+#include <boost/foreach.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace history {
+
+namespace {
+
+boost::uint32_t trigramAt(const std::string& str, std::size_t pos)
+{
+   return (static_cast<boost::uint32_t>(static_cast<unsigned char>(str[pos])) << 16) |
+          (static_cast<boost::uint32_t>(static_cast<unsigned char>(str[pos + 1])) << 8) |
+          static_cast<boost::uint32_t>(static_cast<unsigned char>(str[pos + 2]));
+}
+
+bool containsAll(const std::string& command,
+                 const std::vector<std::string>& terms)
+{
+   BOOST_FOREACH(const std::string& term, terms)
+   {
+      if (!boost::algorithm::contains(command, term))
+         return false;
+   }
+   return true;
+}
+
+} // anonymous namespace
+
+void HistoryIndex::add(const HistoryEntry& entry)
+{
+   std::size_t position = entries_.size();
+   entries_.push_back(entry);
+
+   const std::string& command = entry.command;
+   commands_[command].push_back(position);
+
+   if (command.size() < 3)
+      return;
+
+   // record each distinct trigram once per entry
+   std::vector<Trigram> trigrams;
+   trigrams.reserve(command.size() - 2);
+   for (std::size_t i = 0; i + 2 < command.size(); i++)
+      trigrams.push_back(trigramAt(command, i));
+   std::sort(trigrams.begin(), trigrams.end());
+   trigrams.erase(std::unique(trigrams.begin(), trigrams.end()),
+                  trigrams.end());
+
+   BOOST_FOREACH(Trigram trigram, trigrams)
+   {
+      trigrams_[trigram].push_back(position);
+   }
+}
+
+void HistoryIndex::clear()
+{
+   entries_.clear();
+   trigrams_.clear();
+   commands_.clear();
+}
+
+void HistoryIndex::search(const std::vector<std::string>& terms,
+                          std::size_t maxEntries,
+                          std::vector<HistoryEntry>* pMatches) const
+{
+   // find the least common trigram within the terms; every match contains
+   // it, so only the entries containing it need to be examined
+   const Positions* pCandidates = NULL;
+   BOOST_FOREACH(const std::string& term, terms)
+   {
+      for (std::size_t i = 0; i + 2 < term.size(); i++)
+      {
+         boost::unordered_map<Trigram, Positions>::const_iterator it =
+               trigrams_.find(trigramAt(term, i));
+         if (it == trigrams_.end())
+            return;
+
+         if (pCandidates == NULL || it->second.size() < pCandidates->size())
+            pCandidates = &(it->second);
+      }
+   }
+
+   if (pCandidates != NULL)
+   {
+      for (Positions::const_reverse_iterator it = pCandidates->rbegin();
+           it != pCandidates->rend() && pMatches->size() < maxEntries;
+           ++it)
+      {
+         const HistoryEntry& entry = entries_[*it];
+         if (containsAll(entry.command, terms))
+            pMatches->push_back(entry);
+      }
+   }
+   else
+   {
+      // the terms are too short to have trigrams, so examine every entry
+      // (short terms match most entries so this ends quickly)
+      for (std::vector<HistoryEntry>::const_reverse_iterator it =
+              entries_.rbegin();
+           it != entries_.rend() && pMatches->size() < maxEntries;
+           ++it)
+      {
+         if (containsAll(it->command, terms))
+            pMatches->push_back(*it);
+      }
+   }
+}
+
+void HistoryIndex::searchByPrefix(const std::string& prefix,
+                                  std::size_t maxEntries,
+                                  bool uniqueOnly,
+                                  std::vector<HistoryEntry>* pMatches) const
+{
+   // every entry matches an empty prefix so examine the most recent ones
+   if (prefix.empty())
+   {
+      std::set<std::string> matchedCommands;
+      for (std::vector<HistoryEntry>::const_reverse_iterator it =
+              entries_.rbegin();
+           it != entries_.rend() && pMatches->size() < maxEntries;
+           ++it)
+      {
+         if (!uniqueOnly || matchedCommands.insert(it->command).second)
+            pMatches->push_back(*it);
+      }
+      return;
+   }
+
+   // collect the positions of the entries for commands with the prefix
+   // (only the most recent entry for each command if requested)
+   Positions positions;
+   for (std::map<std::string, Positions>::const_iterator it =
+           commands_.lower_bound(prefix);
+        it != commands_.end() && boost::algorithm::starts_with(it->first, prefix);
+        ++it)
+   {
+      if (uniqueOnly)
+         positions.push_back(it->second.back());
+      else
+         positions.insert(positions.end(), it->second.begin(), it->second.end());
+   }
+
+   // return the most recent of them
+   std::size_t count = std::min(maxEntries, positions.size());
+   std::partial_sort(positions.begin(),
+                     positions.begin() + count,
+                     positions.end(),
+                     std::greater<std::size_t>());
+   for (std::size_t i = 0; i < count; i++)
+      pMatches->push_back(entries_[positions[i]]);
+}
+
+} // namespace history
+} // namespace modules
+} // namespace session
+} // namespace rstudio
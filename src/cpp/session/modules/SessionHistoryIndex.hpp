@@ -0,0 +1,88 @@
+/*
+ * SessionHistoryIndex.hpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_HISTORY_INDEX_HPP
+#define SESSION_HISTORY_INDEX_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/utility.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace history {
+
+struct HistoryEntry
+{
+   HistoryEntry() : index(0), timestamp(0) {}
+   HistoryEntry(int index, double timestamp, const std::string& command)
+      : index(index), timestamp(timestamp), command(command)
+   {
+   }
+   int index;
+   double timestamp;
+   std::string command;
+};
+
+// History entries (in the order they were added) indexed for searching.
+// Entries containing search terms are found through the lists of entries
+// containing each trigram (three character sequence), and entries starting
+// with a prefix through the sorted set of distinct commands, so searches
+// examine only the entries that could match rather than the whole history.
+class HistoryIndex : boost::noncopyable
+{
+public:
+   HistoryIndex() {}
+
+   void add(const HistoryEntry& entry);
+   void clear();
+
+   const std::vector<HistoryEntry>& entries() const { return entries_; }
+
+   // find the entries containing all of the given terms (most recent first)
+   void search(const std::vector<std::string>& terms,
+               std::size_t maxEntries,
+               std::vector<HistoryEntry>* pMatches) const;
+
+   // find the entries starting with the given prefix (most recent first),
+   // optionally including only the most recent entry for each command
+   void searchByPrefix(const std::string& prefix,
+                       std::size_t maxEntries,
+                       bool uniqueOnly,
+                       std::vector<HistoryEntry>* pMatches) const;
+
+private:
+   typedef boost::uint32_t Trigram;
+   typedef std::vector<std::size_t> Positions;
+
+   std::vector<HistoryEntry> entries_;
+
+   // positions (within entries_) of the entries containing each trigram
+   // and of the entries for each distinct command, in ascending order
+   boost::unordered_map<Trigram, Positions> trigrams_;
+   std::map<std::string, Positions> commands_;
+};
+
+} // namespace history
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_HISTORY_INDEX_HPP
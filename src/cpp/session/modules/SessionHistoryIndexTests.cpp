@@ -0,0 +1,155 @@
+/*
+ * SessionHistoryIndexTests.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include "SessionHistoryIndex.hpp"
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace history {
+
+namespace {
+
+void addCommands(HistoryIndex* pIndex)
+{
+   const char* commands[] = {
+      "x <- 1",
+      "plot(cars)",
+      "summary(lm(dist ~ speed, data = cars))",
+      "plot(x)",
+      "head(cars)",
+      "plot(cars)"
+   };
+
+   for (int i = 0; i < 6; i++)
+      pIndex->add(HistoryEntry(i, 0, commands[i]));
+}
+
+std::vector<int> searchIndexes(const HistoryIndex& index,
+                               const std::vector<std::string>& terms,
+                               std::size_t maxEntries)
+{
+   std::vector<HistoryEntry> matches;
+   index.search(terms, maxEntries, &matches);
+
+   std::vector<int> indexes;
+   for (std::size_t i = 0; i < matches.size(); i++)
+      indexes.push_back(matches[i].index);
+   return indexes;
+}
+
+std::vector<int> prefixIndexes(const HistoryIndex& index,
+                               const std::string& prefix,
+                               std::size_t maxEntries,
+                               bool uniqueOnly)
+{
+   std::vector<HistoryEntry> matches;
+   index.searchByPrefix(prefix, maxEntries, uniqueOnly, &matches);
+
+   std::vector<int> indexes;
+   for (std::size_t i = 0; i < matches.size(); i++)
+      indexes.push_back(matches[i].index);
+   return indexes;
+}
+
+} // anonymous namespace
+
+context("HistoryIndex")
+{
+   test_that("entries containing all terms are found most recent first")
+   {
+      HistoryIndex index;
+      addCommands(&index);
+
+      std::vector<std::string> terms;
+      terms.push_back("cars");
+      std::vector<int> found = searchIndexes(index, terms, 10);
+      expect_true(found.size() == 4);
+      expect_true(found[0] == 5);
+      expect_true(found[3] == 1);
+
+      terms.push_back("plot");
+      found = searchIndexes(index, terms, 10);
+      expect_true(found.size() == 2);
+      expect_true(found[0] == 5);
+      expect_true(found[1] == 1);
+
+      found = searchIndexes(index, terms, 1);
+      expect_true(found.size() == 1);
+      expect_true(found[0] == 5);
+
+      terms.push_back("missing");
+      expect_true(searchIndexes(index, terms, 10).empty());
+   }
+
+   test_that("short search terms are matched")
+   {
+      HistoryIndex index;
+      addCommands(&index);
+
+      std::vector<std::string> terms;
+      terms.push_back("x");
+      std::vector<int> found = searchIndexes(index, terms, 10);
+      expect_true(found.size() == 2);
+      expect_true(found[0] == 3);
+      expect_true(found[1] == 0);
+
+      expect_true(searchIndexes(index, std::vector<std::string>(), 10).size() == 6);
+   }
+
+   test_that("entries starting with a prefix are found most recent first")
+   {
+      HistoryIndex index;
+      addCommands(&index);
+
+      std::vector<int> found = prefixIndexes(index, "plot(", 10, false);
+      expect_true(found.size() == 3);
+      expect_true(found[0] == 5);
+      expect_true(found[1] == 3);
+      expect_true(found[2] == 1);
+
+      found = prefixIndexes(index, "plot(", 10, true);
+      expect_true(found.size() == 2);
+      expect_true(found[0] == 5);
+      expect_true(found[1] == 3);
+
+      found = prefixIndexes(index, "plot(", 1, false);
+      expect_true(found.size() == 1);
+      expect_true(found[0] == 5);
+
+      found = prefixIndexes(index, "", 10, true);
+      expect_true(found.size() == 5);
+      expect_true(found[0] == 5);
+
+      expect_true(prefixIndexes(index, "plots", 10, false).empty());
+   }
+
+   test_that("cleared indexes have no entries")
+   {
+      HistoryIndex index;
+      addCommands(&index);
+      index.clear();
+
+      expect_true(index.entries().empty());
+      expect_true(prefixIndexes(index, "plot(", 10, false).empty());
+   }
+}
+
+} // namespace history
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -650,9 +650,21 @@ void handleGraphicsRequest(const http::Request& request,
    // calculate the path to the png
    using namespace rstudio::r::session;
    FilePath imagePath = graphics::display().imagePath(filename);
-      
-   // if it exists then return it
-   if (imagePath.exists())
+
+   // if we have the image in memory then return it directly
+   boost::shared_ptr<const std::string> pImage =
+                              graphics::display().cachedImage(filename);
+   if (pImage)
+   {
+      // strong named - cache permanently (in user's browser only)
+      pResponse->setPrivateCacheForeverHeaders();
+
+      // (images are already compressed so we don't gzip them)
+      pResponse->setContentType(imagePath.mimeContentType());
+      pResponse->setBodyUnencoded(*pImage);
+   }
+   // otherwise if it exists then return it
+   else if (imagePath.exists())
    {
       // strong named - cache permanently (in user's browser only)
       pResponse->setPrivateCacheForeverHeaders();
@@ -662,8 +674,10 @@ void handleGraphicsRequest(const http::Request& request,
    }
    else
    {
-      // redirect to png for currently active plot
-      if (graphics::display().hasOutput())
+      // redirect to png for currently active plot (unless that's the
+      // image we couldn't find)
+      if (graphics::display().hasOutput() &&
+          graphics::display().imageFilename() != filename)
       {
          // calculate location of current image
          std::string imageFilename = graphics::display().imageFilename();
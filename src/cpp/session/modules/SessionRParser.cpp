@@ -44,6 +44,8 @@
 
 #include <boost/container/flat_set.hpp>
 #include <boost/bind.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
 
 namespace rstudio {
 namespace session {
@@ -1405,6 +1407,13 @@ ParseResults parse(const FilePath& filePath,
       return ParseResults();
    
    RTokens rTokens(rCode, RTokens::StripComments);
+   return parse(filePath, rTokens, parseOptions);
+}
+
+ParseResults parse(const FilePath& filePath,
+                   const RTokens& rTokens,
+                   const ParseOptions& parseOptions)
+{
    if (rTokens.empty())
       return ParseResults();
    
@@ -1457,6 +1466,303 @@ ParseResults parse(const FilePath &filePath, const ParseOptions &parseOptions)
             string_utils::utf8ToWide(contents),
             parseOptions);
 }
+
+struct ParseCache::Expression
+{
+   // the tokens of the expression (along with the column it starts at
+   // and the type of the token following it); everything recorded
+   // while parsing the expression is determined by these (and its row)
+   std::wstring tokens;
+   std::size_t hash;
+   
+   // hash of the (top-level) definitions of symbols referenced within
+   // the expression made by preceding expressions
+   std::size_t dependencies;
+   
+   std::size_t row;
+   boost::shared_ptr<ParseNode> pNode;
+   LintItems lint;
+};
+
+namespace {
+
+typedef boost::unordered_map<std::string, std::size_t> TopLevelDefinitions;
+
+bool isControlFlowHeaderKeyword(const RToken& rToken)
+{
+   return rToken.isType(RToken::ID) && (
+            rToken.contentEquals(L"if") ||
+            rToken.contentEquals(L"for") ||
+            rToken.contentEquals(L"while") ||
+            rToken.contentEquals(L"function"));
+}
+
+bool canEndTopLevelExpression(const RToken& rToken, bool closesHeader)
+{
+   if (rToken.isType(RToken::NUMBER) || rToken.isType(RToken::STRING))
+      return true;
+   
+   if (rToken.isType(RToken::ID))
+      return !isControlFlowHeaderKeyword(rToken) &&
+             !rToken.contentEquals(L"repeat") &&
+             !rToken.contentEquals(L"else") &&
+             !rToken.contentEquals(L"in");
+   
+   return isRightBracket(rToken) && !closesHeader;
+}
+
+bool canOnlyBeginTopLevelExpression(const RToken& rToken)
+{
+   if (rToken.isType(RToken::NUMBER) || rToken.isType(RToken::STRING))
+      return true;
+   
+   return rToken.isType(RToken::ID) && !rToken.contentEquals(L"else");
+}
+
+// Find the offsets of the first token of each top-level expression that can
+// be parsed on its own. We only split at a newline (outside of any brackets)
+// following a token that can end an expression, when the next line begins
+// with a token that can only begin a new expression; anything less clear-cut
+// (e.g. a line beginning with an operator or 'else', or following the header
+// of a function definition or 'if' statement) stays with the expression
+// preceding it.
+std::vector<std::size_t> findTopLevelExpressions(const RTokens& rTokens)
+{
+   std::vector<std::size_t> offsets;
+   offsets.push_back(0);
+   
+   // for each open bracket, whether it opens the header of a
+   // control flow statement or function definition
+   std::vector<char> brackets;
+   
+   bool canEnd = false;
+   bool sawNewline = false;
+   bool followsHeaderKeyword = false;
+   
+   for (std::size_t i = 0, n = rTokens.size(); i < n; ++i)
+   {
+      const RToken& rToken = rTokens.atUnsafe(i);
+      if (rToken.isType(RToken::WHITESPACE))
+      {
+         sawNewline = sawNewline || rToken.contentContains(L'\n');
+         continue;
+      }
+      
+      if (brackets.empty() && sawNewline && canEnd &&
+          canOnlyBeginTopLevelExpression(rToken))
+      {
+         offsets.push_back(i);
+      }
+      
+      bool closesHeader = false;
+      if (isLeftBracket(rToken))
+      {
+         brackets.push_back(rToken.isType(RToken::LPAREN) && followsHeaderKeyword);
+      }
+      else if (isRightBracket(rToken))
+      {
+         // unbalanced brackets; just parse the whole document
+         if (brackets.empty())
+            return std::vector<std::size_t>(1, 0);
+         
+         closesHeader = brackets.back();
+         brackets.pop_back();
+      }
+      
+      canEnd = canEndTopLevelExpression(rToken, closesHeader);
+      followsHeaderKeyword = isControlFlowHeaderKeyword(rToken);
+      sawNewline = false;
+   }
+   
+   return offsets;
+}
+
+void appendToKey(std::size_t value, std::wstring* pKey)
+{
+   // (wchar_t may only be 16 bits wide)
+   pKey->push_back(static_cast<wchar_t>(value & 0xFFFF));
+   pKey->push_back(static_cast<wchar_t>((value >> 16) & 0xFFFF));
+}
+
+std::wstring expressionTokens(const RTokens& rTokens,
+                              std::size_t begin,
+                              std::size_t end)
+{
+   std::wstring key;
+   appendToKey(rTokens.atUnsafe(begin).column(), &key);
+   appendToKey(rTokens.at(end).type(), &key);
+   
+   for (std::size_t i = begin; i < end; ++i)
+   {
+      const RToken& rToken = rTokens.atUnsafe(i);
+      appendToKey(rToken.type(), &key);
+      appendToKey(rToken.length(), &key);
+      key.append(rToken.begin(), rToken.end());
+   }
+   
+   return key;
+}
+
+std::size_t expressionDependencies(const RTokens& rTokens,
+                                   std::size_t begin,
+                                   std::size_t end,
+                                   const TopLevelDefinitions& definitions)
+{
+   std::set<std::string> names;
+   for (std::size_t i = begin; i < end; ++i)
+   {
+      const RToken& rToken = rTokens.atUnsafe(i);
+      if (rToken.isType(RToken::ID) || rToken.isType(RToken::STRING))
+      {
+         const std::string& name = rToken.contentAsUtf8();
+         if (definitions.count(name))
+            names.insert(name);
+      }
+   }
+   
+   std::size_t hash = 0;
+   BOOST_FOREACH(const std::string& name, names)
+   {
+      boost::hash_combine(hash, name);
+      boost::hash_combine(hash, definitions.find(name)->second);
+   }
+   return hash;
+}
+
+void addTopLevelDefinitions(const ParseCache::Expression& expression,
+                            TopLevelDefinitions* pDefinitions)
+{
+   const ParseNode::SymbolPositions& symbols = expression.pNode->getDefinedSymbols();
+   for (ParseNode::SymbolPositions::const_iterator it = symbols.begin();
+        it != symbols.end();
+        ++it)
+   {
+      boost::hash_combine((*pDefinitions)[it->first], expression.hash);
+   }
+   
+   BOOST_FOREACH(const boost::shared_ptr<ParseNode>& pChild,
+                 expression.pNode->getChildren())
+   {
+      boost::hash_combine((*pDefinitions)[pChild->name()], expression.hash);
+   }
+}
+
+} // anonymous namespace
+
+ParseResults parse(const FilePath& filePath,
+                   const std::wstring& rCode,
+                   const ParseOptions& parseOptions,
+                   ParseCache* pCache)
+{
+   typedef ParseCache::Expression Expression;
+   typedef boost::unordered_multimap<std::size_t, boost::shared_ptr<Expression> > Expressions;
+   
+   if (!pCache->parseOptions_.parsesLike(parseOptions))
+   {
+      pCache->clear();
+      pCache->parseOptions_ = parseOptions;
+   }
+   
+   if (rCode.empty() || rCode.find_first_not_of(L" \r\n\t\v") == std::string::npos)
+   {
+      pCache->clear();
+      return ParseResults();
+   }
+   
+   RTokens rTokens(rCode, RTokens::StripComments);
+   if (rTokens.empty())
+   {
+      pCache->clear();
+      return ParseResults();
+   }
+   
+   // index the expressions from the previous parse
+   Expressions previous;
+   BOOST_FOREACH(const boost::shared_ptr<Expression>& pExpression, pCache->expressions_)
+   {
+      previous.insert(std::make_pair(pExpression->hash, pExpression));
+   }
+   
+   boost::shared_ptr<ParseNode> pRoot = ParseNode::createRootNode();
+   LintItems lint(parseOptions);
+   TopLevelDefinitions definitions;
+   std::vector< boost::shared_ptr<Expression> > expressions;
+   std::size_t reparsedCount = 0;
+   
+   std::vector<std::size_t> offsets = findTopLevelExpressions(rTokens);
+   for (std::size_t i = 0, n = offsets.size(); i < n; ++i)
+   {
+      std::size_t begin = offsets[i];
+      std::size_t end = i + 1 < n ? offsets[i + 1] : rTokens.size();
+      
+      std::wstring tokens = expressionTokens(rTokens, begin, end);
+      std::size_t hash = boost::hash<std::wstring>()(tokens);
+      std::size_t dependencies = expressionDependencies(rTokens, begin, end, definitions);
+      std::size_t row = rTokens.atUnsafe(begin).row();
+      
+      // re-use the previous parse of this expression if possible
+      boost::shared_ptr<Expression> pExpression;
+      std::pair<Expressions::iterator, Expressions::iterator> range =
+            previous.equal_range(hash);
+      for (Expressions::iterator it = range.first; it != range.second; ++it)
+      {
+         if (it->second->dependencies == dependencies &&
+             it->second->tokens == tokens)
+         {
+            pExpression = it->second;
+            previous.erase(it);
+            break;
+         }
+      }
+      
+      if (pExpression)
+      {
+         int delta = static_cast<int>(row) - static_cast<int>(pExpression->row);
+         if (delta != 0)
+         {
+            pExpression->pNode->shiftRows(delta);
+            pExpression->lint.shiftRows(delta);
+            pExpression->row = row;
+         }
+      }
+      else
+      {
+         pExpression.reset(new Expression());
+         pExpression->tokens.swap(tokens);
+         pExpression->hash = hash;
+         pExpression->dependencies = dependencies;
+         pExpression->row = row;
+         pExpression->pNode = ParseNode::createTopLevelNode(pRoot.get());
+         
+         RTokenCursor cursor(rTokens, begin, end);
+         ParseStatus status(filePath, parseOptions, pExpression->pNode);
+         doParse(cursor, status);
+         status.addLintIfBracketStackNotEmpty();
+         
+         // expressions with errors may not have been split where a full
+         // parse would have ended them, so fall back to a full parse
+         if (status.node() != pExpression->pNode.get() || status.lint().hasErrors())
+         {
+            DEBUG("** Failed to parse top-level expression; parsing full document");
+            pCache->clear();
+            return parse(filePath, rCode, parseOptions);
+         }
+         
+         pExpression->lint = status.lint();
+         ++reparsedCount;
+      }
+      
+      pRoot->addTopLevelContents(pExpression->pNode.get());
+      lint.push_back(pExpression->lint);
+      addTopLevelDefinitions(*pExpression, &definitions);
+      expressions.push_back(pExpression);
+   }
+   
+   pCache->expressions_.swap(expressions);
+   pCache->reparsedCount_ = reparsedCount;
+   
+   return ParseResults(pRoot, lint, parseOptions.globals());
+}
 namespace {
 
 bool closesArgumentList(const RTokenCursor& cursor,
@@ -2008,7 +2314,7 @@ void doParse(RTokenCursor& cursor, ParseStatus& status)
 {
    DEBUG("Beginning parse...");
    // Return early if the document is empty (only whitespace or comments)
-   if (cursor.isAtEndOfDocument())
+   if (cursor.isAtEndOfDocument() && isWhitespaceOrComment(cursor))
       return;
    
    cursor.fwdOverWhitespaceAndComments();
@@ -2264,6 +2570,10 @@ START:
          DEBUG("-- Identifier -- " << cursor);
          if (cursor.isAtEndOfDocument())
          {
+            // the final identifier of a document is still a reference
+            if (cursor.isType(RToken::ID))
+               handleIdentifier(cursor, status);
+            
             while (status.isInControlFlowStatement())
                status.popState();
             return;
@@ -146,6 +146,17 @@ public:
    
    std::set<std::string>& globals() { return globals_; }
    const std::set<std::string>& globals() const { return globals_; }
+   
+   // whether parsing with these options produces the same parse tree and
+   // lint as parsing with 'other' (the 'defined but not used' check and the
+   // globals are applied to the parse results rather than during the parse)
+   bool parsesLike(const ParseOptions& other) const
+   {
+      return lintRFunctions_ == other.lintRFunctions_ &&
+             checkArgumentsToRFunctionCalls_ == other.checkArgumentsToRFunctionCalls_ &&
+             warnIfNoSuchVariableInScope_ == other.warnIfNoSuchVariableInScope_ &&
+             recordStyleLint_ == other.recordStyleLint_;
+   }
 
 private:
    bool lintRFunctions_;
@@ -479,6 +490,15 @@ public:
    bool hasErrors() const { return errorCount_ > 0; }
    void dump();
    
+   void shiftRows(int delta)
+   {
+      BOOST_FOREACH(LintItem& item, lintItems_)
+      {
+         item.startRow += delta;
+         item.endRow += delta;
+      }
+   }
+   
 private:
    
    void addLintItem(const RToken& rToken,
@@ -556,6 +576,18 @@ public:
                new ParseNode(NULL, name, Position(0, 0)));
    }
    
+   // create a node standing in for the root node while a single top-level
+   // expression is parsed on its own. symbols are resolved through the
+   // enclosing (document) root node, although the node is not one of its
+   // children; its contents are later added to that root node with
+   // 'addTopLevelContents()'.
+   static boost::shared_ptr<ParseNode> createTopLevelNode(
+         ParseNode* pEnclosingRoot)
+   {
+      return boost::shared_ptr<ParseNode>(
+               new ParseNode(pEnclosingRoot, "<root>", Position(0, 0)));
+   }
+   
    bool isRootNode() const
    {
       return pParent_ == NULL;
@@ -657,6 +689,65 @@ public:
       children_.push_back(pChild);
    }
    
+   // append the symbols and scopes of a top-level expression (parsed
+   // into a node from 'createTopLevelNode()') to this root node. the
+   // children are shared with (and re-parented from) the top-level node.
+   void addTopLevelContents(ParseNode* pNode)
+   {
+      pNode->pParent_ = this;
+      
+      appendPositions(pNode->definedSymbols_, &definedSymbols_);
+      appendPositions(pNode->referencedSymbols_, &referencedSymbols_);
+      appendPositions(pNode->nseReferencedSymbols_, &nseReferencedSymbols_);
+      
+      for (PackageSymbols::const_iterator it = pNode->internalSymbols_.begin();
+           it != pNode->internalSymbols_.end();
+           ++it)
+      {
+         internalSymbols_[it->first].insert(it->second.begin(), it->second.end());
+      }
+      
+      for (PackageSymbols::const_iterator it = pNode->exportedSymbols_.begin();
+           it != pNode->exportedSymbols_.end();
+           ++it)
+      {
+         exportedSymbols_[it->first].insert(it->second.begin(), it->second.end());
+      }
+      
+      symbolRanges_.insert(symbolRanges_.end(),
+                           pNode->symbolRanges_.begin(),
+                           pNode->symbolRanges_.end());
+      
+      BOOST_FOREACH(const boost::shared_ptr<ParseNode>& pChild, pNode->children_)
+      {
+         pChild->pParent_ = this;
+         children_.push_back(pChild);
+      }
+   }
+   
+   // move everything recorded within this node (but not the position of
+   // the node itself) by 'delta' rows
+   void shiftRows(int delta)
+   {
+      shiftPositions(&definedSymbols_, delta);
+      shiftPositions(&referencedSymbols_, delta);
+      shiftPositions(&nseReferencedSymbols_, delta);
+      
+      for (SymbolRanges::iterator it = symbolRanges_.begin();
+           it != symbolRanges_.end();
+           ++it)
+      {
+         it->first = Range(shiftPosition(it->first.begin(), delta),
+                           shiftPosition(it->first.end(), delta));
+      }
+      
+      BOOST_FOREACH(const boost::shared_ptr<ParseNode>& pChild, children_)
+      {
+         pChild->position_ = shiftPosition(pChild->position_, delta);
+         pChild->shiftRows(delta);
+      }
+   }
+   
    void findAllUnresolvedSymbols(std::vector<ParseItem>* pItems) const
    {
       // Get the unresolved symbols at this node
@@ -818,8 +909,8 @@ public:
    bool symbolHasDefinitionInRange(const std::string& symbol,
                                    const Position& position) const
    {
-      for (SymbolRanges::const_iterator it = symbolRanges().begin();
-           it != symbolRanges().end();
+      for (SymbolRanges::const_iterator it = symbolRanges_.begin();
+           it != symbolRanges_.end();
            ++it)
       {
          if (it->first.contains(position) &&
@@ -828,6 +919,10 @@ public:
             return true;
          }
       }
+      
+      if (pParent_)
+         return pParent_->symbolHasDefinitionInRange(symbol, position);
+      
       return false;
    }
    
@@ -945,10 +1040,9 @@ public:
          const Position& begin,
          const Position& end)
    {
-      core::algorithm::insert(
-            symbolRanges()[Range(begin, end)],
-            symbols.begin(),
-            symbols.end());
+      symbolRanges_.push_back(std::make_pair(
+            Range(begin, end),
+            std::set<std::string>(symbols.begin(), symbols.end())));
    }
    
 public:
@@ -986,11 +1080,39 @@ private:
    PackageSymbols internalSymbols_; // <pkg>::<foo>
    PackageSymbols exportedSymbols_; // <pgk>:::<bar>
    
-   typedef std::map<Range, std::set<std::string> > SymbolRanges;
-   static SymbolRanges& symbolRanges()
+   // symbols made available within (call) ranges of this node; these
+   // are also visible within the child nodes of this node
+   typedef std::vector< std::pair< Range, std::set<std::string> > > SymbolRanges;
+   SymbolRanges symbolRanges_;
+   
+   static void appendPositions(const SymbolPositions& from,
+                               SymbolPositions* pTo)
    {
-      static SymbolRanges instance;
-      return instance;
+      for (SymbolPositions::const_iterator it = from.begin();
+           it != from.end();
+           ++it)
+      {
+         Positions& positions = (*pTo)[it->first];
+         positions.insert(positions.end(), it->second.begin(), it->second.end());
+      }
+   }
+   
+   static Position shiftPosition(const Position& position, int delta)
+   {
+      return Position(position.row + delta, position.column);
+   }
+   
+   static void shiftPositions(SymbolPositions* pPositions, int delta)
+   {
+      for (SymbolPositions::iterator it = pPositions->begin();
+           it != pPositions->end();
+           ++it)
+      {
+         BOOST_FOREACH(Position& position, it->second)
+         {
+            position = shiftPosition(position, delta);
+         }
+      }
    }
 };
 
@@ -1010,6 +1132,21 @@ public:
       functionNames_.push(std::wstring(L""));
    }
    
+   // parse into an existing root node (e.g. one created with
+   // 'ParseNode::createTopLevelNode()')
+   ParseStatus(const FilePath& filePath,
+               const ParseOptions& parseOptions,
+               boost::shared_ptr<ParseNode> pRoot)
+      : pRoot_(pRoot),
+        pNode_(pRoot_.get()),
+        lint_(parseOptions),
+        parseOptions_(parseOptions),
+        filePath_(filePath)
+   {
+      parseStateStack_.push(ParseStateTopLevel);
+      functionNames_.push(std::wstring(L""));
+   }
+   
    ParseNode* node() { return pNode_; }
    LintItems& lint() { return lint_; }
    boost::shared_ptr<ParseNode> root() { return pRoot_; }
@@ -1447,11 +1584,66 @@ private:
    std::set<std::string> globals_;
 };
 
+// Retains the parse of each top-level expression within a document, so that
+// the document can be re-parsed after an edit by parsing only those top-level
+// expressions touched by the edit. An expression's parse is re-used when its
+// tokens are unchanged, as are the definitions (from preceding top-level
+// expressions) of the symbols it refers to; its positions are shifted to
+// account for any rows added or removed above it.
+//
+// Note that lint emitted while parsing can also depend on state outside
+// of the document (e.g. functions available on the search path); it is the
+// responsibility of the owner to clear the cache when that changes.
+class ParseCache : boost::noncopyable
+{
+public:
+   
+   ParseCache()
+      : reparsedCount_(0)
+   {}
+   
+   void clear()
+   {
+      expressions_.clear();
+      reparsedCount_ = 0;
+   }
+   
+   // number of top-level expressions in the most recent parse, and the
+   // number of those that had to be parsed
+   std::size_t size() const { return expressions_.size(); }
+   std::size_t reparsedCount() const { return reparsedCount_; }
+   
+   struct Expression;
+   
+private:
+   
+   friend ParseResults parse(const core::FilePath& filePath,
+                             const std::wstring& rCode,
+                             const ParseOptions& parseOptions,
+                             ParseCache* pCache);
+   
+   std::vector< boost::shared_ptr<Expression> > expressions_;
+   ParseOptions parseOptions_;
+   std::size_t reparsedCount_;
+};
+
 // Primary method ----
 ParseResults parse(const core::FilePath& filePath,
                    const std::wstring& rCode,
                    const ParseOptions& parseOptions = ParseOptions());
 
+// Parse code that has already been tokenized (with comments stripped)
+ParseResults parse(const core::FilePath& filePath,
+                   const core::r_util::RTokens& rTokens,
+                   const ParseOptions& parseOptions);
+
+// Incremental parse, re-using (and updating) the cached parse of a previous
+// version of the document
+ParseResults parse(const core::FilePath& filePath,
+                   const std::wstring& rCode,
+                   const ParseOptions& parseOptions,
+                   ParseCache* pCache);
+
 // Useful aliases ----
 ParseResults parse(const core::FilePath& filePath,
                    const ParseOptions& parseOptions = ParseOptions());
@@ -15,8 +15,11 @@
 
 #include "DefinitionIndex.hpp"
 
+#include <atomic>
 #include <deque>
+#include <set>
 
+#include <core/Thread.hpp>
 #include <core/FilePath.hpp>
 #include <core/DateTime.hpp>
 #include <core/PerformanceTimer.hpp>
@@ -28,6 +31,8 @@
 #include <session/SessionModuleContext.hpp>
 #include <session/projects/SessionProjects.hpp>
 
+#include "DefinitionStore.hpp"
+#include "FindReferences.hpp"
 #include "RSourceIndex.hpp"
 #include "RCompilationDatabase.hpp"
 
@@ -44,25 +49,63 @@ namespace {
 // flag indicating whether we are initialized
 bool s_initialized = false;
 
-struct CppDefinitions
-{
-   std::string file;
-   std::time_t fileLastWrite;
-   std::deque<CppDefinition> definitions;
-};
+// guards the definitions below (which are updated as translation units
+// are indexed in the background)
+boost::mutex s_mutex;
 
-// store definitions by file
-typedef std::map<std::string,CppDefinitions> DefinitionsByFile;
+// definitions indexed during this session, by file
+typedef std::map<std::string,CppFileDefinitions> DefinitionsByFile;
 DefinitionsByFile s_definitionsByFile;
 
-// visitor used to populate deque
+// definitions saved by a previous session, along with the set of files
+// whose stored definitions have since been replaced or removed
+DefinitionStore s_store;
+std::set<std::string> s_supersededFiles;
+
+bool isSuperseded(const std::string& file)
+{
+   return s_supersededFiles.count(file) != 0;
+}
+
+// a translation unit to be indexed
+struct IndexJob : boost::noncopyable
+{
+   IndexJob(const std::string& file,
+            std::time_t fileLastWrite,
+            const std::vector<std::string>& compileArgs,
+            int verbose)
+      : file(file),
+        fileLastWrite(fileLastWrite),
+        compileArgs(compileArgs),
+        verbose(verbose),
+        cancelled(false)
+   {
+   }
+
+   const std::string file;
+   const std::time_t fileLastWrite;
+   const std::vector<std::string> compileArgs;
+   const int verbose;
+   std::atomic<bool> cancelled;
+};
+
+// visitor used to populate deque (stops early if the job is cancelled)
 bool insertDefinition(const CppDefinition& definition,
-                      CppDefinitions* pDefinitions)
+                      CppFileDefinitions* pDefinitions,
+                      const IndexJob* pJob)
 {
+   if (pJob->cancelled)
+      return false;
+
    pDefinitions->definitions.push_back(definition);
    return true;
 }
 
+bool isJobCancelled(const IndexJob* pJob)
+{
+   return pJob->cancelled;
+}
+
 typedef boost::function<bool(const CppDefinition&)> DefinitionVisitor;
 
 CXChildVisitResult cursorVisitor(CXCursor cxCursor,
@@ -171,6 +214,272 @@ CXChildVisitResult cursorVisitor(CXCursor cxCursor,
    }
 }
 
+bool indexTranslationUnit(const IndexJob& job, CppFileDefinitions* pDefinitions)
+{
+   // create index (each translation unit gets its own, so that units can
+   // be parsed concurrently)
+   CXIndex index = libclang::clang().createIndex(
+             1 /* Exclude PCH */,
+             (job.verbose > 0) ? 1 : 0);
+
+   // get args in form clang expects
+   core::system::ProcessArgs argsArray(job.compileArgs);
+
+   // parse the translation unit
+   CXTranslationUnit tu = libclang::clang().parseTranslationUnit(
+                         index,
+                         job.file.c_str(),
+                         argsArray.args(),
+                         argsArray.argCount(),
+                         NULL, 0, // no unsaved files
+                         CXTranslationUnit_None |
+                         CXTranslationUnit_Incomplete);
+
+   // create definitions and wire visitor to it
+   pDefinitions->file = job.file;
+   pDefinitions->fileLastWrite = job.fileLastWrite;
+   DefinitionVisitor visitor =
+      boost::bind(insertDefinition, _1, pDefinitions, &job);
+
+   // visit the cursors and record references (unless we were cancelled
+   // while parsing)
+   if (tu != NULL && !job.cancelled)
+   {
+      libclang::clang().visitChildren(
+           libclang::clang().getTranslationUnitCursor(tu),
+           cursorVisitor,
+           (CXClientData)&visitor);
+
+      findAllReferences(tu,
+                        boost::bind(isJobCancelled, &job),
+                        &pDefinitions->references);
+   }
+
+   // dispose translation unit and index
+   if (tu != NULL)
+      libclang::clang().disposeTranslationUnit(tu);
+   libclang::clang().disposeIndex(index);
+
+   return tu != NULL && !job.cancelled;
+}
+
+// publish the definitions for an indexed translation unit (unless its job
+// was cancelled, in which case the definitions are out of date)
+void publishDefinitions(const IndexJob& job,
+                        const CppFileDefinitions& definitions)
+{
+   LOCK_MUTEX(s_mutex)
+   {
+      if (!job.cancelled)
+      {
+         s_definitionsByFile[job.file] = definitions;
+         s_supersededFiles.insert(job.file);
+      }
+   }
+   END_LOCK_MUTEX
+}
+
+// Indexes translation units on a bounded pool of background threads (so that
+// go to definition and definition searches can use whatever has been indexed
+// so far). Each file has at most one job; a new change to a file cancels its
+// pending or in progress job.
+class DefinitionIndexer : boost::noncopyable
+{
+public:
+   DefinitionIndexer()
+      : idleCount_(0), stopping_(false)
+   {
+   }
+
+   void enqueue(const boost::shared_ptr<IndexJob>& pJob)
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         if (stopping_)
+            return;
+
+         cancelJob(pJob->file);
+         jobs_[pJob->file] = pJob;
+         queue_.push_back(pJob);
+
+         // start another worker if none are free to pick this up
+         if (idleCount_ == 0 && threads_.size() < maxThreads())
+         {
+            boost::shared_ptr<boost::thread> pThread(new boost::thread());
+            core::thread::safeLaunchThread(
+                     boost::bind(&DefinitionIndexer::work, this),
+                     pThread.get());
+            if (pThread->joinable())
+               threads_.push_back(pThread);
+         }
+         else
+         {
+            workAvailable_.notify_one();
+         }
+      }
+      END_LOCK_MUTEX
+   }
+
+   void cancel(const std::string& file)
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         cancelJob(file);
+      }
+      END_LOCK_MUTEX
+   }
+
+   // cancel all jobs and stop the workers. a translation unit that's being
+   // parsed can't be interrupted, so we only wait a few seconds for the
+   // workers to exit (and leave any still parsing to finish on their own)
+   void stop()
+   {
+      std::vector<boost::shared_ptr<boost::thread> > threads;
+      LOCK_MUTEX(mutex_)
+      {
+         stopping_ = true;
+         for (std::map<std::string, boost::shared_ptr<IndexJob> >::iterator it =
+                 jobs_.begin(); it != jobs_.end(); ++it)
+         {
+            it->second->cancelled = true;
+         }
+         jobs_.clear();
+         queue_.clear();
+         threads.swap(threads_);
+      }
+      END_LOCK_MUTEX
+
+      workAvailable_.notify_all();
+
+      boost::posix_time::ptime deadline =
+            boost::posix_time::microsec_clock::universal_time() +
+            boost::posix_time::seconds(3);
+      try
+      {
+         for (std::size_t i = 0; i < threads.size(); i++)
+         {
+            if (!threads[i]->timed_join(deadline))
+            {
+               LOG_WARNING_MESSAGE("Indexing thread didn't stop within 3 sec");
+               threads[i]->detach();
+            }
+         }
+      }
+      catch(const boost::thread_interrupted&)
+      {
+         LOG_WARNING_MESSAGE("thread interrupted while stopping indexing");
+      }
+   }
+
+private:
+   static std::size_t maxThreads()
+   {
+      // parsing is CPU bound, so leave cores for the session and R
+      unsigned int cores = boost::thread::hardware_concurrency();
+      return std::max(1u, std::min(4u, cores / 2));
+   }
+
+   // (requires mutex_)
+   void cancelJob(const std::string& file)
+   {
+      std::map<std::string, boost::shared_ptr<IndexJob> >::iterator it =
+            jobs_.find(file);
+      if (it == jobs_.end())
+         return;
+
+      it->second->cancelled = true;
+      std::deque<boost::shared_ptr<IndexJob> >::iterator queued =
+            std::find(queue_.begin(), queue_.end(), it->second);
+      if (queued != queue_.end())
+         queue_.erase(queued);
+      jobs_.erase(it);
+   }
+
+   void work()
+   {
+      try
+      {
+         for (;;)
+         {
+            boost::shared_ptr<IndexJob> pJob;
+            {
+               boost::mutex::scoped_lock lock(mutex_);
+               ++idleCount_;
+               while (queue_.empty() && !stopping_)
+                  workAvailable_.wait(lock);
+               --idleCount_;
+
+               if (stopping_)
+                  return;
+
+               pJob = queue_.front();
+               queue_.pop_front();
+            }
+
+            CppFileDefinitions definitions;
+            if (indexTranslationUnit(*pJob, &definitions))
+               publishDefinitions(*pJob, definitions);
+
+            LOCK_MUTEX(mutex_)
+            {
+               std::map<std::string, boost::shared_ptr<IndexJob> >::iterator it =
+                     jobs_.find(pJob->file);
+               if (it != jobs_.end() && it->second == pJob)
+                  jobs_.erase(it);
+            }
+            END_LOCK_MUTEX
+         }
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+   }
+
+   boost::mutex mutex_;
+   boost::condition_variable workAvailable_;
+   std::deque<boost::shared_ptr<IndexJob> > queue_;
+   std::map<std::string, boost::shared_ptr<IndexJob> > jobs_;
+   std::vector<boost::shared_ptr<boost::thread> > threads_;
+   std::size_t idleCount_;
+   bool stopping_;
+};
+
+// (on the heap so that it outlives any workers still running at exit)
+DefinitionIndexer& definitionIndexer()
+{
+   static DefinitionIndexer* pIndexer = new DefinitionIndexer();
+   return *pIndexer;
+}
+
+// do we already have definitions for the file as of the given write time?
+bool hasFreshDefinitions(const std::string& file, std::time_t lastWriteTime)
+{
+   bool fresh = false;
+   LOCK_MUTEX(s_mutex)
+   {
+      DefinitionsByFile::const_iterator it = s_definitionsByFile.find(file);
+      if (it != s_definitionsByFile.end())
+      {
+         fresh = it->second.fileLastWrite >= lastWriteTime;
+      }
+      else if (!isSuperseded(file))
+      {
+         int index = s_store.findFile(file);
+         fresh = index != -1 && s_store.fileLastWrite(index) >= lastWriteTime;
+      }
+   }
+   END_LOCK_MUTEX
+   return fresh;
+}
+
+void removeDefinitions(const std::string& file)
+{
+   LOCK_MUTEX(s_mutex)
+   {
+      s_definitionsByFile.erase(file);
+      s_supersededFiles.insert(file);
+   }
+   END_LOCK_MUTEX
+}
+
 void fileChangeHandler(const core::system::FileChangeEvent& event)
 {
    // alias the filename
@@ -182,66 +491,31 @@ void fileChangeHandler(const core::system::FileChangeEvent& event)
    // enough index of the file
    if (event.type() == core::system::FileChangeEvent::FileAdded)
    {
-      // if we have a definition
-      DefinitionsByFile::const_iterator it = s_definitionsByFile.find(file);
-      if (it != s_definitionsByFile.end())
-      {
-         // if the definition is fresh enough then bail
-         if (it->second.fileLastWrite >= event.fileInfo().lastWriteTime())
-            return;
-      }
+      if (hasFreshDefinitions(file, event.fileInfo().lastWriteTime()))
+         return;
    }
 
-   // always remove existing definitions
-   s_definitionsByFile.erase(file);
+   // always cancel any indexing in progress and remove existing definitions
+   definitionIndexer().cancel(file);
+   removeDefinitions(file);
 
    // if this is an add or an update then re-index
    if (event.type() == core::system::FileChangeEvent::FileAdded ||
        event.type() == core::system::FileChangeEvent::FileModified)
    {    
-      // get the compilation arguments for this file and use them to
-      // create a translation unit
+      // get the compilation arguments for this file (this must happen on
+      // the main thread) and queue the translation unit for indexing
       std::vector<std::string> compileArgs =
          rCompilationDatabase().compileArgsForTranslationUnit(file, true);
 
       if (!compileArgs.empty())
       {
-         // create index
-         CXIndex index = libclang::clang().createIndex(
-                   1 /* Exclude PCH */,
-                   (rSourceIndex().verbose() > 0) ? 1 : 0);
-
-         // get args in form clang expects
-         core::system::ProcessArgs argsArray(compileArgs);
-
-         // parse the translation unit
-         CXTranslationUnit tu = libclang::clang().parseTranslationUnit(
-                               index,
-                               file.c_str(),
-                               argsArray.args(),
-                               argsArray.argCount(),
-                               NULL, 0, // no unsaved files
-                               CXTranslationUnit_None |
-                               CXTranslationUnit_Incomplete);
-
-
-         // create definitions and wire visitor to it
-         CppDefinitions definitions;
-         definitions.file = file;
-         definitions.fileLastWrite = event.fileInfo().lastWriteTime();
-         s_definitionsByFile[file] = definitions;
-         DefinitionVisitor visitor =
-            boost::bind(insertDefinition, _1, &s_definitionsByFile[file]);
-
-         // visit the cursors
-         libclang::clang().visitChildren(
-              libclang::clang().getTranslationUnitCursor(tu),
-              cursorVisitor,
-              (CXClientData)&visitor);
-
-         // dispose translation unit and index
-         libclang::clang().disposeTranslationUnit(tu);
-         libclang::clang().disposeIndex(index);
+         boost::shared_ptr<IndexJob> pJob(
+                  new IndexJob(file,
+                               event.fileInfo().lastWriteTime(),
+                               compileArgs,
+                               rSourceIndex().verbose()));
+         definitionIndexer().enqueue(pJob);
       }
    }
 }
@@ -358,15 +632,26 @@ FileLocation findDefinitionLocation(const FileLocation& location)
 
       // if we didn't find it there then look for it in our index
       // of all saved files
-      BOOST_FOREACH(const DefinitionsByFile::value_type& defs,
-                    s_definitionsByFile)
+      std::vector<CppDefinition> found;
+      LOCK_MUTEX(s_mutex)
       {
-         BOOST_FOREACH(const CppDefinition& def, defs.second.definitions)
+         BOOST_FOREACH(const DefinitionsByFile::value_type& defs,
+                       s_definitionsByFile)
          {
-            if (def.USR == USR)
-               return def.location;
+            BOOST_FOREACH(const CppDefinition& def, defs.second.definitions)
+            {
+               if (def.USR == USR)
+                  return def.location;
+            }
          }
+
+         // finally look in the store saved by a previous session
+         s_store.findUSR(USR, isSuperseded, true, &found);
       }
+      END_LOCK_MUTEX
+
+      if (!found.empty())
+         return found.front().location;
    }
 
    // see if we can resolve the cursor to a definition (if we can't
@@ -386,16 +671,80 @@ FileLocation findDefinitionLocation(const FileLocation& location)
    return FileLocation(FilePath(filename), line, column);
 }
 
+bool findIndexedReferences(const std::string& file,
+                           const std::string& USR,
+                           std::string* pSpelling,
+                           std::vector<core::libclang::FileRange>* pRefs)
+{
+   // references are only used if they were recorded as of the file's
+   // current last write time
+   FilePath filePath(file);
+   std::time_t lastWriteTime = filePath.lastWriteTime();
+   std::string normalizedUSR = referenceUSR(USR);
+
+   bool indexed = false;
+   std::vector<CppReference> references;
+   LOCK_MUTEX(s_mutex)
+   {
+      DefinitionsByFile::const_iterator it = s_definitionsByFile.find(file);
+      if (it != s_definitionsByFile.end())
+      {
+         if (it->second.fileLastWrite == lastWriteTime)
+         {
+            indexed = true;
+            BOOST_FOREACH(const CppReference& reference, it->second.references)
+            {
+               if (reference.USR == normalizedUSR)
+                  references.push_back(reference);
+            }
+         }
+      }
+      else if (!isSuperseded(file))
+      {
+         int index = s_store.findFile(file);
+         if (index != -1 && s_store.fileLastWrite(index) == lastWriteTime)
+         {
+            indexed = true;
+            s_store.findReferences(index, normalizedUSR, &references);
+         }
+      }
+   }
+   END_LOCK_MUTEX
+
+   if (!indexed)
+      return false;
+
+   BOOST_FOREACH(const CppReference& reference, references)
+   {
+      if (!reference.spelling.empty())
+         *pSpelling = reference.spelling;
+
+      FileRange range;
+      range.start = FileLocation(filePath, reference.startLine, reference.startColumn);
+      range.end = FileLocation(filePath, reference.endLine, reference.endColumn);
+      pRefs->push_back(range);
+   }
+
+   return true;
+}
+
 namespace {
 
+bool nameMatches(const std::string& term,
+                 const boost::regex& pattern,
+                 const std::string& name)
+{
+   if (!pattern.empty())
+      return regex_utils::textMatches(name, pattern, false, false);
+   else
+      return string_utils::isSubsequence(name, term, true);
+}
+
 bool matches(const std::string& term,
              const boost::regex& pattern,
              const CppDefinition& definition)
 {
-   if (!pattern.empty())
-      return regex_utils::textMatches(definition.name, pattern, false, false);
-   else
-      return string_utils::isSubsequence(definition.name, term, true);
+   return nameMatches(term, pattern, definition.name);
 }
 
 bool insertMatching(const std::string& term,
@@ -409,157 +758,72 @@ bool insertMatching(const std::string& term,
 }
 
 
-json::Object cppDefinitionToJson(const CppDefinition& definition)
+FilePath definitionStoreFilePath()
 {
-   using namespace safe_convert;
-   json::Object definitionJson;
-   definitionJson["usr"] = definition.USR;
-   definitionJson["kind"] = numberTo<int>(definition.kind, 0);
-   definitionJson["parent_name"] = definition.parentName;
-   definitionJson["name"] = definition.name;
-   definitionJson["file"] = definition.location.filePath.absolutePath();
-   definitionJson["line"] = numberTo<int>(definition.location.line, 1);
-   definitionJson["column"] = numberTo<int>(definition.location.column, 1);
-   return definitionJson;
+   return module_context::scopedScratchPath().childPath("cpp-definition-store");
 }
 
-CppDefinition cppDefinitionFromJson(const json::Object& object)
+void loadDefinitionIndex()
 {
-   // read json
-   int kind;
-   int line, column;
-   std::string file;
-   CppDefinition definition;
-   Error error = json::readObject(object,
-                                  "usr", &definition.USR,
-                                  "kind", &kind,
-                                  "parent_name", &definition.parentName,
-                                  "name", &definition.name,
-                                  "file", &file,
-                                  "line", &line,
-                                  "column", &column);
+   // remove the index written (as JSON) by earlier versions
+   Error error = module_context::scopedScratchPath()
+         .childPath("cpp-definition-cache").removeIfExists();
    if (error)
-   {
       LOG_ERROR(error);
-      return CppDefinition();
-   }
-
-   // required data transforms
-   using namespace safe_convert;
-   definition.kind = static_cast<CppDefinitionKind>(kind);
-   definition.location.filePath = FilePath(file);
-   definition.location.line = numberTo<unsigned>(line, 1);
-   definition.location.column = numberTo<unsigned>(column, 1);
 
-   // return definition
-   return definition;
-}
-
-FilePath definitionIndexFilePath()
-{
-   return module_context::scopedScratchPath().childPath("cpp-definition-cache");
-}
-
-void loadDefinitionIndex()
-{
-   using namespace safe_convert;
-
-   FilePath indexFilePath = definitionIndexFilePath();
-   if (!indexFilePath.exists())
-      return;
-
-   std::string contents;
-   Error error = readStringFromFile(indexFilePath, &contents);
+   // map the store (its definitions are read as they are needed)
+   error = s_store.open(definitionStoreFilePath());
    if (error)
-   {
       LOG_ERROR(error);
-      return;
-   }
+}
 
-   json::Value indexValueJson;
-   if (!json::parse(contents, &indexValueJson) ||
-       !json::isType<json::Array>(indexValueJson))
-   {
-      LOG_ERROR_MESSAGE("Error parsing definition index: " + contents);
-      return;
-   }
+void saveDefinitionIndex()
+{
+   std::vector<CppFileDefinitions> files;
 
-   json::Array indexJson = indexValueJson.get_array();
-   BOOST_FOREACH(const json::Value& definitionsJson, indexJson)
+   LOCK_MUTEX(s_mutex)
    {
-      if (!json::isType<json::Object>(definitionsJson))
+      BOOST_FOREACH(const DefinitionsByFile::value_type& defs, s_definitionsByFile)
       {
-         LOG_ERROR_MESSAGE("Unexpected non-object type in definition index");
-         continue;
+         files.push_back(defs.second);
       }
 
-      json::Array defsArrayJson;
-      double fileLastWrite;
-      CppDefinitions definitions;
-      Error error = json::readObject(definitionsJson.get_obj(),
-                                     "file", &definitions.file,
-                                     "file_last_write", &fileLastWrite,
-                                     "definitions", &defsArrayJson);
-      if (error)
+      // carry forward definitions from the store for files that haven't
+      // changed (and still exist)
+      for (std::size_t i = 0; i < s_store.fileCount(); i++)
       {
-         LOG_ERROR(error);
-         continue;
-      }
-      definitions.fileLastWrite = numberTo<double, std::time_t>(fileLastWrite, 0);
-
-      // if the file doesn't exist then bail
-      if (!FilePath::exists(definitions.file))
-         continue;
-
-      BOOST_FOREACH(const json::Value& defJson, defsArrayJson)
-      {
-         if (!json::isType<json::Object>(defJson))
-         {
-            LOG_ERROR_MESSAGE("Unexpected non-object type in definition index");
+         std::string file = s_store.filePath(i);
+         if (isSuperseded(file) || !FilePath::exists(file))
             continue;
-         }
 
-         CppDefinition definition = cppDefinitionFromJson(defJson.get_obj());
-         if (!definition.empty())
-            definitions.definitions.push_back(definition);
+         CppFileDefinitions definitions;
+         s_store.readFile(i, &definitions);
+         files.push_back(definitions);
       }
-
-      s_definitionsByFile[definitions.file] = definitions;
    }
-}
-
-
-void saveDefinitionIndex()
-{
-   using namespace safe_convert;
+   END_LOCK_MUTEX
 
-   json::Array indexJson;
-   BOOST_FOREACH(const DefinitionsByFile::value_type& defs, s_definitionsByFile)
+   // the store is closed while it's replaced (a mapped file can't be
+   // replaced on Windows) and then re-opened
+   LOCK_MUTEX(s_mutex)
    {
-      const CppDefinitions& definitions = defs.second;
-      json::Object definitionsJson;
-      definitionsJson["file"] = definitions.file;
-      definitionsJson["file_last_write"] = numberTo<std::time_t, double>(
-                                               definitions.fileLastWrite, 0);
-      json::Array defsArrayJson;
-      std::transform(definitions.definitions.begin(),
-                     definitions.definitions.end(),
-                     std::back_inserter(defsArrayJson),
-                     cppDefinitionToJson);
-      definitionsJson["definitions"] = defsArrayJson;
+      s_store.close();
 
-      indexJson.push_back(definitionsJson);
-   }
+      Error error = DefinitionStore::write(definitionStoreFilePath(), files);
+      if (error)
+         LOG_ERROR(error);
 
-   std::ostringstream ostr;
-   json::writeFormatted(indexJson, ostr);
-   Error error = writeStringToFile(definitionIndexFilePath(), ostr.str());
-   if (error)
-      LOG_ERROR(error);
+      error = s_store.open(definitionStoreFilePath());
+      if (error)
+         LOG_ERROR(error);
+   }
+   END_LOCK_MUTEX
 }
 
 void onShutdown(bool terminatedNormally)
 {
+   definitionIndexer().stop();
+
    if (terminatedNormally)
       saveDefinitionIndex();
 }
@@ -598,18 +862,35 @@ void searchDefinitions(const std::string& term,
    // for within the in-memory index)
    // if we didn't find it there then look for it in our index
    // of all saved files
-   BOOST_FOREACH(const DefinitionsByFile::value_type& defs, s_definitionsByFile)
+   LOCK_MUTEX(s_mutex)
    {
-      // skip files we've already searched
-      if (units.find(defs.first) != units.end())
-         continue;
+      BOOST_FOREACH(const DefinitionsByFile::value_type& defs, s_definitionsByFile)
+      {
+         // skip files we've already searched
+         if (units.find(defs.first) != units.end())
+            continue;
+
+         BOOST_FOREACH(const CppDefinition& def, defs.second.definitions)
+         {
+            if (matches(term, pattern, def))
+               pDefinitions->push_back(def);
+         }
+      }
 
-      BOOST_FOREACH(const CppDefinition& def, defs.second.definitions)
+      // and the store saved by a previous session (for files that haven't
+      // been re-indexed since)
+      for (std::size_t i = 0; i < s_store.fileCount(); i++)
       {
-         if (matches(term, pattern, def))
-            pDefinitions->push_back(def);
+         std::string file = s_store.filePath(i);
+         if (isSuperseded(file) || units.find(file) != units.end())
+            continue;
+
+         s_store.findNames(i,
+                           boost::bind(nameMatches, term, pattern, _1),
+                           pDefinitions);
       }
    }
+   END_LOCK_MUTEX
 }
 
 Error initializeDefinitionIndex()
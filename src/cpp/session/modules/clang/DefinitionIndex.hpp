@@ -79,12 +79,36 @@ struct CppDefinition
 
 std::ostream& operator<<(std::ostream& os, const CppDefinition& definition);
 
+// reference to a C++ symbol (within the file it was indexed from)
+struct CppReference
+{
+   CppReference()
+      : startLine(0), startColumn(0), endLine(0), endColumn(0)
+   {
+   }
+
+   std::string USR;      // (normalized with referenceUSR)
+   std::string spelling; // (empty if the identifier couldn't be located)
+   unsigned startLine;
+   unsigned startColumn;
+   unsigned endLine;
+   unsigned endColumn;
+};
+
 core::libclang::FileLocation findDefinitionLocation(
                      const core::libclang::FileLocation& location);
 
 void searchDefinitions(const std::string& term,
                        std::vector<CppDefinition>* pDefinitions);
 
+// Find the references to a USR recorded when the given file was indexed.
+// Returns false if the file hasn't been indexed as of its last write time
+// (in which case its references need to be found by parsing it).
+bool findIndexedReferences(const std::string& file,
+                           const std::string& USR,
+                           std::string* pSpelling,
+                           std::vector<core::libclang::FileRange>* pRefs);
+
 core::Error initializeDefinitionIndex();
 
 } // namespace clang
@@ -0,0 +1,709 @@
+/*
+ * DefinitionStore.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "DefinitionStore.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+#include <boost/foreach.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Log.hpp>
+#include <core/system/System.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace clang {
+
+namespace {
+
+// File layout (all integers little endian):
+//
+//   header       magic char[4] "RSCD", version u32, fileCount u32,
+//                definitionCount u32, referenceCount u32, stringsLength u32
+//   files        fileCount x { path u32, lastWrite u64,
+//                              firstDefinition u32, definitionCount u32,
+//                              firstReference u32, referenceCount u32 }
+//                (sorted by path)
+//   definitions  definitionCount x { USR u32, parentName u32, name u32,
+//                                    kind u32, file u32, line u32,
+//                                    column u32 }
+//                (grouped by file)
+//   USR index    definitionCount x u32 (definition indexes, sorted by USR)
+//   references   referenceCount x { USR u32, spelling u32, startLine u32,
+//                                   startColumn u32, endLine u32,
+//                                   endColumn u32 }
+//                (grouped by file, and sorted by USR within each file)
+//   strings      stringsLength bytes of { length u32, bytes }
+//
+// strings are referred to by their offset within the string table
+//
+const char kMagic[] = { 'R', 'S', 'C', 'D' };
+const boost::uint32_t kVersion = 2;
+
+const std::size_t kHeaderSize = sizeof(kMagic) + 5 * 4;
+const std::size_t kFileRecordSize = 4 + 8 + 4 * 4;
+const std::size_t kDefinitionRecordSize = 7 * 4;
+const std::size_t kReferenceRecordSize = 6 * 4;
+
+// field offsets within a definition record
+enum DefinitionField
+{
+   DefinitionUSR = 0,
+   DefinitionParentName = 4,
+   DefinitionName = 8,
+   DefinitionKind = 12,
+   DefinitionFile = 16,
+   DefinitionLine = 20,
+   DefinitionColumn = 24
+};
+
+// field offsets within a reference record
+enum ReferenceField
+{
+   ReferenceUSR = 0,
+   ReferenceSpelling = 4,
+   ReferenceStartLine = 8,
+   ReferenceStartColumn = 12,
+   ReferenceEndLine = 16,
+   ReferenceEndColumn = 20
+};
+
+// field offsets within a file record
+enum FileField
+{
+   FilePathField = 0,
+   FileLastWrite = 4,
+   FileFirstDefinition = 12,
+   FileDefinitionCount = 16,
+   FileFirstReference = 20,
+   FileReferenceCount = 24
+};
+
+void writeU32(boost::uint32_t value, std::string* pBuffer)
+{
+   for (int i = 0; i < 4; i++)
+      pBuffer->push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+}
+
+void writeU64(boost::uint64_t value, std::string* pBuffer)
+{
+   for (int i = 0; i < 8; i++)
+      pBuffer->push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+}
+
+boost::uint32_t readU32(const char* pData)
+{
+   boost::uint32_t value = 0;
+   for (int i = 3; i >= 0; i--)
+      value = (value << 8) | static_cast<unsigned char>(pData[i]);
+   return value;
+}
+
+boost::uint64_t readU64(const char* pData)
+{
+   boost::uint64_t value = 0;
+   for (int i = 7; i >= 0; i--)
+      value = (value << 8) | static_cast<unsigned char>(pData[i]);
+   return value;
+}
+
+// string table under construction (identical strings are shared)
+class StringTable
+{
+public:
+   boost::uint32_t add(const std::string& value)
+   {
+      std::map<std::string, boost::uint32_t>::const_iterator it =
+            offsets_.find(value);
+      if (it != offsets_.end())
+         return it->second;
+
+      boost::uint32_t offset = static_cast<boost::uint32_t>(data_.size());
+      writeU32(static_cast<boost::uint32_t>(value.size()), &data_);
+      data_.append(value);
+      offsets_[value] = offset;
+      return offset;
+   }
+
+   const std::string& data() const { return data_; }
+
+private:
+   std::string data_;
+   std::map<std::string, boost::uint32_t> offsets_;
+};
+
+struct DefinitionRecord
+{
+   std::string USR;
+   boost::uint32_t index;
+
+   bool operator<(const DefinitionRecord& other) const
+   {
+      return USR < other.USR || (USR == other.USR && index < other.index);
+   }
+};
+
+bool fileLessThan(const CppFileDefinitions* pLhs, const CppFileDefinitions* pRhs)
+{
+   return pLhs->file < pRhs->file;
+}
+
+bool referenceLessThan(const CppReference* pLhs, const CppReference* pRhs)
+{
+   return pLhs->USR < pRhs->USR;
+}
+
+} // anonymous namespace
+
+DefinitionStore::DefinitionStore()
+   : fileCount_(0),
+     definitionCount_(0),
+     referenceCount_(0),
+     filesOffset_(0),
+     definitionsOffset_(0),
+     usrIndexOffset_(0),
+     referencesOffset_(0),
+     stringsOffset_(0)
+{
+}
+
+Error DefinitionStore::open(const FilePath& storeFile)
+{
+   close();
+
+   if (!storeFile.exists() || storeFile.size() == 0)
+      return Success();
+
+   try
+   {
+      mapped_.open(storeFile.absolutePath());
+   }
+   catch(const std::exception& e)
+   {
+      Error error = systemError(boost::system::errc::io_error,
+                                ERROR_LOCATION);
+      error.addProperty("what", e.what());
+      error.addProperty("path", storeFile.absolutePath());
+      return error;
+   }
+
+   if (!validate())
+   {
+      // stale format or corrupt file -- treat as empty (it will be
+      // replaced the next time the store is written)
+      LOG_WARNING_MESSAGE("Ignoring invalid C++ definition store: " +
+                          storeFile.absolutePath());
+      close();
+   }
+
+   return Success();
+}
+
+void DefinitionStore::close()
+{
+   if (mapped_.is_open())
+      mapped_.close();
+
+   fileCount_ = 0;
+   definitionCount_ = 0;
+   referenceCount_ = 0;
+   filesOffset_ = 0;
+   definitionsOffset_ = 0;
+   usrIndexOffset_ = 0;
+   referencesOffset_ = 0;
+   stringsOffset_ = 0;
+}
+
+bool DefinitionStore::validate()
+{
+   std::size_t size = mapped_.size();
+   if (size < kHeaderSize || std::memcmp(data(), kMagic, sizeof(kMagic)) != 0)
+      return false;
+
+   const char* pHeader = data() + sizeof(kMagic);
+   if (readU32(pHeader) != kVersion)
+      return false;
+
+   boost::uint64_t fileCount = readU32(pHeader + 4);
+   boost::uint64_t definitionCount = readU32(pHeader + 8);
+   boost::uint64_t referenceCount = readU32(pHeader + 12);
+   boost::uint64_t stringsLength = readU32(pHeader + 16);
+
+   boost::uint64_t expectedSize = kHeaderSize +
+         fileCount * kFileRecordSize +
+         definitionCount * (kDefinitionRecordSize + 4) +
+         referenceCount * kReferenceRecordSize +
+         stringsLength;
+   if (expectedSize != size)
+      return false;
+
+   // record the layout (the accessors used below depend on it)
+   fileCount_ = static_cast<std::size_t>(fileCount);
+   definitionCount_ = static_cast<std::size_t>(definitionCount);
+   referenceCount_ = static_cast<std::size_t>(referenceCount);
+   filesOffset_ = kHeaderSize;
+   definitionsOffset_ = filesOffset_ + fileCount_ * kFileRecordSize;
+   usrIndexOffset_ = definitionsOffset_ + definitionCount_ * kDefinitionRecordSize;
+   referencesOffset_ = usrIndexOffset_ + definitionCount_ * 4;
+   stringsOffset_ = referencesOffset_ + referenceCount_ * kReferenceRecordSize;
+
+   boost::uint64_t expectedDefinition = 0;
+   boost::uint64_t expectedReference = 0;
+   std::string previousPath;
+   for (std::size_t i = 0; i < fileCount_; i++)
+   {
+      const char* pFile = data() + filesOffset_ + i * kFileRecordSize;
+      if (!isValidString(readU32(pFile + FilePathField), stringsLength))
+         return false;
+
+      // files must be sorted (we binary search them) and their
+      // definitions contiguous
+      std::string path = stringAt(readU32(pFile + FilePathField));
+      if (i > 0 && !(previousPath < path))
+         return false;
+      previousPath = path;
+
+      if (readU32(pFile + FileFirstDefinition) != expectedDefinition)
+         return false;
+      expectedDefinition += readU32(pFile + FileDefinitionCount);
+      if (expectedDefinition > definitionCount)
+         return false;
+
+      if (readU32(pFile + FileFirstReference) != expectedReference)
+         return false;
+      expectedReference += readU32(pFile + FileReferenceCount);
+      if (expectedReference > referenceCount)
+         return false;
+   }
+   if (expectedDefinition != definitionCount ||
+       expectedReference != referenceCount)
+   {
+      return false;
+   }
+
+   for (std::size_t i = 0; i < definitionCount_; i++)
+   {
+      const char* pDef = data() + definitionOffset(i);
+      if (!isValidString(readU32(pDef + DefinitionUSR), stringsLength) ||
+          !isValidString(readU32(pDef + DefinitionParentName), stringsLength) ||
+          !isValidString(readU32(pDef + DefinitionName), stringsLength) ||
+          readU32(pDef + DefinitionFile) >= fileCount)
+      {
+         return false;
+      }
+
+      if (readU32(data() + usrIndexOffset_ + i * 4) >= definitionCount)
+         return false;
+   }
+
+   for (std::size_t i = 0; i < referenceCount_; i++)
+   {
+      const char* pRef = data() + referenceOffset(i);
+      if (!isValidString(readU32(pRef + ReferenceUSR), stringsLength) ||
+          !isValidString(readU32(pRef + ReferenceSpelling), stringsLength))
+      {
+         return false;
+      }
+   }
+
+   // the USR index must be a permutation of the definitions sorted by USR
+   // and each file's references must be sorted by USR (both are binary
+   // searched)
+   std::vector<bool> indexed(definitionCount_, false);
+   for (std::size_t i = 0; i < definitionCount_; i++)
+   {
+      std::size_t index = readU32(data() + usrIndexOffset_ + i * 4);
+      if (indexed[index])
+         return false;
+      indexed[index] = true;
+
+      if (i > 0)
+      {
+         std::size_t previous = readU32(data() + usrIndexOffset_ + (i - 1) * 4);
+         if (stringLessThan(
+                readU32(data() + definitionOffset(index) + DefinitionUSR),
+                readU32(data() + definitionOffset(previous) + DefinitionUSR)))
+         {
+            return false;
+         }
+      }
+   }
+
+   for (std::size_t i = 0; i < fileCount_; i++)
+   {
+      const char* pFile = data() + filesOffset_ + i * kFileRecordSize;
+      std::size_t first = readU32(pFile + FileFirstReference);
+      std::size_t end = first + readU32(pFile + FileReferenceCount);
+      for (std::size_t j = first + 1; j < end; j++)
+      {
+         if (stringLessThan(
+                readU32(data() + referenceOffset(j) + ReferenceUSR),
+                readU32(data() + referenceOffset(j - 1) + ReferenceUSR)))
+         {
+            return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+bool DefinitionStore::isValidString(boost::uint64_t offset,
+                                    boost::uint64_t stringsLength) const
+{
+   if (offset + 4 > stringsLength)
+      return false;
+
+   boost::uint64_t length = readU32(data() + stringsOffset_ + offset);
+   return offset + 4 + length <= stringsLength;
+}
+
+std::string DefinitionStore::stringAt(std::size_t offset) const
+{
+   // (every string reference was checked when the store was opened)
+   const char* pString = data() + stringsOffset_ + offset;
+   return std::string(pString + 4, readU32(pString));
+}
+
+bool DefinitionStore::stringLessThan(std::size_t lhsOffset,
+                                     std::size_t rhsOffset) const
+{
+   // (compares as std::string does, without copying either string)
+   if (lhsOffset == rhsOffset)
+      return false;
+
+   const char* pLhs = data() + stringsOffset_ + lhsOffset;
+   const char* pRhs = data() + stringsOffset_ + rhsOffset;
+   std::size_t lhsLength = readU32(pLhs);
+   std::size_t rhsLength = readU32(pRhs);
+   int result = std::memcmp(pLhs + 4, pRhs + 4, std::min(lhsLength, rhsLength));
+   return result < 0 || (result == 0 && lhsLength < rhsLength);
+}
+
+std::size_t DefinitionStore::definitionOffset(std::size_t definitionIndex) const
+{
+   return definitionsOffset_ + definitionIndex * kDefinitionRecordSize;
+}
+
+std::size_t DefinitionStore::referenceOffset(std::size_t referenceIndex) const
+{
+   return referencesOffset_ + referenceIndex * kReferenceRecordSize;
+}
+
+CppReference DefinitionStore::readReference(std::size_t referenceIndex) const
+{
+   const char* pRef = data() + referenceOffset(referenceIndex);
+   CppReference reference;
+   reference.USR = stringAt(readU32(pRef + ReferenceUSR));
+   reference.spelling = stringAt(readU32(pRef + ReferenceSpelling));
+   reference.startLine = readU32(pRef + ReferenceStartLine);
+   reference.startColumn = readU32(pRef + ReferenceStartColumn);
+   reference.endLine = readU32(pRef + ReferenceEndLine);
+   reference.endColumn = readU32(pRef + ReferenceEndColumn);
+   return reference;
+}
+
+std::size_t DefinitionStore::definitionFile(std::size_t definitionIndex) const
+{
+   return readU32(data() + definitionOffset(definitionIndex) + DefinitionFile);
+}
+
+CppDefinition DefinitionStore::readDefinition(std::size_t definitionIndex,
+                                              const FilePath& filePath) const
+{
+   const char* pDef = data() + definitionOffset(definitionIndex);
+   return CppDefinition(
+            stringAt(readU32(pDef + DefinitionUSR)),
+            static_cast<CppDefinitionKind>(readU32(pDef + DefinitionKind)),
+            stringAt(readU32(pDef + DefinitionParentName)),
+            stringAt(readU32(pDef + DefinitionName)),
+            libclang::FileLocation(filePath,
+                                   readU32(pDef + DefinitionLine),
+                                   readU32(pDef + DefinitionColumn)));
+}
+
+int DefinitionStore::findFile(const std::string& file) const
+{
+   std::size_t lower = 0;
+   std::size_t upper = fileCount_;
+   while (lower < upper)
+   {
+      std::size_t middle = lower + (upper - lower) / 2;
+      std::string path = filePath(middle);
+      if (path < file)
+         lower = middle + 1;
+      else if (file < path)
+         upper = middle;
+      else
+         return static_cast<int>(middle);
+   }
+   return -1;
+}
+
+std::string DefinitionStore::filePath(std::size_t fileIndex) const
+{
+   const char* pFile = data() + filesOffset_ + fileIndex * kFileRecordSize;
+   return stringAt(readU32(pFile + FilePathField));
+}
+
+std::time_t DefinitionStore::fileLastWrite(std::size_t fileIndex) const
+{
+   const char* pFile = data() + filesOffset_ + fileIndex * kFileRecordSize;
+   return static_cast<std::time_t>(
+            static_cast<boost::int64_t>(readU64(pFile + FileLastWrite)));
+}
+
+void DefinitionStore::readFile(std::size_t fileIndex,
+                               CppFileDefinitions* pFile) const
+{
+   const char* pRecord = data() + filesOffset_ + fileIndex * kFileRecordSize;
+   pFile->file = filePath(fileIndex);
+   pFile->fileLastWrite = fileLastWrite(fileIndex);
+   pFile->definitions.clear();
+   pFile->references.clear();
+
+   FilePath filePath(pFile->file);
+   std::size_t first = readU32(pRecord + FileFirstDefinition);
+   std::size_t count = readU32(pRecord + FileDefinitionCount);
+   for (std::size_t i = first; i < first + count; i++)
+      pFile->definitions.push_back(readDefinition(i, filePath));
+
+   first = readU32(pRecord + FileFirstReference);
+   count = readU32(pRecord + FileReferenceCount);
+   for (std::size_t i = first; i < first + count; i++)
+      pFile->references.push_back(readReference(i));
+}
+
+void DefinitionStore::findNames(
+            std::size_t fileIndex,
+            const boost::function<bool(const std::string&)>& matches,
+            std::vector<CppDefinition>* pDefinitions) const
+{
+   const char* pRecord = data() + filesOffset_ + fileIndex * kFileRecordSize;
+   std::size_t first = readU32(pRecord + FileFirstDefinition);
+   std::size_t count = readU32(pRecord + FileDefinitionCount);
+   if (count == 0)
+      return;
+
+   FilePath filePath(this->filePath(fileIndex));
+   for (std::size_t i = first; i < first + count; i++)
+   {
+      const char* pDef = data() + definitionOffset(i);
+      if (matches(stringAt(readU32(pDef + DefinitionName))))
+         pDefinitions->push_back(readDefinition(i, filePath));
+   }
+}
+
+void DefinitionStore::findReferences(
+            std::size_t fileIndex,
+            const std::string& USR,
+            std::vector<CppReference>* pReferences) const
+{
+   const char* pRecord = data() + filesOffset_ + fileIndex * kFileRecordSize;
+   std::size_t first = readU32(pRecord + FileFirstReference);
+   std::size_t end = first + readU32(pRecord + FileReferenceCount);
+
+   // binary search the file's references for the first with this USR
+   std::size_t lower = first;
+   std::size_t upper = end;
+   while (lower < upper)
+   {
+      std::size_t middle = lower + (upper - lower) / 2;
+      const char* pRef = data() + referenceOffset(middle);
+      if (stringAt(readU32(pRef + ReferenceUSR)) < USR)
+         lower = middle + 1;
+      else
+         upper = middle;
+   }
+
+   for (std::size_t i = lower; i < end; i++)
+   {
+      CppReference reference = readReference(i);
+      if (reference.USR != USR)
+         break;
+      pReferences->push_back(reference);
+   }
+}
+
+void DefinitionStore::findUSR(
+            const std::string& USR,
+            const boost::function<bool(const std::string&)>& exclude,
+            bool firstOnly,
+            std::vector<CppDefinition>* pDefinitions) const
+{
+   // binary search the USR index for the first definition with this USR
+   std::size_t lower = 0;
+   std::size_t upper = definitionCount_;
+   while (lower < upper)
+   {
+      std::size_t middle = lower + (upper - lower) / 2;
+      std::size_t index = readU32(data() + usrIndexOffset_ + middle * 4);
+      const char* pDef = data() + definitionOffset(index);
+      if (stringAt(readU32(pDef + DefinitionUSR)) < USR)
+         lower = middle + 1;
+      else
+         upper = middle;
+   }
+
+   for (std::size_t i = lower; i < definitionCount_; i++)
+   {
+      std::size_t index = readU32(data() + usrIndexOffset_ + i * 4);
+      const char* pDef = data() + definitionOffset(index);
+      if (stringAt(readU32(pDef + DefinitionUSR)) != USR)
+         break;
+
+      std::string file = filePath(definitionFile(index));
+      if (exclude && exclude(file))
+         continue;
+
+      pDefinitions->push_back(readDefinition(index, FilePath(file)));
+      if (firstOnly)
+         break;
+   }
+}
+
+Error DefinitionStore::write(const FilePath& storeFile,
+                             const std::vector<CppFileDefinitions>& files)
+{
+   // files are written in path order
+   std::vector<const CppFileDefinitions*> sorted;
+   sorted.reserve(files.size());
+   BOOST_FOREACH(const CppFileDefinitions& file, files)
+   {
+      sorted.push_back(&file);
+   }
+   std::sort(sorted.begin(), sorted.end(), fileLessThan);
+
+   StringTable strings;
+   std::string fileRecords;
+   std::string definitionRecords;
+   std::string referenceRecords;
+   std::vector<DefinitionRecord> usrIndex;
+
+   boost::uint32_t definitionCount = 0;
+   boost::uint32_t referenceCount = 0;
+   for (std::size_t i = 0; i < sorted.size(); i++)
+   {
+      const CppFileDefinitions& file = *sorted[i];
+
+      // skip duplicate paths (the first wins)
+      if (i > 0 && sorted[i - 1]->file == file.file)
+         continue;
+
+      writeU32(strings.add(file.file), &fileRecords);
+      writeU64(static_cast<boost::uint64_t>(
+                  static_cast<boost::int64_t>(file.fileLastWrite)),
+               &fileRecords);
+      writeU32(definitionCount, &fileRecords);
+      writeU32(static_cast<boost::uint32_t>(file.definitions.size()), &fileRecords);
+      writeU32(referenceCount, &fileRecords);
+      writeU32(static_cast<boost::uint32_t>(file.references.size()), &fileRecords);
+
+      boost::uint32_t fileIndex = static_cast<boost::uint32_t>(
+               fileRecords.size() / kFileRecordSize - 1);
+
+      BOOST_FOREACH(const CppDefinition& definition, file.definitions)
+      {
+         writeU32(strings.add(definition.USR), &definitionRecords);
+         writeU32(strings.add(definition.parentName), &definitionRecords);
+         writeU32(strings.add(definition.name), &definitionRecords);
+         writeU32(static_cast<boost::uint32_t>(definition.kind), &definitionRecords);
+         writeU32(fileIndex, &definitionRecords);
+         writeU32(definition.location.line, &definitionRecords);
+         writeU32(definition.location.column, &definitionRecords);
+
+         DefinitionRecord record;
+         record.USR = definition.USR;
+         record.index = definitionCount++;
+         usrIndex.push_back(record);
+      }
+
+      // references are sorted by USR (keeping them in document order
+      // for each USR) so they can be binary searched
+      std::vector<const CppReference*> references;
+      references.reserve(file.references.size());
+      BOOST_FOREACH(const CppReference& reference, file.references)
+      {
+         references.push_back(&reference);
+      }
+      std::stable_sort(references.begin(), references.end(), referenceLessThan);
+
+      BOOST_FOREACH(const CppReference* pReference, references)
+      {
+         writeU32(strings.add(pReference->USR), &referenceRecords);
+         writeU32(strings.add(pReference->spelling), &referenceRecords);
+         writeU32(pReference->startLine, &referenceRecords);
+         writeU32(pReference->startColumn, &referenceRecords);
+         writeU32(pReference->endLine, &referenceRecords);
+         writeU32(pReference->endColumn, &referenceRecords);
+         referenceCount++;
+      }
+   }
+
+   std::sort(usrIndex.begin(), usrIndex.end());
+
+   std::string buffer;
+   buffer.append(kMagic, sizeof(kMagic));
+   writeU32(kVersion, &buffer);
+   writeU32(static_cast<boost::uint32_t>(fileRecords.size() / kFileRecordSize), &buffer);
+   writeU32(definitionCount, &buffer);
+   writeU32(referenceCount, &buffer);
+   writeU32(static_cast<boost::uint32_t>(strings.data().size()), &buffer);
+   buffer.append(fileRecords);
+   buffer.append(definitionRecords);
+   BOOST_FOREACH(const DefinitionRecord& record, usrIndex)
+   {
+      writeU32(record.index, &buffer);
+   }
+   buffer.append(referenceRecords);
+   buffer.append(strings.data());
+
+   // write to a temporary file and rename it into place so that a reader
+   // never observes a partially written store (and so that a store which
+   // is currently mapped remains intact)
+   Error error = storeFile.parent().ensureDirectory();
+   if (error)
+      return error;
+
+   FilePath tempFile = storeFile.parent().childPath(
+            storeFile.filename() + "." + core::system::generateShortenedUuid());
+   error = writeStringToFile(tempFile, buffer);
+   if (error)
+      return error;
+
+   error = tempFile.move(storeFile);
+   if (error)
+   {
+      Error removeError = tempFile.removeIfExists();
+      if (removeError)
+         LOG_ERROR(removeError);
+      return error;
+   }
+
+   return Success();
+}
+
+} // namespace clang
+} // namespace modules
+} // namespace session
+} // namespace rstudio
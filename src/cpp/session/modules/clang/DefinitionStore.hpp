@@ -0,0 +1,144 @@
+/*
+ * DefinitionStore.hpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_MODULES_CLANG_DEFINITION_STORE_HPP
+#define SESSION_MODULES_CLANG_DEFINITION_STORE_HPP
+
+#include <ctime>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/utility.hpp>
+
+#include "DefinitionIndex.hpp"
+
+namespace rstudio {
+namespace core {
+   class Error;
+   class FilePath;
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace clang {
+
+// the definitions within a file (and the references it makes), as of the
+// file's last write time
+struct CppFileDefinitions
+{
+   CppFileDefinitions()
+      : fileLastWrite(0)
+   {
+   }
+
+   std::string file;
+   std::time_t fileLastWrite;
+   std::deque<CppDefinition> definitions;
+   std::deque<CppReference> references;
+};
+
+// Persistent store of C++ definitions and references, grouped by file and recorded along
+// with each file's last write time. The store is written as a single flat
+// binary file of fixed size records (plus a string table) which is memory
+// mapped when opened, so that opening it doesn't require reading the
+// definitions it contains; definitions are read (and can be found by USR)
+// directly from the mapped file.
+class DefinitionStore : boost::noncopyable
+{
+public:
+   DefinitionStore();
+
+   // Open (and map) the store, replacing any store already open. A missing
+   // file is not an error; a store with an unknown format or that is
+   // corrupt is treated as empty.
+   core::Error open(const core::FilePath& storeFile);
+
+   void close();
+
+   // Write the given definitions as a store (via a temporary file which is
+   // then renamed into place, so a reader never sees a partial store). The
+   // store file must not be open while it is written: a mapped file can't
+   // be replaced on Windows.
+   static core::Error write(const core::FilePath& storeFile,
+                            const std::vector<CppFileDefinitions>& files);
+
+   std::size_t fileCount() const { return fileCount_; }
+   std::size_t definitionCount() const { return definitionCount_; }
+   std::size_t referenceCount() const { return referenceCount_; }
+
+   // index of the given file (or -1 if the file isn't in the store)
+   int findFile(const std::string& file) const;
+
+   std::string filePath(std::size_t fileIndex) const;
+   std::time_t fileLastWrite(std::size_t fileIndex) const;
+   void readFile(std::size_t fileIndex, CppFileDefinitions* pFile) const;
+
+   // Find the definitions within a file whose names match (names are
+   // matched against the mapped string table, so only the definitions
+   // that match are read)
+   void findNames(std::size_t fileIndex,
+                  const boost::function<bool(const std::string&)>& matches,
+                  std::vector<CppDefinition>* pDefinitions) const;
+
+   // Find the definitions with the given USR (in the order of the files
+   // they appear in), skipping any within files for which 'exclude'
+   // returns true. Stops after the first definition if 'firstOnly' is set.
+   void findUSR(const std::string& USR,
+                const boost::function<bool(const std::string&)>& exclude,
+                bool firstOnly,
+                std::vector<CppDefinition>* pDefinitions) const;
+
+   // Find the references to the given USR (as normalized by referenceUSR)
+   // made by a file
+   void findReferences(std::size_t fileIndex,
+                       const std::string& USR,
+                       std::vector<CppReference>* pReferences) const;
+
+private:
+   const char* data() const { return mapped_.data(); }
+   std::string stringAt(std::size_t offset) const;
+   bool stringLessThan(std::size_t lhsOffset, std::size_t rhsOffset) const;
+   std::size_t definitionOffset(std::size_t definitionIndex) const;
+   CppDefinition readDefinition(std::size_t definitionIndex,
+                                const core::FilePath& filePath) const;
+   std::size_t definitionFile(std::size_t definitionIndex) const;
+   std::size_t referenceOffset(std::size_t referenceIndex) const;
+   CppReference readReference(std::size_t referenceIndex) const;
+   bool isValidString(boost::uint64_t offset, boost::uint64_t stringsLength) const;
+   bool validate();
+
+   boost::iostreams::mapped_file_source mapped_;
+   std::size_t fileCount_;
+   std::size_t definitionCount_;
+   std::size_t referenceCount_;
+   std::size_t filesOffset_;
+   std::size_t definitionsOffset_;
+   std::size_t usrIndexOffset_;
+   std::size_t referencesOffset_;
+   std::size_t stringsOffset_;
+};
+
+} // namespace clang
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_MODULES_CLANG_DEFINITION_STORE_HPP
@@ -0,0 +1,290 @@
+/*
+ * DefinitionStoreTests.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include "DefinitionStore.hpp"
+
+#include <algorithm>
+#include <functional>
+
+#include <boost/bind.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace clang {
+
+using namespace core;
+using namespace core::libclang;
+
+namespace {
+
+bool excludeNothing(const std::string&)
+{
+   return false;
+}
+
+bool excludeFile(const std::string& excluded, const std::string& file)
+{
+   return file == excluded;
+}
+
+CppFileDefinitions makeFile(const std::string& file, std::time_t lastWrite)
+{
+   CppFileDefinitions definitions;
+   definitions.file = file;
+   definitions.fileLastWrite = lastWrite;
+   return definitions;
+}
+
+void addDefinition(CppFileDefinitions* pFile,
+                   const std::string& USR,
+                   const std::string& name,
+                   unsigned line)
+{
+   pFile->definitions.push_back(
+      CppDefinition(USR,
+                    CppFunctionDefinition,
+                    "Parent",
+                    name,
+                    FileLocation(FilePath(pFile->file), line, 1)));
+}
+
+void addReference(CppFileDefinitions* pFile,
+                  const std::string& USR,
+                  unsigned line)
+{
+   CppReference reference;
+   reference.USR = USR;
+   reference.spelling = USR.substr(USR.find_last_of('@') + 1);
+   reference.startLine = line;
+   reference.startColumn = 3;
+   reference.endLine = line;
+   reference.endColumn = 9;
+   pFile->references.push_back(reference);
+}
+
+std::vector<CppFileDefinitions> makeFiles()
+{
+   CppFileDefinitions foo = makeFile("/src/foo.cpp", 100);
+   addDefinition(&foo, "c:@F@foo#", "foo", 10);
+   addDefinition(&foo, "c:@F@shared#", "shared", 20);
+
+   CppFileDefinitions bar = makeFile("/src/bar.cpp", 200);
+   addDefinition(&bar, "c:@F@bar#", "bar", 5);
+   addDefinition(&bar, "c:@F@shared#", "shared", 7);
+   addReference(&bar, "c:@F@shared", 30);
+   addReference(&bar, "c:@F@foo", 31);
+   addReference(&bar, "c:@F@shared", 32);
+
+   std::vector<CppFileDefinitions> files;
+   files.push_back(foo);
+   files.push_back(bar);
+   files.push_back(makeFile("/src/empty.cpp", 300));
+   return files;
+}
+
+} // anonymous namespace
+
+context("DefinitionStore")
+{
+   test_that("definitions round trip through the store")
+   {
+      FilePath storeFile;
+      expect_false(FilePath::tempFilePath(&storeFile));
+      expect_false(DefinitionStore::write(storeFile, makeFiles()));
+
+      DefinitionStore store;
+      expect_false(store.open(storeFile));
+      expect_true(store.fileCount() == 3);
+      expect_true(store.definitionCount() == 4);
+
+      int index = store.findFile("/src/foo.cpp");
+      expect_true(index != -1);
+      expect_true(store.filePath(index) == "/src/foo.cpp");
+      expect_true(store.fileLastWrite(index) == 100);
+
+      CppFileDefinitions foo;
+      store.readFile(index, &foo);
+      expect_true(foo.file == "/src/foo.cpp");
+      expect_true(foo.definitions.size() == 2);
+      expect_true(foo.definitions[0].USR == "c:@F@foo#");
+      expect_true(foo.definitions[0].name == "foo");
+      expect_true(foo.definitions[0].parentName == "Parent");
+      expect_true(foo.definitions[0].kind == CppFunctionDefinition);
+      expect_true(foo.definitions[0].location ==
+                  FileLocation(FilePath("/src/foo.cpp"), 10, 1));
+
+      CppFileDefinitions empty;
+      store.readFile(store.findFile("/src/empty.cpp"), &empty);
+      expect_true(empty.definitions.empty());
+
+      expect_true(store.findFile("/src/missing.cpp") == -1);
+
+      storeFile.removeIfExists();
+   }
+
+   test_that("definitions can be found by USR")
+   {
+      FilePath storeFile;
+      expect_false(FilePath::tempFilePath(&storeFile));
+      expect_false(DefinitionStore::write(storeFile, makeFiles()));
+
+      DefinitionStore store;
+      expect_false(store.open(storeFile));
+
+      std::vector<CppDefinition> found;
+      store.findUSR("c:@F@shared#", excludeNothing, false, &found);
+      expect_true(found.size() == 2);
+
+      found.clear();
+      store.findUSR("c:@F@shared#", excludeNothing, true, &found);
+      expect_true(found.size() == 1);
+
+      found.clear();
+      store.findUSR("c:@F@shared#",
+                    boost::bind(excludeFile, "/src/bar.cpp", _1),
+                    false,
+                    &found);
+      expect_true(found.size() == 1);
+      expect_true(found[0].location.filePath.absolutePath() == "/src/foo.cpp");
+
+      found.clear();
+      store.findUSR("c:@F@none#", excludeNothing, false, &found);
+      expect_true(found.empty());
+
+      storeFile.removeIfExists();
+   }
+
+   test_that("references can be found by file and USR")
+   {
+      FilePath storeFile;
+      expect_false(FilePath::tempFilePath(&storeFile));
+      expect_false(DefinitionStore::write(storeFile, makeFiles()));
+
+      DefinitionStore store;
+      expect_false(store.open(storeFile));
+      expect_true(store.referenceCount() == 3);
+
+      int bar = store.findFile("/src/bar.cpp");
+      std::vector<CppReference> found;
+      store.findReferences(bar, "c:@F@shared", &found);
+      expect_true(found.size() == 2);
+      expect_true(found[0].startLine == 30);
+      expect_true(found[1].startLine == 32);
+      expect_true(found[0].spelling == "shared");
+      expect_true(found[0].startColumn == 3);
+      expect_true(found[0].endColumn == 9);
+
+      found.clear();
+      store.findReferences(bar, "c:@F@missing", &found);
+      expect_true(found.empty());
+
+      found.clear();
+      store.findReferences(store.findFile("/src/foo.cpp"), "c:@F@shared", &found);
+      expect_true(found.empty());
+
+      CppFileDefinitions definitions;
+      store.readFile(bar, &definitions);
+      expect_true(definitions.references.size() == 3);
+
+      storeFile.removeIfExists();
+   }
+
+   test_that("definitions can be found by name")
+   {
+      FilePath storeFile;
+      expect_false(FilePath::tempFilePath(&storeFile));
+      expect_false(DefinitionStore::write(storeFile, makeFiles()));
+
+      DefinitionStore store;
+      expect_false(store.open(storeFile));
+
+      std::vector<CppDefinition> found;
+      store.findNames(store.findFile("/src/bar.cpp"),
+                      boost::bind(std::equal_to<std::string>(), "shared", _1),
+                      &found);
+      expect_true(found.size() == 1);
+      expect_true(found[0].USR == "c:@F@shared#");
+      expect_true(found[0].location ==
+                  FileLocation(FilePath("/src/bar.cpp"), 7, 1));
+
+      found.clear();
+      store.findNames(store.findFile("/src/empty.cpp"),
+                      boost::bind(std::equal_to<std::string>(), "shared", _1),
+                      &found);
+      expect_true(found.empty());
+
+      storeFile.removeIfExists();
+   }
+
+   test_that("corrupt and missing stores are treated as empty")
+   {
+      FilePath storeFile;
+      expect_false(FilePath::tempFilePath(&storeFile));
+      expect_false(DefinitionStore::write(storeFile, makeFiles()));
+
+      // truncate the store part way through its records
+      std::string contents;
+      expect_false(readStringFromFile(storeFile, &contents));
+      expect_false(writeStringToFile(storeFile, contents.substr(0, contents.size() / 2)));
+
+      DefinitionStore store;
+      expect_false(store.open(storeFile));
+      expect_true(store.fileCount() == 0);
+      expect_true(store.findFile("/src/foo.cpp") == -1);
+
+      // swap the first two entries of the USR index (so that it's no
+      // longer sorted)
+      std::size_t usrIndex = 24 + 3 * 28 + 4 * 28;
+      std::string unsorted = contents;
+      std::swap_ranges(unsorted.begin() + usrIndex,
+                       unsorted.begin() + usrIndex + 4,
+                       unsorted.begin() + usrIndex + 4);
+      expect_false(writeStringToFile(storeFile, unsorted));
+      expect_false(store.open(storeFile));
+      expect_true(store.fileCount() == 0);
+
+      // and likewise the first two references (both in bar.cpp)
+      std::size_t references = usrIndex + 4 * 4;
+      unsorted = contents;
+      std::swap_ranges(unsorted.begin() + references,
+                       unsorted.begin() + references + 24,
+                       unsorted.begin() + references + 24);
+      expect_false(writeStringToFile(storeFile, unsorted));
+      expect_false(store.open(storeFile));
+      expect_true(store.fileCount() == 0);
+
+      // (the intact store is valid)
+      expect_false(writeStringToFile(storeFile, contents));
+      expect_false(store.open(storeFile));
+      expect_true(store.fileCount() == 3);
+
+      expect_false(store.open(FilePath("/no/such/definition/store")));
+      expect_true(store.fileCount() == 0);
+
+      storeFile.removeIfExists();
+   }
+}
+
+} // namespace clang
+} // namespace modules
+} // namespace session
+} // namespace rstudio
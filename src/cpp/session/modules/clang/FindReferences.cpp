@@ -43,7 +43,7 @@ namespace {
 struct FindReferencesData
 {
    FindReferencesData(CXTranslationUnit tu, const std::string& USR)
-      : tu(tu), USR(USR)
+      : tu(tu), USR(referenceUSR(USR))
    {
    }
    CXTranslationUnit tu;
@@ -52,26 +52,64 @@ struct FindReferencesData
    std::vector<FileRange> references;
 };
 
-// if the USR's differ only by an ending # consider them equal
-// we do this because references to function declarations seem to
-// accue an extra # within their USRs
-bool equalUSR(const std::string& USR1, const std::string& USR2)
+// locate the identifier for a reference (returns false if the identifier
+// couldn't be found, in which case the range is the whole cursor extent)
+bool referenceRange(CXTranslationUnit tu,
+                    const Cursor& cursor,
+                    const Cursor& referencedCursor,
+                    FileRange* pRange)
 {
-   using namespace boost::algorithm;
-   bool endHashUSR1 = ends_with(USR1, "#");
-   bool endHashUSR2 = ends_with(USR2, "#");
-   if ((endHashUSR1 && endHashUSR2) || (!endHashUSR1 && !endHashUSR2))
+   // tokenize to extract identifer location for cursors that
+   // represent larger source constructs
+   libclang::Tokens tokens(tu, cursor.getExtent());
+   std::vector<unsigned> indexes;
+
+   // for constructors & destructors we search backwards so that the
+   // match is for the constructor identifier rather than the class
+   // identifer
+   unsigned numTokens = tokens.numTokens();
+   if (referencedCursor.getKind() == CXCursor_Constructor ||
+       referencedCursor.getKind() == CXCursor_Destructor)
    {
-      return USR1 == USR2;
+      for (unsigned i = 0; i < numTokens; i++)
+         indexes.push_back(numTokens - i - 1);
    }
-   else if (endHashUSR1)
+   else
    {
-      return USR1.substr(0, USR1.length() - 1) == USR2;
+      for (unsigned i = 0; i < numTokens; i++)
+         indexes.push_back(i);
    }
-   else
+
+   // cycle through the tokens
+   std::string spelling = cursor.spelling();
+   BOOST_FOREACH(unsigned i, indexes)
    {
-      return USR2.substr(0, USR2.length() - 1) == USR1;
+      Token token = tokens.getToken(i);
+      if (token.kind() == CXToken_Identifier &&
+          token.spelling() == spelling)
+      {
+         *pRange = token.extent().getFileRange();
+         return true;
+      }
    }
+
+   // if we didn't find an identifier that matches use the
+   // original match (i.e. important for constructors where
+   // the 'spelling' of the invocation is the name of the
+   // variable declared)
+   *pRange = cursor.getExtent().getFileRange();
+   return false;
+}
+
+// get the declaration referenced by a cursor (returns a null cursor if
+// there isn't one)
+Cursor referencedDeclaration(const Cursor& cursor)
+{
+   Cursor referencedCursor = cursor.getReferenced();
+   if (referencedCursor.isValid() && referencedCursor.isDeclaration())
+      return referencedCursor;
+   else
+      return Cursor();
 }
 
 CXChildVisitResult findReferencesVisitor(CXCursor cxCursor,
@@ -93,70 +131,89 @@ CXChildVisitResult findReferencesVisitor(CXCursor cxCursor,
    if (!location.isFromMainFile())
       return CXChildVisit_Continue;
 
-   // get referenced cursor
-   Cursor referencedCursor = cursor.getReferenced();
-   if (referencedCursor.isValid() && referencedCursor.isDeclaration())
+   // get referenced cursor (and check for matching USR)
+   Cursor referencedCursor = referencedDeclaration(cursor);
+   if (referencedCursor.isValid() &&
+       referenceUSR(referencedCursor.getUSR()) == pData->USR)
    {
-      // check for matching USR
-      if (equalUSR(referencedCursor.getUSR(), pData->USR))
+      FileRange foundRange;
+      if (referenceRange(pData->tu, cursor, referencedCursor, &foundRange))
       {
-         // tokenize to extract identifer location for cursors that
-         // represent larger source constructs
-         FileRange foundRange;
-         libclang::Tokens tokens(pData->tu, cursor.getExtent());
-         std::vector<unsigned> indexes;
-
-         // for constructors & destructors we search backwards so that the
-         // match is for the constructor identifier rather than the class
-         // identifer
-         unsigned numTokens = tokens.numTokens();
-         if (referencedCursor.getKind() == CXCursor_Constructor ||
-             referencedCursor.getKind() == CXCursor_Destructor)
-         {
-            for (unsigned i = 0; i < numTokens; i++)
-               indexes.push_back(numTokens - i - 1);
-         }
-         else
-         {
-            for (unsigned i = 0; i < numTokens; i++)
-               indexes.push_back(i);
-         }
+         // record spelling if necessary
+         if (pData->spelling.empty())
+            pData->spelling = cursor.spelling();
+      }
 
-         // cycle through the tokens
-         BOOST_FOREACH(unsigned i, indexes)
-         {
-            Token token = tokens.getToken(i);
-            if (token.kind() == CXToken_Identifier &&
-                token.spelling() == cursor.spelling())
-            {
-               // record spelling if necessary
-               if (pData->spelling.empty())
-                  pData->spelling = cursor.spelling();
+      // record the range if it's not a duplicate of the previous range
+      if (pData->references.empty() ||
+          (pData->references.back() != foundRange))
+      {
+         pData->references.push_back(foundRange);
+      }
+   }
 
-               // record the range
-               foundRange = token.extent().getFileRange();
+   // recurse into namespaces, classes, etc.
+   return CXChildVisit_Recurse;
+}
 
-               break;
-            }
-         }
+struct FindAllReferencesData
+{
+   FindAllReferencesData(CXTranslationUnit tu,
+                         const boost::function<bool()>& isCancelled,
+                         std::deque<CppReference>* pReferences)
+      : tu(tu), isCancelled(isCancelled), pReferences(pReferences)
+   {
+   }
+   CXTranslationUnit tu;
+   const boost::function<bool()>& isCancelled;
+   std::deque<CppReference>* pReferences;
+
+   // previous range recorded for each USR (to skip duplicates)
+   std::map<std::string,FileRange> previousRanges;
+};
+
+CXChildVisitResult findAllReferencesVisitor(CXCursor cxCursor,
+                                            CXCursor,
+                                            CXClientData data)
+{
+   FindAllReferencesData* pData = (FindAllReferencesData*)data;
+   if (pData->isCancelled && pData->isCancelled())
+      return CXChildVisit_Break;
+
+   Cursor cursor(cxCursor);
+   if (!cursor.isValid())
+      return CXChildVisit_Continue;
 
-         // if we didn't find an identifier that matches use the
-         // original match (i.e. important for constructors where
-         // the 'spelling' of the invocation is the name of the
-         // variable declared)
-         if (foundRange.empty())
-            foundRange = cursor.getExtent().getFileRange();
+   if (!cursor.getSourceLocation().isFromMainFile())
+      return CXChildVisit_Continue;
+
+   Cursor referencedCursor = referencedDeclaration(cursor);
+   if (referencedCursor.isValid())
+   {
+      std::string USR = referenceUSR(referencedCursor.getUSR());
+      if (!USR.empty())
+      {
+         FileRange range;
+         bool found = referenceRange(pData->tu, cursor, referencedCursor, &range);
 
-         // record the range if it's not a duplicate of the previous range
-         if (pData->references.empty() ||
-             (pData->references.back() != foundRange))
+         FileRange& previousRange = pData->previousRanges[USR];
+         if (previousRange != range)
          {
-            pData->references.push_back(foundRange);
+            previousRange = range;
+
+            CppReference reference;
+            reference.USR = USR;
+            if (found)
+               reference.spelling = cursor.spelling();
+            reference.startLine = range.start.line;
+            reference.startColumn = range.start.column;
+            reference.endLine = range.end.line;
+            reference.endColumn = range.end.column;
+            pData->pReferences->push_back(reference);
          }
       }
    }
 
-   // recurse into namespaces, classes, etc.
    return CXChildVisit_Recurse;
 }
 
@@ -312,7 +369,24 @@ void findReferences(std::string USR,
 
 } // anonymous namespace
 
+std::string referenceUSR(const std::string& USR)
+{
+   if (boost::algorithm::ends_with(USR, "#"))
+      return USR.substr(0, USR.length() - 1);
+   else
+      return USR;
+}
 
+void findAllReferences(CXTranslationUnit tu,
+                       const boost::function<bool()>& isCancelled,
+                       std::deque<CppReference>* pReferences)
+{
+   FindAllReferencesData data(tu, isCancelled, pReferences);
+   libclang::clang().visitChildren(
+               libclang::clang().getTranslationUnitCursor(tu),
+               findAllReferencesVisitor,
+               (CXClientData)&data);
+}
 
 core::Error findReferences(const core::libclang::FileLocation& location,
                            std::string* pSpelling,
@@ -353,6 +427,12 @@ core::Error findReferences(const core::libclang::FileLocation& location,
                            pSpelling,
                            pRefs);
          }
+         // then in the references recorded by the definition index (for
+         // files which haven't changed since they were indexed)
+         else if (findIndexedReferences(filename, USR, pSpelling, pRefs))
+         {
+            continue;
+         }
          else
          {
             // get the compilation arguments for this file and use them to
@@ -16,11 +16,16 @@
 #ifndef SESSION_MODULES_CLANG_FIND_REFERENCES_HPP
 #define SESSION_MODULES_CLANG_FIND_REFERENCES_HPP
 
+#include <deque>
 #include <vector>
 
+#include <boost/function.hpp>
+
 #include <core/Error.hpp>
 
 #include <core/json/JsonRpc.hpp>
+
+#include "DefinitionIndex.hpp"
  
 namespace rstudio {
 
@@ -35,6 +40,16 @@ namespace session {
 namespace modules {      
 namespace clang {
 
+// USR used to compare references (references to function declarations
+// seem to accrue an extra # within their USRs, so it is dropped)
+std::string referenceUSR(const std::string& USR);
+
+// find all of the references within the main file of a translation unit
+// (stopping early if isCancelled returns true)
+void findAllReferences(CXTranslationUnit tu,
+                       const boost::function<bool()>& isCancelled,
+                       std::deque<CppReference>* pReferences);
+
 core::Error findReferences(const core::libclang::FileLocation& location,
                            std::string* pSpelling,
                            std::vector<core::libclang::FileRange>* pRefs);
@@ -14,7 +14,10 @@
  */
 
 #include "DataViewer.hpp"
+#include "DataViewerFormat.hpp"
+#include "DataViewerIndex.hpp"
 
+#include <cstring>
 #include <string>
 #include <vector>
 #include <sstream>
@@ -22,6 +25,7 @@
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 #include <boost/format.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
 #include <core/Log.hpp>
@@ -54,9 +58,6 @@
 #define kGridResourceLocation "/" kGridResource "/"
 #define kNoBoundEnv "_rs_no_env"
 
-// separates filter type from contents (e.g. "numeric|12-25")
-#define kFilterSeparator "|"
-
 // the largest number of factor values we're willing to display (after this
 // point the column's text is searched as though it were a character column)
 #define MAX_FACTORS 64
@@ -126,75 +127,16 @@ namespace {
  *    This allows us to efficiently perform operations on very large datasets
  *    once they've been winnowed down to smaller objects using searches and
  *    filters.
+ *
+ * INDEXED:
+ *    Most frames don't need a working copy at all: their atomic columns are
+ *    ordered and filtered in place by a DataFrameIndex, which computes the
+ *    rows to display (caching the order of each column sorted on, and the
+ *    rows matching the current filters) and from which each page is read.
+ *    The working copy is used only for frames with columns the index can't
+ *    handle.
  */    
 
-// indicates whether one filter string is a subset of another; e.g. if a column
-// is filtered for "abc" and then "abcd", the new state is a subset of the
-// previous state.
-bool isFilterSubset(const std::string& outer, const std::string& inner) 
-{
-   // shortcut for identical filters (the typical case)
-   if (inner == outer) 
-      return true;
-
-   // find filter separators; if we can't find them, presume no subset since we
-   // can't parse filters
-   size_t outerPipe = outer.find(kFilterSeparator);
-   if (outerPipe == std::string::npos) 
-      return false;
-   size_t innerPipe = inner.find(kFilterSeparator);
-   if (innerPipe == std::string::npos)
-      return false;
-
-   std::string outerType(outer.substr(0, outerPipe));
-   std::string innerType(inner.substr(0, innerPipe));
-   std::string outerValue(outer.substr(outerPipe + 1, 
-            outer.length() - outerPipe));
-   std::string innerValue(inner.substr(innerPipe + 1, 
-            inner.length() - innerPipe));
-   
-   // only identical types can be subsets
-   if (outerType != innerType) 
-      return false;
-
-   if (outerType == "numeric")
-   {
-      // matches a numeric filter (i.e. "2.71_3.14") -- in this case we need to
-      // check the components for range inclusion
-      boost::regex numFilter("(-?\\d+\\.?\\d*)_(-?\\d+\\.?\\d*)");
-      boost::smatch innerMatch, outerMatch;
-      if (regex_utils::search(innerValue, innerMatch, numFilter) &&
-          regex_utils::search(outerValue, outerMatch, numFilter))
-      {
-         // for numeric filters, the inner is a subset if its lower bound (1)
-         // is larger than the outer lower bound, and the upper bound (2) is
-         // smaller than the outer upper bound
-         return safe_convert::stringTo<double>(innerMatch[1], 0) >= 
-                safe_convert::stringTo<double>(outerMatch[1], 0) &&
-                safe_convert::stringTo<double>(innerMatch[2], 0) <= 
-                safe_convert::stringTo<double>(outerMatch[2], 0);
-      }
-
-      // if not identical and not a range, then not a subset
-      return false;
-   } 
-   else if (outerType == "factor" || outerType == "boolean")
-   {
-      // factors and boolean values have to be identical for subsetting, and we
-      // already checked above
-      return false;
-   }
-   else if (outerType == "character")
-   {
-      // characters are a subset if the outer string is within the inner one
-      // (i.e. a seach for "walnuts" (inner) is within "walnut" (outer))
-      return inner.find(outer) != std::string::npos;
-   }
-   
-   // unknown filter type
-   return false;
-}
-
 typedef enum 
 {
   DIM_ROWS,
@@ -295,6 +237,156 @@ struct CachedFrame
 // The set of active frames. Used primarily to check each for changes.
 std::map<std::string, CachedFrame> s_cachedFrames;
 
+// the R vectors an indexed column's values are read from
+struct ColumnValues : boost::noncopyable
+{
+   r::sexp::PreservedSEXP column;
+
+   // a (shallow) copy of the column's strings or levels, which keeps them
+   // alive even if the column is modified in place
+   r::sexp::PreservedSEXP strings;
+};
+
+// is the given column still the frame's column? (the frame is preserved
+// by its index)
+bool isCurrentColumn(SEXP dataSEXP, int col, SEXP columnSEXP)
+{
+   return col < Rf_length(dataSEXP) && VECTOR_ELT(dataSEXP, col) == columnSEXP;
+}
+
+// reads a column of a data frame for indexing; columns the index can't
+// handle are left unsupported
+boost::shared_ptr<DataColumn> readColumn(SEXP dataSEXP, int nrow, int col)
+{
+   boost::shared_ptr<DataColumn> pColumn = boost::make_shared<DataColumn>();
+
+   SEXP columnSEXP = VECTOR_ELT(dataSEXP, col);
+   boost::shared_ptr<ColumnValues> pValues = boost::make_shared<ColumnValues>();
+   pValues->column.set(columnSEXP);
+   pColumn->pValues = pValues;
+   pColumn->isCurrent = boost::bind(isCurrentColumn, dataSEXP, col, columnSEXP);
+   if (Rf_length(columnSEXP) != nrow ||
+       !Rf_isNull(Rf_getAttrib(columnSEXP, R_DimSymbol)))
+   {
+      return pColumn;
+   }
+
+   // classed columns (other than factors) are displayed by their format
+   // methods; we can order those whose order is that of their values
+   if (!Rf_isNull(Rf_getAttrib(columnSEXP, R_ClassSymbol)) &&
+       !Rf_isFactor(columnSEXP))
+   {
+      if (!Rf_inherits(columnSEXP, "Date") &&
+          !Rf_inherits(columnSEXP, "POSIXct") &&
+          !Rf_inherits(columnSEXP, "difftime"))
+      {
+         return pColumn;
+      }
+   }
+   else
+   {
+      pColumn->searchable = true;
+   }
+
+   // strings are read in place, so only those in the session's encoding
+   // (or UTF-8) can be indexed
+   SEXP stringsSEXP = R_NilValue;
+   switch (TYPEOF(columnSEXP))
+   {
+   case REALSXP:
+      pColumn->type = ColumnNumeric;
+      pColumn->pReal = REAL(columnSEXP);
+      break;
+   case INTSXP:
+      pColumn->type = Rf_isFactor(columnSEXP) ? ColumnFactor : ColumnInteger;
+      pColumn->pInteger = INTEGER(columnSEXP);
+      if (pColumn->type == ColumnFactor)
+         stringsSEXP = Rf_getAttrib(columnSEXP, R_LevelsSymbol);
+      break;
+   case LGLSXP:
+      pColumn->type = ColumnLogical;
+      pColumn->pInteger = LOGICAL(columnSEXP);
+      break;
+   case STRSXP:
+      pColumn->type = ColumnCharacter;
+      stringsSEXP = columnSEXP;
+      break;
+   default:
+      return pColumn;
+   }
+
+   if (TYPEOF(stringsSEXP) == STRSXP)
+   {
+      int n = Rf_length(stringsSEXP);
+      SEXP copySEXP = Rf_allocVector(STRSXP, n);
+      pValues->strings.set(copySEXP);
+      pColumn->strings.reserve(n);
+      for (int i = 0; i < n; i++)
+      {
+         SEXP stringSEXP = STRING_ELT(stringsSEXP, i);
+         SET_STRING_ELT(copySEXP, i, stringSEXP);
+         if (stringSEXP == NA_STRING)
+         {
+            pColumn->strings.push_back(NULL);
+         }
+         else if (Rf_getCharCE(stringSEXP) == CE_NATIVE ||
+                  Rf_getCharCE(stringSEXP) == CE_UTF8)
+         {
+            pColumn->strings.push_back(CHAR(stringSEXP));
+         }
+         else
+         {
+            pColumn->type = ColumnUnsupported;
+            pColumn->searchable = false;
+            pColumn->strings.clear();
+            break;
+         }
+      }
+   }
+
+   return pColumn;
+}
+
+// An index over a frame being viewed; the frame is preserved for as long as
+// the index refers to it (and the columns it has read, for as long as it
+// refers to them).
+struct IndexedFrame : boost::noncopyable
+{
+   IndexedFrame(SEXP dataSEXP, int nrow, int ncol)
+      : data(dataSEXP),
+        index(nrow, ncol, boost::bind(readColumn, dataSEXP, nrow, _1))
+   {
+   }
+
+   r::sexp::PreservedSEXP data;
+   DataFrameIndex index;
+};
+
+// The indexes over the frames being viewed, by cache key.
+std::map<std::string, boost::shared_ptr<IndexedFrame> > s_indexedFrames;
+
+// returns the index for the given frame, or NULL if it can't be indexed
+DataFrameIndex* frameIndex(const std::string& cacheKey, SEXP dataSEXP,
+                           int nrow, int ncol)
+{
+   if (cacheKey.empty() || TYPEOF(dataSEXP) != VECSXP ||
+       Rf_length(dataSEXP) != ncol)
+   {
+      return NULL;
+   }
+
+   // the index is kept as long as we're viewing the same object (which may
+   // be replaced in the cache, or recreated if it had to be converted to a
+   // data frame)
+   boost::shared_ptr<IndexedFrame>& pFrame = s_indexedFrames[cacheKey];
+   if (!pFrame || pFrame->data.get() != dataSEXP ||
+       pFrame->index.nrow() != nrow)
+   {
+      pFrame.reset(new IndexedFrame(dataSEXP, nrow, ncol));
+   }
+   return &pFrame->index;
+}
+
 std::string viewerCacheDir() 
 {
    return module_context::sessionScratchPath().childPath(kViewerCacheDir)
@@ -434,6 +526,208 @@ void handleGridResReq(const http::Request& request,
    pResponse->setCacheableFile(gridResource, request);
 }
 
+// the cells of a column on the page of data being returned
+enum PageColumnType
+{
+   PageColumnFormatted,
+   PageColumnNumeric,
+   PageColumnLogical,
+   PageColumnCharacter,
+   PageColumnFactor
+};
+
+struct PageColumn
+{
+   PageColumn()
+      : type(PageColumnFormatted), valuesSEXP(R_NilValue),
+        levelsSEXP(R_NilValue)
+   {
+   }
+
+   PageColumnType type;
+
+   // the column's values (or, if formatted by R, the cells of the page)
+   SEXP valuesSEXP;
+
+   // factor levels
+   SEXP levelsSEXP;
+
+   // the format of the numbers on the page
+   NumberFormat format;
+};
+
+// whether a vector has values for each of the given rows
+bool hasRows(SEXP valuesSEXP, const std::vector<int>& rows)
+{
+   int length = Rf_length(valuesSEXP);
+   BOOST_FOREACH(int row, rows)
+   {
+      if (row >= length)
+         return false;
+   }
+   return true;
+}
+
+// prepares a column to have the given rows written as .rs.formatDataColumn
+// would format them; returns false for columns which need R to format them
+bool readPageColumn(SEXP columnSEXP,
+                    const std::vector<int>& rows,
+                    int digits,
+                    int scipen,
+                    PageColumn* pColumn)
+{
+   bool factor = Rf_isFactor(columnSEXP);
+   if ((!factor && !Rf_isNull(Rf_getAttrib(columnSEXP, R_ClassSymbol))) ||
+       !Rf_isNull(Rf_getAttrib(columnSEXP, R_DimSymbol)) ||
+       !hasRows(columnSEXP, rows))
+   {
+      return false;
+   }
+
+   if (factor)
+   {
+      pColumn->levelsSEXP = Rf_getAttrib(columnSEXP, R_LevelsSymbol);
+      if (TYPEOF(pColumn->levelsSEXP) != STRSXP)
+         return false;
+      pColumn->type = PageColumnFactor;
+   }
+   else if (TYPEOF(columnSEXP) == REALSXP || TYPEOF(columnSEXP) == INTSXP)
+   {
+      // numbers are formatted alike (as R's format() would) across the page
+      std::vector<double> values;
+      values.reserve(rows.size());
+      BOOST_FOREACH(int row, rows)
+      {
+         if (TYPEOF(columnSEXP) == REALSXP)
+            values.push_back(REAL(columnSEXP)[row]);
+         else if (INTEGER(columnSEXP)[row] != NA_INTEGER)
+            values.push_back(INTEGER(columnSEXP)[row]);
+      }
+      pColumn->format = numberFormat(values, digits, scipen);
+      pColumn->type = PageColumnNumeric;
+   }
+   else if (TYPEOF(columnSEXP) == LGLSXP)
+   {
+      pColumn->type = PageColumnLogical;
+   }
+   else if (TYPEOF(columnSEXP) == STRSXP)
+   {
+      pColumn->type = PageColumnCharacter;
+   }
+   else
+   {
+      return false;
+   }
+
+   pColumn->valuesSEXP = columnSEXP;
+   return true;
+}
+
+// creates an R vector of the given rows (R uses 1-based indexing)
+SEXP pageRowsSEXP(const std::vector<int>& rows, r::sexp::Protect* pProtect)
+{
+   SEXP rowsSEXP = Rf_allocVector(INTSXP, rows.size());
+   pProtect->add(rowsSEXP);
+   for (std::size_t i = 0; i < rows.size(); i++)
+      INTEGER(rowsSEXP)[i] = rows[i] + 1;
+   return rowsSEXP;
+}
+
+// returns a data frame's row names attribute without expanding compact
+// (automatic) row names as getAttrib would
+SEXP rowNames(SEXP dataSEXP)
+{
+   for (SEXP attribSEXP = ATTRIB(dataSEXP);
+        attribSEXP != R_NilValue;
+        attribSEXP = CDR(attribSEXP))
+   {
+      if (TAG(attribSEXP) == R_RowNamesSymbol)
+         return CAR(attribSEXP);
+   }
+   return R_NilValue;
+}
+
+void writeString(json::StreamWriter& writer, SEXP stringSEXP)
+{
+   if (stringSEXP == NA_STRING)
+   {
+      writer.intValue(SPECIAL_CELL_NA);
+      return;
+   }
+
+   const char* value = Rf_translateCharUTF8(stringSEXP);
+   writer.stringValue(value, std::strlen(value));
+}
+
+// writes the cell of a column at the given (0-based) index in the page,
+// which is the given row of the data
+void writeCell(json::StreamWriter& writer,
+               const PageColumn& column,
+               int index,
+               int row,
+               std::string* pBuffer)
+{
+   switch (column.type)
+   {
+   case PageColumnFormatted:
+      if (TYPEOF(column.valuesSEXP) == STRSXP &&
+          index < Rf_length(column.valuesSEXP))
+         writeString(writer, STRING_ELT(column.valuesSEXP, index));
+      else
+         writer.stringValue("", 0);
+      break;
+
+   case PageColumnNumeric:
+   {
+      double value;
+      if (TYPEOF(column.valuesSEXP) == REALSXP)
+         value = REAL(column.valuesSEXP)[row];
+      else if (INTEGER(column.valuesSEXP)[row] != NA_INTEGER)
+         value = INTEGER(column.valuesSEXP)[row];
+      else
+         value = NA_REAL;
+
+      if (R_IsNA(value))
+      {
+         writer.intValue(SPECIAL_CELL_NA);
+      }
+      else
+      {
+         formatNumber(value, column.format, pBuffer);
+         writer.stringValue(pBuffer->c_str(), pBuffer->size());
+      }
+      break;
+   }
+
+   case PageColumnLogical:
+   {
+      int value = LOGICAL(column.valuesSEXP)[row];
+      if (value == NA_LOGICAL)
+         writer.intValue(SPECIAL_CELL_NA);
+      else if (value)
+         writer.stringValue("TRUE", 4);
+      else
+         writer.stringValue("FALSE", 5);
+      break;
+   }
+
+   case PageColumnCharacter:
+      writeString(writer, STRING_ELT(column.valuesSEXP, row));
+      break;
+
+   case PageColumnFactor:
+   {
+      int code = INTEGER(column.valuesSEXP)[row];
+      if (code == NA_INTEGER || code < 1 ||
+          code > Rf_length(column.levelsSEXP))
+         writer.intValue(SPECIAL_CELL_NA);
+      else
+         writeString(writer, STRING_ELT(column.levelsSEXP, code - 1));
+      break;
+   }
+   }
+}
+
 json::Value getCols(SEXP dataSEXP)
 {
    SEXP colsSEXP = R_NilValue;
@@ -467,7 +761,7 @@ json::Value getCols(SEXP dataSEXP)
 // NB: may throw exceptions! these are expected to be handled by the handlers
 // in getGridData, where they will be marshaled to JSON and displayed on the
 // client.
-json::Value getData(SEXP dataSEXP, const http::Fields& fields)
+void getData(SEXP dataSEXP, const http::Fields& fields, std::string* pOutput)
 {
    Error error;
    r::sexp::Protect protect;
@@ -508,6 +802,20 @@ json::Value getData(SEXP dataSEXP, const http::Fields& fields)
    bool needsTransform = ordercol > 0 || hasFilter || !search.empty();
    bool hasTransform = false;
 
+   // order and filter the rows through the frame's index if we can, rather
+   // than transforming the frame in R
+   const std::vector<int>* pRows = NULL;
+   if (needsTransform)
+   {
+      DataFrameIndex* pIndex = frameIndex(cacheKey, dataSEXP, nrow, ncol);
+      if (pIndex != NULL &&
+          pIndex->select(filters, search, ordercol - 1, orderdir == "desc"))
+      {
+         pRows = &pIndex->rows();
+         needsTransform = false;
+      }
+   }
+
    // check to see if we have an ordered/filtered view we can build from
    std::map<std::string, CachedFrame>::iterator cachedFrame = 
       s_cachedFrames.find(cacheKey);
@@ -579,20 +887,30 @@ json::Value getData(SEXP dataSEXP, const http::Fields& fields)
    }
 
    // apply new row count if we've tansformed the data (or need to)
-   filteredNRow = needsTransform || hasTransform ?
-      safeDim(dataSEXP, DIM_ROWS) : 
-      nrow;
+   if (pRows != NULL)
+      filteredNRow = static_cast<int>(pRows->size());
+   else
+      filteredNRow = needsTransform || hasTransform ?
+         safeDim(dataSEXP, DIM_ROWS) : 
+         nrow;
 
    // return the lesser of the rows available and rows requested
-   length = std::min(length, filteredNRow - start);
+   length = std::max(0, std::min(length, filteredNRow - start));
 
-   // DataTables uses 0-based indexing, but R uses 1-based indexing
-   start ++;
+   // the (0-based) rows of the data to return
+   std::vector<int> pageRows(length);
+   for (int row = 0; row < length; row++)
+      pageRows[row] = pRows != NULL ? (*pRows)[start + row] : start + row;
+
+   // the same rows for R, which uses 1-based indexing (created if needed)
+   SEXP rowsSEXP = R_NilValue;
 
-   // extract the portion of the column vector requested by the client
-   SEXP formattedDataSEXP = Rf_allocVector(VECSXP, ncol);
-   protect.add(formattedDataSEXP);
-   for (unsigned i = 0; i < static_cast<unsigned>(ncol); i++)
+   // read each column's cells; columns we can't format here (e.g. dates,
+   // which have their own format methods) are formatted by R
+   int digits = r::options::getOption<int>("digits", 7, false);
+   int scipen = r::options::getOption<int>("scipen", 0, false);
+   std::vector<PageColumn> columns(ncol);
+   for (int i = 0; i < ncol; i++)
    {
       SEXP columnSEXP = VECTOR_ELT(dataSEXP, i);
       if (columnSEXP == NULL || TYPEOF(columnSEXP) == NILSXP || 
@@ -601,91 +919,103 @@ json::Value getData(SEXP dataSEXP, const http::Fields& fields)
          throw r::exec::RErrorException("No data in column " + 
                boost::lexical_cast<std::string>(i));
       }
+
+      if (readPageColumn(columnSEXP, pageRows, digits, scipen, &columns[i]))
+         continue;
+
+      if (rowsSEXP == R_NilValue)
+         rowsSEXP = pageRowsSEXP(pageRows, &protect);
       SEXP formattedColumnSEXP;
-      r::exec::RFunction formatFx(".rs.formatDataColumn");
-      formatFx.addParam(columnSEXP);
-      formatFx.addParam(static_cast<int>(start));
-      formatFx.addParam(static_cast<int>(length));
-      error = formatFx.call(&formattedColumnSEXP, &protect);
+      error = r::exec::RFunction(".rs.formatDataColumnAt", columnSEXP,
+            rowsSEXP).call(&formattedColumnSEXP, &protect);
       if (error)
          throw r::exec::RErrorException(error.summary());
-      SET_VECTOR_ELT(formattedDataSEXP, i, formattedColumnSEXP);
-    }
+      columns[i].valuesSEXP = formattedColumnSEXP;
+   }
 
-   // format the row names 
-   SEXP rownamesSEXP;
-   r::exec::RFunction(".rs.formatRowNames", dataSEXP, start, length)
-      .call(&rownamesSEXP, &protect);
-   
-   // create the result grid as JSON
-   json::Array data;
+   // read the row names; as with columns, R formats any we can't read here
+   bool automaticRowNames = false;
+   bool pageRowNames = false;
+   SEXP rownamesSEXP = rowNames(dataSEXP);
+   if (TYPEOF(rownamesSEXP) == INTSXP && Rf_length(rownamesSEXP) > 0 &&
+       INTEGER(rownamesSEXP)[0] == NA_INTEGER)
+   {
+      automaticRowNames = true;
+   }
+   else if ((TYPEOF(rownamesSEXP) != INTSXP &&
+             TYPEOF(rownamesSEXP) != STRSXP) ||
+            !hasRows(rownamesSEXP, pageRows))
+   {
+      if (rowsSEXP == R_NilValue)
+         rowsSEXP = pageRowsSEXP(pageRows, &protect);
+      r::exec::RFunction(".rs.formatRowNamesAt", dataSEXP, rowsSEXP)
+         .call(&rownamesSEXP, &protect);
+      pageRowNames = true;
+   }
+
+   // write the result grid as JSON
+   std::string output;
+   json::StreamWriter writer(&output);
+   writer.startObject();
+   writer.key("draw");
+   writer.intValue(draw);
+   writer.key("recordsTotal");
+   writer.intValue(nrow);
+   writer.key("recordsFiltered");
+   writer.intValue(filteredNRow);
+   writer.key("data");
+   writer.startArray();
+
+   std::string buffer;
    for (int row = 0; row < length; row++)
    {
-      json::Array rowData;
-      if (rownamesSEXP != NULL &&
-          TYPEOF(rownamesSEXP) != NILSXP &&
-          !Rf_isNull(rownamesSEXP) )
+      writer.startArray();
+
+      // row names, or the row number where there's no name
+      int rowNumber = pageRows[row] + 1;
+      if (automaticRowNames)
       {
-         SEXP nameSEXP = STRING_ELT(rownamesSEXP, row);
-         if (nameSEXP != NULL &&
-             nameSEXP != NA_STRING &&
-             r::sexp::length(nameSEXP) > 0)
-         {
-            rowData.push_back(Rf_translateCharUTF8(nameSEXP));
-         }
-         else
-         {
-            rowData.push_back(row + start);
-         }
+         buffer = safe_convert::numberToString(rowNumber);
+         writer.stringValue(buffer.c_str(), buffer.size());
       }
-      else
+      else if (TYPEOF(rownamesSEXP) == INTSXP)
       {
-         rowData.push_back(row + start);
+         buffer = safe_convert::numberToString(
+                  INTEGER(rownamesSEXP)[pageRowNames ? row : pageRows[row]]);
+         writer.stringValue(buffer.c_str(), buffer.size());
       }
-
-      for (int col = 0; col<Rf_length(formattedDataSEXP); col++)
+      else if (TYPEOF(rownamesSEXP) == STRSXP)
       {
-         SEXP columnSEXP = VECTOR_ELT(formattedDataSEXP, col);
-         if (columnSEXP != NULL && 
-             TYPEOF(columnSEXP) != NILSXP &&
-             !Rf_isNull(columnSEXP))
-         {
-            SEXP stringSEXP = STRING_ELT(columnSEXP, row);
-            if (stringSEXP != NULL &&
-                stringSEXP != NA_STRING &&
-                r::sexp::length(stringSEXP) > 0)
-            {
-               rowData.push_back(Rf_translateCharUTF8(stringSEXP));
-            }
-            else if (stringSEXP == NA_STRING) 
-            {
-               rowData.push_back(SPECIAL_CELL_NA);
-            }
-            else
-            {
-               rowData.push_back("");
-            }
-         }
+         SEXP nameSEXP = STRING_ELT(rownamesSEXP,
+                                    pageRowNames ? row : pageRows[row]);
+         if (nameSEXP != NA_STRING && r::sexp::length(nameSEXP) > 0)
+            writeString(writer, nameSEXP);
          else
-         {
-            rowData.push_back("");
-         }
+            writer.intValue(rowNumber);
+      }
+      else
+      {
+         writer.intValue(rowNumber);
       }
-      data.push_back(rowData);
+
+      for (int col = 0; col < ncol; col++)
+         writeCell(writer, columns[col], row, pageRows[row], &buffer);
+
+      writer.endArray();
    }
 
-   json::Object result;
-   result["draw"] = draw;
-   result["recordsTotal"] = nrow;
-   result["recordsFiltered"] = filteredNRow;
-   result["data"] = data;
-   return result;
+   writer.endArray();
+   writer.endObject();
+   writer.flush();
+
+   pOutput->swap(output);
 }
 
 Error getGridData(const http::Request& request,
                   http::Response* pResponse)
 {
    json::Value result;
+   boost::shared_ptr<std::string> pOutput = boost::make_shared<std::string>();
    http::status::Code status = http::status::Ok;
 
    try
@@ -752,7 +1082,7 @@ Error getGridData(const http::Request& request,
          }
          else if (show == "data")
          {
-            result = getData(dataSEXP, fields);
+            getData(dataSEXP, fields, pOutput.get());
          }
       }
 
@@ -768,8 +1098,9 @@ Error getGridData(const http::Request& request,
    }
    CATCH_UNEXPECTED_EXCEPTION
 
-   std::ostringstream ostr;
-   json::write(result, ostr);
+   // data is written directly to the output; anything else is in result
+   if (pOutput->empty())
+      json::write(result).swap(*pOutput);
 
    // There are some unprintable ASCII control characters that are written
    // verbatim by json::write, but that won't parse in most Javascript JSON
@@ -779,7 +1110,7 @@ Error getGridData(const http::Request& request,
    // unprintable and (b) some characters are invalid *even if escaped* e.g.
    // \v, there's little to be gained here in trying to marshal them to the
    // viewer.
-   std::string output = ostr.str();
+   std::string& output = *pOutput;
    for (size_t i = 0; i < output.size(); i++) 
    {
       char c = output[i];
@@ -792,7 +1123,7 @@ Error getGridData(const http::Request& request,
  
    pResponse->setNoCacheHeaders();    // don't cache data/grid shape
    pResponse->setStatusCode(status);
-   pResponse->setBody(output);
+   pResponse->setSharedBody(pOutput);
 
    return Success();
 }
@@ -804,6 +1135,7 @@ Error removeCacheKey(const std::string& cacheKey)
       s_cachedFrames.find(cacheKey);
    if (pos != s_cachedFrames.end())
       s_cachedFrames.erase(pos);
+   s_indexedFrames.erase(cacheKey);
    
    // remove cache env object and backing file
    return r::exec::RFunction(".rs.removeCachedData", cacheKey, 
@@ -863,8 +1195,9 @@ void onDetectChanges(module_context::ChangeSource source)
          // create a new frame object to capture the new state of the frame
          CachedFrame newFrame(i->second.envName, i->second.objName, sexp);
 
-         // clear working data for the object
+         // clear working data and the index for the object
          r::exec::RFunction(".rs.removeWorkingData", i->first).call();
+         s_indexedFrames.erase(i->first);
 
          // replace cached copy (if we have something to replace it with)
          if (sexp != NULL)
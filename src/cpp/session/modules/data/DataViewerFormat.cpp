@@ -0,0 +1,158 @@
+/*
+ * DataViewerFormat.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "DataViewerFormat.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <boost/foreach.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+namespace {
+
+// R computes the digits needed for numbers in [1e-22, 1e22] exactly
+const int kMaxPower = 22;
+
+// the significant digits and power of ten of a number shown to the given
+// digits (as computed by R's scientific())
+void scientific(double value,
+                int digits,
+                int* pPower,
+                int* pSignificant,
+                bool* pRoundingWidens)
+{
+   char buffer[64];
+   std::snprintf(buffer, sizeof(buffer), "%.*e", digits - 1, std::fabs(value));
+
+   // the mantissa is d.ddddd (or d if there's only one digit)
+   const char* exponent = std::strchr(buffer, 'e');
+   *pPower = std::atoi(exponent + 1);
+
+   int significant = digits;
+   for (const char* pos = exponent - 1; significant > 1 && *pos == '0'; pos--)
+      significant--;
+   *pSignificant = significant;
+
+   // rounding may have carried into a new power of ten (e.g. 99999.9 shown
+   // to 5 digits is 1e+05) though the number itself has fewer digits
+   *pRoundingWidens = *pPower > 0 && *pPower <= kMaxPower &&
+                      std::fabs(value) < std::pow(10.0, *pPower);
+}
+
+} // anonymous namespace
+
+// see formatReal in R's format.c
+NumberFormat numberFormat(const std::vector<double>& values,
+                          int digits,
+                          int scipen)
+{
+   digits = std::max(1, std::min(digits, kMaxPower));
+
+   bool negative = false;
+   int maxLeft = INT_MIN;
+   int maxSignedLeft = INT_MIN;
+   int maxRight = INT_MIN;
+   int maxSignificant = INT_MIN;
+   int maxPower = INT_MIN;
+   int minPower = INT_MAX;
+
+   BOOST_FOREACH(double value, values)
+   {
+      if (!std::isfinite(value))
+         continue;
+
+      int power, significant;
+      bool roundingWidens;
+      scientific(value, digits, &power, &significant, &roundingWidens);
+
+      int left = power + 1;
+      if (roundingWidens)
+         left--;
+
+      bool isNegative = value < 0;
+      negative = negative || isNegative;
+      maxLeft = std::max(maxLeft, left);
+      maxSignedLeft = std::max(maxSignedLeft, isNegative + (left <= 0 ? 1 : left));
+      maxRight = std::max(maxRight, significant - left);
+      maxSignificant = std::max(maxSignificant, significant);
+      maxPower = std::max(maxPower, power);
+      minPower = std::min(minPower, power);
+   }
+
+   NumberFormat format;
+   if (maxSignificant == INT_MIN)
+      return format;
+
+   if (maxLeft < 0)
+      maxSignedLeft = 1 + negative;
+   if (maxRight < 0)
+      maxRight = 0;
+   int fixedWidth = maxSignedLeft + maxRight + (maxRight != 0);
+
+   int exponentDigits = (maxPower >= 100 || minPower <= -99) ? 2 : 1;
+   int mantissaDecimals = maxSignificant - 1;
+   int scientificWidth = negative + (mantissaDecimals > 0) + mantissaDecimals +
+                         4 + exponentDigits;
+
+   if (fixedWidth <= scientificWidth + scipen)
+   {
+      format.decimals = maxRight;
+   }
+   else
+   {
+      format.scientific = true;
+      format.decimals = mantissaDecimals;
+   }
+   return format;
+}
+
+void formatNumber(double value, const NumberFormat& format, std::string* pOutput)
+{
+   if (std::isnan(value))
+   {
+      pOutput->assign("NaN");
+      return;
+   }
+   else if (std::isinf(value))
+   {
+      pOutput->assign(value > 0 ? "Inf" : "-Inf");
+      return;
+   }
+
+   // R doesn't show negative zero
+   if (value == 0)
+      value = 0;
+
+   char buffer[512];
+   std::snprintf(buffer, sizeof(buffer), format.scientific ? "%.*e" : "%.*f",
+                 format.decimals, value);
+   pOutput->assign(buffer);
+}
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
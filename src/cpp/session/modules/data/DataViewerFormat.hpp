@@ -0,0 +1,57 @@
+/*
+ * DataViewerFormat.hpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_DATA_VIEWER_FORMAT_HPP
+#define SESSION_DATA_VIEWER_FORMAT_HPP
+
+#include <string>
+#include <vector>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+// The notation in which R's format() displays a vector of numbers: the
+// fixed or scientific notation which (given the "digits" and "scipen"
+// options) shows each number to the same number of decimal places.
+struct NumberFormat
+{
+   NumberFormat() : scientific(false), decimals(0) {}
+
+   bool scientific;
+
+   // the digits following the decimal point (of the mantissa, if scientific)
+   int decimals;
+};
+
+// determine the format of the given numbers (non-finite numbers don't
+// affect the format)
+NumberFormat numberFormat(const std::vector<double>& values,
+                          int digits,
+                          int scipen);
+
+// format a (non-missing) number; NaN and infinite numbers are formatted as
+// "NaN", "Inf" and "-Inf"
+void formatNumber(double value, const NumberFormat& format, std::string* pOutput);
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_DATA_VIEWER_FORMAT_HPP
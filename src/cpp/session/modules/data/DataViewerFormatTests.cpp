@@ -0,0 +1,121 @@
+/*
+ * DataViewerFormatTests.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <limits>
+
+#include <boost/foreach.hpp>
+
+#include "DataViewerFormat.hpp"
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+namespace {
+
+// format numbers as format(values, trim = TRUE) would in R
+std::vector<std::string> format(const std::vector<double>& values,
+                                int digits = 7,
+                                int scipen = 0)
+{
+   NumberFormat numbers = numberFormat(values, digits, scipen);
+   std::vector<std::string> formatted;
+   BOOST_FOREACH(double value, values)
+   {
+      std::string text;
+      formatNumber(value, numbers, &text);
+      formatted.push_back(text);
+   }
+   return formatted;
+}
+
+std::vector<double> values(double v1,
+                           double v2 = std::numeric_limits<double>::quiet_NaN(),
+                           double v3 = std::numeric_limits<double>::quiet_NaN())
+{
+   std::vector<double> result;
+   result.push_back(v1);
+   if (v2 == v2)
+      result.push_back(v2);
+   if (v3 == v3)
+      result.push_back(v3);
+   return result;
+}
+
+std::vector<std::string> strings(const char* s1,
+                                 const char* s2 = NULL,
+                                 const char* s3 = NULL)
+{
+   std::vector<std::string> result;
+   result.push_back(s1);
+   if (s2)
+      result.push_back(s2);
+   if (s3)
+      result.push_back(s3);
+   return result;
+}
+
+} // anonymous namespace
+
+context("Data viewer number formatting")
+{
+   test_that("Numbers share their decimal places")
+   {
+      expect_true(format(values(1, 2.5)) == strings("1.0", "2.5"));
+      expect_true(format(values(1, 10, 100)) == strings("1", "10", "100"));
+      expect_true(format(values(-1.5, 0.25)) == strings("-1.50", "0.25"));
+      expect_true(format(values(3.14159265)) == strings("3.141593"));
+      expect_true(format(values(1234567.1)) == strings("1234567"));
+      expect_true(format(values(-0.0)) == strings("0"));
+   }
+
+   test_that("Scientific notation is used when it's narrower")
+   {
+      expect_true(format(values(100000)) == strings("1e+05"));
+      expect_true(format(values(123456)) == strings("123456"));
+      expect_true(format(values(0.0001)) == strings("1e-04"));
+      expect_true(format(values(0.0001, 1)) == strings("1e-04", "1e+00"));
+      expect_true(format(values(1.5e-300)) == strings("1.5e-300"));
+   }
+
+   test_that("The digits and scipen options are respected")
+   {
+      expect_true(format(values(100000), 7, 1) == strings("100000"));
+      expect_true(format(values(3.14159265), 3) == strings("3.14"));
+      expect_true(format(values(123.456), 3) == strings("123"));
+   }
+
+   test_that("Non-finite numbers don't affect the format")
+   {
+      double inf = std::numeric_limits<double>::infinity();
+      double nan = std::numeric_limits<double>::quiet_NaN();
+
+      std::vector<double> numbers = values(1.5, inf, -inf);
+      numbers.push_back(nan);
+      std::vector<std::string> expected = strings("1.5", "Inf", "-Inf");
+      expected.push_back("NaN");
+      expect_true(format(numbers) == expected);
+   }
+}
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
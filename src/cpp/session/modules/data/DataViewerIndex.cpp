@@ -0,0 +1,827 @@
+/*
+ * DataViewerIndex.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "DataViewerIndex.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include <boost/cstdint.hpp>
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/regex.hpp>
+
+#include <core/RegexUtils.hpp>
+#include <core/SafeConvert.hpp>
+
+// separates filter type from contents (e.g. "numeric|12-25")
+#define kFilterSeparator "|"
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+namespace {
+
+// the number of column orders kept for each frame
+const std::size_t kMaxCachedOrders = 4;
+
+// R's representation of a missing integer (or logical) value
+const int kNaInteger = std::numeric_limits<int>::min();
+
+// R's NA_REAL is a NaN distinguished by the value of its low word
+bool isNaReal(double value)
+{
+   if (!std::isnan(value))
+      return false;
+
+   boost::uint64_t bits;
+   std::memcpy(&bits, &value, sizeof(bits));
+   return (bits & 0xFFFFFFFF) == 1954;
+}
+
+char lowerAscii(char ch)
+{
+   return (ch >= 'A' && ch <= 'Z') ? ch + ('a' - 'A') : ch;
+}
+
+std::string toLowerAscii(const std::string& str)
+{
+   std::string lower(str);
+   std::transform(lower.begin(), lower.end(), lower.begin(), lowerAscii);
+   return lower;
+}
+
+bool containsIgnoreCase(const char* text, const std::string& lowerNeedle)
+{
+   for (const char* pos = text; ; pos++)
+   {
+      std::size_t i = 0;
+      while (i < lowerNeedle.size() && pos[i] != '\0' &&
+             lowerAscii(pos[i]) == lowerNeedle[i])
+         i++;
+
+      if (i == lowerNeedle.size())
+         return true;
+      if (pos[i] == '\0')
+         return false;
+   }
+}
+
+// formats a (finite) number as R's as.character does: with up to 15
+// significant digits, in fixed notation unless scientific notation is shorter
+std::string formatReal(double value)
+{
+   char buffer[32];
+   std::snprintf(buffer, sizeof(buffer), "%.14e", value);
+
+   std::string formatted(buffer);
+   std::string sign;
+   if (formatted[0] == '-')
+   {
+      sign = "-";
+      formatted.erase(0, 1);
+   }
+
+   // split d.dddddddddddddde+XX into its digits and exponent
+   std::size_t exponentPos = formatted.find('e');
+   std::string digits = formatted.substr(0, 1) + formatted.substr(2, exponentPos - 2);
+   int exponent = safe_convert::stringTo<int>(formatted.substr(exponentPos + 1), 0);
+   std::size_t lastDigit = digits.find_last_not_of('0');
+   digits.erase(lastDigit == std::string::npos ? 1 : lastDigit + 1);
+   int significant = static_cast<int>(digits.size());
+
+   std::string scientific = digits.substr(0, 1);
+   if (significant > 1)
+      scientific += "." + digits.substr(1);
+   std::snprintf(buffer, sizeof(buffer), "e%c%02d",
+                 exponent < 0 ? '-' : '+', std::abs(exponent));
+   scientific += buffer;
+
+   std::string fixed;
+   if (exponent >= 0)
+   {
+      if (significant > exponent + 1)
+         fixed = digits.substr(0, exponent + 1) + "." + digits.substr(exponent + 1);
+      else
+         fixed = digits + std::string(exponent + 1 - significant, '0');
+   }
+   else
+   {
+      fixed = "0." + std::string(-exponent - 1, '0') + digits;
+   }
+
+   return sign + (fixed.size() <= scientific.size() ? fixed : scientific);
+}
+
+bool isNA(const DataColumn& column, int row)
+{
+   switch (column.type)
+   {
+   case ColumnNumeric:
+      return std::isnan(column.pReal[row]);
+   case ColumnInteger:
+   case ColumnLogical:
+   case ColumnFactor:
+      return column.pInteger[row] == kNaInteger;
+   case ColumnCharacter:
+      return column.strings[row] == NULL;
+   default:
+      return true;
+   }
+}
+
+// the value of a (non-missing) cell as R's as.numeric would give it
+bool numericValue(const DataColumn& column, int row, double* pValue)
+{
+   switch (column.type)
+   {
+   case ColumnNumeric:
+      *pValue = column.pReal[row];
+      return !std::isnan(*pValue);
+   case ColumnInteger:
+   case ColumnLogical:
+   case ColumnFactor:
+      *pValue = column.pInteger[row];
+      return column.pInteger[row] != kNaInteger;
+   default:
+      return false;
+   }
+}
+
+// the text of a (non-missing) cell as R's as.character would give it
+const char* cellText(const DataColumn& column, int row, std::string* pBuffer)
+{
+   switch (column.type)
+   {
+   case ColumnCharacter:
+      return column.strings[row];
+
+   case ColumnFactor:
+   {
+      int code = column.pInteger[row];
+      if (code < 1 || code > static_cast<int>(column.strings.size()))
+         return NULL;
+      return column.strings[code - 1];
+   }
+
+   case ColumnLogical:
+   {
+      int value = column.pInteger[row];
+      if (value == kNaInteger)
+         return NULL;
+      return value ? "TRUE" : "FALSE";
+   }
+
+   case ColumnInteger:
+   {
+      int value = column.pInteger[row];
+      if (value == kNaInteger)
+         return NULL;
+      *pBuffer = safe_convert::numberToString(value);
+      return pBuffer->c_str();
+   }
+
+   case ColumnNumeric:
+   {
+      double value = column.pReal[row];
+      if (isNaReal(value))
+         return NULL;
+      else if (std::isnan(value))
+         *pBuffer = "NaN";
+      else if (std::isinf(value))
+         *pBuffer = value > 0 ? "Inf" : "-Inf";
+      else
+         *pBuffer = formatReal(value);
+      return pBuffer->c_str();
+   }
+
+   default:
+      return NULL;
+   }
+}
+
+// orderings of rows by the values of a column; as with R's order(), missing
+// values are ordered last
+
+struct RealLess
+{
+   explicit RealLess(const double* pValues) : pValues(pValues) {}
+
+   bool operator()(int a, int b) const
+   {
+      double x = pValues[a];
+      double y = pValues[b];
+      if (std::isnan(y))
+         return !std::isnan(x);
+      return x < y;
+   }
+
+   const double* pValues;
+};
+
+struct IntegerLess
+{
+   explicit IntegerLess(const int* pValues) : pValues(pValues) {}
+
+   bool operator()(int a, int b) const
+   {
+      int x = pValues[a];
+      int y = pValues[b];
+      if (y == kNaInteger)
+         return x != kNaInteger;
+      return x != kNaInteger && x < y;
+   }
+
+   const int* pValues;
+};
+
+struct StringLess
+{
+   explicit StringLess(const std::vector<const char*>& values)
+      : pValues(&values)
+   {
+   }
+
+   bool operator()(int a, int b) const
+   {
+      const char* x = (*pValues)[a];
+      const char* y = (*pValues)[b];
+      if (x == y)
+         return false;
+      if (y == NULL)
+         return true;
+      return x != NULL && std::strcoll(x, y) < 0;
+   }
+
+   const std::vector<const char*>* pValues;
+};
+
+template <typename Less>
+bool rowsEqual(const Less& less, int a, int b)
+{
+   return !less(a, b) && !less(b, a);
+}
+
+bool rowsEqual(const DataColumn& column, int a, int b)
+{
+   switch (column.type)
+   {
+   case ColumnNumeric:
+      return rowsEqual(RealLess(column.pReal), a, b);
+   case ColumnCharacter:
+      return rowsEqual(StringLess(column.strings), a, b);
+   default:
+      return rowsEqual(IntegerLess(column.pInteger), a, b);
+   }
+}
+
+// stable sort of rows into ascending order
+void sortRows(const DataColumn& column, std::vector<int>* pRows)
+{
+   switch (column.type)
+   {
+   case ColumnNumeric:
+      std::stable_sort(pRows->begin(), pRows->end(), RealLess(column.pReal));
+      break;
+   case ColumnCharacter:
+      std::stable_sort(pRows->begin(), pRows->end(),
+                       StringLess(column.strings));
+      break;
+   default:
+      std::stable_sort(pRows->begin(), pRows->end(),
+                       IntegerLess(column.pInteger));
+      break;
+   }
+}
+
+// given rows in ascending order, produce them in descending order; as with
+// R's order(decreasing = TRUE), ties keep their order and missing values
+// remain last
+void reverseRows(const DataColumn& column,
+                 const std::vector<int>& ascending,
+                 std::vector<int>* pDescending)
+{
+   pDescending->clear();
+   pDescending->reserve(ascending.size());
+
+   std::size_t naStart = ascending.size();
+   while (naStart > 0 && isNA(column, ascending[naStart - 1]))
+      naStart--;
+
+   std::size_t groupEnd = naStart;
+   while (groupEnd > 0)
+   {
+      std::size_t groupStart = groupEnd - 1;
+      while (groupStart > 0 &&
+             rowsEqual(column, ascending[groupStart - 1], ascending[groupEnd - 1]))
+         groupStart--;
+
+      pDescending->insert(pDescending->end(),
+                          ascending.begin() + groupStart,
+                          ascending.begin() + groupEnd);
+      groupEnd = groupStart;
+   }
+
+   pDescending->insert(pDescending->end(),
+                       ascending.begin() + naStart,
+                       ascending.end());
+}
+
+enum FilterType
+{
+   FilterFactor,
+   FilterCharacter,
+   FilterNumeric,
+   FilterBoolean
+};
+
+struct RowFilter
+{
+   RowFilter() : col(-1), type(FilterCharacter), range(false), min(0), max(0) {}
+
+   int col;
+   FilterType type;
+
+   // numeric bounds (range filters) or value
+   bool range;
+   double min;
+   double max;
+
+   // lower case text (character filters)
+   std::string text;
+};
+
+bool readNumber(const std::string& str, double* pValue)
+{
+   boost::optional<double> value = safe_convert::stringTo<double>(str);
+   if (!value)
+      return false;
+   *pValue = *value;
+   return true;
+}
+
+// reads a column filter as .rs.applyTransform does; returns false if the
+// filter can't be applied here, or sets pApply to false if it should be
+// ignored (as it would be by .rs.applyTransform)
+bool readFilter(const std::string& filter,
+                int col,
+                const DataColumn& column,
+                bool* pApply,
+                RowFilter* pFilter)
+{
+   *pApply = false;
+
+   std::size_t pipe = filter.find(kFilterSeparator);
+   if (pipe == std::string::npos)
+      return true;
+   std::string type = filter.substr(0, pipe);
+   std::string value = filter.substr(pipe + 1);
+   value = value.substr(0, value.find(kFilterSeparator));
+   if (value.empty())
+      return true;
+
+   bool numericColumn = column.type == ColumnNumeric ||
+                        column.type == ColumnInteger ||
+                        column.type == ColumnLogical;
+
+   pFilter->col = col;
+   if (type == "factor")
+   {
+      pFilter->type = FilterFactor;
+      if (!numericColumn && column.type != ColumnFactor)
+         return false;
+      if (!readNumber(value, &pFilter->min))
+         return false;
+   }
+   else if (type == "character")
+   {
+      pFilter->type = FilterCharacter;
+      if (!column.searchable)
+         return false;
+      pFilter->text = toLowerAscii(value);
+   }
+   else if (type == "numeric")
+   {
+      pFilter->type = FilterNumeric;
+      if (!numericColumn)
+         return false;
+      std::size_t separator = value.find('_');
+      pFilter->range = separator != std::string::npos;
+      if (!readNumber(value.substr(0, separator), &pFilter->min))
+         return false;
+      if (pFilter->range)
+      {
+         std::string max = value.substr(separator + 1);
+         if (!readNumber(max.substr(0, max.find('_')), &pFilter->max))
+            return false;
+      }
+   }
+   else if (type == "boolean")
+   {
+      pFilter->type = FilterBoolean;
+      if (!numericColumn)
+         return false;
+      pFilter->min = value == "TRUE" ? 1 : 0;
+   }
+   else
+   {
+      // unknown filter type
+      return true;
+   }
+
+   *pApply = true;
+   return true;
+}
+
+bool matches(const RowFilter& filter,
+             const DataColumn& column,
+             int row,
+             std::string* pBuffer)
+{
+   double value;
+   switch (filter.type)
+   {
+   case FilterFactor:
+   case FilterBoolean:
+      return numericValue(column, row, &value) && value == filter.min;
+
+   case FilterNumeric:
+      if (!numericValue(column, row, &value) || std::isinf(value))
+         return false;
+      if (filter.range)
+         return value >= filter.min && value <= filter.max;
+      return value == filter.min;
+
+   case FilterCharacter:
+   {
+      const char* text = cellText(column, row, pBuffer);
+      return text != NULL && containsIgnoreCase(text, filter.text);
+   }
+   }
+
+   return false;
+}
+
+} // anonymous namespace
+
+bool isFilterSubset(const std::string& outer, const std::string& inner)
+{
+   // shortcut for identical filters (the typical case)
+   if (inner == outer)
+      return true;
+
+   // find filter separators; if we can't find them, presume no subset since we
+   // can't parse filters
+   size_t outerPipe = outer.find(kFilterSeparator);
+   if (outerPipe == std::string::npos)
+      return false;
+   size_t innerPipe = inner.find(kFilterSeparator);
+   if (innerPipe == std::string::npos)
+      return false;
+
+   std::string outerType(outer.substr(0, outerPipe));
+   std::string innerType(inner.substr(0, innerPipe));
+   std::string outerValue(outer.substr(outerPipe + 1,
+            outer.length() - outerPipe));
+   std::string innerValue(inner.substr(innerPipe + 1,
+            inner.length() - innerPipe));
+
+   // only identical types can be subsets
+   if (outerType != innerType)
+      return false;
+
+   if (outerType == "numeric")
+   {
+      // matches a numeric filter (i.e. "2.71_3.14") -- in this case we need to
+      // check the components for range inclusion
+      boost::regex numFilter("(-?\\d+\\.?\\d*)_(-?\\d+\\.?\\d*)");
+      boost::smatch innerMatch, outerMatch;
+      if (regex_utils::search(innerValue, innerMatch, numFilter) &&
+          regex_utils::search(outerValue, outerMatch, numFilter))
+      {
+         // for numeric filters, the inner is a subset if its lower bound (1)
+         // is larger than the outer lower bound, and the upper bound (2) is
+         // smaller than the outer upper bound
+         return safe_convert::stringTo<double>(innerMatch[1], 0) >=
+                safe_convert::stringTo<double>(outerMatch[1], 0) &&
+                safe_convert::stringTo<double>(innerMatch[2], 0) <=
+                safe_convert::stringTo<double>(outerMatch[2], 0);
+      }
+
+      // if not identical and not a range, then not a subset
+      return false;
+   }
+   else if (outerType == "factor" || outerType == "boolean")
+   {
+      // factors and boolean values have to be identical for subsetting, and we
+      // already checked above
+      return false;
+   }
+   else if (outerType == "character")
+   {
+      // characters are a subset if the outer string is within the inner one
+      // (i.e. a seach for "walnuts" (inner) is within "walnut" (outer))
+      return inner.find(outer) != std::string::npos;
+   }
+
+   // unknown filter type
+   return false;
+}
+
+DataFrameIndex::DataFrameIndex(int nrow, int ncol,
+                               const ColumnSource& columnSource)
+   : nrow_(nrow),
+     ncol_(ncol),
+     columnSource_(columnSource),
+     selected_(false),
+     allRows_(true),
+     ordered_(false),
+     orderCol_(-1),
+     descending_(false)
+{
+}
+
+bool DataFrameIndex::select(const std::vector<std::string>& filters,
+                            const std::string& search,
+                            int orderCol,
+                            bool descending)
+{
+   dropReplacedColumns();
+
+   if (!filter(filters, search))
+      return false;
+
+   if (ordered_ && orderCol == orderCol_ && descending == descending_)
+      return true;
+
+   if (!order(orderCol, descending))
+      return false;
+
+   ordered_ = true;
+   orderCol_ = orderCol;
+   descending_ = descending;
+   return true;
+}
+
+void DataFrameIndex::dropReplacedColumns()
+{
+   typedef std::map<int, boost::shared_ptr<DataColumn> >::iterator iterator;
+   for (iterator it = columns_.begin(); it != columns_.end(); )
+   {
+      const DataColumn& column = *it->second;
+      if (!column.isCurrent || column.isCurrent())
+      {
+         ++it;
+         continue;
+      }
+
+      // drop the column's orders, and the selection and order (which may
+      // depend on its values)
+      int col = it->first;
+      typedef std::list<std::pair<int, std::vector<int> > >::iterator
+                                                            order_iterator;
+      for (order_iterator order = orders_.begin(); order != orders_.end(); )
+      {
+         if (order->first == col)
+            order = orders_.erase(order);
+         else
+            ++order;
+      }
+      selected_ = false;
+      ordered_ = false;
+
+      columns_.erase(it++);
+   }
+}
+
+const DataColumn& DataFrameIndex::column(int col)
+{
+   boost::shared_ptr<DataColumn>& pColumn = columns_[col];
+   if (!pColumn)
+   {
+      pColumn = columnSource_(col);
+      if (!pColumn)
+         pColumn = boost::make_shared<DataColumn>();
+   }
+   return *pColumn;
+}
+
+const std::vector<int>& DataFrameIndex::ascendingOrder(int col)
+{
+   typedef std::list<std::pair<int, std::vector<int> > >::iterator iterator;
+   for (iterator it = orders_.begin(); it != orders_.end(); ++it)
+   {
+      if (it->first == col)
+      {
+         orders_.splice(orders_.begin(), orders_, it);
+         return orders_.front().second;
+      }
+   }
+
+   orders_.push_front(std::make_pair(col, std::vector<int>()));
+   if (orders_.size() > kMaxCachedOrders)
+      orders_.pop_back();
+
+   std::vector<int>& order = orders_.front().second;
+   order.resize(nrow_);
+   for (int row = 0; row < nrow_; row++)
+      order[row] = row;
+   sortRows(column(col), &order);
+   return order;
+}
+
+bool DataFrameIndex::filter(const std::vector<std::string>& filters,
+                            const std::string& search)
+{
+   if (selected_ && filters == filters_ && search == search_)
+      return true;
+
+   // read the filters and check that we can apply them
+   std::vector<RowFilter> rowFilters;
+   for (std::size_t i = 0; i < filters.size(); i++)
+   {
+      if (filters[i].empty())
+         continue;
+
+      int col = static_cast<int>(i);
+      if (col >= ncol_)
+         return false;
+
+      bool apply;
+      RowFilter rowFilter;
+      if (!readFilter(filters[i], col, column(col), &apply, &rowFilter))
+         return false;
+      if (apply)
+         rowFilters.push_back(rowFilter);
+   }
+
+   std::string lowerSearch = toLowerAscii(search);
+   if (!search.empty())
+   {
+      for (int col = 0; col < ncol_; col++)
+      {
+         if (!column(col).searchable)
+            return false;
+      }
+   }
+
+   bool allRows = rowFilters.empty() && search.empty();
+   std::vector<int> selection;
+   if (!allRows)
+   {
+      // if the previous selection contains all of the rows which could match
+      // the new filters, we need only look at its rows
+      bool narrowed = selected_ && !allRows_ &&
+                      filters.size() == filters_.size() &&
+                      lowerSearch.find(toLowerAscii(search_)) != std::string::npos;
+      for (std::size_t i = 0; narrowed && i < filters.size(); i++)
+      {
+         narrowed = filters_[i].empty() || isFilterSubset(filters_[i], filters[i]);
+      }
+
+      std::vector<const DataColumn*> columns;
+      for (int col = 0; !search.empty() && col < ncol_; col++)
+         columns.push_back(&column(col));
+
+      std::string buffer;
+      int candidates = narrowed ? static_cast<int>(selection_.size()) : nrow_;
+      for (int i = 0; i < candidates; i++)
+      {
+         int row = narrowed ? selection_[i] : i;
+
+         bool match = true;
+         BOOST_FOREACH(const RowFilter& rowFilter, rowFilters)
+         {
+            if (!matches(rowFilter, column(rowFilter.col), row, &buffer))
+            {
+               match = false;
+               break;
+            }
+         }
+
+         if (match && !search.empty())
+         {
+            match = false;
+            BOOST_FOREACH(const DataColumn* pColumn, columns)
+            {
+               const char* text = cellText(*pColumn, row, &buffer);
+               if (text != NULL && containsIgnoreCase(text, lowerSearch))
+               {
+                  match = true;
+                  break;
+               }
+            }
+         }
+
+         if (match)
+            selection.push_back(row);
+      }
+   }
+
+   selected_ = true;
+   filters_ = filters;
+   search_ = search;
+   allRows_ = allRows;
+   selection_.swap(selection);
+   ordered_ = false;
+   return true;
+}
+
+bool DataFrameIndex::order(int orderCol, bool descending)
+{
+   if (orderCol < 0)
+   {
+      if (allRows_)
+      {
+         rows_.resize(nrow_);
+         for (int row = 0; row < nrow_; row++)
+            rows_[row] = row;
+      }
+      else
+      {
+         rows_ = selection_;
+      }
+      return true;
+   }
+
+   if (orderCol >= ncol_)
+      return false;
+   const DataColumn& orderColumn = column(orderCol);
+   if (orderColumn.type == ColumnUnsupported)
+      return false;
+
+   std::vector<int> ascending;
+   if (allRows_)
+   {
+      const std::vector<int>& order = ascendingOrder(orderCol);
+      if (!descending)
+      {
+         rows_ = order;
+         return true;
+      }
+      reverseRows(orderColumn, order, &rows_);
+      return true;
+   }
+
+   bool cached = false;
+   typedef std::list<std::pair<int, std::vector<int> > >::const_iterator iterator;
+   for (iterator it = orders_.begin(); it != orders_.end(); ++it)
+      cached = cached || it->first == orderCol;
+
+   if (cached || selection_.size() > static_cast<std::size_t>(nrow_ / 8))
+   {
+      // pick the selected rows out of the column's order
+      std::vector<char> selected(nrow_, 0);
+      BOOST_FOREACH(int row, selection_)
+      {
+         selected[row] = 1;
+      }
+
+      const std::vector<int>& order = ascendingOrder(orderCol);
+      ascending.reserve(selection_.size());
+      BOOST_FOREACH(int row, order)
+      {
+         if (selected[row])
+            ascending.push_back(row);
+      }
+   }
+   else
+   {
+      // few enough rows are selected that it's cheaper to sort them alone
+      ascending = selection_;
+      sortRows(orderColumn, &ascending);
+   }
+
+   if (descending)
+      reverseRows(orderColumn, ascending, &rows_);
+   else
+      rows_.swap(ascending);
+   return true;
+}
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
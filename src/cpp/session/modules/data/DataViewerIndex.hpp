@@ -0,0 +1,163 @@
+/*
+ * DataViewerIndex.hpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_DATA_VIEWER_INDEX_HPP
+#define SESSION_DATA_VIEWER_INDEX_HPP
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+enum ColumnType
+{
+   ColumnUnsupported,
+   ColumnNumeric,
+   ColumnInteger,
+   ColumnLogical,
+   ColumnFactor,
+   ColumnCharacter
+};
+
+// A view of the values of a data frame column (the values themselves are
+// owned by R and aren't copied, but are kept alive for as long as the view
+// is). Integer, logical and factor values use R's NA_INTEGER for missing
+// values; numeric values use R's NA_REAL.
+struct DataColumn
+{
+   DataColumn()
+      : type(ColumnUnsupported), searchable(false), pReal(NULL), pInteger(NULL)
+   {
+   }
+
+   ColumnType type;
+
+   // whether the column's values are displayed as they're formatted here
+   // (and can therefore be matched by the global search); false for classed
+   // columns such as dates, which can still be ordered by their values
+   bool searchable;
+
+   // numeric values
+   const double* pReal;
+
+   // integer and logical values, or factor codes
+   const int* pInteger;
+
+   // character values (NULL for NA) or factor levels
+   std::vector<const char*> strings;
+
+   // keeps the values above alive (e.g. by preserving the R vectors that
+   // hold them)
+   boost::shared_ptr<void> pValues;
+
+   // returns false once the column has been replaced within its frame (so
+   // that it needs to be read again); empty if it can't be replaced
+   boost::function<bool()> isCurrent;
+};
+
+// loads the given (0-based) column of a frame
+typedef boost::function<boost::shared_ptr<DataColumn>(int)> ColumnSource;
+
+// indicates whether the rows matching one filter string are a subset of the
+// rows matching another; e.g. if a column is filtered for "abc" and then
+// "abcd", the new state is a subset of the previous state.
+bool isFilterSubset(const std::string& outer, const std::string& inner);
+
+// Sorts and filters the rows of a data frame for the data viewer without
+// copying the frame: the rows to display are computed as a vector of row
+// indices, and pages of the frame are then read through it.
+//
+// The (stable) ascending order of each column sorted on is cached, so
+// changing the sort direction or the filters needn't sort again. The rows
+// selected by the current filters and search are also cached, and when the
+// filters are narrowed (e.g. a search for "abc" is extended to "abcd") only
+// those rows are examined.
+//
+// Columns which have been replaced within the frame since they were read
+// (e.g. by data.table's :=, which modifies the frame in place) are read
+// again, along with the orders and selection computed from them.
+//
+// Filters and the global search have the semantics of .rs.applyTransform
+// (NAs never match; text is matched case-insensitively, though only ASCII
+// characters are case folded). Where a filter or column can't be handled
+// here (e.g. list columns), select() returns false and the caller should
+// fall back to transforming the frame in R.
+class DataFrameIndex : boost::noncopyable
+{
+public:
+   DataFrameIndex(int nrow, int ncol, const ColumnSource& columnSource);
+
+   // select the rows matching the given column filters ("type|value", as
+   // sent by the client) and global search, ordered by the given (0-based)
+   // column or in frame order if orderCol is negative
+   bool select(const std::vector<std::string>& filters,
+               const std::string& search,
+               int orderCol,
+               bool descending);
+
+   // the (0-based) rows selected, in display order
+   const std::vector<int>& rows() const { return rows_; }
+
+   int nrow() const { return nrow_; }
+   int ncol() const { return ncol_; }
+
+private:
+   void dropReplacedColumns();
+   const DataColumn& column(int col);
+   const std::vector<int>& ascendingOrder(int col);
+
+   bool filter(const std::vector<std::string>& filters,
+               const std::string& search);
+   bool order(int orderCol, bool descending);
+
+   int nrow_;
+   int ncol_;
+   ColumnSource columnSource_;
+   std::map<int, boost::shared_ptr<DataColumn> > columns_;
+
+   // cached ascending orders, most recently used first
+   std::list<std::pair<int, std::vector<int> > > orders_;
+
+   // the rows (in frame order) matching the current filters and search
+   bool selected_;
+   std::vector<std::string> filters_;
+   std::string search_;
+   bool allRows_;
+   std::vector<int> selection_;
+
+   // the selected rows in the current order
+   bool ordered_;
+   int orderCol_;
+   bool descending_;
+   std::vector<int> rows_;
+};
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_DATA_VIEWER_INDEX_HPP
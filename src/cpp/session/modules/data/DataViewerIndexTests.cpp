@@ -0,0 +1,340 @@
+/*
+ * DataViewerIndexTests.cpp
+ *
+ * Copyright (C) 2009-18 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <cstring>
+#include <limits>
+#include <set>
+
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/make_shared.hpp>
+
+#include "DataViewerIndex.hpp"
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+namespace {
+
+const int kNA = std::numeric_limits<int>::min();
+
+// R's NA_REAL
+double naReal()
+{
+   boost::uint64_t bits = 0x7FF00000000007A2ULL;
+   double value;
+   std::memcpy(&value, &bits, sizeof(value));
+   return value;
+}
+
+// a frame of six rows:
+//
+//    price  count  name      kind  flag
+//    2.5    3      "Eggs"    b     TRUE
+//    NA     1      "bread"   a     FALSE
+//    10     NA     "eggnog"  b     NA
+//    2.5    2      NA        NA    TRUE
+//    -1     5      "Walnut"  c     FALSE
+//    1e5    3      "eggs"    a     TRUE
+struct TestFrame
+{
+   TestFrame()
+   {
+      double price[] = { 2.5, naReal(), 10, 2.5, -1, 1e5 };
+      int count[] = { 3, 1, kNA, 2, 5, 3 };
+      int kind[] = { 2, 1, 2, kNA, 3, 1 };
+      int flag[] = { 1, 0, kNA, 1, 0, 1 };
+      const char* name[] = { "Eggs", "bread", "eggnog", NULL, "Walnut", "eggs" };
+
+      prices.assign(price, price + 6);
+      counts.assign(count, count + 6);
+      kinds.assign(kind, kind + 6);
+      flags.assign(flag, flag + 6);
+      names.assign(name, name + 6);
+   }
+
+   bool isCurrent(int col, int version)
+   {
+      return version == static_cast<int>(replaced.count(col));
+   }
+
+   boost::shared_ptr<DataColumn> column(int col)
+   {
+      loads++;
+      boost::shared_ptr<DataColumn> pColumn = boost::make_shared<DataColumn>();
+      pColumn->searchable = true;
+      pColumn->isCurrent = boost::bind(&TestFrame::isCurrent, this, col,
+                                       static_cast<int>(replaced.count(col)));
+      switch (col)
+      {
+      case 0:
+         pColumn->type = ColumnNumeric;
+         pColumn->pReal = &prices[0];
+         break;
+      case 1:
+         pColumn->type = ColumnInteger;
+         pColumn->pInteger = replaced.count(col) ? &replacement[0] : &counts[0];
+         break;
+      case 2:
+         pColumn->type = ColumnCharacter;
+         pColumn->strings = names;
+         break;
+      case 3:
+         pColumn->type = ColumnFactor;
+         pColumn->pInteger = &kinds[0];
+         pColumn->strings.push_back("a");
+         pColumn->strings.push_back("b");
+         pColumn->strings.push_back("c");
+         break;
+      case 4:
+         pColumn->type = ColumnLogical;
+         pColumn->pInteger = &flags[0];
+         break;
+      default:
+         pColumn->searchable = false;
+         break;
+      }
+      return pColumn;
+   }
+
+   ColumnSource source()
+   {
+      return boost::bind(&TestFrame::column, this, _1);
+   }
+
+   std::vector<double> prices;
+   std::vector<int> counts;
+   std::vector<int> kinds;
+   std::vector<int> flags;
+   std::vector<const char*> names;
+   int loads = 0;
+
+   // the replacement for the count column, once it's been replaced
+   std::set<int> replaced;
+   std::vector<int> replacement;
+};
+
+std::vector<std::string> noFilters(int ncol = 5)
+{
+   return std::vector<std::string>(ncol);
+}
+
+std::vector<std::string> filter(int col, const std::string& value)
+{
+   std::vector<std::string> filters = noFilters();
+   filters[col] = value;
+   return filters;
+}
+
+std::vector<int> rows(int r1, int r2 = -1, int r3 = -1,
+                      int r4 = -1, int r5 = -1, int r6 = -1)
+{
+   int values[] = { r1, r2, r3, r4, r5, r6 };
+   std::vector<int> result;
+   for (int i = 0; i < 6 && values[i] >= 0; i++)
+      result.push_back(values[i]);
+   return result;
+}
+
+} // anonymous namespace
+
+context("Data viewer index")
+{
+   test_that("Columns are ordered with ties kept and missing values last")
+   {
+      TestFrame frame;
+      DataFrameIndex index(6, 5, frame.source());
+
+      expect_true(index.select(noFilters(), "", 0, false));
+      expect_true(index.rows() == rows(4, 0, 3, 2, 5, 1));
+
+      expect_true(index.select(noFilters(), "", 0, true));
+      expect_true(index.rows() == rows(5, 2, 0, 3, 4, 1));
+
+      expect_true(index.select(noFilters(), "", 1, true));
+      expect_true(index.rows() == rows(4, 0, 5, 3, 1, 2));
+
+      expect_true(index.select(noFilters(), "", 2, false));
+      // (strings are collated in the C locale here)
+      expect_true(index.rows() == rows(0, 4, 1, 2, 5, 3));
+
+      expect_true(index.select(noFilters(), "", 3, false));
+      expect_true(index.rows() == rows(1, 5, 0, 2, 4, 3));
+
+      expect_true(index.select(noFilters(), "", 4, true));
+      expect_true(index.rows() == rows(0, 3, 5, 1, 4, 2));
+   }
+
+   test_that("Filters are applied as they are in R")
+   {
+      TestFrame frame;
+      DataFrameIndex index(6, 5, frame.source());
+
+      expect_true(index.select(filter(0, "numeric|0_5"), "", -1, false));
+      expect_true(index.rows() == rows(0, 3));
+
+      expect_true(index.select(filter(0, "numeric|2.5"), "", -1, false));
+      expect_true(index.rows() == rows(0, 3));
+
+      expect_true(index.select(filter(1, "numeric|3"), "", -1, false));
+      expect_true(index.rows() == rows(0, 5));
+
+      expect_true(index.select(filter(2, "character|EGG"), "", -1, false));
+      expect_true(index.rows() == rows(0, 2, 5));
+
+      expect_true(index.select(filter(3, "factor|2"), "", -1, false));
+      expect_true(index.rows() == rows(0, 2));
+
+      expect_true(index.select(filter(4, "boolean|FALSE"), "", -1, false));
+      expect_true(index.rows() == rows(1, 4));
+
+      // filters without values or with unknown types are ignored
+      expect_true(index.select(filter(4, "boolean|"), "", -1, false));
+      expect_true(index.rows().size() == 6);
+      expect_true(index.select(filter(4, "unknown|1"), "", -1, false));
+      expect_true(index.rows().size() == 6);
+   }
+
+   test_that("The search matches values as R would format them")
+   {
+      TestFrame frame;
+      DataFrameIndex index(6, 5, frame.source());
+
+      expect_true(index.select(noFilters(), "1e+05", -1, false));
+      expect_true(index.rows() == rows(5));
+
+      expect_true(index.select(noFilters(), "2.5", -1, false));
+      expect_true(index.rows() == rows(0, 3));
+
+      expect_true(index.select(noFilters(), "walnut", -1, false));
+      expect_true(index.rows() == rows(4));
+
+      expect_true(index.select(noFilters(), "na", -1, false));
+      expect_true(index.rows().empty());
+
+      expect_true(index.select(noFilters(), "true", -1, false));
+      expect_true(index.rows() == rows(0, 3, 5));
+
+      // NaN is searched for as "NaN", whereas NA isn't searched
+      frame.prices[1] = std::numeric_limits<double>::quiet_NaN();
+      DataFrameIndex nanIndex(6, 5, frame.source());
+      expect_true(nanIndex.select(noFilters(), "nan", -1, false));
+      expect_true(nanIndex.rows() == rows(1));
+   }
+
+   test_that("Filters and search combine with ordering")
+   {
+      TestFrame frame;
+      DataFrameIndex index(6, 5, frame.source());
+
+      std::vector<std::string> filters = filter(2, "character|e");
+      expect_true(index.select(filters, "", 1, false));
+      expect_true(index.rows() == rows(1, 0, 5, 2));
+
+      filters[4] = "boolean|TRUE";
+      expect_true(index.select(filters, "", 1, true));
+      expect_true(index.rows() == rows(0, 5));
+
+      expect_true(index.select(filters, "eggs", 1, true));
+      expect_true(index.rows() == rows(0, 5));
+   }
+
+   test_that("Narrowed filters refine the previous selection")
+   {
+      TestFrame frame;
+      DataFrameIndex index(6, 5, frame.source());
+
+      expect_true(index.select(noFilters(), "egg", -1, false));
+      expect_true(index.rows() == rows(0, 2, 5));
+
+      // rows outside the previous selection aren't examined again
+      frame.names[4] = "eggs";
+      expect_true(index.select(noFilters(), "eggs", -1, false));
+      expect_true(index.rows() == rows(0, 5));
+
+      // but a wider search starts from scratch
+      expect_true(index.select(noFilters(), "gs", -1, false));
+      expect_true(index.rows() == rows(0, 5));
+   }
+
+   test_that("Columns are loaded once")
+   {
+      TestFrame frame;
+      DataFrameIndex index(6, 5, frame.source());
+      expect_true(index.select(noFilters(), "", 0, false));
+      expect_true(index.select(filter(0, "numeric|0_5"), "", 0, true));
+      expect_true(index.select(noFilters(), "egg", 0, true));
+      expect_true(frame.loads == 5);
+   }
+
+   test_that("Columns replaced in place are read again")
+   {
+      TestFrame frame;
+      DataFrameIndex index(6, 5, frame.source());
+      expect_true(index.select(noFilters(), "", 1, false));
+      expect_true(index.rows() == rows(1, 3, 0, 5, 4, 2));
+      expect_true(index.select(filter(1, "numeric|3_5"), "", 1, false));
+      expect_true(index.rows() == rows(0, 5, 4));
+      expect_true(frame.loads == 1);
+
+      // replace the count column (as data.table's := does, leaving the
+      // frame itself unchanged)
+      int counts[] = { 6, 5, 4, 3, 2, 1 };
+      frame.replacement.assign(counts, counts + 6);
+      frame.replaced.insert(1);
+
+      expect_true(index.select(filter(1, "numeric|3_5"), "", 1, false));
+      expect_true(index.rows() == rows(3, 2, 1));
+      expect_true(frame.loads == 2);
+
+      // the replacement is current
+      expect_true(index.select(noFilters(), "", 1, true));
+      expect_true(index.rows() == rows(0, 1, 2, 3, 4, 5));
+      expect_true(frame.loads == 2);
+   }
+
+   test_that("Unsupported columns fall back")
+   {
+      TestFrame frame;
+      DataFrameIndex index(6, 6, frame.source());
+      expect_true(index.select(noFilters(6), "", 1, false));
+      expect_false(index.select(noFilters(6), "", 5, false));
+      expect_false(index.select(noFilters(6), "egg", -1, false));
+
+      std::vector<std::string> filters = noFilters(6);
+      filters[2] = "numeric|1_2";
+      expect_false(index.select(filters, "", -1, false));
+   }
+
+   test_that("Filter subsets are detected")
+   {
+      expect_true(isFilterSubset("numeric|1_10", "numeric|2_5"));
+      expect_false(isFilterSubset("numeric|2_5", "numeric|1_10"));
+      expect_true(isFilterSubset("character|egg", "character|eggs"));
+      expect_false(isFilterSubset("character|eggs", "character|egg"));
+      expect_false(isFilterSubset("factor|1", "factor|2"));
+   }
+}
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
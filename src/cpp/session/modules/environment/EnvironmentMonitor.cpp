@@ -15,6 +15,10 @@
 
 #include "EnvironmentMonitor.hpp"
 
+#include <algorithm>
+
+#include <boost/foreach.hpp>
+
 #include <r/RSexp.hpp>
 #include <r/RInterface.hpp>
 #include <session/SessionModuleContext.hpp>
@@ -42,31 +46,36 @@ void enqueRefreshEvent()
    module_context::enqueClientEvent(refreshEvent);
 }
 
-// if the given variable is an unevaluated promise, add it to the given
-// list of variables
-void addUnevaledPromise(std::vector<r::sexp::Variable>* pEnv,
-                        const r::sexp::Variable& var)
+// can the description of the given variable be reused for as long as it
+// remains bound to the same (unshared) object?
+bool isDescriptionCacheable(SEXP env, const r::sexp::Variable& var)
 {
-   if (isUnevaluatedPromise(var.second))
+   SEXP varSEXP = var.second;
+   if (varSEXP == R_NilValue ||
+       varSEXP == R_UnboundValue ||
+       varSEXP == R_MissingArg)
    {
-      pEnv->push_back(var);
+      return false;
    }
-}
 
-// If the given variable exists in the given list, remove it. Compares on name
-// only.
-void removeVarFromList(std::vector<r::sexp::Variable>* pEnv,
-                       const r::sexp::Variable& var)
-{
-   for (std::vector<r::sexp::Variable>::iterator iter = pEnv->begin();
-        iter != pEnv->end(); iter++)
+   // objects with reference semantics can change without being rebound
+   switch (TYPEOF(varSEXP))
    {
-      if (iter->first == var.first)
-      {
-         pEnv->erase(iter);
-         break;
-      }
+   case ENVSXP:
+   case EXTPTRSXP:
+   case WEAKREFSXP:
+   case PROMSXP:
+   case S4SXP:
+      return false;
+   default:
+      break;
    }
+
+   // data.tables are modified in place by reference
+   if (r::sexp::inherits(varSEXP, "data.table"))
+      return false;
+
+   return !r::sexp::hasActiveBinding(var.first, env);
 }
 
 } // anonymous namespace
@@ -76,22 +85,52 @@ EnvironmentMonitor::EnvironmentMonitor() :
    refreshOnInit_(false)
 {}
 
-void EnvironmentMonitor::enqueRemovedEvent(const r::sexp::Variable& variable)
+void EnvironmentMonitor::enqueRemovedEvent(const std::string& name)
 {
-   ClientEvent removedEvent(client_events::kEnvironmentRemoved, variable.first);
+   ClientEvent removedEvent(client_events::kEnvironmentRemoved, name);
    module_context::enqueClientEvent(removedEvent);
 }
 
 void EnvironmentMonitor::enqueAssignedEvent(const r::sexp::Variable& variable)
 {
    // get object info
-   json::Value objInfo = varToJson(getMonitoredEnvironment(), variable);
+   json::Value objInfo = describeVariable(variable);
 
    // enque event
    ClientEvent assignedEvent(client_events::kEnvironmentAssigned, objInfo);
    module_context::enqueClientEvent(assignedEvent);
 }
 
+json::Value EnvironmentMonitor::describeVariable(
+                                       const r::sexp::Variable& variable)
+{
+   Descriptions::const_iterator it = descriptions_.find(variable.first);
+   if (it != descriptions_.end() && it->second.value == variable.second)
+      return it->second.json;
+
+   SEXP env = getMonitoredEnvironment();
+   json::Value description = varToJson(env, variable);
+
+   // describing an object can raise its NAMED count; record the count
+   // afterwards so that it isn't seen as a change when we next check
+   Bindings::iterator binding = lastEnv_.find(variable.first);
+   if (binding != lastEnv_.end() && binding->second.value == variable.second)
+      binding->second.named = NAMED(variable.second);
+
+   if (isDescriptionCacheable(env, variable))
+   {
+      Description& cached = descriptions_[variable.first];
+      cached.value = variable.second;
+      cached.json = description;
+   }
+   else
+   {
+      descriptions_.erase(variable.first);
+   }
+
+   return description;
+}
+
 void EnvironmentMonitor::setMonitoredEnvironment(SEXP pEnvironment,
                                                  bool refresh)
 {
@@ -100,6 +139,7 @@ void EnvironmentMonitor::setMonitoredEnvironment(SEXP pEnvironment,
       return;
 
    environment_.set(pEnvironment);
+   descriptions_.clear();
 
    // init the environment by doing an initial check for changes
    initialized_ = false;
@@ -120,121 +160,105 @@ bool EnvironmentMonitor::hasEnvironment()
 void EnvironmentMonitor::listEnv(std::vector<r::sexp::Variable>* pEnv)
 {
    r::sexp::Protect rProtect;
-   r::sexp::listEnvironment(getMonitoredEnvironment(),
-                            false,
-                            userSettings().showLastDotValue(),
-                            &rProtect,
-                            pEnv);
+   r::sexp::listEnvironmentUnsorted(getMonitoredEnvironment(),
+                                    false,
+                                    userSettings().showLastDotValue(),
+                                    &rProtect,
+                                    pEnv);
 }
 
 void EnvironmentMonitor::checkForChanges()
 {
-   // information about the current environment
-   std::vector<r::sexp::Variable> currentEnv ;
-   std::vector<r::sexp::Variable> currentPromises;
+   // get the set of variables in the current environment (in no particular
+   // order; only the variables that have changed are sorted)
+   std::vector<r::sexp::Variable> currentEnv;
+   listEnv(&currentEnv);
 
    // list of assigns/removes (includes both value changes and promise
    // evaluations)
    std::vector<r::sexp::Variable> addedVars;
-   std::vector<r::sexp::Variable> removedVars;
+   std::vector<std::string> removedVars;
 
-   // get the set of variables and promises in the current environment
-   listEnv(&currentEnv);
+   // compare each binding with its state when we last checked
+   Bindings currentBindings;
+   currentBindings.rehash(currentEnv.size());
+   BOOST_FOREACH(const r::sexp::Variable& var, currentEnv)
+   {
+      Binding binding;
+      binding.value = var.second;
+      binding.named = NAMED(var.second);
+      binding.unevaluatedPromise = isUnevaluatedPromise(var.second);
+      currentBindings[var.first] = binding;
+
+      Bindings::const_iterator last = lastEnv_.find(var.first);
+      if (last == lastEnv_.end() ||
+          last->second.value != binding.value ||
+          last->second.named != binding.named ||
+          (last->second.unevaluatedPromise && !binding.unevaluatedPromise))
+      {
+         addedVars.push_back(var);
+      }
+   }
 
-   // R returns an environment list sorted in dictionary order. Since the
-   // set difference algorithms below use simple string comparisons to
-   // establish order, we need to re-sort the list into canonical order
-   // to avoid the algorithms detecting superfluous insertions.
-   std::sort(currentEnv.begin(), currentEnv.end(), compareVarName);
+   for (Bindings::const_iterator it = lastEnv_.begin();
+        it != lastEnv_.end(); ++it)
+   {
+      if (currentBindings.find(it->first) == currentBindings.end())
+         removedVars.push_back(it->first);
+   }
+
+   // descriptions of changed objects are stale
+   BOOST_FOREACH(const r::sexp::Variable& var, addedVars)
+   {
+      descriptions_.erase(var.first);
+   }
+   BOOST_FOREACH(const std::string& var, removedVars)
+   {
+      descriptions_.erase(var);
+   }
 
-   std::for_each(currentEnv.begin(), currentEnv.end(),
-                 boost::bind(addUnevaledPromise, &currentPromises, _1));
+   bool lastEnvEmpty = lastEnv_.empty();
+   lastEnv_.swap(currentBindings);
 
-   bool refreshEnqueued = false;
    if (!initialized_)
    {
       if (refreshOnInit_ ||
           getMonitoredEnvironment() == R_GlobalEnv)
       {
          enqueRefreshEvent();
-         refreshEnqueued = true;
       }
       initialized_ = true;
       refreshOnInit_ = false;
    }
-   else
+   else if (!addedVars.empty() || !removedVars.empty())
    {
-      if (currentEnv != lastEnv_)
+      // optimize for empty currentEnv (user reset workspace) or empty
+      // lastEnv_ (startup) by just sending a single refresh event
+      // only do this for the global environment--while debugging local
+      // environments, the environment object list is sent down as part of
+      // the context depth event.
+      if ((currentEnv.empty() || lastEnvEmpty)
+          && getMonitoredEnvironment() == R_GlobalEnv)
       {
-         // optimize for empty currentEnv (user reset workspace) or empty
-         // lastEnv_ (startup) by just sending a single refresh event
-         // only do this for the global environment--while debugging local
-         // environments, the environment object list is sent down as part of
-         // the context depth event.
-         if ((currentEnv.empty() || lastEnv_.empty())
-             && getMonitoredEnvironment() == R_GlobalEnv)
-         {
-            enqueRefreshEvent();
-            refreshEnqueued = true;
-         }
-         else
-         {
-            std::set_difference(lastEnv_.begin(), lastEnv_.end(),
-                                currentEnv.begin(), currentEnv.end(),
-                                std::back_inserter(removedVars),
-                                compareVarName);
-
-            // fire removed event for deletes
-            std::for_each(removedVars.begin(),
-                          removedVars.end(),
-                          boost::bind(&EnvironmentMonitor::enqueRemovedEvent,
-                                      this, _1));
-
-            // remove deleted objects from the list of uneval'ed promises
-            // so we'll stop monitoring them for evaluation
-            std::for_each(removedVars.begin(),
-                          removedVars.end(),
-                          boost::bind(removeVarFromList, &unevaledPromises_, _1));
-
-            // find adds & assigns (all variable name/value combinations in the
-            // current environment but NOT in the previous environment)
-            std::set_difference(currentEnv.begin(), currentEnv.end(),
-                                lastEnv_.begin(), lastEnv_.end(),
-                                std::back_inserter(addedVars));
-
-            // remove assigned objects from the list of uneval'ed promises
-            // (otherwise, we double-assign in the case where a promise SEXP
-            // is simultaneously forced/evaluated and assigned a new value)
-            std::for_each(addedVars.begin(),
-                          addedVars.end(),
-                          boost::bind(removeVarFromList, &unevaledPromises_, _1));
-
-         }
+         enqueRefreshEvent();
       }
-      // if a refresh is scheduled there's no need to emit add events one by one
-      if (!refreshEnqueued)
+      else
       {
-         // have any promises been evaluated since we last checked?
-         if (currentPromises != unevaledPromises_)
+         // fire removed event for deletes
+         std::sort(removedVars.begin(), removedVars.end());
+         BOOST_FOREACH(const std::string& var, removedVars)
          {
-            // for each promise that is in the set of promises we are monitoring
-            // for evaluation but not in the set of currently tracked promises,
-            // we assume this to be an eval--process as an assign
-            std::set_difference(unevaledPromises_.begin(), unevaledPromises_.end(),
-                                currentPromises.begin(), currentPromises.end(),
-                                std::back_inserter(addedVars));
+            enqueRemovedEvent(var);
          }
 
          // fire assigned event for adds, assigns, and promise evaluations
-         std::for_each(addedVars.begin(),
-                       addedVars.end(),
-                       boost::bind(&EnvironmentMonitor::enqueAssignedEvent,
-                                    this, _1));
+         std::sort(addedVars.begin(), addedVars.end(), compareVarName);
+         BOOST_FOREACH(const r::sexp::Variable& var, addedVars)
+         {
+            enqueAssignedEvent(var);
+         }
       }
    }
-
-   unevaledPromises_ = currentPromises;
-   lastEnv_ = currentEnv;
 }
 
 } // namespace environment
@@ -13,6 +13,12 @@
  *
  */
 
+#include <string>
+
+#include <boost/unordered_map.hpp>
+
+#include <core/json/Json.hpp>
+
 #include <r/RSexp.hpp>
 #include <r/RInterface.hpp>
 
@@ -31,13 +37,37 @@ public:
    SEXP getMonitoredEnvironment();
    bool hasEnvironment();
    void checkForChanges();
+
+   // describe a variable in the monitored environment (reusing the previous
+   // description of its value when the value can't have changed)
+   core::json::Value describeVariable(const r::sexp::Variable& variable);
+
 private:
+   // what we remember about each binding between checks; a binding has
+   // changed when it refers to a different object, when the object's NAMED
+   // count changes (since objects which aren't shared may be modified in
+   // place), or when a promise it refers to has been evaluated
+   struct Binding
+   {
+      SEXP value;
+      int named;
+      bool unevaluatedPromise;
+   };
+   typedef boost::unordered_map<std::string, Binding> Bindings;
+
+   struct Description
+   {
+      SEXP value;
+      core::json::Value json;
+   };
+   typedef boost::unordered_map<std::string, Description> Descriptions;
+
    void listEnv(std::vector<r::sexp::Variable>* pEnvironment);
-   void enqueRemovedEvent(const r::sexp::Variable& variable);
+   void enqueRemovedEvent(const std::string& name);
    void enqueAssignedEvent(const r::sexp::Variable& variable);
 
-   std::vector<r::sexp::Variable> lastEnv_;
-   std::vector<r::sexp::Variable> unevaledPromises_;
+   Bindings lastEnv_;
+   Descriptions descriptions_;
    r::sexp::PreservedSEXP environment_;
    bool initialized_;
    bool refreshOnInit_;
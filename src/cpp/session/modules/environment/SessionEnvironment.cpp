@@ -375,11 +375,13 @@ json::Array environmentListAsJson()
                           &rProtect,
                           &vars);
 
-       // get object details and transform to json
+       // get object details and transform to json (reusing the
+       // descriptions of objects which haven't changed)
        std::transform(vars.begin(),
                       vars.end(),
                       std::back_inserter(listJson),
-                      boost::bind(varToJson, env, _1));
+                      boost::bind(&EnvironmentMonitor::describeVariable,
+                                  s_pEnvironmentMonitor, _1));
     }
 
     return listJson;
@@ -35,7 +35,8 @@ namespace {
 // supervisor is a module level static so that we can terminateChildren
 // upon exit of the session (otherwise we could leave a long running
 // operation still hogging cpu after we exit)
-core::system::ProcessSupervisor s_processSupervisor;
+core::system::ProcessSupervisor s_processSupervisor(
+                              core::system::supervisor_mode::EventDriven);
 
 void onBackgroundProcessing(bool)
 {